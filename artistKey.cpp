@@ -0,0 +1,77 @@
+#include "artistKey.h"
+#include <QHash>
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <QDebug>
+
+namespace {
+
+// bumped when normalise() changes, so stored keys are recomputed
+const int RULES_VERSION = 1;
+
+QHash<QString, QString> aliases;    // normalised alias -> normalised artist
+int rules = RULES_VERSION;
+
+QString normalise(const QString &artist) {
+    QString name = artist.normalized(QString::NormalizationForm_C).toCaseFolded().simplified();
+    static const char *articles[] = { "the", "a", "an" };
+    for (int i = 0; i < 3; i++) {
+        QString article = QLatin1String(articles[i]);
+        // "beatles, the", and "the beatles" unless the article is all there is
+        if (name.endsWith(QString(", ") + article)) {
+            return name.left(name.size() - article.size() - 2);
+        }
+        if (name.size() > article.size() + 1 && name.startsWith(article + QLatin1Char(' '))) {
+            return name.mid(article.size() + 1);
+        }
+    }
+    return name;
+}
+
+}
+
+QString artistKey(const QString &artist) {
+    QString key = normalise(artist);
+    return aliases.value(key, key);
+}
+
+void loadArtistAliases(const QString &fileName) {
+    aliases.clear();
+    rules = RULES_VERSION;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return;
+    }
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    QStringList lines;
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        int separator = line.indexOf(QLatin1Char('='));
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')) || separator < 0) {
+            continue;
+        }
+        QString alias = normalise(line.left(separator));
+        QString target = normalise(line.mid(separator + 1));
+        if (!alias.isEmpty() && !target.isEmpty() && alias != target) {
+            aliases.insert(alias, target);
+            lines.append(alias + QLatin1Char('=') + target);
+        }
+    }
+    // "a = b" and "b = c": a is c too. Chains longer than the number of
+    // aliases are cycles, those are left where they stop.
+    QHash<QString, QString>::iterator it;
+    for (it = aliases.begin(); it != aliases.end(); ++it) {
+        for (int hops = 0; hops < aliases.size() && aliases.contains(it.value()); hops++) {
+            it.value() = aliases.value(it.value());
+        }
+    }
+    lines.sort();
+    rules = (int)(qHash(lines.join(QLatin1String("\n"))) & 0x3fffffff) + RULES_VERSION;
+    //qDebug() << "loadArtistAliases:" << aliases.size() << "aliases from" << fileName;
+}
+
+int artistKeyRules() {
+    return rules;
+}
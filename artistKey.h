@@ -0,0 +1,25 @@
+#pragma once
+#include "debug.h"
+#include <QString>
+
+/*
+ * artistKey() is what the library groups songs by artist on: "The Beatles",
+ * "Beatles, The" and "the  beatles" all give "beatles". The name is put in
+ * Unicode NFC and case folded, spaces are collapsed and a leading or trailing
+ * article ("The", "A", "An") is dropped. What's left is looked up in the
+ * aliases, which map other spellings to one artist ("Prince and the
+ * Revolution = Prince").
+ *
+ * The key is stored next to the name in MUSICLIBRARY, so the tree finds an
+ * artist's node with one hash lookup. artistKeyRules() changes whenever the
+ * aliases (or these rules) do, and the stored keys are worked out again.
+ */
+const char * const ARTIST_ALIASES_FILE = "AAMusicPlayer_ARTISTALIASES.txt";
+
+QString artistKey(const QString &artist);
+
+// "alias = artist" per line, blank lines and lines starting with # are skipped
+void loadArtistAliases(const QString &fileName = ARTIST_ALIASES_FILE);
+
+// identifies the aliases and the rules, never 0
+int artistKeyRules();
@@ -0,0 +1,716 @@
+#include "audioEngine.h"
+#include "sampleKernels.h"
+#include <QAudioDecoder>
+#include <QAudioBuffer>
+#include <QAudioOutput>
+#include <QAudioDeviceInfo>
+#include <QTimer>
+#include <QDebug>
+#include <string.h>
+#include <qmath.h>
+
+//--------------------DecodeWorker---------------------
+DecodeWorker::DecodeWorker(RingBuffer *ring, const QAudioFormat &format)
+    : QObject(0), ring(ring), format(format), decoder(0), retryTimer(0) {
+    pendingOffset = 0;
+    skipBytes = 0;
+    primeBytes = 0;
+    generation = 0;
+    isPrimed = false;
+    decoderDone = false;
+}
+
+DecodeWorker::~DecodeWorker() {
+    delete decoder;
+}
+
+void DecodeWorker::start(QString absFilePath, qint64 skip, int prime, int gen) {
+    // the decoder and timer are created here so they belong to the decode thread
+    if (!decoder) {
+        decoder = new QAudioDecoder(this);
+        decoder->setAudioFormat(format);
+        connect(decoder, SIGNAL(bufferReady()), this, SLOT(bufferReady()));
+        connect(decoder, SIGNAL(finished()), this, SLOT(decodeFinished()));
+        connect(decoder, SIGNAL(error(QAudioDecoder::Error)), this, SLOT(decodeError()));
+        connect(decoder, SIGNAL(durationChanged(qint64)), this, SIGNAL(durationChanged(qint64)));
+        retryTimer = new QTimer(this);
+        retryTimer->setInterval(5);
+        connect(retryTimer, SIGNAL(timeout()), this, SLOT(drainPending()));
+    }
+    stop();
+    skipBytes = skip;
+    primeBytes = prime;
+    generation = gen;
+    isPrimed = false;
+    decoderDone = false;
+    decoder->setSourceFilename(absFilePath);
+    decoder->start();
+}
+
+void DecodeWorker::stop() {
+    if (decoder) {
+        decoder->stop();
+    }
+    if (retryTimer) {
+        retryTimer->stop();
+    }
+    pending.clear();
+    pendingOffset = 0;
+}
+
+void DecodeWorker::bufferReady() {
+    // don't take more from the decoder while the last buffer is still waiting
+    if (!pending.isEmpty() || !decoder->bufferAvailable()) {
+        return;
+    }
+    QAudioBuffer buffer = decoder->read();
+    if (!buffer.isValid()) {
+        return;
+    }
+    const char *data = buffer.constData<char>();
+    int len = buffer.byteCount();
+    if (skipBytes > 0) {
+        int dropped = (int)qMin(skipBytes, (qint64)len);
+        skipBytes -= dropped;
+        data += dropped;
+        len -= dropped;
+    }
+    push(data, len);
+}
+
+void DecodeWorker::push(const char *data, int len) {
+    int written = ring->write(data, len);
+    if (written < len) {
+        pending = QByteArray(data + written, len - written);
+        pendingOffset = 0;
+        retryTimer->start();
+    }
+    if (!isPrimed && (ring->available() >= primeBytes || ring->freeSpace() == 0)) {
+        isPrimed = true;
+        emit(primed(generation));
+    }
+}
+
+void DecodeWorker::drainPending() {
+    if (!pending.isEmpty()) {
+        pendingOffset += ring->write(pending.constData() + pendingOffset, pending.size() - pendingOffset);
+        if (pendingOffset < pending.size()) {
+            return;
+        }
+        pending.clear();
+        pendingOffset = 0;
+    }
+    retryTimer->stop();
+    if (decoder->bufferAvailable()) {
+        bufferReady();
+    }
+    else if (decoderDone) {
+        emit(finished(generation));
+    }
+}
+
+void DecodeWorker::decodeFinished() {
+    decoderDone = true;
+    if (!isPrimed) {
+        // short track, everything fits in the ring
+        isPrimed = true;
+        emit(primed(generation));
+    }
+    if (pending.isEmpty()) {
+        emit(finished(generation));
+    }
+}
+
+void DecodeWorker::decodeError() {
+    emit(error(decoder->errorString()));
+    stop();
+}
+
+//--------------------RingBufferDevice---------------------
+// the engine always decodes to 16-bit stereo
+static const int CHANNELS = 2;
+static const int BYTES_PER_FRAME = CHANNELS * sizeof(qint16);
+// crossfade mixing is done in chunks of this many frames (~23ms at 44.1kHz)
+static const int FADE_CHUNK_FRAMES = 1024;
+
+RingBufferDevice::RingBufferDevice(RingBuffer *ring0, RingBuffer *ring1, QObject *parent)
+    : QIODevice(parent), starving(false) {
+    rings[0] = ring0;
+    rings[1] = ring1;
+    decodeDone[0].store(0);
+    decodeDone[1].store(0);
+    active.store(0);
+    fading.store(0);
+    xruns.store(0);
+    tapRing.store(0);
+    setSlotGain(0, 1.0f);
+    setSlotGain(1, 1.0f);
+    fadeFrames = 0;
+    fadeDoneFrames = 0;
+    fadeCurve = LINEAR;
+    // sized once here so the audio thread never allocates
+    pcmOut.resize(FADE_CHUNK_FRAMES * CHANNELS);
+    pcmIn.resize(FADE_CHUNK_FRAMES * CHANNELS);
+    mixOut.resize(FADE_CHUNK_FRAMES * CHANNELS);
+    mixIn.resize(FADE_CHUNK_FRAMES * CHANNELS);
+}
+
+void RingBufferDevice::setDecodeFinished(int slot, bool done) {
+    decodeDone[slot].storeRelease(done ? 1 : 0);
+}
+
+int RingBufferDevice::activeSlot() const {
+    return active.loadAcquire();
+}
+
+int RingBufferDevice::underruns() const {
+    return xruns.load();
+}
+
+void RingBufferDevice::resetUnderruns() {
+    xruns.store(0);
+}
+
+void RingBufferDevice::startCrossfade(qint64 frames, FadeCurve curve) {
+    fadeFrames = qMax(frames, (qint64)1);
+    fadeDoneFrames = 0;
+    fadeCurve = curve;
+    fading.storeRelease(1);
+}
+
+void RingBufferDevice::cancelCrossfade() {
+    fading.storeRelease(0);
+}
+
+bool RingBufferDevice::isCrossfading() const {
+    return fading.loadAcquire();
+}
+
+void RingBufferDevice::setSlotGain(int slot, float gain) {
+    int bits;
+    memcpy(&bits, &gain, sizeof(bits));
+    gainBits[slot].storeRelease(bits);
+}
+
+void RingBufferDevice::setTap(RingBuffer *tap) {
+    tapRing.storeRelease(tap);
+}
+
+float RingBufferDevice::slotGain(int slot) const {
+    int bits = gainBits[slot].loadAcquire();
+    float gain;
+    memcpy(&gain, &bits, sizeof(gain));
+    return gain;
+}
+
+qint64 RingBufferDevice::readData(char *data, qint64 maxlen) {
+    qint64 n;
+    if (fading.loadAcquire()) {
+        n = readCrossfade(data, maxlen);
+        if (!fading.loadAcquire() && n < maxlen) {
+            // the fade finished part way, continue from the new track
+            n += readSlot(active.loadAcquire(), data + n, maxlen - n);
+        }
+    }
+    else {
+        n = readSlot(active.loadAcquire(), data, maxlen);
+    }
+    RingBuffer *tap = tapRing.loadAcquire();
+    if (tap && n > 0) {
+        tap->write(data, (int)n);
+    }
+    return n;
+}
+
+qint64 RingBufferDevice::readSlot(int slot, char *data, qint64 maxlen) {
+    int n = rings[slot]->read(data, (int)maxlen);
+    float gain = slotGain(slot);
+    if (gain != 1.0f) {
+        // scale in place, through float so a boost clips instead of wrapping
+        const SampleKernels &k = sampleKernels();
+        qint16 *pcm = (qint16 *)data;
+        int samples = n / sizeof(qint16);
+        for (int done = 0; done < samples; done += mixOut.size()) {
+            int chunk = qMin(samples - done, mixOut.size());
+            k.s16ToFloat(pcm + done, mixOut.data(), chunk);
+            k.applyGain(mixOut.data(), chunk, gain);
+            k.floatToS16(mixOut.constData(), pcm + done, chunk);
+        }
+    }
+    if (n == maxlen) {
+        starving = false;
+        return n;
+    }
+    if (decodeDone[slot].loadAcquire()) {
+        // end of track: let the output go idle once the ring is empty
+        if (n == 0) {
+            emit(drained());
+        }
+        return n;
+    }
+    // decoder fell behind, pad with silence and count the underrun once
+    if (!starving) {
+        starving = true;
+        xruns.ref();
+    }
+    memset(data + n, 0, maxlen - n);
+    return maxlen;
+}
+
+qint64 RingBufferDevice::readCrossfade(char *data, qint64 maxlen) {
+    const SampleKernels &k = sampleKernels();
+    int out = active.loadAcquire();
+    int in = 1 - out;
+    qint64 frames = qMin(maxlen / BYTES_PER_FRAME, fadeFrames - fadeDoneFrames);
+    qint64 written = 0;
+
+    while (frames > 0) {
+        int chunk = (int)qMin(frames, (qint64)FADE_CHUNK_FRAMES);
+        int bytes = chunk * BYTES_PER_FRAME;
+        int samples = chunk * CHANNELS;
+
+        // the outgoing track may end a little early, that's just silence
+        int got = rings[out]->read((char *)pcmOut.data(), bytes);
+        memset((char *)pcmOut.data() + got, 0, bytes - got);
+        got = rings[in]->read((char *)pcmIn.data(), bytes);
+        if (got < bytes && !decodeDone[in].loadAcquire()) {
+            if (!starving) {
+                starving = true;
+                xruns.ref();
+            }
+        }
+        else {
+            starving = false;
+        }
+        memset((char *)pcmIn.data() + got, 0, bytes - got);
+
+        float outFrom, inFrom, outTo, inTo;
+        fadeGains(fadeDoneFrames, outFrom, inFrom);
+        fadeGains(fadeDoneFrames + chunk, outTo, inTo);
+        float outGain = slotGain(out), inGain = slotGain(in);
+        outFrom *= outGain;
+        outTo *= outGain;
+        inFrom *= inGain;
+        inTo *= inGain;
+        k.s16ToFloat(pcmOut.constData(), mixOut.data(), samples);
+        k.s16ToFloat(pcmIn.constData(), mixIn.data(), samples);
+        k.applyGainRamp(mixOut.data(), samples, outFrom, outTo);
+        k.mixGainRamp(mixOut.data(), mixIn.constData(), samples, inFrom, inTo);
+        k.floatToS16(mixOut.constData(), (qint16 *)(data + written), samples);
+
+        fadeDoneFrames += chunk;
+        written += bytes;
+        frames -= chunk;
+    }
+
+    if (fadeDoneFrames >= fadeFrames) {
+        // drop whatever is left of the outgoing track and switch over
+        rings[out]->skip(rings[out]->available());
+        active.storeRelease(in);
+        fading.storeRelease(0);
+        emit(crossfadeDone());
+    }
+    return written;
+}
+
+void RingBufferDevice::fadeGains(qint64 frame, float &out, float &in) const {
+    float p = qMin((float)frame / fadeFrames, 1.0f);
+    if (fadeCurve == EQUAL_POWER) {
+        // constant perceived loudness through the fade
+        out = cosf(p * (float)M_PI_2);
+        in = sinf(p * (float)M_PI_2);
+    }
+    else {
+        out = 1.0f - p;
+        in = p;
+    }
+}
+
+qint64 RingBufferDevice::writeData(const char *data, qint64 len) {
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return -1;
+}
+
+//--------------------AudioEngine---------------------
+AudioEngine::AudioEngine(QObject *parent) : QObject(parent), output(0) {
+    audioFormat.setSampleRate(44100);
+    audioFormat.setChannelCount(CHANNELS);
+    audioFormat.setSampleSize(16);
+    audioFormat.setSampleType(QAudioFormat::SignedInt);
+    audioFormat.setByteOrder(QAudioFormat::LittleEndian);
+    audioFormat.setCodec("audio/pcm");
+
+    for (int slot = 0; slot < 2; slot++) {
+        slotDuration[slot] = 0;
+        slotGeneration[slot] = 0;
+        replayGain[slot] = 1.0f;
+        decoding[slot] = false;
+    }
+    curState = QMediaPlayer::StoppedState;
+    startOffsetMs = 0;
+    processedBaseUs = 0;
+    generation = 0;
+    ringMs = 500;
+    vol = 100;
+    muted = false;
+    outputStarted = false;
+    fadeMs = 0;
+    fadeCurve = RingBufferDevice::EQUAL_POWER;
+    nextRequested = false;
+    analysisTap = 0;
+    createPipeline();
+
+    output = new QAudioOutput(audioFormat, this);
+    output->setNotifyInterval(100);
+    connect(output, SIGNAL(notify()), this, SLOT(notify()));
+}
+
+AudioEngine::~AudioEngine() {
+    haltPipeline();
+    destroyPipeline();
+    delete output;
+}
+
+void AudioEngine::createPipeline() {
+    for (int slot = 0; slot < 2; slot++) {
+        ring[slot] = new RingBuffer(audioFormat.bytesForDuration((qint64)ringMs*1000));
+    }
+    device = new RingBufferDevice(ring[0], ring[1], this);
+    device->open(QIODevice::ReadOnly);
+    device->setSlotGain(0, replayGain[0]);
+    device->setSlotGain(1, replayGain[1]);
+    device->setTap(analysisTap);
+    connect(device, SIGNAL(drained()), this, SLOT(drained()));
+    connect(device, SIGNAL(crossfadeDone()), this, SLOT(crossfadeDone()));
+
+    for (int slot = 0; slot < 2; slot++) {
+        worker[slot] = new DecodeWorker(ring[slot], audioFormat);
+        worker[slot]->moveToThread(&decodeThread[slot]);
+        connect(&decodeThread[slot], SIGNAL(finished()), worker[slot], SLOT(deleteLater()));
+        connect(worker[slot], SIGNAL(primed(int)), this, SLOT(primed(int)));
+        connect(worker[slot], SIGNAL(finished(int)), this, SLOT(decodeFinished(int)));
+        connect(worker[slot], SIGNAL(durationChanged(qint64)), this, SLOT(workerDurationChanged(qint64)));
+        connect(worker[slot], SIGNAL(error(QString)), this, SIGNAL(error(QString)));
+        decodeThread[slot].start();
+    }
+}
+
+void AudioEngine::destroyPipeline() {
+    // the workers are deleted on their own threads when those finish
+    for (int slot = 0; slot < 2; slot++) {
+        decodeThread[slot].quit();
+        decodeThread[slot].wait();
+        worker[slot] = 0;
+    }
+    delete device;
+    delete ring[0];
+    delete ring[1];
+}
+
+bool AudioEngine::isAvailable() const {
+    return QAudioDeviceInfo::defaultOutputDevice().isFormatSupported(audioFormat);
+}
+
+void AudioEngine::setMedia(const QString &path) {
+    stop();
+    int cur = device->activeSlot();
+    slotPath[cur] = path;
+    slotDuration[cur] = 0;
+    emit(durationChanged(0));
+}
+
+QString AudioEngine::media() const {
+    return slotPath[device->activeSlot()];
+}
+
+QMediaPlayer::State AudioEngine::state() const {
+    return curState;
+}
+
+qint64 AudioEngine::position() const {
+    if (!outputStarted) {
+        return startOffsetMs;
+    }
+    return startOffsetMs + (output->processedUSecs() - processedBaseUs)/1000;
+}
+
+qint64 AudioEngine::duration() const {
+    return slotDuration[device->activeSlot()];
+}
+
+const QAudioFormat &AudioEngine::format() const {
+    return audioFormat;
+}
+
+void AudioEngine::setBufferMs(int ms) {
+    // resizing the rings is only safe while nothing is reading or writing them
+    qint64 pos = position();
+    bool wasPlaying = (curState == QMediaPlayer::PlayingState);
+    QString path = media();
+    qint64 dur = duration();
+    haltPipeline();
+    destroyPipeline();
+    ringMs = ms;
+    createPipeline();
+    slotPath[0] = path;
+    slotDuration[0] = dur;
+    slotPath[1].clear();
+    startOffsetMs = pos;
+    if (wasPlaying) {
+        startDecoding(0, path, pos);
+    }
+}
+
+int AudioEngine::bufferMs() const {
+    return ringMs;
+}
+
+qreal AudioEngine::fillLevel() const {
+    RingBuffer *r = ring[device->activeSlot()];
+    return (qreal)r->available() / r->capacity();
+}
+
+int AudioEngine::underruns() const {
+    return device->underruns();
+}
+
+qint64 AudioEngine::latencyMs() const {
+    // decoded but not yet heard: what's in the ring plus the device buffer
+    qint64 queued = ring[device->activeSlot()]->available();
+    if (outputStarted) {
+        queued += output->bufferSize() - output->bytesFree();
+    }
+    return audioFormat.durationForBytes(queued)/1000;
+}
+
+void AudioEngine::setCrossfade(int ms, RingBufferDevice::FadeCurve curve) {
+    fadeMs = ms;
+    fadeCurve = curve;
+}
+
+int AudioEngine::crossfadeMs() const {
+    return fadeMs;
+}
+
+void AudioEngine::crossfadeTo(const QString &absFilePath, qreal gainDb) {
+    // start decoding the incoming track now; the fade itself starts in
+    // checkCrossfade() once it is primed and the outgoing one is close to its end
+    if (curState != QMediaPlayer::PlayingState || device->isCrossfading()) {
+        return;
+    }
+    int next = 1 - device->activeSlot();
+    slotDuration[next] = 0;
+    replayGain[next] = (float)qPow(10.0, gainDb/20.0);
+    device->setSlotGain(next, replayGain[next]);
+    startDecoding(next, absFilePath, 0);
+}
+
+void AudioEngine::setAnalysisTap(RingBuffer *tap) {
+    analysisTap = tap;
+    device->setTap(tap);
+}
+
+void AudioEngine::setReplayGain(qreal gainDb) {
+    int cur = device->activeSlot();
+    replayGain[cur] = (float)qPow(10.0, gainDb/20.0);
+    device->setSlotGain(cur, replayGain[cur]);
+}
+
+void AudioEngine::play() {
+    int cur = device->activeSlot();
+    if (slotPath[cur].isEmpty()) {
+        return;
+    }
+    if (curState == QMediaPlayer::PausedState && outputStarted) {
+        output->resume();
+        setState(QMediaPlayer::PlayingState);
+        return;
+    }
+    if (curState != QMediaPlayer::PlayingState) {
+        haltPipeline();
+        startDecoding(cur, slotPath[cur], startOffsetMs);
+        setState(QMediaPlayer::PlayingState);
+    }
+}
+
+void AudioEngine::pause() {
+    if (curState == QMediaPlayer::PlayingState) {
+        if (outputStarted) {
+            output->suspend();
+        }
+        setState(QMediaPlayer::PausedState);
+    }
+}
+
+void AudioEngine::stop() {
+    haltPipeline();
+    startOffsetMs = 0;
+    setState(QMediaPlayer::StoppedState);
+    emit(positionChanged(0));
+}
+
+void AudioEngine::setPosition(qint64 ms) {
+    // QAudioDecoder can't seek, so restart it and drop everything before ms
+    if (curState == QMediaPlayer::StoppedState) {
+        startOffsetMs = ms;
+        return;
+    }
+    int cur = device->activeSlot();
+    haltPipeline();
+    startDecoding(cur, slotPath[cur], ms);
+    setState(QMediaPlayer::PlayingState);
+}
+
+void AudioEngine::setVolume(int volume) {
+    vol = volume;
+    applyVolume();
+}
+
+void AudioEngine::setMuted(bool mute) {
+    muted = mute;
+    applyVolume();
+}
+
+void AudioEngine::startDecoding(int slot, const QString &path, qint64 fromMs) {
+    haltSlot(slot);
+    slotPath[slot] = path;
+    if (slot == device->activeSlot()) {
+        startOffsetMs = fromMs;
+        device->resetUnderruns();
+    }
+    decoding[slot] = true;
+    device->setDecodeFinished(slot, false);
+    qint64 skipBytes = audioFormat.bytesForDuration(fromMs*1000);
+    // start the output once half the ring is filled
+    int primeBytes = ring[slot]->capacity()/2;
+    slotGeneration[slot] = ++generation;
+    QMetaObject::invokeMethod(worker[slot], "start", Qt::QueuedConnection,
+                              Q_ARG(QString, path), Q_ARG(qint64, skipBytes),
+                              Q_ARG(int, primeBytes), Q_ARG(int, slotGeneration[slot]));
+}
+
+void AudioEngine::haltSlot(int slot) {
+    // stop the decoder before touching the ring, the worker is its only writer
+    if (decoding[slot]) {
+        QMetaObject::invokeMethod(worker[slot], "stop", Qt::BlockingQueuedConnection);
+        decoding[slot] = false;
+    }
+    slotGeneration[slot] = 0;
+    // the active ring is only reset once the output stopped pulling from it
+    if (slot != device->activeSlot() || !outputStarted) {
+        ring[slot]->reset();
+    }
+}
+
+void AudioEngine::haltPipeline() {
+    if (outputStarted) {
+        output->stop();
+        outputStarted = false;
+    }
+    device->cancelCrossfade();
+    int cur = device->activeSlot();
+    haltSlot(cur);
+    haltSlot(1 - cur);
+    slotPath[1 - cur].clear();
+    processedBaseUs = 0;
+    nextRequested = false;
+}
+
+void AudioEngine::primed(int gen) {
+    int cur = device->activeSlot();
+    if (gen == slotGeneration[cur] && !outputStarted) {
+        applyVolume();
+        processedBaseUs = 0;
+        output->start(device);
+        outputStarted = true;
+        if (curState == QMediaPlayer::PausedState) {
+            output->suspend();
+        }
+    }
+    else if (gen == slotGeneration[1 - cur]) {
+        checkCrossfade();
+    }
+}
+
+void AudioEngine::decodeFinished(int gen) {
+    for (int slot = 0; slot < 2; slot++) {
+        if (gen == slotGeneration[slot]) {
+            device->setDecodeFinished(slot, true);
+        }
+    }
+}
+
+void AudioEngine::drained() {
+    if (curState != QMediaPlayer::PlayingState || !outputStarted || device->isCrossfading()) {
+        return;
+    }
+    haltPipeline();
+    startOffsetMs = 0;
+    setState(QMediaPlayer::StoppedState);
+    emit(endOfMedia());
+}
+
+void AudioEngine::crossfadeDone() {
+    // the incoming slot is now the active one, retire the outgoing decoder
+    int cur = device->activeSlot();
+    haltSlot(1 - cur);
+    slotPath[1 - cur].clear();
+    nextRequested = false;
+    emit(durationChanged(slotDuration[cur]));
+    emit(currentMediaChanged(slotPath[cur]));
+}
+
+void AudioEngine::notify() {
+    emit(positionChanged(position()));
+    checkCrossfade();
+#if DEBUG_PIPELINE
+    qDebug() << "AudioEngine: fill=" << fillLevel() << " xruns=" << underruns()
+             << " latencyMs=" << latencyMs();
+#endif
+}
+
+void AudioEngine::checkCrossfade() {
+    int cur = device->activeSlot();
+    if (fadeMs <= 0 || curState != QMediaPlayer::PlayingState || !outputStarted ||
+        device->isCrossfading() || slotDuration[cur] <= 0) {
+        return;
+    }
+    qint64 remaining = slotDuration[cur] - position();
+    // ask for the next track early enough for it to be decoded and primed
+    if (!nextRequested && remaining <= fadeMs + ringMs + 1000) {
+        nextRequested = true;
+        emit(aboutToFinish());
+        return;
+    }
+    int next = 1 - cur;
+    if (decoding[next] && ring[next]->available() >= ring[next]->capacity()/2 && remaining <= fadeMs) {
+        // fade over exactly what is left of the outgoing track; from here on
+        // the position and duration shown are the incoming track's
+        processedBaseUs = output->processedUSecs();
+        startOffsetMs = 0;
+        device->startCrossfade(audioFormat.framesForDuration(qMax(remaining, (qint64)1)*1000), fadeCurve);
+        emit(durationChanged(slotDuration[next]));
+    }
+}
+
+void AudioEngine::workerDurationChanged(qint64 ms) {
+    int slot = (sender() == worker[0]) ? 0 : 1;
+    if (ms > 0) {
+        slotDuration[slot] = ms;
+        if (slot == device->activeSlot()) {
+            emit(durationChanged(ms));
+        }
+    }
+}
+
+void AudioEngine::setState(QMediaPlayer::State newState) {
+    if (curState != newState) {
+        curState = newState;
+        emit(stateChanged(curState));
+    }
+}
+
+void AudioEngine::applyVolume() {
+    output->setVolume(muted ? 0 : vol/100.0);
+}
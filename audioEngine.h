@@ -0,0 +1,232 @@
+#pragma once
+#include "debug.h"
+#include "ringBuffer.h"
+#include <QObject>
+#include <QIODevice>
+#include <QThread>
+#include <QVector>
+#include <QAtomicPointer>
+#include <QAudioFormat>
+#include <QMediaPlayer>
+
+class QAudioDecoder;
+class QAudioOutput;
+class QTimer;
+class AudioEngine;
+
+/*
+ * DecodeWorker lives on one of the engine's decode threads. It pulls buffers
+ * out of a QAudioDecoder and pushes them into its ring buffer; when the ring
+ * is full it holds on to the current buffer and stops reading from the
+ * decoder, which in turn stalls the decoder until the output has drained some.
+ */
+class DecodeWorker : public QObject {
+    Q_OBJECT
+
+public:
+    DecodeWorker(RingBuffer *ring, const QAudioFormat &format);
+    ~DecodeWorker();
+
+public slots:
+    void start(QString absFilePath, qint64 skipBytes, int primeBytes, int generation);
+    void stop();
+
+signals:
+    void durationChanged(qint64 ms);
+    void primed(int generation);
+    void finished(int generation);
+    void error(QString msg);
+
+private slots:
+    void bufferReady();
+    void decodeFinished();
+    void decodeError();
+    void drainPending();
+
+private:
+    void push(const char *data, int len);
+
+    RingBuffer *ring;
+    QAudioFormat format;
+    QAudioDecoder *decoder;
+    QTimer *retryTimer;
+    QByteArray pending;     // part of the last buffer that didn't fit in ring
+    int pendingOffset;
+    qint64 skipBytes;       // decoded bytes still to drop after a seek
+    int primeBytes;
+    int generation;         // tags signals so stale ones from a restart are ignored
+    bool isPrimed;
+    bool decoderDone;
+};
+
+/*
+ * Pull-mode source for QAudioOutput, reading on the audio thread from the
+ * ring of the active decode slot. If that ring runs dry before its decoder has
+ * finished, it pads with silence so the device keeps running and counts an
+ * underrun (xrun).
+ *
+ * During a crossfade it reads both slots, mixes them in float with the
+ * sample kernels and, once the fade is complete, makes the incoming slot the
+ * active one and emits crossfadeDone().
+ */
+class RingBufferDevice : public QIODevice {
+    Q_OBJECT
+
+public:
+    enum FadeCurve {LINEAR, EQUAL_POWER};
+
+    RingBufferDevice(RingBuffer *ring0, RingBuffer *ring1, QObject *parent = 0);
+    void setDecodeFinished(int slot, bool done);
+    int activeSlot() const;
+    int underruns() const;
+    void resetUnderruns();
+
+    // only call this while the output isn't pulling
+    void cancelCrossfade();
+    // may be called while playing, the fade starts at the next read
+    void startCrossfade(qint64 frames, FadeCurve curve);
+    bool isCrossfading() const;
+    // linear gain applied to everything read from a slot, 1 leaves it untouched
+    void setSlotGain(int slot, float gain);
+    // copy of the output for analysis; skipped when the ring is full, never blocks
+    void setTap(RingBuffer *tap);
+
+signals:
+    void drained();
+    void crossfadeDone();
+
+protected:
+    virtual qint64 readData(char *data, qint64 maxlen);
+    virtual qint64 writeData(const char *data, qint64 len);
+
+private:
+    qint64 readSlot(int slot, char *data, qint64 maxlen);
+    qint64 readCrossfade(char *data, qint64 maxlen);
+    void fadeGains(qint64 frame, float &out, float &in) const;
+    float slotGain(int slot) const;
+
+    RingBuffer *rings[2];
+    QAtomicInt decodeDone[2];
+    QAtomicInt active;
+    QAtomicInt fading;
+    QAtomicInt xruns;
+    QAtomicInt gainBits[2];     // float bit patterns, so the audio thread can read them lock-free
+    QAtomicPointer<RingBuffer> tapRing;
+    bool starving;
+
+    // crossfade state, written before `fading` is released
+    qint64 fadeFrames;
+    qint64 fadeDoneFrames;
+    FadeCurve fadeCurve;
+    QVector<qint16> pcmOut, pcmIn;
+    QVector<float> mixOut, mixIn;
+};
+
+/*
+ * AudioEngine is the alternative to QMediaPlayer: QAudioDecoder on a decode
+ * thread -> lock-free RingBuffer -> QAudioOutput. It mirrors the subset of the
+ * QMediaPlayer interface the Player uses, and exposes the buffer fill level,
+ * underrun count and end-to-end latency for tuning.
+ *
+ * There are two decode slots so the next track can be decoded while the
+ * current one is still playing. With a crossfade configured, the engine emits
+ * aboutToFinish() ahead of the end of the track; if crossfadeTo() is called in
+ * response, the two tracks are mixed over the crossfade duration and
+ * currentMediaChanged() is emitted instead of endOfMedia().
+ */
+class AudioEngine : public QObject {
+    Q_OBJECT
+
+public:
+    AudioEngine(QObject *parent = 0);
+    ~AudioEngine();
+
+    bool isAvailable() const;
+    void setMedia(const QString &absFilePath);
+    QString media() const;
+    QMediaPlayer::State state() const;
+    qint64 position() const;
+    qint64 duration() const;
+    const QAudioFormat &format() const;
+
+    // tuning and statistics
+    void setBufferMs(int ms);
+    int bufferMs() const;
+    qreal fillLevel() const;
+    int underruns() const;
+    qint64 latencyMs() const;
+
+    // crossfade, 0 ms disables it
+    void setCrossfade(int ms, RingBufferDevice::FadeCurve curve);
+    int crossfadeMs() const;
+    void crossfadeTo(const QString &absFilePath, qreal gainDb = 0);
+
+    // ReplayGain of the current track in dB, applied in software so it can boost too
+    void setReplayGain(qreal gainDb);
+
+    // the output is also copied into tap (16-bit stereo), e.g. for a spectrum analyser
+    void setAnalysisTap(RingBuffer *tap);
+
+public slots:
+    void play();
+    void pause();
+    void stop();
+    void setPosition(qint64 ms);
+    void setVolume(int volume);
+    void setMuted(bool muted);
+
+signals:
+    void stateChanged(QMediaPlayer::State);
+    void positionChanged(qint64);
+    void durationChanged(qint64);
+    void endOfMedia();
+    void aboutToFinish();
+    void currentMediaChanged(QString);
+    void error(QString);
+
+private slots:
+    void primed(int generation);
+    void decodeFinished(int generation);
+    void drained();
+    void crossfadeDone();
+    void notify();
+    void workerDurationChanged(qint64 ms);
+
+private:
+    void createPipeline();
+    void destroyPipeline();
+    void startDecoding(int slot, const QString &path, qint64 fromMs);
+    void haltSlot(int slot);
+    void haltPipeline();
+    void checkCrossfade();
+    void setState(QMediaPlayer::State newState);
+    void applyVolume();
+
+    QAudioFormat audioFormat;
+    QThread decodeThread[2];
+    DecodeWorker *worker[2];
+    RingBuffer *ring[2];
+    RingBufferDevice *device;
+    QAudioOutput *output;
+
+    // per decode slot
+    QString slotPath[2];
+    qint64 slotDuration[2];
+    int slotGeneration[2];
+    float replayGain[2];    // linear ReplayGain, kept here so it survives setBufferMs()
+    RingBuffer *analysisTap;
+    bool decoding[2];
+
+    QMediaPlayer::State curState;
+    qint64 startOffsetMs;   // position the current decode started from
+    qint64 processedBaseUs; // output time at which the current track started
+    int generation;
+    int ringMs;
+    int vol;
+    bool muted;
+    bool outputStarted;
+
+    int fadeMs;
+    RingBufferDevice::FadeCurve fadeCurve;
+    bool nextRequested;     // aboutToFinish() already emitted for this track
+};
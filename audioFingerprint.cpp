@@ -0,0 +1,183 @@
+#include "audioFingerprint.h"
+#include "fft.h"
+#include "sampleKernels.h"
+#include <QtAlgorithms>
+#include <QtEndian>
+#include <qmath.h>
+#include <string.h>
+
+const double AudioFingerprint::MATCH_THRESHOLD = 0.35;
+
+//--------------------AudioFingerprint---------------------
+AudioFingerprint::AudioFingerprint() {
+}
+
+AudioFingerprint::AudioFingerprint(const QVector<quint32> &subFingerprints) : subs(subFingerprints) {
+}
+
+bool AudioFingerprint::isEmpty() const {
+    return subs.isEmpty();
+}
+
+int AudioFingerprint::size() const {
+    return subs.size();
+}
+
+const QVector<quint32> &AudioFingerprint::values() const {
+    return subs;
+}
+
+QVector<quint32> AudioFingerprint::indexKeys() const {
+    QVector<quint32> keys;
+    for (int i = 0; i < subs.size(); i += INDEX_STRIDE) {
+        quint32 key = subs[i];
+        if (key != 0 && key != 0xffffffffu && !keys.contains(key)) {
+            keys.append(key);
+        }
+    }
+    return keys;
+}
+
+double AudioFingerprint::bitErrorRate(const AudioFingerprint &other, int maxShift) const {
+    const quint32 *a = subs.constData();
+    const quint32 *b = other.subs.constData();
+    double best = 1.0;
+    for (int shift = -maxShift; shift <= maxShift; shift++) {
+        // a[i] lines up with b[i + shift]
+        int from = qMax(0, -shift);
+        int to = qMin(subs.size(), other.subs.size() - shift);
+        int count = to - from;
+        if (count < FRAMES_PER_SECOND) {
+            continue;
+        }
+        int errors = 0;
+        for (int i = from; i < to; i++) {
+            errors += qPopulationCount(a[i] ^ b[i + shift]);
+        }
+        best = qMin(best, errors / (32.0 * count));
+    }
+    return best;
+}
+
+bool AudioFingerprint::matches(const AudioFingerprint &other) const {
+    return bitErrorRate(other) < MATCH_THRESHOLD;
+}
+
+QByteArray AudioFingerprint::toByteArray() const {
+    QByteArray data(subs.size() * 4, 0);
+    uchar *out = (uchar *)data.data();
+    for (int i = 0; i < subs.size(); i++) {
+        qToLittleEndian(subs[i], out + 4*i);
+    }
+    return data;
+}
+
+AudioFingerprint AudioFingerprint::fromByteArray(const QByteArray &data) {
+    QVector<quint32> subs(data.size() / 4);
+    const uchar *in = (const uchar *)data.constData();
+    for (int i = 0; i < subs.size(); i++) {
+        subs[i] = qFromLittleEndian<quint32>(in + 4*i);
+    }
+    return AudioFingerprint(subs);
+}
+
+//--------------------FingerprintSink---------------------
+FingerprintSink::FingerprintSink() {
+    fft = 0;
+    rate = 0;
+    maxSubs = AudioFingerprint::WINDOW_MS / 1000 * AudioFingerprint::FRAMES_PER_SECOND;
+    monoStart = 0;
+    energyFloor = 0.0f;
+    frameCount = 0;
+}
+
+FingerprintSink::~FingerprintSink() {
+    delete fft;
+}
+
+void FingerprintSink::start(int sampleRate) {
+    // ~90ms frames whatever the rate, so files at different rates line up
+    rate = sampleRate;
+    int n = rate > 24000 ? 4096 : 2048;
+    fft = new Fft(n);
+    re.resize(n);
+    im.resize(n);
+    window.resize(n);
+    for (int i = 0; i < n; i++) {
+        window[i] = (float)(0.5 - 0.5 * qCos(2.0 * M_PI * i / n));
+    }
+    bandBins.resize(BANDS + 1);
+    for (int b = 0; b <= BANDS; b++) {
+        double hz = 300.0 * qPow(2000.0 / 300.0, (double)b / BANDS);
+        int bin = qBound(1, qRound(hz * n / rate), n/2);
+        bandBins[b] = b > 0 ? qMax(bin, bandBins[b-1] + 1) : bin;
+    }
+    // 70 dB under a full scale sine, so near silence doesn't produce noise bits
+    energyFloor = (n / 4.0f) * (n / 4.0f) * 1e-7f;
+}
+
+bool FingerprintSink::consume(const float *samples, int frames, int channels, int sampleRate) {
+    if (!fft) {
+        start(sampleRate);
+    }
+    int old = mono.size();
+    mono.resize(old + frames);
+    float *out = mono.data() + old;
+    if (channels == 1) {
+        memcpy(out, samples, frames * sizeof(float));
+    } else {
+        float scale = 1.0f / channels;
+        for (int i = 0; i < frames; i++) {
+            float sum = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                sum += samples[i * channels + c];
+            }
+            out[i] = sum * scale;
+        }
+    }
+    analyse();
+    return subs.size() < maxSubs;
+}
+
+void FingerprintSink::analyse() {
+    const SampleKernels &k = sampleKernels();
+    const int n = fft->size();
+    qint64 frameStart = (qint64)frameCount * rate / AudioFingerprint::FRAMES_PER_SECOND;
+    while (subs.size() < maxSubs && frameStart + n <= monoStart + mono.size()) {
+        memcpy(re.data(), mono.constData() + (frameStart - monoStart), n * sizeof(float));
+        k.applyWindow(re.data(), window.constData(), n);
+        memset(im.data(), 0, n * sizeof(float));
+        fft->forward(re.data(), im.data());
+
+        float *e = energies[frameCount & 1];
+        const float *prev = energies[(frameCount + 1) & 1];
+        for (int b = 0; b < BANDS; b++) {
+            float sum = 0.0f;
+            for (int i = bandBins[b]; i < bandBins[b+1]; i++) {
+                sum += re[i] * re[i] + im[i] * im[i];
+            }
+            e[b] = qMax(sum, energyFloor);
+        }
+        if (frameCount > 0) {
+            quint32 bits = 0;
+            for (int b = 0; b < BANDS - 1; b++) {
+                if ((e[b] - e[b+1]) - (prev[b] - prev[b+1]) > 0.0f) {
+                    bits |= 1u << b;
+                }
+            }
+            subs.append(bits);
+        }
+        frameCount++;
+        frameStart = (qint64)frameCount * rate / AudioFingerprint::FRAMES_PER_SECOND;
+    }
+    // drop what no future frame needs
+    int drop = (int)qMin(frameStart - monoStart, (qint64)mono.size());
+    if (drop > 0) {
+        mono.remove(0, drop);
+        monoStart += drop;
+    }
+}
+
+AudioFingerprint FingerprintSink::fingerprint() const {
+    return AudioFingerprint(subs);
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "debug.h"
+#include "pcmDecoder.h"
+#include <QByteArray>
+#include <QVector>
+
+class Fft;
+
+/*
+ * AudioFingerprint is a compact acoustic fingerprint of the opening
+ * WINDOW_MS of a track: one 32-bit sub-fingerprint every 1/64 s, each bit
+ * telling whether the energy difference of two neighbouring bands (33 log
+ * spaced bands from 300 Hz to 2 kHz) went up or down since the previous
+ * sub-fingerprint. That survives re-encoding and resampling, so copies of a
+ * recording match with a low bit error rate while unrelated audio is close
+ * to 0.5.
+ */
+class AudioFingerprint {
+public:
+    static const int WINDOW_MS = 20000;
+    static const int FRAMES_PER_SECOND = 64;
+    // every INDEX_STRIDE-th sub-fingerprint goes into the lookup index
+    static const int INDEX_STRIDE = 16;
+    // bit error rate under which two fingerprints are the same recording
+    static const double MATCH_THRESHOLD;
+
+    AudioFingerprint();
+    AudioFingerprint(const QVector<quint32> &subFingerprints);
+
+    bool isEmpty() const;
+    int size() const;
+    const QVector<quint32> &values() const;
+    // the keys this fingerprint is found under in the index, without
+    // silence (all bits equal) and duplicates
+    QVector<quint32> indexKeys() const;
+
+    // lowest bit error rate over all alignments up to maxShift
+    // sub-fingerprints apart, 1.0 if they overlap by less than a second
+    double bitErrorRate(const AudioFingerprint &other, int maxShift = 32) const;
+    bool matches(const AudioFingerprint &other) const;
+
+    // little endian, 4 bytes per sub-fingerprint, as stored in the database
+    QByteArray toByteArray() const;
+    static AudioFingerprint fromByteArray(const QByteArray &data);
+
+private:
+    QVector<quint32> subs;
+};
+
+/*
+ * FingerprintSink fingerprints the audio of a PcmDecoder run, and stops the
+ * decode once the window is complete.
+ */
+class FingerprintSink : public PcmSink {
+public:
+    FingerprintSink();
+    ~FingerprintSink();
+
+    bool consume(const float *samples, int frames, int channels, int sampleRate);
+    AudioFingerprint fingerprint() const;
+
+private:
+    void start(int sampleRate);
+    void analyse();
+
+    static const int BANDS = 33;
+
+    Fft *fft;
+    int rate;
+    int maxSubs;
+    QVector<float> mono;        // downmixed input, mono[0] is sample monoStart
+    qint64 monoStart;
+    QVector<float> window;
+    QVector<float> re, im;
+    QVector<int> bandBins;      // first bin of every band, plus one past the last
+    float energies[2][BANDS];
+    float energyFloor;
+    QVector<quint32> subs;
+    int frameCount;
+};
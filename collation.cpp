@@ -0,0 +1,103 @@
+#include "collation.h"
+#include "parallelSort.h"
+
+namespace {
+
+// cached keys, dropped all at once when there are more
+const int MAX_KEYS = 200000;
+
+struct KeyLess {
+    KeyLess(const QVector<QCollatorSortKey> &sortKeys) : keys(&sortKeys) {}
+    bool operator()(int a, int b) const {
+        return keys->at(a).compare(keys->at(b)) < 0;
+    }
+    const QVector<QCollatorSortKey> *keys;
+};
+
+struct RankLess {
+    RankLess(const QVector<int> &sortRanks) : ranks(sortRanks.constData()) {}
+    bool operator()(int a, int b) const {
+        return ranks[a] < ranks[b];
+    }
+    const int *ranks;
+};
+
+}
+
+Collation::Collation() {
+    collator.setCaseSensitivity(Qt::CaseInsensitive);
+    collator.setNumericMode(true);
+}
+
+Collation *Collation::instance() {
+    static Collation collation;
+    return &collation;
+}
+
+QCollatorSortKey Collation::key(const QString &text) {
+    QHash<QString, QCollatorSortKey>::const_iterator it = keys.constFind(text);
+    if (it != keys.constEnd()) {
+        return it.value();
+    }
+    if (keys.size() >= MAX_KEYS) {
+        keys.clear();
+    }
+    return keys.insert(text, collator.sortKey(text)).value();
+}
+
+bool Collation::lessThan(const QString &a, const QString &b) {
+    return key(a).compare(key(b)) < 0;
+}
+
+QVector<int> Collation::ranks(const QStringList &strings) {
+    // one key per distinct string, the distinct strings are what gets sorted
+    QHash<QString, int> distinct;
+    QVector<int> slot(strings.size());
+    QVector<QCollatorSortKey> sortKeys;
+    for (int i = 0; i < strings.size(); i++) {
+        QHash<QString, int>::const_iterator it = distinct.constFind(strings[i]);
+        if (it == distinct.constEnd()) {
+            it = distinct.insert(strings[i], sortKeys.size());
+            sortKeys.append(key(strings[i]));
+        }
+        slot[i] = it.value();
+    }
+    QVector<int> order(sortKeys.size());
+    for (int i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    parallelStableSort(order, KeyLess(sortKeys));
+    QVector<int> rankOf(order.size());
+    int rank = 0;
+    for (int i = 0; i < order.size(); i++) {
+        if (i > 0 && sortKeys[order[i-1]].compare(sortKeys[order[i]]) != 0) {
+            rank = i;
+        }
+        rankOf[order[i]] = rank;
+    }
+    QVector<int> result(strings.size());
+    for (int i = 0; i < strings.size(); i++) {
+        result[i] = rankOf[slot[i]];
+    }
+    return result;
+}
+
+QVector<int> Collation::order(const QStringList &strings) {
+    QVector<int> rank = ranks(strings);
+    QVector<int> order(strings.size());
+    for (int i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    parallelStableSort(order, RankLess(rank));
+    return order;
+}
+
+void Collation::sort(QStringList &strings) {
+    QVector<int> sortedOrder = order(strings);
+    QStringList sorted;
+    sorted.reserve(strings.size());
+    for (int i = 0; i < sortedOrder.size(); i++) {
+        sorted.append(strings[sortedOrder[i]]);
+    }
+    strings = sorted;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "debug.h"
+#include <QCollator>
+#include <QCollatorSortKey>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/*
+ * Collation orders names the way the user's locale does, ignoring case and
+ * comparing the numbers in titles by value ("Track 9" before "Track 10"),
+ * for the playlist's column sort and the library tree. The locale's sort
+ * key of a string is computed once and kept, after that comparing two
+ * strings compares their keys.
+ *
+ * Sorting many strings goes through ranks(): each distinct string gets its
+ * key once, they are sorted once, and callers then compare plain ints.
+ * There's one per application, for the GUI thread.
+ */
+class Collation {
+public:
+    static Collation *instance();
+
+    QCollatorSortKey key(const QString &text);
+    bool lessThan(const QString &a, const QString &b);
+    // position of each of strings in collation order, equal strings (as
+    // far as the locale is concerned) get the same rank
+    QVector<int> ranks(const QStringList &strings);
+    // indexes of strings in collation order, equal ones in the order given
+    QVector<int> order(const QStringList &strings);
+    void sort(QStringList &strings);
+
+private:
+    Collation();
+
+    QCollator collator;
+    QHash<QString, QCollatorSortKey> keys;
+};
@@ -0,0 +1,321 @@
+#include "compressedBitmap.h"
+#include <QtAlgorithms>
+#include <algorithm>
+
+CompressedBitmap::CompressedBitmap() {
+}
+
+int CompressedBitmap::find(quint16 key) const {
+    // ids mostly come in ascending order, they're in the last container
+    int high = containers.size();
+    if (high > 0 && containers[high-1].key <= key) {
+        return containers[high-1].key == key ? high-1 : -high-1;
+    }
+    int low = 0;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (containers[middle].key < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < containers.size() && containers[low].key == key ? low : -low-1;
+}
+
+void CompressedBitmap::add(quint32 id) {
+    quint16 key = id >> 16;
+    quint16 low = id & 0xFFFF;
+    int i = find(key);
+    if (i < 0) {
+        i = -i-1;
+        Container c;
+        c.key = key;
+        c.cardinality = 0;
+        containers.insert(i, c);
+    }
+    Container &c = containers[i];
+    if (!c.bits.isEmpty()) {
+        quint64 mask = Q_UINT64_C(1) << (low & 63);
+        if (!(c.bits[low >> 6] & mask)) {
+            c.bits[low >> 6] |= mask;
+            c.cardinality++;
+        }
+        return;
+    }
+    if (c.array.isEmpty() || c.array.last() < low) {
+        c.array.append(low);
+    } else {
+        QVector<quint16>::iterator at = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (*at == low) {
+            return;
+        }
+        c.array.insert(at, low);
+    }
+    c.cardinality++;
+    if (c.cardinality > ARRAY_MAX) {
+        toBits(c);
+    }
+}
+
+void CompressedBitmap::remove(quint32 id) {
+    int i = find(id >> 16);
+    if (i < 0) {
+        return;
+    }
+    quint16 low = id & 0xFFFF;
+    Container &c = containers[i];
+    if (!c.bits.isEmpty()) {
+        quint64 mask = Q_UINT64_C(1) << (low & 63);
+        if (!(c.bits[low >> 6] & mask)) {
+            return;
+        }
+        c.bits[low >> 6] &= ~mask;
+        c.cardinality--;
+        // not right at ARRAY_MAX, or a set going up and down across it
+        // would convert every time
+        if (c.cardinality <= ARRAY_MAX / 2) {
+            toArray(c);
+        }
+    } else {
+        QVector<quint16>::iterator at = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (at == c.array.end() || *at != low) {
+            return;
+        }
+        c.array.erase(at);
+        c.cardinality--;
+    }
+    if (c.cardinality == 0) {
+        containers.remove(i);
+    }
+}
+
+bool CompressedBitmap::contains(quint32 id) const {
+    int i = find(id >> 16);
+    if (i < 0) {
+        return false;
+    }
+    quint16 low = id & 0xFFFF;
+    const Container &c = containers[i];
+    if (!c.bits.isEmpty()) {
+        return c.bits[low >> 6] & (Q_UINT64_C(1) << (low & 63));
+    }
+    return std::binary_search(c.array.begin(), c.array.end(), low);
+}
+
+int CompressedBitmap::count() const {
+    int n = 0;
+    for (int i = 0; i < containers.size(); i++) {
+        n += containers[i].cardinality;
+    }
+    return n;
+}
+
+bool CompressedBitmap::isEmpty() const {
+    return containers.isEmpty();
+}
+
+void CompressedBitmap::clear() {
+    containers.clear();
+}
+
+QVector<quint32> CompressedBitmap::toVector() const {
+    QVector<quint32> ids;
+    ids.reserve(count());
+    foreach (const Container &c, containers) {
+        quint32 high = (quint32)c.key << 16;
+        if (c.bits.isEmpty()) {
+            foreach (quint16 low, c.array) {
+                ids.append(high | low);
+            }
+            continue;
+        }
+        for (int w = 0; w < WORDS; w++) {
+            quint64 word = c.bits[w];
+            while (word) {
+                ids.append(high | (w << 6) | qCountTrailingZeroBits(word));
+                word &= word - 1;
+            }
+        }
+    }
+    return ids;
+}
+
+void CompressedBitmap::toBits(Container &c) {
+    c.bits.fill(0, WORDS);
+    foreach (quint16 low, c.array) {
+        c.bits[low >> 6] |= Q_UINT64_C(1) << (low & 63);
+    }
+    c.array = QVector<quint16>();
+}
+
+void CompressedBitmap::toArray(Container &c) {
+    c.array.clear();
+    c.array.reserve(c.cardinality);
+    for (int w = 0; w < WORDS; w++) {
+        quint64 word = c.bits[w];
+        while (word) {
+            c.array.append((w << 6) | qCountTrailingZeroBits(word));
+            word &= word - 1;
+        }
+    }
+    c.bits = QVector<quint64>();
+}
+
+CompressedBitmap::Container CompressedBitmap::intersect(const Container &a, const Container &b) {
+    Container c;
+    c.key = a.key;
+    c.cardinality = 0;
+    if (!a.bits.isEmpty() && !b.bits.isEmpty()) {
+        c.bits.resize(WORDS);
+        for (int w = 0; w < WORDS; w++) {
+            c.bits[w] = a.bits[w] & b.bits[w];
+            c.cardinality += qPopulationCount(c.bits[w]);
+        }
+        if (c.cardinality <= ARRAY_MAX) {
+            toArray(c);
+        }
+    } else if (!a.bits.isEmpty() || !b.bits.isEmpty()) {
+        // the array's values looked up in the bitset
+        const Container &array = a.bits.isEmpty() ? a : b;
+        const Container &bitset = a.bits.isEmpty() ? b : a;
+        foreach (quint16 low, array.array) {
+            if (bitset.bits[low >> 6] & (Q_UINT64_C(1) << (low & 63))) {
+                c.array.append(low);
+            }
+        }
+        c.cardinality = c.array.size();
+    } else {
+        c.array.reserve(qMin(a.array.size(), b.array.size()));
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(c.array));
+        c.cardinality = c.array.size();
+    }
+    return c;
+}
+
+CompressedBitmap::Container CompressedBitmap::unite(const Container &a, const Container &b) {
+    Container c;
+    c.key = a.key;
+    c.cardinality = 0;
+    if (a.bits.isEmpty() && b.bits.isEmpty() && a.cardinality + b.cardinality <= ARRAY_MAX) {
+        c.array.reserve(a.cardinality + b.cardinality);
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(c.array));
+        c.cardinality = c.array.size();
+        return c;
+    }
+    c.bits.fill(0, WORDS);
+    const Container *sides[2] = { &a, &b };
+    for (int s = 0; s < 2; s++) {
+        if (sides[s]->bits.isEmpty()) {
+            foreach (quint16 low, sides[s]->array) {
+                c.bits[low >> 6] |= Q_UINT64_C(1) << (low & 63);
+            }
+        } else {
+            for (int w = 0; w < WORDS; w++) {
+                c.bits[w] |= sides[s]->bits[w];
+            }
+        }
+    }
+    for (int w = 0; w < WORDS; w++) {
+        c.cardinality += qPopulationCount(c.bits[w]);
+    }
+    if (c.cardinality <= ARRAY_MAX) {
+        toArray(c);
+    }
+    return c;
+}
+
+int CompressedBitmap::intersectCount(const Container &a, const Container &b) {
+    int n = 0;
+    if (!a.bits.isEmpty() && !b.bits.isEmpty()) {
+        for (int w = 0; w < WORDS; w++) {
+            n += qPopulationCount(a.bits[w] & b.bits[w]);
+        }
+    } else if (!a.bits.isEmpty() || !b.bits.isEmpty()) {
+        const Container &array = a.bits.isEmpty() ? a : b;
+        const Container &bitset = a.bits.isEmpty() ? b : a;
+        foreach (quint16 low, array.array) {
+            if (bitset.bits[low >> 6] & (Q_UINT64_C(1) << (low & 63))) {
+                n++;
+            }
+        }
+    } else {
+        // a merge, both sorted
+        const quint16 *i = a.array.constData(), *iEnd = i + a.array.size();
+        const quint16 *j = b.array.constData(), *jEnd = j + b.array.size();
+        while (i < iEnd && j < jEnd) {
+            if (*i < *j) {
+                i++;
+            } else if (*j < *i) {
+                j++;
+            } else {
+                n++;
+                i++;
+                j++;
+            }
+        }
+    }
+    return n;
+}
+
+CompressedBitmap CompressedBitmap::operator&(const CompressedBitmap &other) const {
+    CompressedBitmap result;
+    int i = 0, j = 0;
+    while (i < containers.size() && j < other.containers.size()) {
+        if (containers[i].key < other.containers[j].key) {
+            i++;
+        } else if (other.containers[j].key < containers[i].key) {
+            j++;
+        } else {
+            Container c = intersect(containers[i], other.containers[j]);
+            if (c.cardinality > 0) {
+                result.containers.append(c);
+            }
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+CompressedBitmap CompressedBitmap::operator|(const CompressedBitmap &other) const {
+    CompressedBitmap result;
+    int i = 0, j = 0;
+    while (i < containers.size() || j < other.containers.size()) {
+        if (j == other.containers.size() || (i < containers.size() && containers[i].key < other.containers[j].key)) {
+            result.containers.append(containers[i++]);
+        } else if (i == containers.size() || other.containers[j].key < containers[i].key) {
+            result.containers.append(other.containers[j++]);
+        } else {
+            result.containers.append(unite(containers[i], other.containers[j]));
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+int CompressedBitmap::intersectionCount(const CompressedBitmap &other) const {
+    int n = 0;
+    int i = 0, j = 0;
+    while (i < containers.size() && j < other.containers.size()) {
+        if (containers[i].key < other.containers[j].key) {
+            i++;
+        } else if (other.containers[j].key < containers[i].key) {
+            j++;
+        } else {
+            n += intersectCount(containers[i], other.containers[j]);
+            i++;
+            j++;
+        }
+    }
+    return n;
+}
+
+int CompressedBitmap::bytes() const {
+    int n = containers.size() * sizeof(Container);
+    foreach (const Container &c, containers) {
+        n += c.array.size() * sizeof(quint16) + c.bits.size() * sizeof(quint64);
+    }
+    return n;
+}
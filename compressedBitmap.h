@@ -0,0 +1,55 @@
+#pragma once
+#include <QVector>
+#include <QtGlobal>
+
+/*
+ * CompressedBitmap is a set of ids, laid out the way Roaring bitmaps are:
+ * the ids are split by their top 16 bits into containers, and a container
+ * holds the low 16 bits as a sorted array while there are up to 4096 of
+ * them, as a 65536-bit bitset past that. A value that half of a large
+ * library has takes 8 KB per 65536 songs, a rare one 2 bytes per song.
+ * Intersections and unions go a container at a time, word by word where
+ * both sides are bitsets.
+ *
+ * Adding ids in ascending order, as the LibraryIndex hands them out, only
+ * ever appends.
+ */
+class CompressedBitmap {
+public:
+    CompressedBitmap();
+
+    void add(quint32 id);
+    void remove(quint32 id);
+    bool contains(quint32 id) const;
+    int count() const;
+    bool isEmpty() const;
+    void clear();
+    // ascending
+    QVector<quint32> toVector() const;
+
+    CompressedBitmap operator&(const CompressedBitmap &other) const;
+    CompressedBitmap operator|(const CompressedBitmap &other) const;
+    // (*this & other).count(), without making it
+    int intersectionCount(const CompressedBitmap &other) const;
+    // memory taken by the containers
+    int bytes() const;
+
+private:
+    enum { ARRAY_MAX = 4096, WORDS = 1024 };
+    struct Container {
+        quint16 key;
+        int cardinality;
+        QVector<quint16> array;     // sorted, while it's small
+        QVector<quint64> bits;      // WORDS of them otherwise
+    };
+
+    // index of the container for key, or -(where it goes)-1
+    int find(quint16 key) const;
+    static void toBits(Container &c);
+    static void toArray(Container &c);
+    static Container intersect(const Container &a, const Container &b);
+    static Container unite(const Container &a, const Container &b);
+    static int intersectCount(const Container &a, const Container &b);
+
+    QVector<Container> containers;  // by key
+};
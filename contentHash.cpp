@@ -0,0 +1,87 @@
+#include "contentHash.h"
+#include <QFile>
+#include <QByteArray>
+#include <QtEndian>
+#include <QDebug>
+#include <string.h>
+
+namespace {
+
+const quint64 GOLDEN = Q_UINT64_C(0x9e3779b97f4a7c15);
+
+inline quint64 mix(quint64 h) {
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    h *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+    h ^= h >> 33;
+    return h;
+}
+
+// where the audio payload starts and ends, past the tags at either end
+void payloadRange(QFile &file, qint64 &start, qint64 &end) {
+    start = 0;
+    end = file.size();
+    QByteArray header = file.read(10);
+    if (header.size() == 10 && header.startsWith("ID3")) {
+        // syncsafe size, not counting the header (and the footer, if flagged)
+        const uchar *h = (const uchar *)header.constData();
+        qint64 size = ((h[6] & 0x7f) << 21) | ((h[7] & 0x7f) << 14) | ((h[8] & 0x7f) << 7) | (h[9] & 0x7f);
+        start = 10 + size + ((h[5] & 0x10) ? 10 : 0);
+    }
+    if (end - start >= 128 && file.seek(end - 128) && file.read(3) == "TAG") {
+        end -= 128;
+    }
+    if (end - start >= 32 && file.seek(end - 32)) {
+        QByteArray footer = file.read(32);
+        if (footer.size() == 32 && footer.startsWith("APETAGEX")) {
+            const uchar *f = (const uchar *)footer.constData();
+            // the size counts the footer but not the optional header
+            qint64 size = qFromLittleEndian<quint32>(f + 12);
+            quint32 flags = qFromLittleEndian<quint32>(f + 20);
+            end -= size + ((flags & 0x80000000u) ? 32 : 0);
+        }
+    }
+    if (end <= start) {
+        // not what the tags claimed, hash the whole file then
+        start = 0;
+        end = file.size();
+    }
+}
+
+}
+
+quint64 hashBytes(const char *data, int size, quint64 seed) {
+    quint64 h = seed ^ ((quint64)size * GOLDEN);
+    int i = 0;
+    for (; i + 8 <= size; i += 8) {
+        h = (h ^ mix(qFromLittleEndian<quint64>((const uchar *)data + i))) * GOLDEN;
+        h ^= h >> 29;
+    }
+    if (i < size) {
+        uchar tail[8];
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, data + i, size - i);
+        h = (h ^ mix(qFromLittleEndian<quint64>(tail))) * GOLDEN;
+    }
+    h = mix(h);
+    return h ? h : 1;
+}
+
+quint64 contentHash(const QString &absFilePath) {
+    QFile file(absFilePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    qint64 start, end;
+    payloadRange(file, start, end);
+    qint64 length = qMin(end - start, (qint64)CONTENT_HASH_SLICE);
+    if (length <= 0 || !file.seek(start + (end - start - length) / 2)) {
+        return 0;
+    }
+    QByteArray slice = file.read(length);
+    if (slice.size() != length) {
+        return 0;
+    }
+    return hashBytes(slice.constData(), slice.size(), (quint64)(end - start));
+}
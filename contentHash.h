@@ -0,0 +1,19 @@
+#pragma once
+#include "debug.h"
+#include <QtGlobal>
+#include <QString>
+
+/*
+ * contentHash() identifies a music file by its audio payload instead of its
+ * path or tags, so a file keeps its hash when it is moved, renamed or
+ * retagged. The tag regions at either end (ID3v2, ID3v1, APEv2) are skipped
+ * and at most CONTENT_HASH_SLICE bytes from the middle of the rest are hashed
+ * together with the payload size. Reads are bounded whatever the file size.
+ * Returns 0 if the file can't be read.
+ */
+const int CONTENT_HASH_SLICE = 64 * 1024;
+
+quint64 contentHash(const QString &absFilePath);
+
+// fast 64-bit non-cryptographic hash, 8 bytes per step, never 0
+quint64 hashBytes(const char *data, int size, quint64 seed = 0);
@@ -1,3 +1,8 @@
 // contains debugging statement values
 #define DEBUG_PLAYLIST false
 #define DEBUG_PLAYLISTVIEW false
+#define DEBUG_PREFETCH false
+#define DEBUG_PIPELINE false
+#define DEBUG_KERNELS false
+#define DEBUG_ANALYSIS false
+#define DEBUG_JOBS false
@@ -0,0 +1,135 @@
+#include "facetIndex.h"
+
+FacetIndex::FacetIndex() {
+}
+
+void FacetIndex::clear() {
+    for (int f = 0; f < FACETS; f++) {
+        Values &v = facets[f];
+        v.ids.clear();
+        v.names.clear();
+        v.songs.clear();
+        v.songValue.clear();
+    }
+}
+
+void FacetIndex::insert(int id, const QStringList &values) {
+    for (int f = 0; f < FACETS; f++) {
+        Values &v = facets[f];
+        QString value = values.value(f);
+        QHash<QString, int>::const_iterator it = v.ids.constFind(value);
+        int valueId;
+        if (it == v.ids.constEnd()) {
+            valueId = v.names.size();
+            v.ids.insert(value, valueId);
+            v.names.append(value);
+            v.songs.append(CompressedBitmap());
+        } else {
+            valueId = it.value();
+        }
+        v.songs[valueId].add(id);
+        while (v.songValue.size() <= id) {
+            v.songValue.append(-1);
+        }
+        v.songValue[id] = valueId;
+    }
+}
+
+void FacetIndex::remove(int id) {
+    for (int f = 0; f < FACETS; f++) {
+        Values &v = facets[f];
+        int valueId = v.songValue.value(id, -1);
+        if (valueId >= 0) {
+            v.songs[valueId].remove(id);
+            v.songValue[id] = -1;
+        }
+    }
+}
+
+QStringList FacetIndex::values(int id) const {
+    QStringList values;
+    for (int f = 0; f < FACETS; f++) {
+        int valueId = facets[f].songValue.value(id, -1);
+        values << (valueId >= 0 ? facets[f].names[valueId] : QString());
+    }
+    return values;
+}
+
+void FacetIndex::select(Facet facet, const QStringList &values) {
+    facets[facet].selected = values.toSet();
+}
+
+bool FacetIndex::isActive() const {
+    for (int f = 0; f < FACETS; f++) {
+        if (!facets[f].selected.isEmpty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FacetIndex::accepts(int id) const {
+    for (int f = 0; f < FACETS; f++) {
+        const Values &v = facets[f];
+        if (v.selected.isEmpty()) {
+            continue;
+        }
+        int valueId = v.songValue.value(id, -1);
+        if (valueId < 0 || !v.selected.contains(v.names[valueId])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CompressedBitmap FacetIndex::chosen(int facet) const {
+    const Values &v = facets[facet];
+    CompressedBitmap songs;
+    foreach (const QString &value, v.selected) {
+        int valueId = v.ids.value(value, -1);
+        if (valueId >= 0) {
+            songs = songs | v.songs[valueId];
+        }
+    }
+    return songs;
+}
+
+CompressedBitmap FacetIndex::selection() const {
+    CompressedBitmap songs;
+    bool first = true;
+    for (int f = 0; f < FACETS; f++) {
+        if (!facets[f].selected.isEmpty()) {
+            songs = first ? chosen(f) : songs & chosen(f);
+            first = false;
+        }
+    }
+    return songs;
+}
+
+QList<FacetIndex::Count> FacetIndex::counts(Facet facet, const CompressedBitmap *within) const {
+    // what the other facets (and within) let through, made once
+    CompressedBitmap base;
+    bool limited = false;
+    if (within) {
+        base = *within;
+        limited = true;
+    }
+    for (int f = 0; f < FACETS; f++) {
+        if (f != facet && !facets[f].selected.isEmpty()) {
+            base = limited ? base & chosen(f) : chosen(f);
+            limited = true;
+        }
+    }
+    const Values &v = facets[facet];
+    QList<Count> counts;
+    for (int valueId = 0; valueId < v.names.size(); valueId++) {
+        Count c;
+        c.value = v.names[valueId];
+        c.songs = limited ? v.songs[valueId].intersectionCount(base) : v.songs[valueId].count();
+        c.selected = v.selected.contains(c.value);
+        if (c.songs > 0 || c.selected) {
+            counts.append(c);
+        }
+    }
+    return counts;
+}
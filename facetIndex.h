@@ -0,0 +1,64 @@
+#pragma once
+#include "debug.h"
+#include "compressedBitmap.h"
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QList>
+
+/*
+ * FacetIndex keeps a CompressedBitmap of song ids for every value of every
+ * facet: genre, year, format and album. The ids are the LibraryIndex's.
+ *
+ * Selecting values narrows the library down. A song has to have one of the
+ * selected values of a facet, for every facet that has any selected. A
+ * value's count is the number of its songs that the other facets'
+ * selections let through, so it tells how many songs selecting it would
+ * show. Counting a facet takes an AND and a population count per value,
+ * not a pass over the songs.
+ *
+ * The empty value stands for songs without the tag.
+ */
+class FacetIndex {
+public:
+    enum Facet { GENRE, YEAR, FORMAT, ALBUM, FACETS };
+    struct Count {
+        QString value;
+        int songs;
+        bool selected;
+    };
+
+    FacetIndex();
+
+    // drops all songs, the selection stays
+    void clear();
+    // values in Facet order
+    void insert(int id, const QStringList &values);
+    void remove(int id);
+    QStringList values(int id) const;
+
+    // no values selects the whole facet
+    void select(Facet facet, const QStringList &values);
+    bool isActive() const;
+    bool accepts(int id) const;
+    // the songs accepted, when isActive()
+    CompressedBitmap selection() const;
+    // values that have songs among within (0 for all songs), or are selected
+    QList<Count> counts(Facet facet, const CompressedBitmap *within) const;
+
+private:
+    struct Values {
+        QHash<QString, int> ids;
+        QVector<QString> names;
+        QVector<CompressedBitmap> songs;    // by value id
+        QVector<int> songValue;             // song id -> value id, -1 for none
+        QSet<QString> selected;
+    };
+
+    // songs with one of the facet's selected values
+    CompressedBitmap chosen(int facet) const;
+
+    Values facets[FACETS];
+};
@@ -0,0 +1,86 @@
+#include "facetPanel.h"
+#include "libraryIndex.h"
+#include "collation.h"
+#include <QtWidgets>
+
+FacetPanel::FacetPanel(LibraryIndex *libraryIndex, QWidget *parent) : QTabWidget(parent), index(libraryIndex), filling(false) {
+    QStringList names;
+    names << tr("Genre") << tr("Year") << tr("Format") << tr("Album");
+    for (int f = 0; f < FacetIndex::FACETS; f++) {
+        lists[f] = new QListWidget(this);
+        lists[f]->setUniformItemSizes(true);
+        addTab(lists[f], names[f]);
+        stale[f] = true;
+        connect(lists[f], SIGNAL(itemChanged(QListWidgetItem*)), this, SLOT(itemChanged(QListWidgetItem*)));
+    }
+    refreshTimer.setSingleShot(true);
+    refreshTimer.setInterval(500);
+    connect(&refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
+    connect(this, SIGNAL(currentChanged(int)), this, SLOT(tabShown(int)));
+    refresh();
+}
+
+void FacetPanel::refresh() {
+    refreshTimer.stop();
+    for (int f = 0; f < FacetIndex::FACETS; f++) {
+        stale[f] = true;
+    }
+    fill(currentIndex());
+}
+
+void FacetPanel::scheduleRefresh() {
+    if (!refreshTimer.isActive()) {
+        refreshTimer.start();
+    }
+}
+
+void FacetPanel::tabShown(int facet) {
+    if (facet >= 0 && stale[facet]) {
+        fill(facet);
+    }
+}
+
+void FacetPanel::fill(int facet) {
+    if (facet < 0) {
+        return;
+    }
+    stale[facet] = false;
+    QList<FacetIndex::Count> counts = index->facetCounts(facet);
+    QStringList values;
+    foreach (const FacetIndex::Count &c, counts) {
+        values << c.value;
+    }
+    QVector<int> order = Collation::instance()->order(values);
+
+    QListWidget *list = lists[facet];
+    int scrolled = list->verticalScrollBar()->value();
+    filling = true;
+    list->setUpdatesEnabled(false);
+    list->clear();
+    foreach (int i, order) {
+        const FacetIndex::Count &c = counts[i];
+        QListWidgetItem *item = new QListWidgetItem(QString("%1 (%2)").arg(c.value.isEmpty() ? tr("Unknown") : c.value).arg(c.songs));
+        item->setData(Qt::UserRole, c.value);
+        item->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+        item->setCheckState(c.selected ? Qt::Checked : Qt::Unchecked);
+        list->addItem(item);
+    }
+    list->setUpdatesEnabled(true);
+    list->verticalScrollBar()->setValue(scrolled);
+    filling = false;
+}
+
+// slot
+void FacetPanel::itemChanged(QListWidgetItem *item) {
+    if (filling) {
+        return;
+    }
+    QListWidget *list = item->listWidget();
+    QStringList values;
+    for (int i = 0; i < list->count(); i++) {
+        if (list->item(i)->checkState() == Qt::Checked) {
+            values << list->item(i)->data(Qt::UserRole).toString();
+        }
+    }
+    emit(facetChanged(indexOf(list), values));
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "debug.h"
+#include "facetIndex.h"
+#include <QTabWidget>
+#include <QTimer>
+
+class LibraryIndex;
+class QListWidget;
+class QListWidgetItem;
+
+/*
+ * The facet panel over the library view: a tab each for genre, year,
+ * format and album, listing the values with how many songs of the current
+ * selection have them. Checking values narrows the library view down to
+ * their songs. The counts come from the LibraryIndex's bitmaps, only the
+ * tab that's showing is counted.
+ */
+class FacetPanel : public QTabWidget {
+    Q_OBJECT
+
+public:
+    FacetPanel(LibraryIndex *libraryIndex, QWidget *parent = 0);
+
+public slots:
+    // counts again
+    void refresh();
+    // after a moment, the library is changing
+    void scheduleRefresh();
+
+signals:
+    // facet is a FacetIndex::Facet, the checked values
+    void facetChanged(int facet, QStringList values);
+
+private slots:
+    void itemChanged(QListWidgetItem *item);
+    void tabShown(int facet);
+
+private:
+    void fill(int facet);
+
+    LibraryIndex *index;
+    QListWidget *lists[FacetIndex::FACETS];
+    bool stale[FacetIndex::FACETS];     // counted before the last change
+    QTimer refreshTimer;
+    bool filling;
+};
@@ -0,0 +1,49 @@
+#include "fft.h"
+#include "sampleKernels.h"
+#include <qmath.h>
+
+Fft::Fft(int size) : n(size) {
+    int bits = 0;
+    while ((1 << bits) < n) {
+        bits++;
+    }
+    bitReversed.resize(n);
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++) {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bitReversed[i] = r;
+    }
+    twiddleRe.resize(qMax(n - 1, 1));
+    twiddleIm.resize(qMax(n - 1, 1));
+    for (int h = 1; h < n; h *= 2) {
+        for (int k = 0; k < h; k++) {
+            double angle = -M_PI * k / h;
+            twiddleRe[h - 1 + k] = (float)qCos(angle);
+            twiddleIm[h - 1 + k] = (float)qSin(angle);
+        }
+    }
+}
+
+int Fft::size() const {
+    return n;
+}
+
+void Fft::forward(float *re, float *im) const {
+    for (int i = 0; i < n; i++) {
+        int j = bitReversed[i];
+        if (j > i) {
+            qSwap(re[i], re[j]);
+            qSwap(im[i], im[j]);
+        }
+    }
+    const SampleKernels &k = sampleKernels();
+    for (int h = 1; h < n; h *= 2) {
+        const float *wr = twiddleRe.constData() + h - 1;
+        const float *wi = twiddleIm.constData() + h - 1;
+        for (int j = 0; j < n; j += 2*h) {
+            k.fftButterfly(re + j, im + j, re + j + h, im + j + h, wr, wi, h);
+        }
+    }
+}
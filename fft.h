@@ -0,0 +1,23 @@
+#pragma once
+#include "debug.h"
+#include <QVector>
+
+/*
+ * In-place radix-2 FFT on split real/imaginary arrays. The size is fixed at
+ * construction (a power of two) so the bit-reversal table and the twiddles
+ * of every stage are computed once; each stage runs on the sample kernels'
+ * fftButterfly.
+ */
+class Fft {
+public:
+    Fft(int size);
+
+    int size() const;
+    void forward(float *re, float *im) const;
+
+private:
+    int n;
+    QVector<int> bitReversed;
+    // twiddles of the stage with half-size h start at offset h-1
+    QVector<float> twiddleRe, twiddleIm;
+};
@@ -0,0 +1,159 @@
+#include "fingerprintAnalyzer.h"
+#include "audioFingerprint.h"
+#include "pcmDecoder.h"
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QDebug>
+
+namespace {
+
+// stops the decode when the run is cancelled
+class CancellableSink : public FingerprintSink {
+public:
+    CancellableSink(FingerprintAnalyzer *owner) : analyzer(owner) {}
+
+    bool consume(const float *samples, int frames, int channels, int sampleRate) {
+        return FingerprintSink::consume(samples, frames, channels, sampleRate) && !analyzer->isCancelled();
+    }
+
+    FingerprintAnalyzer *analyzer;
+};
+
+class FingerprintTask : public QRunnable {
+public:
+    FingerprintTask(FingerprintAnalyzer *owner, const QString &absFilePath)
+        : analyzer(owner), path(absFilePath) {}
+
+    void run() {
+        FingerprintAnalyzer::Result result;
+        result.absFilePath = path;
+        result.ok = false;
+        if (!analyzer->isCancelled()) {
+            PcmDecoder decoder;
+            CancellableSink sink(analyzer);
+            // a little extra for the last FFT frame
+            if (decoder.decode(path, &sink, AudioFingerprint::WINDOW_MS + 200) && !analyzer->isCancelled()) {
+                AudioFingerprint fingerprint = sink.fingerprint();
+                // under a second can't be told apart from anything else
+                if (fingerprint.size() >= AudioFingerprint::FRAMES_PER_SECOND) {
+                    result.ok = true;
+                    result.fingerprint = fingerprint.toByteArray();
+                }
+            }
+        }
+        analyzer->post(result);
+    }
+
+private:
+    FingerprintAnalyzer *analyzer;
+    QString path;
+};
+
+}
+
+FingerprintAnalyzer::FingerprintAnalyzer(QObject *parent) : QObject(parent) {
+    scheduler = JobScheduler::instance();
+    lastElapsed = 0;
+    total = 0;
+    done = 0;
+    failed = 0;
+}
+
+FingerprintAnalyzer::~FingerprintAnalyzer() {
+    cancel();
+    scheduler->waitForGroup(this);
+}
+
+void FingerprintAnalyzer::addTrack(const QString &absFilePath) {
+    if (!isRunning()) {
+        // new run
+        cancelled.storeRelease(0);
+        total = 0;
+        done = 0;
+        failed = 0;
+        timer.start();
+    }
+    total++;
+    scheduler->submit(new FingerprintTask(this, absFilePath), JobScheduler::USER_INITIATED, this);
+}
+
+void FingerprintAnalyzer::cancel() {
+    // like LoudnessAnalyzer, dropped tasks are reported as failures
+    cancelled.storeRelease(1);
+    int dropped = scheduler->cancel(this);
+    for (int i = 0; i < dropped; i++) {
+        Result r;
+        r.ok = false;
+        post(r);
+    }
+}
+
+bool FingerprintAnalyzer::isCancelled() const {
+    return cancelled.loadAcquire() != 0;
+}
+
+bool FingerprintAnalyzer::isRunning() const {
+    return done < total;
+}
+
+int FingerprintAnalyzer::threadCount() const {
+    return scheduler->maxRunning(JobScheduler::USER_INITIATED);
+}
+
+int FingerprintAnalyzer::tracksTotal() const {
+    return total;
+}
+
+int FingerprintAnalyzer::tracksDone() const {
+    return done;
+}
+
+int FingerprintAnalyzer::tracksFailed() const {
+    return failed;
+}
+
+qint64 FingerprintAnalyzer::elapsedMs() const {
+    return isRunning() ? timer.elapsed() : lastElapsed;
+}
+
+double FingerprintAnalyzer::tracksPerMinutePerCore() const {
+    qint64 ms = elapsedMs();
+    if (ms <= 0) {
+        return 0.0;
+    }
+    return (done - failed) * 60000.0 / ms / threadCount();
+}
+
+void FingerprintAnalyzer::post(const Result &result) {
+    QMutexLocker locker(&resultsLock);
+    results.append(result);
+    if (results.size() == 1) {
+        QMetaObject::invokeMethod(this, "collectResults", Qt::QueuedConnection);
+    }
+}
+
+void FingerprintAnalyzer::collectResults() {
+    QList<Result> batch;
+    {
+        QMutexLocker locker(&resultsLock);
+        batch.swap(results);
+    }
+    bool cancelledRun = isCancelled();
+    foreach (const Result &r, batch) {
+        done++;
+        if (!r.ok) {
+            failed++;
+        } else if (!cancelledRun) {
+            emit(trackFingerprinted(r.absFilePath, r.fingerprint));
+        }
+    }
+    emit(progress(done, total));
+    if (!isRunning()) {
+        lastElapsed = timer.elapsed();
+#if DEBUG_ANALYSIS
+        qDebug() << "FingerprintAnalyzer:" << done << "tracks," << failed << "failed,"
+                 << lastElapsed << "ms," << tracksPerMinutePerCore() << "tracks/min/core";
+#endif
+        emit(finished());
+    }
+}
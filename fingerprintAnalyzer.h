@@ -0,0 +1,65 @@
+#pragma once
+#include "debug.h"
+#include "jobScheduler.h"
+#include <QObject>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+/*
+ * FingerprintAnalyzer computes the AudioFingerprint of a batch of tracks in
+ * the background, one track per JobScheduler job. Only the fingerprint
+ * window is decoded. Results are reported on the thread that owns the
+ * analyzer, serialised with AudioFingerprint::toByteArray().
+ */
+class FingerprintAnalyzer : public QObject {
+    Q_OBJECT
+
+public:
+    FingerprintAnalyzer(QObject *parent = 0);
+    ~FingerprintAnalyzer();
+
+    void addTrack(const QString &absFilePath);
+    void cancel();
+    bool isRunning() const;
+    int threadCount() const;
+
+    // statistics of the current (or last) run
+    int tracksTotal() const;
+    int tracksDone() const;
+    int tracksFailed() const;
+    qint64 elapsedMs() const;
+    double tracksPerMinutePerCore() const;
+
+    // filled in by the worker threads and picked up by collectResults()
+    struct Result {
+        QString absFilePath;
+        bool ok;
+        QByteArray fingerprint;
+    };
+    void post(const Result &result);
+    bool isCancelled() const;
+
+signals:
+    void trackFingerprinted(QString absFilePath, QByteArray fingerprint);
+    void progress(int done, int total);
+    void finished();
+
+private slots:
+    void collectResults();
+
+private:
+    JobScheduler *scheduler;
+    QAtomicInt cancelled;
+    QMutex resultsLock;
+    QList<Result> results;
+
+    QElapsedTimer timer;
+    qint64 lastElapsed;
+    int total;
+    int done;
+    int failed;
+};
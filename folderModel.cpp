@@ -0,0 +1,90 @@
+#include "folderModel.h"
+#include "pathTrie.h"
+#include <QtWidgets>
+
+FolderModel::FolderModel(QObject *parent) : QAbstractItemModel(parent) {
+    trie = PathTrie::instance();
+    connect(trie, SIGNAL(rowAboutToBeInserted(quint32, int)), this, SLOT(rowAboutToBeInserted(quint32, int)));
+    connect(trie, SIGNAL(rowInserted()), this, SLOT(rowInserted()));
+    connect(trie, SIGNAL(rowAboutToBeRemoved(quint32, int)), this, SLOT(rowAboutToBeRemoved(quint32, int)));
+    connect(trie, SIGNAL(rowRemoved()), this, SLOT(rowRemoved()));
+}
+
+quint32 FolderModel::node(const QModelIndex &idx) const {
+    return idx.isValid() ? (quint32)idx.internalId() : PathTrie::ROOT;
+}
+
+QModelIndex FolderModel::nodeIndex(quint32 node) const {
+    if (node == PathTrie::ROOT) {
+        return QModelIndex();
+    }
+    return createIndex(trie->row(node), 0, node);
+}
+
+QStringList FolderModel::filesUnder(const QModelIndex &idx) const {
+    return trie->filesUnder(node(idx));
+}
+
+int FolderModel::rowCount(const QModelIndex &parent) const {
+    if (parent.column() > 0) {
+        return 0;
+    }
+    return trie->childCount(node(parent));
+}
+
+int FolderModel::columnCount(const QModelIndex &parent) const {
+    Q_UNUSED(parent);
+    return 1;
+}
+
+QModelIndex FolderModel::index(int row, int column, const QModelIndex &parent) const {
+    if (column != 0 || row < 0 || row >= rowCount(parent)) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, trie->child(node(parent), row));
+}
+
+QModelIndex FolderModel::parent(const QModelIndex &index) const {
+    if (!index.isValid()) {
+        return QModelIndex();
+    }
+    return nodeIndex(trie->parent(node(index)));
+}
+
+QVariant FolderModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid()) {
+        return QVariant();
+    }
+    quint32 n = node(index);
+    switch (role) {
+    case Qt::DisplayRole:
+        return trie->label(n);
+    case Qt::ToolTipRole:
+        return trie->path(n);
+    case Qt::DecorationRole:
+        // a node with children is a directory, even if it's a path itself
+        return QApplication::style()->standardIcon(trie->childCount(n) > 0 || !trie->isFile(n) ? QStyle::SP_DirIcon : QStyle::SP_FileIcon);
+    default:
+        return QVariant();
+    }
+}
+
+// slot
+void FolderModel::rowAboutToBeInserted(quint32 parent, int row) {
+    beginInsertRows(nodeIndex(parent), row, row);
+}
+
+// slot
+void FolderModel::rowInserted() {
+    endInsertRows();
+}
+
+// slot
+void FolderModel::rowAboutToBeRemoved(quint32 parent, int row) {
+    beginRemoveRows(nodeIndex(parent), row, row);
+}
+
+// slot
+void FolderModel::rowRemoved() {
+    endRemoveRows();
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "debug.h"
+#include <QAbstractItemModel>
+#include <QModelIndex>
+#include <QStringList>
+
+class PathTrie;
+
+/*
+ * FolderModel shows the library by directory, straight from the PathTrie:
+ * a row is a trie node, a directory (or a chain of single-child ones, as
+ * "home/me/Music") or a file. It keeps nothing of its own, rows come and
+ * go as the trie's signals say.
+ */
+class FolderModel : public QAbstractItemModel {
+    Q_OBJECT
+
+public:
+    FolderModel(QObject *parent = 0);
+
+    // the files at or under idx
+    QStringList filesUnder(const QModelIndex &idx) const;
+
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    virtual QModelIndex parent(const QModelIndex &index) const;
+    virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+private slots:
+    void rowAboutToBeInserted(quint32 parent, int row);
+    void rowInserted();
+    void rowAboutToBeRemoved(quint32 parent, int row);
+    void rowRemoved();
+
+private:
+    quint32 node(const QModelIndex &idx) const;
+    QModelIndex nodeIndex(quint32 node) const;
+
+    PathTrie *trie;
+};
@@ -0,0 +1,212 @@
+#include "fuzzyMatcher.h"
+#include "libraryIndex.h"
+#include "jobScheduler.h"
+#include <QRunnable>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+const int CHUNK = 4096;         // rows per job
+const int MAX_TEXT = 256;       // characters of a row that are scored
+
+const int MATCH = 16;
+const int WORD_START = 8;
+const int CONSECUTIVE = 6;
+const int GAP = 1;              // per character skipped
+const int NONE = -(1 << 28);
+
+class ScoreJob : public QRunnable {
+public:
+    ScoreJob(FuzzyMatcher *owner) : matcher(owner) {}
+
+    void run() {
+        matcher->scoreChunks();
+    }
+
+private:
+    FuzzyMatcher *matcher;
+};
+
+bool betterMatch(const FuzzyMatcher::Match &a, const FuzzyMatcher::Match &b) {
+    return a.score != b.score ? a.score > b.score : a.row < b.row;
+}
+
+}
+
+FuzzyMatcher::FuzzyMatcher() {
+    scheduler = JobScheduler::instance();
+    searchNsecs = 0;
+    queryMask = 0;
+    candidates = 0;
+    candidateCount = 0;
+    chunkCount = 0;
+    chunkResults = 0;
+}
+
+FuzzyMatcher::~FuzzyMatcher() {
+    scheduler->cancel(this);
+    scheduler->waitForGroup(this);
+}
+
+void FuzzyMatcher::setRows(const QStringList &rows) {
+    texts = rows.toVector();
+    masks.resize(texts.size());
+    for (int i = 0; i < texts.size(); i++) {
+        masks[i] = charMask(texts[i]);
+    }
+    lastQuery.clear();
+    lastMatches.clear();
+}
+
+int FuzzyMatcher::rowCount() const {
+    return texts.size();
+}
+
+quint64 FuzzyMatcher::charMask(const QString &text) {
+    // a bit per letter and digit, everything else shares the top bits
+    quint64 mask = 0;
+    const QChar *c = text.constData();
+    for (int i = 0; i < text.size(); i++) {
+        ushort u = c[i].unicode();
+        if (u >= 'a' && u <= 'z') {
+            mask |= Q_UINT64_C(1) << (u - 'a');
+        } else if (u >= '0' && u <= '9') {
+            mask |= Q_UINT64_C(1) << (26 + u - '0');
+        } else if (u != ' ') {
+            mask |= Q_UINT64_C(1) << (36 + u % 28);
+        }
+    }
+    return mask;
+}
+
+int FuzzyMatcher::score(const QString &query, const QString &text) {
+    const int m = query.size();
+    const int n = qMin(text.size(), MAX_TEXT);
+    const QChar *q = query.constData();
+    const QChar *t = text.constData();
+    // most rows fail here, before any scoring
+    int k = 0;
+    for (int j = 0; j < n && k < m; j++) {
+        if (t[j] == q[k]) {
+            k++;
+        }
+    }
+    if (k < m) {
+        return -1;
+    }
+
+    // best[j]: best score of the query so far with its last character at j
+    int rowA[MAX_TEXT], rowB[MAX_TEXT];
+    int *prev = rowA, *cur = rowB;
+    for (int j = 0; j < n; j++) {
+        cur[j] = t[j] == q[0] ? MATCH + ((j == 0 || t[j-1] == ' ') ? WORD_START : 0) : NONE;
+    }
+    for (int i = 1; i < m; i++) {
+        qSwap(prev, cur);
+        // carry: best prev[k] - GAP * (j - 1 - k) over k <= j - 2
+        int carry = NONE;
+        for (int j = 0; j < n; j++) {
+            if (j >= 2) {
+                carry = qMax(carry, prev[j-2]) - GAP;
+            }
+            if (j < i || t[j] != q[i]) {
+                cur[j] = NONE;
+                continue;
+            }
+            int from = qMax(carry, prev[j-1] == NONE ? NONE : prev[j-1] + CONSECUTIVE);
+            cur[j] = from <= NONE / 2 ? NONE : from + MATCH + (t[j-1] == ' ' ? WORD_START : 0);
+        }
+    }
+    int best = NONE;
+    for (int j = 0; j < n; j++) {
+        best = qMax(best, cur[j]);
+    }
+    return best <= NONE / 2 ? -1 : qMax(best, 0);
+}
+
+void FuzzyMatcher::scoreChunks() {
+    for (;;) {
+        int chunk = nextChunk.fetchAndAddRelaxed(1);
+        if (chunk >= chunkCount) {
+            return;
+        }
+        QVector<Match> &out = chunkResults[chunk];
+        int to = qMin(candidateCount, (chunk + 1) * CHUNK);
+        for (int i = chunk * CHUNK; i < to; i++) {
+            int row = candidates ? candidates[i] : i;
+            if ((masks.at(row) & queryMask) != queryMask) {
+                continue;
+            }
+            int s = score(query, texts.at(row));
+            if (s >= 0) {
+                Match match;
+                match.row = row;
+                match.score = s;
+                out.append(match);
+            }
+        }
+    }
+}
+
+QVector<FuzzyMatcher::Match> FuzzyMatcher::search(const QString &text, int limit) {
+    QElapsedTimer timer;
+    timer.start();
+    // spaces don't have to match, they only mark the word starts
+    QString folded = LibraryIndex::fold(text).remove(QLatin1Char(' '));
+    QVector<Match> matches;
+    if (folded.isEmpty()) {
+        lastQuery.clear();
+        lastMatches.clear();
+        searchNsecs = timer.nsecsElapsed();
+        return matches;
+    }
+
+    // a longer query can only match fewer rows
+    bool narrowing = !lastQuery.isEmpty() && folded.startsWith(lastQuery);
+    QVector<int> previous = lastMatches;
+    query = folded;
+    queryMask = charMask(folded);
+    candidates = narrowing ? previous.constData() : 0;
+    candidateCount = narrowing ? previous.size() : texts.size();
+    chunkCount = (candidateCount + CHUNK - 1) / CHUNK;
+    QVector<QVector<Match> > results(chunkCount);
+    chunkResults = results.data();
+    nextChunk.storeRelease(0);
+
+    int helpers = qMin(chunkCount - 1, scheduler->maxRunning(JobScheduler::INTERACTIVE));
+    for (int i = 0; i < helpers; i++) {
+        scheduler->submit(new ScoreJob(this), JobScheduler::INTERACTIVE, this);
+    }
+    scoreChunks();
+    // the chunks are all taken, jobs that didn't start have nothing to do
+    scheduler->cancel(this);
+    scheduler->waitForGroup(this);
+
+    lastQuery = folded;
+    lastMatches.clear();
+    for (int c = 0; c < chunkCount; c++) {
+        foreach (const Match &match, results[c]) {
+            lastMatches.append(match.row);
+            matches.append(match);
+        }
+    }
+    int shown = qMin(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + shown, matches.end(), betterMatch);
+    matches.resize(shown);
+    searchNsecs = timer.nsecsElapsed();
+#if DEBUG_PLAYLISTVIEW
+    qDebug() << "FuzzyMatcher:" << folded << lastMatches.size() << "of" << texts.size() << "rows in"
+             << searchNsecs / 1000 << "us," << helpers << "helpers";
+#endif
+    return matches;
+}
+
+int FuzzyMatcher::matchCount() const {
+    return lastMatches.size();
+}
+
+qint64 FuzzyMatcher::lastSearchNsecs() const {
+    return searchNsecs;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "debug.h"
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QAtomicInt>
+
+class JobScheduler;
+
+/*
+ * FuzzyMatcher ranks the rows of a list (the playlist, for quick find) by
+ * how well a query matches them as a subsequence: the query's characters
+ * have to appear in order, but not next to each other. Runs of consecutive
+ * characters and matches at the start of a word score higher, the gaps
+ * between them cost a little.
+ *
+ * Each row keeps a 64-bit mask of the characters in it, so the rows missing
+ * one of the query's characters are dropped with one AND before scoring.
+ * The rest are scored in chunks on the JobScheduler's INTERACTIVE workers.
+ * The searching thread takes chunks as well, so a search never waits for
+ * a busy worker. A query that extends the previous one only rescores the
+ * previous matches.
+ */
+class FuzzyMatcher {
+public:
+    struct Match {
+        int row;
+        int score;
+    };
+
+    FuzzyMatcher();
+    ~FuzzyMatcher();
+
+    // folded with LibraryIndex::fold()
+    void setRows(const QStringList &rows);
+    int rowCount() const;
+    // best first, at most limit; an empty query matches nothing
+    QVector<Match> search(const QString &query, int limit);
+    // all the rows the last query matched, and how long it took
+    int matchCount() const;
+    qint64 lastSearchNsecs() const;
+
+    static quint64 charMask(const QString &text);
+    // -1 if query isn't a subsequence of text
+    static int score(const QString &query, const QString &text);
+
+    // run by the scoring jobs
+    void scoreChunks();
+
+private:
+    QVector<QString> texts;
+    QVector<quint64> masks;
+    JobScheduler *scheduler;
+
+    QString lastQuery;
+    QVector<int> lastMatches;       // rows, ascending
+    qint64 searchNsecs;
+
+    // the search in progress
+    QString query;
+    quint64 queryMask;
+    const int *candidates;          // rows to look at, 0 for all of them
+    int candidateCount;
+    int chunkCount;
+    QAtomicInt nextChunk;
+    QVector<Match> *chunkResults;
+};
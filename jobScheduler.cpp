@@ -0,0 +1,321 @@
+#include "jobScheduler.h"
+#include <QMutexLocker>
+#include <QDebug>
+
+JobScheduler *JobScheduler::self = 0;
+
+void JobWorker::run() {
+    scheduler->work(workerIndex);
+}
+
+JobScheduler::JobScheduler(QObject *parent) : QObject(parent) {
+    self = this;
+    int cores = qMax(2, QThread::idealThreadCount());
+    for (int p = 0; p < PRIORITY_CLASSES; p++) {
+        queues[p].resize(cores);
+        maxJobs[p] = cores;
+        // a couple of files read at once is as fast as the disk goes
+        maxIoJobs[p] = 2;
+        runningJobs[p] = 0;
+        runningIo[p] = 0;
+        completedJobs[p] = 0;
+        cancelledJobs[p] = 0;
+    }
+    // leave a core for whatever the user asks for next
+    maxJobs[BACKGROUND] = cores - 1;
+    maxIoJobs[BACKGROUND] = 1;
+    nextWorker = 0;
+    quit = false;
+    throttled = false;
+    throttledTotal = 0;
+    activityPending = false;
+    stealCount = 0;
+
+    for (int i = 0; i < cores; i++) {
+        workers.append(new JobWorker(this, i));
+        workers[i]->start();
+    }
+}
+
+JobScheduler::~JobScheduler() {
+    {
+        QMutexLocker locker(&lock);
+        quit = true;
+        jobAvailable.wakeAll();
+    }
+    foreach (JobWorker *worker, workers) {
+        worker->wait();
+        delete worker;
+    }
+    for (int p = 0; p < PRIORITY_CLASSES; p++) {
+        for (int w = 0; w < queues[p].size(); w++) {
+            foreach (const Entry &e, queues[p][w]) {
+                if (e.job->autoDelete()) {
+                    delete e.job;
+                }
+            }
+        }
+    }
+    if (self == this) {
+        self = 0;
+    }
+}
+
+JobScheduler *JobScheduler::instance() {
+    return self;
+}
+
+void JobScheduler::submit(QRunnable *job, Priority priority, const void *group, int flags) {
+    QMutexLocker locker(&lock);
+    Entry e;
+    e.job = job;
+    e.group = group;
+    e.flags = flags;
+    e.priority = priority;
+    // follow-up jobs stay with the worker that queued them
+    int w = workerIndexOf(QThread::currentThread());
+    if (w < 0) {
+        w = nextWorker;
+        nextWorker = (nextWorker + 1) % workers.size();
+    }
+    queues[priority][w].append(e);
+    groupJobs[group]++;
+    jobAvailable.wakeAll();
+    activityLocked();
+}
+
+int JobScheduler::cancel(const void *group) {
+    QMutexLocker locker(&lock);
+    int dropped = 0;
+    for (int p = 0; p < PRIORITY_CLASSES; p++) {
+        for (int w = 0; w < queues[p].size(); w++) {
+            QList<Entry> &queue = queues[p][w];
+            for (int i = queue.size() - 1; i >= 0; i--) {
+                if (queue[i].group != group) {
+                    continue;
+                }
+                if (queue[i].job->autoDelete()) {
+                    delete queue[i].job;
+                }
+                queue.removeAt(i);
+                cancelledJobs[p]++;
+                dropped++;
+            }
+        }
+    }
+    if (dropped > 0) {
+        if ((groupJobs[group] -= dropped) <= 0) {
+            groupJobs.remove(group);
+        }
+        jobFinished.wakeAll();
+        activityLocked();
+    }
+    return dropped;
+}
+
+void JobScheduler::waitForGroup(const void *group) {
+    // not from a worker, its own job would never finish
+    QMutexLocker locker(&lock);
+    while (groupJobs.value(group) > 0) {
+        jobFinished.wait(&lock);
+    }
+}
+
+void JobScheduler::setMaxRunning(Priority priority, int jobs) {
+    QMutexLocker locker(&lock);
+    maxJobs[priority] = qMax(1, jobs);
+    jobAvailable.wakeAll();
+}
+
+void JobScheduler::setMaxIo(Priority priority, int jobs) {
+    QMutexLocker locker(&lock);
+    maxIoJobs[priority] = qMax(1, jobs);
+    jobAvailable.wakeAll();
+}
+
+int JobScheduler::maxRunning(Priority priority) const {
+    QMutexLocker locker(&lock);
+    return qMin(maxJobs[priority], workers.size());
+}
+
+int JobScheduler::workerCount() const {
+    return workers.size();
+}
+
+bool JobScheduler::isThrottled() const {
+    QMutexLocker locker(&lock);
+    return throttled;
+}
+
+int JobScheduler::queued(Priority priority) const {
+    QMutexLocker locker(&lock);
+    return queuedLocked(priority);
+}
+
+int JobScheduler::running(Priority priority) const {
+    QMutexLocker locker(&lock);
+    return runningJobs[priority];
+}
+
+int JobScheduler::completed(Priority priority) const {
+    QMutexLocker locker(&lock);
+    return completedJobs[priority];
+}
+
+int JobScheduler::cancelled(Priority priority) const {
+    QMutexLocker locker(&lock);
+    return cancelledJobs[priority];
+}
+
+int JobScheduler::steals() const {
+    QMutexLocker locker(&lock);
+    return stealCount;
+}
+
+qint64 JobScheduler::throttledMs() const {
+    QMutexLocker locker(&lock);
+    return throttledTotal + (throttled ? throttleTimer.elapsed() : 0);
+}
+
+void JobScheduler::playbackStateChanged(QMediaPlayer::State state) {
+    QMutexLocker locker(&lock);
+    bool playing = (state == QMediaPlayer::PlayingState);
+    if (playing == throttled) {
+        return;
+    }
+    throttled = playing;
+    if (throttled) {
+        throttleTimer.start();
+    } else {
+        throttledTotal += throttleTimer.elapsed();
+        // the background class may run wide again
+        jobAvailable.wakeAll();
+    }
+#if DEBUG_JOBS
+    qDebug() << "JobScheduler: background jobs" << (throttled ? "throttled" : "unthrottled")
+             << queuedLocked(BACKGROUND) << "queued" << runningJobs[BACKGROUND] << "running";
+#endif
+}
+
+void JobScheduler::notifyActivity() {
+    int queuedTotal = 0, runningTotal = 0;
+    {
+        QMutexLocker locker(&lock);
+        activityPending = false;
+        for (int p = 0; p < PRIORITY_CLASSES; p++) {
+            queuedTotal += queuedLocked((Priority)p);
+            runningTotal += runningJobs[p];
+        }
+    }
+    emit(activityChanged(queuedTotal, runningTotal));
+}
+
+void JobScheduler::work(int workerIndex) {
+    QMutexLocker locker(&lock);
+    while (!quit) {
+        Entry e;
+        if (!takeJob(workerIndex, e)) {
+            jobAvailable.wait(&lock);
+            continue;
+        }
+        runningJobs[e.priority]++;
+        if (e.flags & IO_BOUND) {
+            runningIo[e.priority]++;
+        }
+        QThread::Priority threadPriority = QThread::NormalPriority;
+        if (e.priority == BACKGROUND) {
+            // IdlePriority is SCHED_IDLE on Linux, the audio threads always win
+            threadPriority = throttled ? QThread::IdlePriority : QThread::LowPriority;
+        }
+        activityLocked();
+        locker.unlock();
+
+        QThread::currentThread()->setPriority(threadPriority);
+        e.job->run();
+        if (e.job->autoDelete()) {
+            delete e.job;
+        }
+
+        locker.relock();
+        runningJobs[e.priority]--;
+        if (e.flags & IO_BOUND) {
+            runningIo[e.priority]--;
+        }
+        completedJobs[e.priority]++;
+        if (--groupJobs[e.group] <= 0) {
+            groupJobs.remove(e.group);
+        }
+        jobFinished.wakeAll();
+        // a freed slot may let a job through that another worker passed over
+        jobAvailable.wakeAll();
+        activityLocked();
+    }
+}
+
+bool JobScheduler::takeJob(int workerIndex, Entry &entry) {
+    const int n = workers.size();
+    for (int p = 0; p < PRIORITY_CLASSES; p++) {
+        if (runningJobs[p] >= limit((Priority)p)) {
+            continue;
+        }
+        // newest own job first, it's the one most likely still in cache
+        QList<Entry> &own = queues[p][workerIndex];
+        for (int i = own.size() - 1; i >= 0; i--) {
+            if (canStart(own[i])) {
+                entry = own.takeAt(i);
+                return true;
+            }
+        }
+        // then the oldest job of another worker
+        for (int k = 1; k < n; k++) {
+            QList<Entry> &other = queues[p][(workerIndex + k) % n];
+            for (int i = 0; i < other.size(); i++) {
+                if (canStart(other[i])) {
+                    entry = other.takeAt(i);
+                    stealCount++;
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool JobScheduler::canStart(const Entry &entry) const {
+    return !(entry.flags & IO_BOUND) || runningIo[entry.priority] < ioLimit(entry.priority);
+}
+
+int JobScheduler::limit(Priority priority) const {
+    if (priority == BACKGROUND && throttled) {
+        return 1;
+    }
+    return maxJobs[priority];
+}
+
+int JobScheduler::ioLimit(Priority priority) const {
+    return maxIoJobs[priority];
+}
+
+int JobScheduler::queuedLocked(Priority priority) const {
+    int count = 0;
+    for (int w = 0; w < queues[priority].size(); w++) {
+        count += queues[priority][w].size();
+    }
+    return count;
+}
+
+int JobScheduler::workerIndexOf(QThread *thread) const {
+    for (int i = 0; i < workers.size(); i++) {
+        if (workers[i] == thread) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void JobScheduler::activityLocked() {
+    if (!activityPending) {
+        activityPending = true;
+        QMetaObject::invokeMethod(this, "notifyActivity", Qt::QueuedConnection);
+    }
+}
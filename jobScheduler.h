@@ -0,0 +1,142 @@
+#pragma once
+#include "debug.h"
+#include <QObject>
+#include <QList>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <QRunnable>
+#include <QElapsedTimer>
+#include <QMediaPlayer>
+
+class JobScheduler;
+
+// one worker thread of the JobScheduler, it only runs JobScheduler::work()
+class JobWorker : public QThread {
+public:
+    JobWorker(JobScheduler *owner, int index) : scheduler(owner), workerIndex(index) {}
+
+protected:
+    void run();
+
+private:
+    JobScheduler *scheduler;
+    int workerIndex;
+};
+
+/*
+ * JobScheduler runs the background work of the player (analysis, hashing,
+ * prefetching, tag writes) on one set of worker threads, so the jobs don't
+ * each bring their own QThreadPool and compete for the cores behind each
+ * other's backs.
+ *
+ * Every job has a priority class. A free worker always takes the most urgent
+ * class it may start: each class has its own limit on running jobs, and on
+ * running jobs flagged IO_BOUND. While the player is in PlayingState the
+ * BACKGROUND class is throttled to a single job at idle thread priority,
+ * which keeps the decoder and the audio output fed.
+ *
+ * Each worker has its own queues. A job submitted from a worker stays on that
+ * worker, which takes its newest job first, and idle workers steal the oldest
+ * jobs of the others. Jobs are whole tracks or files, so one lock for all the
+ * queues is plenty.
+ *
+ * Jobs are grouped by an owner pointer, which is what cancel() and
+ * waitForGroup() work on. Like QThreadPool, the scheduler deletes jobs that
+ * have autoDelete() set.
+ */
+class JobScheduler : public QObject {
+    Q_OBJECT
+
+public:
+    enum Priority {
+        INTERACTIVE = 0,    // the user is waiting on it right now
+        USER_INITIATED,     // asked for, results expected soon
+        BACKGROUND,         // maintenance, can take as long as it likes
+        PRIORITY_CLASSES
+    };
+    // job flags
+    const static int IO_BOUND = 1;
+
+    // there's one per application, created in main()
+    JobScheduler(QObject *parent = 0);
+    ~JobScheduler();
+    static JobScheduler *instance();
+
+    void submit(QRunnable *job, Priority priority, const void *group, int flags = 0);
+    // drops the queued jobs of group, returns how many there were. Running
+    // jobs finish, they have to check their own cancel flag.
+    int cancel(const void *group);
+    // blocks until none of group's jobs are queued or running
+    void waitForGroup(const void *group);
+
+    void setMaxRunning(Priority priority, int jobs);
+    void setMaxIo(Priority priority, int jobs);
+    int maxRunning(Priority priority) const;
+    int workerCount() const;
+    bool isThrottled() const;
+
+    // statistics
+    int queued(Priority priority) const;
+    int running(Priority priority) const;
+    int completed(Priority priority) const;
+    int cancelled(Priority priority) const;
+    int steals() const;
+    qint64 throttledMs() const;
+
+public slots:
+    void playbackStateChanged(QMediaPlayer::State state);
+
+signals:
+    // queued and running jobs of all classes, rate limited to once per event loop pass
+    void activityChanged(int queued, int running);
+
+private slots:
+    void notifyActivity();
+
+private:
+    friend class JobWorker;
+
+    struct Entry {
+        QRunnable *job;
+        const void *group;
+        int flags;
+        Priority priority;
+    };
+
+    void work(int workerIndex);
+    bool takeJob(int workerIndex, Entry &entry);
+    bool canStart(const Entry &entry) const;
+    int limit(Priority priority) const;
+    int ioLimit(Priority priority) const;
+    int queuedLocked(Priority priority) const;
+    int workerIndexOf(QThread *thread) const;
+    void activityLocked();
+
+    mutable QMutex lock;
+    QWaitCondition jobAvailable;
+    QWaitCondition jobFinished;
+    QVector<JobWorker *> workers;
+    // per worker, per class; the owner takes from the back, thieves from the front
+    QVector<QList<Entry> > queues[PRIORITY_CLASSES];
+    int nextWorker;
+    bool quit;
+
+    int maxJobs[PRIORITY_CLASSES];
+    int maxIoJobs[PRIORITY_CLASSES];
+    int runningJobs[PRIORITY_CLASSES];
+    int runningIo[PRIORITY_CLASSES];
+    QHash<const void *, int> groupJobs;     // queued + running per group
+    bool throttled;
+    QElapsedTimer throttleTimer;
+    qint64 throttledTotal;
+    bool activityPending;
+
+    int completedJobs[PRIORITY_CLASSES];
+    int cancelledJobs[PRIORITY_CLASSES];
+    int stealCount;
+
+    static JobScheduler *self;
+};
@@ -1,6 +1,11 @@
 #include "debug.h"
 #include "library.h"
 #include "libraryModel.h"
+#include "libraryIndex.h"
+#include "libraryFilterProxyModel.h"
+#include "facetPanel.h"
+#include "folderModel.h"
+#include "pathTrie.h"
 #include "playlistLibraryModel.h"
 #include "playlistLibraryView.h"
 #include <QAbstractItemView>
@@ -13,12 +18,33 @@ Library::Library(QWidget *parent) : QWidget(parent) {
     playlistLabel = new QLabel(this);
     playlistLabel->setText("Playlists");
 
-    // library model
+    // library model, past the node cap the albums and songs of collapsed
+    // artists are dropped, to be fetched again when they're expanded
     libraryModel = new LibraryModel(this);
+    libraryModel->setNodeCap(LIBRARY_NODE_CAP);
+
+    // filter box, narrowing the library down while typing
+    filterBox = new QLineEdit(this);
+    filterBox->setPlaceholderText(tr("Filter by title, artist or album"));
+    filterBox->setClearButtonEnabled(true);
+    filterModel = new LibraryFilterProxyModel(libraryModel, this);
+
+    // facet panel, narrowing it down by genre, year, format and album
+    facetPanel = new FacetPanel(libraryModel->searchIndex(), this);
 
     // library view
     libraryView = new LibraryView(this);
-    libraryView->setModel(libraryModel);
+    libraryView->setModel(filterModel);
+
+    // folder view, the same songs by directory
+    folderModel = new FolderModel(this);
+    folderView = new QTreeView(this);
+    folderView->setModel(folderModel);
+    folderView->setHeaderHidden(true);
+    folderView->setUniformRowHeights(true);
+    browseTabs = new QTabWidget(this);
+    browseTabs->addTab(libraryView, tr("Artists"));
+    browseTabs->addTab(folderView, tr("Folders"));
 
     // playlist-library model
     plModel = new PlaylistLibraryModel(this);
@@ -34,18 +60,36 @@ Library::Library(QWidget *parent) : QWidget(parent) {
     displayLayout->addWidget(libraryLabel);
     displayLayout->setStretch(0, 1);
 
-    displayLayout->addWidget(libraryView);
-    displayLayout->setStretch(1, 10);
+    displayLayout->addWidget(filterBox);
+    displayLayout->setStretch(1, 1);
+
+    displayLayout->addWidget(facetPanel);
+    displayLayout->setStretch(2, 4);
+
+    displayLayout->addWidget(browseTabs);
+    displayLayout->setStretch(3, 10);
 
     displayLayout->addWidget(playlistLabel);
-    displayLayout->setStretch(2, 1);
+    displayLayout->setStretch(4, 1);
 
     displayLayout->addWidget(plView);
-    displayLayout->setStretch(3, 5);
+    displayLayout->setStretch(5, 5);
     setLayout(displayLayout);
 
     // signal connections
     connect(libraryView, SIGNAL(activated(QModelIndex)), this, SLOT(addToPlaylist(QModelIndex)));
+    connect(filterBox, SIGNAL(textChanged(QString)), filterModel, SLOT(setFilterQuery(QString)));
+    connect(filterModel, SIGNAL(filtered(int, int, qint64)), this, SLOT(libraryFiltered(int, int, qint64)));
+    connect(facetPanel, SIGNAL(facetChanged(int, QStringList)), filterModel, SLOT(setFacet(int, QStringList)));
+    // queued: a check in the panel filters, and the panel's lists are refilled
+    connect(filterModel, SIGNAL(filtered(int, int, qint64)), facetPanel, SLOT(refresh()), Qt::QueuedConnection);
+    connect(libraryModel, SIGNAL(rowsInserted(QModelIndex, int, int)), facetPanel, SLOT(scheduleRefresh()));
+    connect(libraryModel, SIGNAL(dataChanged(QModelIndex, QModelIndex)), facetPanel, SLOT(scheduleRefresh()));
+    connect(libraryModel, SIGNAL(facetsChanged()), facetPanel, SLOT(scheduleRefresh()));
+    connect(folderView, SIGNAL(activated(QModelIndex)), this, SLOT(addFolderToPlaylist(QModelIndex)));
+    connect(browseTabs, SIGNAL(currentChanged(int)), this, SLOT(browseTabChanged(int)));
+    connect(libraryView, SIGNAL(expanded(QModelIndex)), this, SLOT(libraryExpanded(QModelIndex)));
+    connect(libraryView, SIGNAL(collapsed(QModelIndex)), this, SLOT(libraryCollapsed(QModelIndex)));
 
 }
 
@@ -71,7 +115,13 @@ PlaylistLibraryView* Library::view_pl() const {
 }
 
 // slot
-void Library::addToPlaylist(const QModelIndex idx) {
+void Library::setWindowed(bool windowed) {
+    libraryModel->setNodeCap(windowed ? LIBRARY_NODE_CAP : 0);
+}
+
+// slot
+void Library::addToPlaylist(const QModelIndex viewIdx) {
+    QModelIndex idx = filterModel->mapToSource(viewIdx);
     TreeItem *item = libraryModel->getItem(idx);
     ////qDebug() << "Clicked item has data: " << item->data();
     if (item->getItemType() == TreeItem::SONG) {
@@ -80,4 +130,63 @@ void Library::addToPlaylist(const QModelIndex idx) {
     if (item->getItemType() == TreeItem::ARTIST) {
         emit(addArtistToPlaylist(libraryModel->getArtistSongInfo(idx)));
     }
+    if (item->getItemType() == TreeItem::ALBUM) {
+        emit(addArtistToPlaylist(libraryModel->getAlbumSongInfo(idx)));
+    }
+}
+
+// slot
+void Library::libraryFiltered(int songs, int artists, qint64 nsecs) {
+    if (!libraryModel->searchIndex()->isActive()) {
+        libraryLabel->setText("Media Library");
+        libraryLabel->setToolTip(QString());
+        return;
+    }
+    libraryLabel->setText(QString("Media Library (%1 songs)").arg(songs));
+    libraryLabel->setToolTip(QString("%1 artists, found in %2 ms").arg(artists).arg(nsecs/1000000.0, 0, 'f', 2));
+    // a handful of artists is what's being looked for, so show their songs;
+    // the albums and songs of an artist are only fetched when it's expanded
+    if (artists <= 20) {
+        for (int a = 0; a < filterModel->rowCount(); a++) {
+            QModelIndex artistIdx = filterModel->index(a, 0);
+            expandFetched(artistIdx);
+            for (int b = 0; b < filterModel->rowCount(artistIdx); b++) {
+                expandFetched(filterModel->index(b, 0, artistIdx));
+            }
+        }
+    }
+}
+
+void Library::expandFetched(const QModelIndex &idx) {
+    if (filterModel->canFetchMore(idx)) {
+        filterModel->fetchMore(idx);
+    }
+    libraryView->expand(idx);
+}
+
+// slot
+void Library::libraryExpanded(const QModelIndex &viewIdx) {
+    libraryModel->setExpanded(filterModel->mapToSource(viewIdx), true);
+}
+
+// slot
+void Library::libraryCollapsed(const QModelIndex &viewIdx) {
+    libraryModel->setExpanded(filterModel->mapToSource(viewIdx), false);
+}
+
+// slot
+void Library::addFolderToPlaylist(QModelIndex idx) {
+    // a file, or everything under a folder
+    emit(addArtistToPlaylist(libraryModel->getPathSongInfo(folderModel->filesUnder(idx))));
+}
+
+// slot
+void Library::browseTabChanged(int tab) {
+    if (browseTabs->widget(tab) != folderView) {
+        return;
+    }
+    // what keeping the paths in the trie saves
+    PathTrie::Stats stats = PathTrie::instance()->stats();
+    folderView->setToolTip(QString("%1 paths in %2 directory nodes: %3 KB, %4 KB as separate strings")
+                           .arg(stats.paths).arg(stats.nodes).arg(stats.bytes / 1024).arg(stats.flatBytes / 1024));
 }
@@ -5,12 +5,17 @@
 #include "playlistLibraryView.h"
 #include <QWidget>
 #include <QTreeView>
+#include <QTabWidget>
 #include <QLabel>
+#include <QLineEdit>
 
 class LibraryModel;
 class LibraryView;
 class PlaylistLibraryModel;
 class PlaylistLibraryView;
+class LibraryFilterProxyModel;
+class FacetPanel;
+class FolderModel;
 
 class Library : public QWidget {
     Q_OBJECT
@@ -23,18 +28,40 @@ public:
     PlaylistLibraryModel *model_pl() const;
     PlaylistLibraryView *view_pl() const;
 
+public slots:
+    // windowed: albums and songs past LIBRARY_NODE_CAP are dropped when
+    // they're out of view; otherwise everything fetched stays in memory
+    void setWindowed(bool windowed);
+
 private slots:
     void addToPlaylist(QModelIndex idx);
+    void libraryFiltered(int songs, int artists, qint64 nsecs);
+    void addFolderToPlaylist(QModelIndex idx);
+    void browseTabChanged(int tab);
+    void libraryExpanded(const QModelIndex &viewIdx);
+    void libraryCollapsed(const QModelIndex &viewIdx);
 
 signals:
     void addSongToPlaylist(const QHash<QString, QString> hash);
     void addArtistToPlaylist(const QList<QHash<QString, QString> > hashList);
 
 private:
+    // album and song nodes kept in memory
+    static const int LIBRARY_NODE_CAP = 20000;
+
+    // fetches idx's children if needed, so expanding it shows them
+    void expandFetched(const QModelIndex &idx);
+
     QLabel *libraryLabel;
     QLabel *playlistLabel;
+    QLineEdit *filterBox;
     LibraryModel *libraryModel;
+    LibraryFilterProxyModel *filterModel;
+    FacetPanel *facetPanel;
     LibraryView *libraryView;
+    FolderModel *folderModel;
+    QTreeView *folderView;
+    QTabWidget *browseTabs;
     PlaylistLibraryModel *plModel;
     PlaylistLibraryView *plView;
 };
@@ -0,0 +1,106 @@
+#include "libraryBackfill.h"
+#include "contentHash.h"
+#include <QRunnable>
+#include <QMutexLocker>
+#include <taglib/fileref.h>
+#include <taglib/tag.h>
+
+namespace {
+
+class BackfillTask : public QRunnable {
+public:
+    BackfillTask(LibraryBackfill *owner, const QString &absFilePath, bool hash, bool facets)
+        : backfill(owner), path(absFilePath), wantHash(hash), wantFacets(facets) {}
+
+    void run() {
+        LibraryBackfill::Result result;
+        result.absFilePath = path;
+        result.hash = 0;
+        result.faceted = false;
+        result.year = 0;
+        if (!backfill->isCancelled()) {
+            if (wantHash) {
+                result.hash = (qint64)contentHash(path);
+            }
+            if (wantFacets) {
+                QByteArray byteArray = path.toUtf8();
+                TagLib::FileRef f(byteArray.constData());
+                if (!f.isNull() && f.tag()) {
+                    result.genre = QString::fromStdString(f.tag()->genre().toCString(true));
+                    result.year = f.tag()->year();
+                }
+                // untagged is an answer too, the row isn't read again
+                result.faceted = true;
+            }
+        }
+        backfill->post(result);
+    }
+
+private:
+    LibraryBackfill *backfill;
+    QString path;
+    bool wantHash;
+    bool wantFacets;
+};
+
+}
+
+LibraryBackfill::LibraryBackfill(QObject *parent) : QObject(parent) {
+    scheduler = JobScheduler::instance();
+}
+
+LibraryBackfill::~LibraryBackfill() {
+    cancel();
+    scheduler->waitForGroup(this);
+}
+
+void LibraryBackfill::addFile(const QString &absFilePath, bool hash, bool facets) {
+    if (queued.contains(absFilePath)) {
+        return;
+    }
+    if (queued.isEmpty()) {
+        cancelled.storeRelease(0);
+    }
+    queued.insert(absFilePath);
+    scheduler->submit(new BackfillTask(this, absFilePath, hash, facets), JobScheduler::BACKGROUND, this,
+                      JobScheduler::IO_BOUND);
+}
+
+void LibraryBackfill::cancel() {
+    // the rows stay as they are, the next populateModel() queues them again
+    cancelled.storeRelease(1);
+    scheduler->cancel(this);
+    queued.clear();
+}
+
+bool LibraryBackfill::isCancelled() const {
+    return cancelled.loadAcquire() != 0;
+}
+
+void LibraryBackfill::post(const Result &result) {
+    QMutexLocker locker(&resultsLock);
+    results.append(result);
+    if (results.size() == 1) {
+        QMetaObject::invokeMethod(this, "collectResults", Qt::QueuedConnection);
+    }
+}
+
+void LibraryBackfill::collectResults() {
+    QList<Result> batch;
+    {
+        QMutexLocker locker(&resultsLock);
+        batch.swap(results);
+    }
+    if (isCancelled()) {
+        return;
+    }
+    foreach (const Result &r, batch) {
+        queued.remove(r.absFilePath);
+        if (r.hash) {
+            emit(hashRead(r.absFilePath, r.hash));
+        }
+        if (r.faceted) {
+            emit(facetsRead(r.absFilePath, r.genre, r.year));
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "debug.h"
+#include "jobScheduler.h"
+#include <QObject>
+#include <QList>
+#include <QSet>
+#include <QMutex>
+#include <QString>
+#include <QAtomicInt>
+
+/*
+ * LibraryBackfill reads what library rows added by older versions lack,
+ * the content hash and the genre and year tags, so populateModel() can
+ * build the tree from the database as it is. One file per BACKGROUND job,
+ * IO_BOUND; results are reported on the thread that owns it.
+ */
+class LibraryBackfill : public QObject {
+    Q_OBJECT
+
+public:
+    LibraryBackfill(QObject *parent = 0);
+    ~LibraryBackfill();
+
+    // a file already queued isn't queued again
+    void addFile(const QString &absFilePath, bool hash, bool facets);
+    void cancel();
+    bool isCancelled() const;
+
+    // filled in by the worker threads and picked up by collectResults()
+    struct Result {
+        QString absFilePath;
+        qint64 hash;        // 0 if not asked for, or the file can't be read
+        bool faceted;
+        QString genre;
+        int year;
+    };
+    void post(const Result &result);
+
+signals:
+    void hashRead(QString absFilePath, qint64 hash);
+    void facetsRead(QString absFilePath, QString genre, int year);
+
+private slots:
+    void collectResults();
+
+private:
+    JobScheduler *scheduler;
+    QAtomicInt cancelled;
+    QMutex resultsLock;
+    QList<Result> results;
+    QSet<QString> queued;
+};
@@ -0,0 +1,39 @@
+#include "libraryFilterProxyModel.h"
+#include "libraryModel.h"
+#include "libraryIndex.h"
+#include "treeItem.h"
+
+LibraryFilterProxyModel::LibraryFilterProxyModel(LibraryModel *model, QObject *parent)
+    : QSortFilterProxyModel(parent), library(model), index(model->searchIndex()) {
+    setSourceModel(model);
+}
+
+void LibraryFilterProxyModel::setFilterQuery(const QString &query) {
+    index->search(query);
+    refilter();
+}
+
+void LibraryFilterProxyModel::setFacet(int facet, const QStringList &values) {
+    index->selectFacet(facet, values);
+    refilter();
+}
+
+void LibraryFilterProxyModel::refilter() {
+    invalidateFilter();
+    emit(filtered(index->matchCount(), index->isActive() ? index->artistMatchCount() : rowCount(),
+                  index->lastSearchNsecs()));
+}
+
+bool LibraryFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const {
+    if (!index->isActive()) {
+        return true;
+    }
+    TreeItem *item = library->getItem(sourceModel()->index(sourceRow, 0, sourceParent));
+    if (item->getItemType() == TreeItem::ARTIST) {
+        return index->artistMatches(item->getItemData().value("ArtistKey"));
+    }
+    if (item->getItemType() == TreeItem::ALBUM) {
+        return index->albumMatches(item->parent()->getItemData().value("ArtistKey"), item->getItemData().value("Album"));
+    }
+    return index->matches(item->pathNode());
+}
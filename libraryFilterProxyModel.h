@@ -0,0 +1,36 @@
+#pragma once
+#include <QSortFilterProxyModel>
+#include <QStringList>
+
+class LibraryModel;
+class LibraryIndex;
+
+/*
+ * LibraryFilterProxyModel sits between the LibraryModel and its view and
+ * shows the songs matching the filter box and the facet panel, with their albums and
+ * artists. The matching is done by the model's LibraryIndex, rows are only looked up in it.
+ */
+class LibraryFilterProxyModel : public QSortFilterProxyModel {
+    Q_OBJECT
+
+public:
+    LibraryFilterProxyModel(LibraryModel *model, QObject *parent = 0);
+
+public slots:
+    void setFilterQuery(const QString &query);
+    // facet is a FacetIndex::Facet, no values shows them all
+    void setFacet(int facet, const QStringList &values);
+
+signals:
+    // after every new query: songs and artists shown, and the index lookup time
+    void filtered(int songs, int artists, qint64 nsecs);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
+
+private:
+    void refilter();
+
+    LibraryModel *library;
+    LibraryIndex *index;
+};
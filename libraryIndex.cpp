@@ -0,0 +1,438 @@
+#include "libraryIndex.h"
+#include "artistKey.h"
+#include "pathTrie.h"
+#include <QElapsedTimer>
+#include <algorithm>
+
+LibraryIndex::LibraryIndex() {
+    live = 0;
+    matchTotal = 0;
+    artistTotal = 0;
+    searchNsecs = 0;
+}
+
+void LibraryIndex::clear() {
+    entries.clear();
+    freeIds.clear();
+    foreach (quint32 node, ids.keys()) {
+        PathTrie::instance()->release(node);
+    }
+    ids.clear();
+    grams.clear();
+    artistIds.clear();
+    artistKeys.clear();
+    albumIds.clear();
+    albumNames.clear();
+    live = 0;
+    facetIndex.clear();
+    candidates.clear();
+    textMatches.clear();
+    matched.clear();
+    artistHits.clear();
+    albumHits.clear();
+    matchTotal = 0;
+    artistTotal = 0;
+}
+
+QString LibraryIndex::fold(const QString &text) {
+    // decomposing is slow, most tags don't need it
+    bool ascii = true;
+    for (int i = 0; i < text.size() && ascii; i++) {
+        ascii = text[i].unicode() < 0x80;
+    }
+    QString source = ascii ? text : text.normalized(QString::NormalizationForm_KD);
+    QString out;
+    out.reserve(source.size() + 1);
+    bool inWord = false;
+    for (int i = 0; i < source.size(); i++) {
+        QChar c = source[i];
+        if (c.category() == QChar::Mark_NonSpacing) {
+            continue;
+        }
+        if (c.isLetterOrNumber()) {
+            if (!inWord) {
+                out += QLatin1Char(' ');
+                inWord = true;
+            }
+            out += c.toCaseFolded();
+        } else {
+            inWord = false;
+        }
+    }
+    return out;
+}
+
+quint64 LibraryIndex::gramKey(const QString &words, int from, int length) {
+    quint64 key = (quint64)length << 48;
+    for (int i = 0; i < length; i++) {
+        key |= (quint64)words[from + i].unicode() << (32 - 16 * i);
+    }
+    return key;
+}
+
+void LibraryIndex::insert(const QString &absFilePath, const QString &title, const QString &artist, const QString &album,
+                          const QString &genre, const QString &year, const QString &format) {
+    QStringList facets;
+    facets << genre << year << format << album;
+    int id = ids.value(PathTrie::instance()->find(absFilePath), -1);
+    if (id >= 0) {
+        // read again, it keeps its id
+        rewrite(id, artistKey(artist), album, fold(title), fold(artist), fold(album), facets);
+        return;
+    }
+    add(absFilePath, artistKey(artist), album, fold(title), fold(artist), fold(album), facets);
+}
+
+void LibraryIndex::update(const QString &absFilePath, const QString &title, const QString &artist, const QString &album) {
+    int id = ids.value(PathTrie::instance()->find(absFilePath), -1);
+    if (id < 0) {
+        return;
+    }
+    // the folded words are all that's kept, the changed part is spliced in
+    const Entry &e = entries[id];
+    QString titleWords = title.isEmpty() ? e.words.left(e.artistFrom) : fold(title);
+    QString artistWords = artist.isEmpty() ? e.words.mid(e.artistFrom, e.albumFrom - e.artistFrom) : fold(artist);
+    QString albumWords = album.isEmpty() ? e.words.mid(e.albumFrom) : fold(album);
+    QString key = artist.isEmpty() ? artistKeys[e.artist] : artistKey(artist);
+    QString albumName = album.isEmpty() ? albumNames[e.album] : album;
+    QStringList facets = facetIndex.values(id);
+    facets[FacetIndex::ALBUM] = albumName;
+    rewrite(id, key, albumName, titleWords, artistWords, albumWords, facets);
+}
+
+void LibraryIndex::updateFacets(const QString &absFilePath, const QString &genre, const QString &year,
+                                const QString &format) {
+    int id = ids.value(PathTrie::instance()->find(absFilePath), -1);
+    if (id < 0) {
+        return;
+    }
+    const Entry &e = entries[id];
+    QString titleWords = e.words.left(e.artistFrom);
+    QString artistWords = e.words.mid(e.artistFrom, e.albumFrom - e.artistFrom);
+    QString albumWords = e.words.mid(e.albumFrom);
+    QString key = artistKeys[e.artist];
+    QString albumName = albumNames[e.album];
+    QStringList facets = facetIndex.values(id);
+    facets[FacetIndex::GENRE] = genre;
+    facets[FacetIndex::YEAR] = year;
+    facets[FacetIndex::FORMAT] = format;
+    rewrite(id, key, albumName, titleWords, artistWords, albumWords, facets);
+}
+
+void LibraryIndex::add(const QString &absFilePath, const QString &key, const QString &album, const QString &titleWords,
+                       const QString &artistWords, const QString &albumWords, const QStringList &facets) {
+    // a removed song's id is taken again, so the entries and the grams'
+    // lists stay as long as the library is
+    int id;
+    if (freeIds.isEmpty()) {
+        id = entries.size();
+        entries.append(Entry());
+        matched.resize(entries.size());
+    } else {
+        id = freeIds.takeLast();
+    }
+    ids.insert(PathTrie::instance()->insert(absFilePath), id);
+    live++;
+    fill(id, key, album, titleWords, artistWords, albumWords);
+    post(id);
+    facetIndex.insert(id, facets);
+    rematch(id);
+}
+
+void LibraryIndex::rewrite(int id, const QString &key, const QString &album, const QString &titleWords,
+                           const QString &artistWords, const QString &albumWords, const QStringList &facets) {
+    unmatch(id);
+    unpost(id);
+    fill(id, key, album, titleWords, artistWords, albumWords);
+    post(id);
+    facetIndex.insert(id, facets);
+    rematch(id);
+}
+
+void LibraryIndex::fill(int id, const QString &key, const QString &album, const QString &titleWords,
+                        const QString &artistWords, const QString &albumWords) {
+    Entry &e = entries[id];
+    e.words = titleWords + artistWords + albumWords;
+    e.artistFrom = titleWords.size();
+    e.albumFrom = e.artistFrom + artistWords.size();
+    e.removed = false;
+    QHash<QString, int>::const_iterator a = artistIds.constFind(key);
+    if (a == artistIds.constEnd()) {
+        e.artist = artistKeys.size();
+        artistIds.insert(key, e.artist);
+        artistKeys.append(key);
+        artistHits.append(0);
+    } else {
+        e.artist = a.value();
+    }
+    QString albumGroup = key + QLatin1Char('\n') + album;
+    QHash<QString, int>::const_iterator b = albumIds.constFind(albumGroup);
+    if (b == albumIds.constEnd()) {
+        e.album = albumNames.size();
+        albumIds.insert(albumGroup, e.album);
+        albumNames.append(album);
+        albumHits.append(0);
+    } else {
+        e.album = b.value();
+    }
+}
+
+QVector<quint64> LibraryIndex::gramKeys(const QString &words) {
+    QVector<quint64> keys;
+    for (int i = 1; i < words.size(); i++) {
+        if (words[i-1] != QLatin1Char(' ')) {
+            continue;
+        }
+        int end = words.indexOf(QLatin1Char(' '), i);
+        int length = (end < 0 ? words.size() : end) - i;
+        for (int n = 1; n <= qMin(3, length); n++) {
+            keys.append(gramKey(words, i, n));
+        }
+    }
+    return keys;
+}
+
+void LibraryIndex::post(int id) {
+    foreach (quint64 key, gramKeys(entries[id].words)) {
+        QVector<int> &list = grams[key];
+        // usually the newest id, at the end; a reused one goes in its place
+        if (list.isEmpty() || list.last() < id) {
+            list.append(id);
+            continue;
+        }
+        QVector<int>::iterator at = std::lower_bound(list.begin(), list.end(), id);
+        if (*at != id) {
+            list.insert(at, id);
+        }
+    }
+}
+
+void LibraryIndex::unpost(int id) {
+    foreach (quint64 key, gramKeys(entries[id].words)) {
+        QHash<quint64, QVector<int> >::iterator it = grams.find(key);
+        if (it == grams.end()) {
+            continue;
+        }
+        QVector<int> &list = it.value();
+        QVector<int>::iterator at = std::lower_bound(list.begin(), list.end(), id);
+        if (at != list.end() && *at == id) {
+            list.erase(at);
+        }
+        if (list.isEmpty()) {
+            grams.erase(it);
+        }
+    }
+}
+
+void LibraryIndex::rematch(int id) {
+    // against the current query and facets, without searching again
+    bool text = queryWords.isEmpty() || entryMatches(entries[id]);
+    if (text && !queryWords.isEmpty()) {
+        candidates.insert(std::lower_bound(candidates.begin(), candidates.end(), id), id);
+        textMatches.add(id);
+    }
+    if (isActive()) {
+        setMatched(id, text && facetIndex.accepts(id));
+    }
+}
+
+void LibraryIndex::unmatch(int id) {
+    setMatched(id, false);
+    facetIndex.remove(id);
+    textMatches.remove(id);
+    QVector<int>::iterator at = std::lower_bound(candidates.begin(), candidates.end(), id);
+    if (at != candidates.end() && *at == id) {
+        candidates.erase(at);
+    }
+}
+
+void LibraryIndex::remove(const QString &absFilePath) {
+    quint32 node = PathTrie::instance()->find(absFilePath);
+    int id = ids.value(node, -1);
+    if (id < 0) {
+        return;
+    }
+    unmatch(id);
+    unpost(id);
+    ids.remove(node);
+    PathTrie::instance()->release(node);
+    entries[id].removed = true;
+    entries[id].words.clear();
+    freeIds.append(id);
+    live--;
+}
+
+int LibraryIndex::size() const {
+    return live;
+}
+
+const QVector<int> &LibraryIndex::rarestList(const QStringList &words) const {
+    static const QVector<int> none;
+    const QVector<int> *rarest = 0;
+    foreach (const QString &word, words) {
+        QHash<quint64, QVector<int> >::const_iterator it = grams.constFind(gramKey(word, 0, qMin(3, word.size())));
+        if (it == grams.constEnd()) {
+            return none;
+        }
+        if (!rarest || it.value().size() < rarest->size()) {
+            rarest = &it.value();
+        }
+    }
+    return rarest ? *rarest : none;
+}
+
+bool LibraryIndex::search(const QString &query) {
+    QElapsedTimer timer;
+    timer.start();
+    QStringList words = fold(query).split(QLatin1Char(' '), QString::SkipEmptyParts);
+
+    // typing on: every old word is still there, maybe longer
+    bool narrowing = !queryWords.isEmpty() && words.size() >= queryWords.size();
+    for (int i = 0; i < queryWords.size() && narrowing; i++) {
+        narrowing = words[i].startsWith(queryWords[i]);
+    }
+    queryWords = words;
+    patterns.clear();
+    foreach (const QString &word, words) {
+        patterns << QString(" ") + word;
+    }
+    match(narrowing);
+    searchNsecs = timer.nsecsElapsed();
+    return isActive();
+}
+
+void LibraryIndex::selectFacet(int facet, const QStringList &values) {
+    QElapsedTimer timer;
+    timer.start();
+    facetIndex.select((FacetIndex::Facet)facet, values);
+    // the words matched before still do
+    matchSelection();
+    searchNsecs = timer.nsecsElapsed();
+}
+
+QList<FacetIndex::Count> LibraryIndex::facetCounts(int facet) const {
+    return facetIndex.counts((FacetIndex::Facet)facet, queryWords.isEmpty() ? 0 : &textMatches);
+}
+
+void LibraryIndex::match(bool narrowing) {
+    // the songs with the words first, the facets are applied to those
+    QVector<int> next;
+    if (!queryWords.isEmpty()) {
+        const QVector<int> &listed = rarestList(queryWords);
+        if (narrowing && candidates.size() <= listed.size()) {
+            foreach (int id, candidates) {
+                const Entry &e = entries[id];
+                if (!e.removed && entryMatches(e)) {
+                    next.append(id);
+                }
+            }
+        } else {
+            // a single short word is exactly what its gram lists
+            bool exact = queryWords.size() == 1 && queryWords[0].size() <= 3;
+            next.reserve(listed.size());
+            foreach (int id, listed) {
+                const Entry &e = entries[id];
+                if (!e.removed && (exact || entryMatches(e))) {
+                    next.append(id);
+                }
+            }
+        }
+    }
+    candidates = next;
+    textMatches.clear();
+    foreach (int id, next) {
+        textMatches.add(id);
+    }
+    matchSelection();
+}
+
+void LibraryIndex::matchSelection() {
+    matched.fill(false);
+    artistHits.fill(0);
+    albumHits.fill(0);
+    matchTotal = 0;
+    artistTotal = 0;
+    if (facetIndex.isActive()) {
+        CompressedBitmap shown = queryWords.isEmpty() ? facetIndex.selection() : textMatches & facetIndex.selection();
+        foreach (quint32 id, shown.toVector()) {
+            setMatched(id, true);
+        }
+    } else {
+        foreach (int id, candidates) {
+            setMatched(id, true);
+        }
+    }
+}
+
+bool LibraryIndex::entryMatches(const Entry &entry) const {
+    foreach (const QString &pattern, patterns) {
+        if (!entry.words.contains(pattern)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LibraryIndex::setMatched(int id, bool match) {
+    if (matched.testBit(id) == match) {
+        return;
+    }
+    matched.setBit(id, match);
+    albumHits[entries[id].album] += match ? 1 : -1;
+    int &hits = artistHits[entries[id].artist];
+    if (match) {
+        matchTotal++;
+        if (hits++ == 0) {
+            artistTotal++;
+        }
+    } else {
+        matchTotal--;
+        if (--hits == 0) {
+            artistTotal--;
+        }
+    }
+}
+
+bool LibraryIndex::isActive() const {
+    return !queryWords.isEmpty() || facetIndex.isActive();
+}
+
+bool LibraryIndex::matches(const QString &absFilePath) const {
+    return matches(PathTrie::instance()->find(absFilePath));
+}
+
+bool LibraryIndex::matches(quint32 pathNode) const {
+    if (!isActive()) {
+        return true;
+    }
+    int id = ids.value(pathNode, -1);
+    return id >= 0 && matched.testBit(id);
+}
+
+bool LibraryIndex::artistMatches(const QString &key) const {
+    if (!isActive()) {
+        return true;
+    }
+    int id = artistIds.value(key, -1);
+    return id >= 0 && artistHits[id] > 0;
+}
+
+bool LibraryIndex::albumMatches(const QString &key, const QString &album) const {
+    if (!isActive()) {
+        return true;
+    }
+    int id = albumIds.value(key + QLatin1Char('\n') + album, -1);
+    return id >= 0 && albumHits[id] > 0;
+}
+
+int LibraryIndex::matchCount() const {
+    return isActive() ? matchTotal : live;
+}
+
+int LibraryIndex::artistMatchCount() const {
+    return artistTotal;
+}
+
+qint64 LibraryIndex::lastSearchNsecs() const {
+    return searchNsecs;
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include "debug.h"
+#include "facetIndex.h"
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QBitArray>
+
+/*
+ * LibraryIndex finds library songs by the words of their title, artist and
+ * album, for the filter box over the library tree. It lives in memory next
+ * to the tree, LibraryModel keeps it up to date, and a search never goes to
+ * the database.
+ *
+ * A song matches when every word of the query starts one of its words, case
+ * and accents ignored ("beat hey" finds The Beatles' Hey Jude). The words of
+ * each song are indexed by their first one, two and three characters, so a
+ * search only looks at the songs listed under the rarest query word. When
+ * the query just grows, as it does while typing, the previous matches are
+ * narrowed down instead if there are fewer of them.
+ *
+ * Songs added or changed while a query is active are matched against it
+ * straight away, so the results stay current without searching again.
+ * A changed song keeps its id and only its own grams are redone; a removed
+ * song's id goes to the next one added, so edits don't grow the index.
+ * The paths are held in the PathTrie, which the folder view shows.
+ *
+ * The genre, year, format and album of each song are in a FacetIndex too.
+ * Facet values selected in the panel narrow the matches down further, and
+ * the panel's counts are taken among the songs the words match.
+ */
+class LibraryIndex {
+public:
+    LibraryIndex();
+
+    // drops all songs, the query stays
+    void clear();
+    void insert(const QString &absFilePath, const QString &title, const QString &artist, const QString &album,
+                const QString &genre = QString(), const QString &year = QString(), const QString &format = QString());
+    // empty fields keep their value
+    void update(const QString &absFilePath, const QString &title, const QString &artist, const QString &album);
+    void updateFacets(const QString &absFilePath, const QString &genre, const QString &year, const QString &format);
+    void remove(const QString &absFilePath);
+    int size() const;
+
+    // false for an empty query, which matches everything
+    bool search(const QString &query);
+    // facet is a FacetIndex::Facet
+    void selectFacet(int facet, const QStringList &values);
+    QList<FacetIndex::Count> facetCounts(int facet) const;
+    // a query or a facet selection
+    bool isActive() const;
+    bool matches(const QString &absFilePath) const;
+    // by the path's PathTrie node
+    bool matches(quint32 pathNode) const;
+    // an artist node (by its artistKey()) has a matching song
+    bool artistMatches(const QString &key) const;
+    // and one of its albums
+    bool albumMatches(const QString &key, const QString &album) const;
+    int matchCount() const;
+    int artistMatchCount() const;
+    qint64 lastSearchNsecs() const;
+
+    // lower case, no accents, every word behind a single space
+    static QString fold(const QString &text);
+
+private:
+    struct Entry {
+        QString words;      // folded title, artist and album, in that order
+        int artistFrom;     // where the artist's and the album's words start
+        int albumFrom;
+        int artist;         // artist id, songs with the same artistKey() share it
+        int album;          // album id, per artist
+        bool removed;
+    };
+
+    void add(const QString &absFilePath, const QString &key, const QString &album, const QString &titleWords,
+             const QString &artistWords, const QString &albumWords, const QStringList &facets);
+    // a song already in, changed: same id, its grams and matches redone
+    void rewrite(int id, const QString &key, const QString &album, const QString &titleWords,
+                 const QString &artistWords, const QString &albumWords, const QStringList &facets);
+    void fill(int id, const QString &key, const QString &album, const QString &titleWords,
+              const QString &artistWords, const QString &albumWords);
+    static QVector<quint64> gramKeys(const QString &words);
+    // id in or out of the grams' lists of its words
+    void post(int id);
+    void unpost(int id);
+    // id in or out of the current matches
+    void rematch(int id);
+    void unmatch(int id);
+    // narrowing: the words only grew since the last match()
+    void match(bool narrowing);
+    // the songs matching the words that the facets let through
+    void matchSelection();
+    static quint64 gramKey(const QString &words, int from, int length);
+    const QVector<int> &rarestList(const QStringList &words) const;
+    bool entryMatches(const Entry &entry) const;
+    void setMatched(int id, bool match);
+
+    QVector<Entry> entries;
+    QVector<int> freeIds;                   // removed entries, taken again first
+    QHash<quint32, int> ids;                // live songs only, by PathTrie node
+    QHash<quint64, QVector<int> > grams;    // word prefix -> ids, ascending
+    QHash<QString, int> artistIds;          // by artistKey()
+    QVector<QString> artistKeys;
+    QHash<QString, int> albumIds;           // by artistKey() + "\n" + album
+    QVector<QString> albumNames;
+    int live;
+    FacetIndex facetIndex;
+
+    QStringList queryWords;                 // folded
+    QStringList patterns;                   // " word", finds word starts
+    QVector<int> candidates;                // the songs matching the words, ascending
+    CompressedBitmap textMatches;           // the same
+    QBitArray matched;
+    QVector<int> artistHits;                // matching songs per artist id
+    QVector<int> albumHits;                 // and per album id
+    int matchTotal;
+    int artistTotal;
+    qint64 searchNsecs;
+};
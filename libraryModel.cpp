@@ -1,4 +1,16 @@
 #include "libraryModel.h"
+#include "collation.h"
+#include "artistKey.h"
+#include "loudnessAnalyzer.h"
+#include "fingerprintAnalyzer.h"
+#include "audioFingerprint.h"
+#include "contentHash.h"
+#include "tempoKeyAnalyzer.h"
+#include "tempoKeyMeter.h"
+#include "tagWriter.h"
+#include "statementCache.h"
+#include "libraryIndex.h"
+#include "libraryBackfill.h"
 #include <assert.h>
 #include <QMimeData>
 #include <QtWidgets>
@@ -12,7 +24,24 @@
 
 LibraryModel::LibraryModel(QObject *parent) : QAbstractItemModel(parent) {
     u = new Util();
+    statements = 0;
+    filterIndex = new LibraryIndex();
+    analyzer = new LoudnessAnalyzer(this);
+    connect(analyzer, SIGNAL(trackAnalysed(QString, double, double)), this, SLOT(trackLoudnessAnalysed(QString, double, double)));
+    connect(analyzer, SIGNAL(albumAnalysed(QStringList, double, double)), this, SLOT(albumLoudnessAnalysed(QStringList, double, double)));
+    connect(analyzer, SIGNAL(finished()), this, SIGNAL(loudnessAnalysisFinished()));
+    tempoAnalyzer = new TempoKeyAnalyzer(this);
+    connect(tempoAnalyzer, SIGNAL(trackAnalysed(QString, double, int)), this, SLOT(tempoKeyAnalysed(QString, double, int)));
+    connect(tempoAnalyzer, SIGNAL(finished()), this, SIGNAL(tempoKeyAnalysisFinished()));
+    fingerprinter = new FingerprintAnalyzer(this);
+    pendingFingerprintJobs = 0;
+    connect(fingerprinter, SIGNAL(trackFingerprinted(QString, QByteArray)), this, SLOT(trackFingerprinted(QString, QByteArray)));
+    connect(fingerprinter, SIGNAL(finished()), this, SLOT(fingerprintingFinished()));
+    backfill = new LibraryBackfill(this);
+    connect(backfill, SIGNAL(hashRead(QString, qint64)), this, SLOT(hashBackfilled(QString, qint64)));
+    connect(backfill, SIGNAL(facetsRead(QString, QString, int)), this, SLOT(facetsBackfilled(QString, QString, int)));
     getImportDirs();    // populate importDirs with preferred music directories.
+    loadArtistAliases();
     if (!QSqlDatabase::drivers().contains("QSQLITE")) {
         QMessageBox msgBox;
         msgBox.setText("Unable to load database, Library needs the SQLITE driver");
@@ -38,8 +67,14 @@ LibraryModel::LibraryModel(QObject *parent) : QAbstractItemModel(parent) {
 }
 
 LibraryModel::~LibraryModel() {
+    delete analyzer;
+    delete fingerprinter;
+    delete tempoAnalyzer;
+    delete backfill;
     delete u;
     delete rootItem;
+    delete filterIndex;
+    delete statements;
     db.close();
 }
 
@@ -77,19 +112,118 @@ QSqlError LibraryModel::initDb() {
         return db.lastError();
     }
 
+    statements = new StatementCache(db);
+
     QStringList tables = db.tables();
-    if (tables.contains("MUSICLIBRARY", Qt::CaseInsensitive)) {
-        return QSqlError();
+    if (!tables.contains("MUSICLIBRARY", Qt::CaseInsensitive)) {
+        SqlQuery q(statements, "CREATE TABLE IF NOT EXISTS MUSICLIBRARY(id integer primary key, absFilePath varchar(200) UNIQUE, fileName varchar, Title varchar, Artist varchar, Album varchar, Length int)");
+        if (!q.exec()) {
+            // error if table creation not successfull
+            //qDebug() << "Music Table creation error";
+            return q.lastError();
+        }
     }
 
-    QSqlQuery q(db);
-    q.prepare("CREATE TABLE IF NOT EXISTS MUSICLIBRARY(id integer primary key, absFilePath varchar(200) UNIQUE, fileName varchar, Title varchar, Artist varchar, Album varchar, Length int)");
-    if (!q.exec()) {
-        // error if table creation not successfull
-        //qDebug() << "Music Table creation error";
-        return q.lastError();
+    // loudness columns, added to libraries created before loudness analysis existed.
+    // NULL means not analysed yet.
+    QSqlRecord columns = db.record("MUSICLIBRARY");
+    QStringList loudnessColumns;
+    loudnessColumns << "Loudness" << "TruePeak" << "AlbumLoudness" << "AlbumPeak";
+    QStringList schema;
+    QString column;
+    foreach(column, loudnessColumns) {
+        if (!columns.contains(column)) {
+            // a column name can't be a bound value
+            schema << QString("ALTER TABLE MUSICLIBRARY ADD COLUMN %1 real").arg(column);
+        }
+    }
+
+    // acoustic fingerprints, and the index that finds candidate matches by
+    // sub-fingerprint instead of comparing against every track
+    if (!columns.contains("Fingerprint")) {
+        schema << "ALTER TABLE MUSICLIBRARY ADD COLUMN Fingerprint blob";
+    }
+    // hash of the audio payload, which finds moved files during a scan
+    if (!columns.contains("ContentHash")) {
+        schema << "ALTER TABLE MUSICLIBRARY ADD COLUMN ContentHash integer";
+    }
+    // tempo and key, NULL until analysed. A key that couldn't be told is
+    // stored as TempoKeyMeter::NO_KEY, so the track isn't analysed again.
+    if (!columns.contains("Bpm")) {
+        schema << "ALTER TABLE MUSICLIBRARY ADD COLUMN Bpm real";
+    }
+    if (!columns.contains("MusicalKey")) {
+        schema << "ALTER TABLE MUSICLIBRARY ADD COLUMN MusicalKey integer";
+    }
+    // what songs are grouped by artist on, see artistKey()
+    if (!columns.contains("ArtistKey")) {
+        schema << "ALTER TABLE MUSICLIBRARY ADD COLUMN ArtistKey varchar"
+               << "CREATE INDEX IF NOT EXISTS ArtistKeyIndex ON MUSICLIBRARY(ArtistKey)";
+    }
+    // facets of the library browser; NULL Format means the tags haven't
+    // been read for them yet, see populateModel()
+    if (!columns.contains("Genre")) {
+        schema << "ALTER TABLE MUSICLIBRARY ADD COLUMN Genre varchar";
+    }
+    if (!columns.contains("Year")) {
+        schema << "ALTER TABLE MUSICLIBRARY ADD COLUMN Year int";
+    }
+    if (!columns.contains("Format")) {
+        schema << "ALTER TABLE MUSICLIBRARY ADD COLUMN Format varchar";
     }
+    if (!tables.contains("FINGERPRINTINDEX", Qt::CaseInsensitive)) {
+        schema << "CREATE TABLE FINGERPRINTINDEX(Key integer, Track integer)"
+               << "CREATE INDEX FingerprintKey ON FINGERPRINTINDEX(Key)"
+               << "CREATE INDEX FingerprintTrack ON FINGERPRINTINDEX(Track)";
+    }
+    QString sql;
+    foreach(sql, schema) {
+        SqlQuery q(statements, sql);
+        if (!q.exec()) {
+            return q.lastError();
+        }
+    }
+
+    return updateArtistKeys();
+}
 
+QSqlError LibraryModel::updateArtistKeys() {
+    // user_version holds the artistKeyRules() the stored keys were made with
+    SqlQuery version(statements, "PRAGMA user_version");
+    if (!version.exec() || !version.next()) {
+        return version.lastError();
+    }
+    int stored = version.value(0).toInt();
+    version.finish();
+    if (stored == artistKeyRules()) {
+        return QSqlError();
+    }
+    SqlQuery artists(statements, "SELECT DISTINCT Artist FROM MUSICLIBRARY");
+    if (!artists.exec()) {
+        return artists.lastError();
+    }
+    QStringList names;
+    while (artists.next()) {
+        names.append(artists.value(0).toString());
+    }
+    artists.finish();
+    db.transaction();
+    SqlQuery update(statements, "UPDATE MUSICLIBRARY SET ArtistKey=:ArtistKey WHERE Artist=:Artist");
+    foreach (const QString &name, names) {
+        update.bindValue(":ArtistKey", artistKey(name));
+        update.bindValue(":Artist", name);
+        if (!update.exec()) {
+            db.rollback();
+            return update.lastError();
+        }
+    }
+    // a pragma takes no bound values
+    SqlQuery done(statements, QString("PRAGMA user_version = %1").arg(artistKeyRules()));
+    if (!done.exec()) {
+        db.rollback();
+        return done.lastError();
+    }
+    db.commit();
     return QSqlError();
 }
 
@@ -97,74 +231,205 @@ QSqlError LibraryModel::initDb() {
 QSqlError LibraryModel::populateModel() {
     //qDebug() << "Populate the Model from database";
 
-    // make root
-    QSqlQuery q(db);    // query for distinct artists
-    QSqlQuery q2(db);   // query for songs with the same artist
-    QSqlQuery q3(db);   // query to delete invalid database entries
-    QList<QHash<QString, QString> > validSongs;
-    if (!q.exec(QString("SELECT DISTINCT Artist FROM MUSICLIBRARY ORDER BY Artist ASC"))) {
-        //qDebug() << "PopulateModel(): select artist failed!";
+    // one pass over the songs checks the files and counts them per artist,
+    // only the artist nodes are made: albums and songs are fetched from the
+    // database when their parent is expanded. Nothing but the file's
+    // existence is read here: rows older versions left without a content
+    // hash or facets are read in the background, see LibraryBackfill
+    SqlQuery q(statements, "SELECT absFilePath, Title, Artist, ArtistKey, Album, Fingerprint IS NOT NULL, ContentHash, Genre, Year, Format FROM MUSICLIBRARY");
+    QStringList unhashed;
+    QStringList unfaceted;
+    QStringList gone;
+    if (!q.exec()) {
+        //qDebug() << "PopulateModel(): select songs failed!";
         return q.lastError();
     }
     rootItem = new TreeItem(QHash<QString, QString>(), TreeItem::ROOT);
-
-    // populate the artist and song nodes
-    int artistCount = 0;
+    artistNodes.clear();
+    nodeCache.clear();
+    pendingSongs.clear();
+    filterIndex->clear();
+    missingFiles.clear();
+    missingByHash.clear();
+    missingAlbums.clear();
+
+    QHash<QString, int> songCounts;
+    // an artist's node is named after the spelling most of its songs use
+    QHash<QString, QHash<QString, int> > spellings;
     while (q.next()) {
-        validSongs.clear();
-        // find artist first
-        QString Artist = q.value(0).toString();
-
-        // find and check how many of its children are valid.
-        if (!q2.exec(QString("SELECT absFilePath, Title FROM MUSICLIBRARY WHERE Artist='%1' ORDER BY Title ASC").arg(Artist))) {
-            //qDebug() << "PopulateModel(): Selecting SONGS with Artist=" << Artist << " failed!";
-            return q2.lastError();
-        }
-        while (q2.next()) {
-            QFileInfo f(q2.value(0).toString());
-            if (!f.exists()) {
-                // if it doesn't exist, remove database entry
-                //qDebug() << "Want to remove item!";
-                if (!q3.exec(QString("DELETE FROM MUSICLIBRARY WHERE absFilePath='%1'")
-                                    .arg(q2.value(0).toString()))) {
-                        //qDebug() << "PopulateModel(): Removing invalid DB entry with absFilePath=" << q2.value(0).toString() << " failed!";
-                        return q.lastError();
-                }
-                continue;
+        QString absFilePath = q.value(0).toString();
+        QString key = q.value(3).toString();
+        QFileInfo f(absFilePath);
+        bool hashed = !q.value(6).isNull();
+        if (!f.exists() && (hashed || q.value(5).toBool())) {
+            // it may just have moved: keep the entry (out of the tree)
+            // for the scan to find by hash, or reattachMovedFiles() by
+            // fingerprint. dropMissingFiles() deletes it otherwise.
+            if (hashed) {
+                missingByHash.insert(q.value(6).toLongLong(), absFilePath);
+            }
+            if (q.value(5).toBool()) {
+                missingFiles.insert(absFilePath);
             }
-            // otherwise add this to validSongs list
+            missingAlbums.insert(absFilePath, key + "\n" + q.value(4).toString());
+            continue;
+        }
+        if (!f.exists()) {
+            // if it doesn't exist, remove database entry
+            gone.append(absFilePath);
+            continue;
+        }
+        if (!hashed) {
+            // added before content hashes existed
+            unhashed.append(absFilePath);
+        }
+        QString genre = q.value(7).toString();
+        int year = q.value(8).toInt();
+        QString format = q.value(9).toString();
+        if (q.value(9).isNull()) {
+            // added before facets existed, the format is in the name
+            format = formatOf(absFilePath);
+            unfaceted.append(absFilePath);
+        }
+        songCounts[key]++;
+        spellings[key][q.value(2).toString()]++;
+        filterIndex->insert(absFilePath, q.value(1).toString(), q.value(2).toString(), q.value(4).toString(),
+                            genre, yearString(year), format);
+    }
+    q.finish();
+
+    QStringList keys = songCounts.keys();
+    QStringList artists;
+    foreach (const QString &key, keys) {
+        const QHash<QString, int> &names = spellings[key];
+        QHash<QString, int>::const_iterator best = names.constBegin();
+        for (QHash<QString, int>::const_iterator it = names.constBegin(); it != names.constEnd(); ++it) {
+            if (it.value() > best.value()) {
+                best = it;
+            }
+        }
+        artists.append(best.key());
+    }
+    // the tree is in collation order, not SQLite's
+    QVector<int> artistOrder = Collation::instance()->order(artists);
+    if (!artistOrder.isEmpty()) {
+        beginInsertRows(QModelIndex(), 0, artistOrder.size()-1);
+        for (int a = 0; a < artistOrder.size(); a++) {
+            const QString &key = keys[artistOrder[a]];
             QHash<QString, QString> hash;
-            hash["absFilePath"] = q2.value(0).toString();
-            hash["Title"] = q2.value(1).toString();
-            validSongs.append(hash);
+            hash["Artist"] = artists[artistOrder[a]];
+            hash["ArtistKey"] = key;
+            rootItem->addChild(TreeItem::ARTIST, hash);
+            TreeItem *artistNode = rootItem->child(a);
+            artistNode->setSongCount(songCounts[key]);
+            artistNode->setFetched(false);
+            artistNodes.insert(key, artistNode);
         }
-        if (validSongs.size() > 0) {
-            // if there are valid songs left, add to library
-            addArtistAndSongs(artistCount, Artist, validSongs);
-            artistCount++;
+        endInsertRows();
+    }
+
+    if (!gone.isEmpty()) {
+        db.transaction();
+        SqlQuery remove(statements, "DELETE FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+        foreach (const QString &absFilePath, gone) {
+            remove.bindValue(":absFilePath", absFilePath);
+            if (!remove.exec()) {
+                //qDebug() << "PopulateModel(): Removing invalid DB entry with absFilePath=" << absFilePath << " failed!";
+                db.rollback();
+                return remove.lastError();
+            }
         }
+        db.commit();
+    }
+    QSet<QString> facetless = unfaceted.toSet();
+    foreach (const QString &absFilePath, unhashed) {
+        backfill->addFile(absFilePath, true, facetless.remove(absFilePath));
+    }
+    foreach (const QString &absFilePath, facetless) {
+        backfill->addFile(absFilePath, false, true);
     }
     return QSqlError();
 }
 
-void LibraryModel::addArtistAndSongs(int artistCount, QString Artist, QList<QHash<QString, QString> > &validSongs) {
-    // helper for populateModel(), should not be used by other functions
+// slot
+void LibraryModel::hashBackfilled(QString absFilePath, qint64 hash) {
+    SqlQuery q(statements, "UPDATE MUSICLIBRARY SET ContentHash=:ContentHash WHERE absFilePath=:absFilePath");
+    q.bindValue(":ContentHash", hash);
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec()) {
+        //qDebug() << "Error at hashBackfilled() - Executing query: " << q.lastError();
+    }
+}
 
-    // Add to rootItem at row=artistCount an ARTIST node named "Artist".
-    beginInsertRows(QModelIndex(), artistCount, artistCount);
-    QHash<QString, QString> hash;
-    hash["Artist"] = Artist;
-    rootItem->addChild(TreeItem::ARTIST, hash);
-    endInsertRows();
+// slot
+void LibraryModel::facetsBackfilled(QString absFilePath, QString genre, int year) {
+    SqlQuery q(statements, "UPDATE MUSICLIBRARY SET Genre=:Genre, Year=:Year, Format=:Format WHERE absFilePath=:absFilePath");
+    q.bindValue(":Genre", genre);
+    q.bindValue(":Year", year);
+    q.bindValue(":Format", formatOf(absFilePath));
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec()) {
+        //qDebug() << "Error at facetsBackfilled() - Executing query: " << q.lastError();
+        return;
+    }
+    filterIndex->updateFacets(absFilePath, genre, yearString(year), formatOf(absFilePath));
+    emit(facetsChanged());
+}
 
-    // Add the validSongs as child SONG nodes to the new ARTIST node
-    beginInsertRows(index(artistCount,0), 0, validSongs.size()-1);
-    foreach(hash, validSongs) {
-        rootItem->child(artistCount)->addChild(TreeItem::SONG, hash);
+void LibraryModel::dropMissingFiles() {
+    // missing entries the scan didn't find by hash, except for the
+    // fingerprinted ones that reattachMovedFiles() can still look for
+    SqlQuery q(statements, "DELETE FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+    db.transaction();
+    QMultiHash<qint64, QString>::iterator it = missingByHash.begin();
+    while (it != missingByHash.end()) {
+        if (!missingFiles.contains(it.value())) {
+            q.bindValue(":absFilePath", it.value());
+            q.exec();
+            missingAlbums.remove(it.value());
+            it = missingByHash.erase(it);
+        } else {
+            ++it;
+        }
     }
-    // update the item_counts entry
-    item_counts[Artist] = validSongs.size();
-    endInsertRows();
+    db.commit();
+}
+
+bool LibraryModel::relocateMissingFile(qint64 hash, const QString &absFilePath) {
+    // a file that isn't in the library yet has the payload of a missing
+    // entry: it moved, so the entry follows it instead of a re-import.
+    // Copies of one file that moved together each take one of the entries
+    QMultiHash<qint64, QString>::iterator it = missingByHash.find(hash);
+    if (it == missingByHash.end()) {
+        return false;
+    }
+    QString missing = it.value();
+    SqlQuery q(statements, "UPDATE MUSICLIBRARY SET absFilePath=:newPath, fileName=:fileName WHERE absFilePath=:absFilePath");
+    q.bindValue(":newPath", absFilePath);
+    q.bindValue(":fileName", QFileInfo(absFilePath).fileName());
+    q.bindValue(":absFilePath", missing);
+    if (!q.exec() || q.numRowsAffected() != 1) {
+        //qDebug() << "Error at relocateMissingFile() - Executing query: " << q.lastError();
+        return false;
+    }
+    missingByHash.erase(it);
+    missingFiles.remove(missing);
+    missingAlbums.remove(missing);
+    SqlQuery song(statements, "SELECT Title, Artist, Album, Genre, Year FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+    song.bindValue(":absFilePath", absFilePath);
+    if (song.exec() && song.next()) {
+        insertSongNode(absFilePath, song.value(0).toString(), song.value(1).toString(), song.value(2).toString(),
+                       song.value(3).toString(), song.value(4).toInt());
+    }
+    return true;
+}
+
+QString LibraryModel::formatOf(const QString &absFilePath) {
+    return QFileInfo(absFilePath).suffix().toLower();
+}
+
+QString LibraryModel::yearString(int year) {
+    return year > 0 ? QString::number(year) : QString();
 }
 
 void LibraryModel::showError(const QSqlError &err, const QString msg) {
@@ -174,33 +439,6 @@ void LibraryModel::showError(const QSqlError &err, const QString msg) {
 }
 
 
-bool LibraryModel::addEntry(QSqlQuery &q, const QString &absFilePath, const QString &fileName,
-        const QString &title, const QString &artist, const QString &album, const int length) {
-    q.bindValue(":absFilePath", absFilePath);
-    q.bindValue(":fileName", fileName);
-    q.bindValue(":Title", title);
-    q.bindValue(":Artist", artist);
-    q.bindValue(":Album", album);
-    q.bindValue(":Length", length);
-    if (!q.exec()) {
-        //qDebug() << "Error at addEntry() " <<  q.lastError();
-        return false;
-    }
-
-    if (!item_counts.contains(artist)) {
-        QHash<QString, QString> hash;
-        hash["Artist"] = artist;
-        //updateLibrary(QModelIndex());
-        fetchMore(QModelIndex());
-        return true;
-    } else {
-        // do i need to do updateLibrary here???
-        item_counts[artist] += 1;
-        return true;
-    }
-    return false;
-}
-
 // Protected methods
 int LibraryModel::rowCount(const QModelIndex &parent) const {
     ////qDebug() << "In rowCount:";
@@ -260,6 +498,13 @@ QVariant LibraryModel::data(const QModelIndex &index, int role) const {
         TreeItem *item = getItem(index);
         return item->data();
     }
+    if (role == Qt::ToolTipRole) {
+        TreeItem *item = getItem(index);
+        if (item->getItemType() == TreeItem::ARTIST || item->getItemType() == TreeItem::ALBUM) {
+            int songs = item->songCount();
+            return songs == 1 ? QString("1 song") : QString("%1 songs").arg(songs);
+        }
+    }
 
     return QVariant();
 }
@@ -274,11 +519,248 @@ TreeItem *LibraryModel::getItem(const QModelIndex &index) const {
     return rootItem;
 }
 
+bool LibraryModel::hasChildren(const QModelIndex &parent) const {
+    // artists and albums know their songs before their rows are fetched
+    TreeItem *item = getItem(parent);
+    switch (item->getItemType()) {
+        case TreeItem::ARTIST:
+        case TreeItem::ALBUM:
+            return item->isFetched() ? item->ChildCount() > 0 : item->songCount() > 0;
+        case TreeItem::SONG:
+            return false;
+        default:
+            return item->ChildCount() > 0;
+    }
+}
+
+bool LibraryModel::canFetchMore(const QModelIndex &parent) const {
+    TreeItem *item = getItem(parent);
+    return !item->isFetched() || pendingSongs.contains(item);
+}
+
+void LibraryModel::fetchMore(const QModelIndex &parent) {
+    TreeItem *item = getItem(parent);
+    if (pendingSongs.contains(item)) {
+        // scrolled to the end of what's fetched of a long album
+        fetchSongPage(item, parent);
+    } else if (!item->isFetched()) {
+        item->setFetched(true);
+        if (item->getItemType() == TreeItem::ARTIST) {
+            fetchAlbums(item, parent);
+        } else if (item->getItemType() == TreeItem::ALBUM) {
+            fetchSongs(item, parent);
+        }
+    } else {
+        return;
+    }
+    evictNodes(item);
+}
+
+void LibraryModel::fetchAlbums(TreeItem *artistNode, const QModelIndex &artistIdx) {
+    // an album's songs are counted by SQLite, the missing ones taken off
+    QString key = artistNode->getItemData().value("ArtistKey");
+    QHash<QString, int> missing;
+    QString prefix = key + "\n";
+    foreach (const QString &album, missingAlbums) {
+        if (album.startsWith(prefix)) {
+            missing[album.mid(prefix.size())]++;
+        }
+    }
+    SqlQuery q(statements, "SELECT Album, COUNT(*) FROM MUSICLIBRARY WHERE ArtistKey=:ArtistKey GROUP BY Album");
+    q.bindValue(":ArtistKey", key);
+    if (!q.exec()) {
+        //qDebug() << "Error at fetchAlbums() - Executing query: " << q.lastError();
+        return;
+    }
+    QStringList albums;
+    QList<int> counts;
+    while (q.next()) {
+        QString album = q.value(0).toString();
+        int count = q.value(1).toInt() - missing.value(album);
+        if (count > 0) {
+            albums.append(album);
+            counts.append(count);
+        }
+    }
+    QVector<int> order = Collation::instance()->order(albums);
+    if (order.isEmpty()) {
+        return;
+    }
+    beginInsertRows(artistIdx, 0, order.size()-1);
+    for (int i = 0; i < order.size(); i++) {
+        QHash<QString, QString> hash;
+        hash["Album"] = albums[order[i]];
+        artistNode->addChild(TreeItem::ALBUM, hash);
+        TreeItem *albumNode = artistNode->child(i);
+        albumNode->setSongCount(counts[order[i]]);
+        albumNode->setFetched(false);
+    }
+    endInsertRows();
+    nodeCache.add(artistNode, order.size());
+}
+
+void LibraryModel::fetchSongs(TreeItem *albumNode, const QModelIndex &albumIdx) {
+    // the titles are read to put the songs in order, the rows after the
+    // first page are kept as ids until they're scrolled to
+    SqlQuery q(statements, "SELECT id, absFilePath, Title FROM MUSICLIBRARY WHERE ArtistKey=:ArtistKey AND Album=:Album");
+    q.bindValue(":ArtistKey", albumNode->parent()->getItemData().value("ArtistKey"));
+    q.bindValue(":Album", albumNode->getItemData().value("Album"));
+    if (!q.exec()) {
+        //qDebug() << "Error at fetchSongs() - Executing query: " << q.lastError();
+        return;
+    }
+    QVector<qint64> ids;
+    QStringList paths;
+    QStringList titles;
+    while (q.next()) {
+        if (!missingAlbums.contains(q.value(1).toString())) {
+            ids.append(q.value(0).toLongLong());
+            paths.append(q.value(1).toString());
+            titles.append(q.value(2).toString());
+        }
+    }
+    QVector<int> order = Collation::instance()->order(titles);
+    albumNode->setSongCount(order.size());
+    if (order.isEmpty()) {
+        return;
+    }
+    int page = qMin(SONG_PAGE, order.size());
+    beginInsertRows(albumIdx, 0, page-1);
+    for (int i = 0; i < page; i++) {
+        QHash<QString, QString> hash;
+        hash["id"] = QString::number(ids[order[i]]);
+        hash["Title"] = titles[order[i]];
+        hash["absFilePath"] = paths[order[i]];
+        albumNode->addChild(TreeItem::SONG, hash);
+    }
+    endInsertRows();
+    nodeCache.add(albumNode, page);
+    if (page < order.size()) {
+        QVector<qint64> &pending = pendingSongs[albumNode];
+        pending.reserve(order.size() - page);
+        for (int i = page; i < order.size(); i++) {
+            pending.append(ids[order[i]]);
+        }
+    }
+}
+
+void LibraryModel::fetchSongPage(TreeItem *albumNode, const QModelIndex &albumIdx) {
+    // the next SONG_PAGE songs of the album, looked up by id; the last page
+    // is padded with id 0, which SQLite never gives a row
+    QVector<qint64> &pending = pendingSongs[albumNode];
+    int page = qMin(SONG_PAGE, pending.size());
+    QStringList placeholders;
+    for (int j = 0; j < SONG_PAGE; j++) {
+        placeholders << "?";
+    }
+    SqlQuery q(statements, QString("SELECT id, absFilePath, Title FROM MUSICLIBRARY WHERE id IN (%1)").arg(placeholders.join(",")));
+    for (int j = 0; j < SONG_PAGE; j++) {
+        q.addBindValue(j < page ? pending[j] : (qint64)0);
+    }
+    if (!q.exec()) {
+        //qDebug() << "Error at fetchSongPage() - Executing query: " << q.lastError();
+        return;
+    }
+    QHash<qint64, QHash<QString, QString> > rows;
+    while (q.next()) {
+        QHash<QString, QString> hash;
+        hash["id"] = q.value(0).toString();
+        hash["Title"] = q.value(2).toString();
+        hash["absFilePath"] = q.value(1).toString();
+        rows.insert(q.value(0).toLongLong(), hash);
+    }
+    // in the order they were sorted in, without the ones gone since
+    QList<QHash<QString, QString> > songs;
+    for (int j = 0; j < page; j++) {
+        if (rows.contains(pending[j])) {
+            songs.append(rows.value(pending[j]));
+        }
+    }
+    pending.remove(0, page);
+    if (pending.isEmpty()) {
+        pendingSongs.remove(albumNode);
+    }
+    if (songs.isEmpty()) {
+        return;
+    }
+    int first = albumNode->ChildCount();
+    beginInsertRows(albumIdx, first, first + songs.size()-1);
+    foreach (const QHash<QString, QString> &hash, songs) {
+        albumNode->addChild(TreeItem::SONG, hash);
+    }
+    endInsertRows();
+    nodeCache.add(albumNode, songs.size());
+}
+
+void LibraryModel::evictNodes(TreeItem *keep) {
+    // past the cap, the children of the nodes used longest ago go
+    foreach (TreeItem *node, nodeCache.overCap(keep)) {
+        if (nodeCache.size() <= nodeCache.cap()) {
+            break;
+        }
+        // the children of one already evicted have gone with it
+        if (nodeCache.contains(node) && node->isFetched()) {
+            unfetchChildren(node, nodeIndex(node));
+        }
+    }
+    //qDebug() << "LibraryModel:" << nodeCache.size() << "nodes fetched, cap" << nodeCache.cap();
+}
+
+QModelIndex LibraryModel::nodeIndex(TreeItem *node) const {
+    if (!node || node == rootItem) {
+        return QModelIndex();
+    }
+    return createIndex(node->childNumber(), 0, node);
+}
+
+void LibraryModel::forgetNodes(TreeItem *node) {
+    // node and what's under it leave the cache, before they're deleted
+    foreach (TreeItem *child, node->getChildItems()) {
+        if (child->getItemType() != TreeItem::SONG) {
+            forgetNodes(child);
+        }
+    }
+    nodeCache.remove(node);
+    pendingSongs.remove(node);
+}
+
+void LibraryModel::setNodeCap(int nodes) {
+    nodeCache.setCap(nodes);
+    evictNodes(0);
+}
+
+void LibraryModel::setExpanded(const QModelIndex &idx, bool expanded) {
+    TreeItem *item = getItem(idx);
+    if (item != rootItem) {
+        nodeCache.setPinned(item, expanded);
+    }
+}
+
+void LibraryModel::unfetchChildren(TreeItem *node, const QModelIndex &idx) {
+    // they're fetched again, from the database as it is now
+    QList<TreeItem*> &children = node->getChildItems();
+    foreach (TreeItem *child, children) {
+        if (child->getItemType() != TreeItem::SONG) {
+            forgetNodes(child);
+        }
+    }
+    nodeCache.release(node);
+    pendingSongs.remove(node);
+    if (!children.isEmpty()) {
+        beginRemoveRows(idx, 0, children.size()-1);
+        qDeleteAll(children);
+        children.clear();
+        endRemoveRows();
+    }
+    node->setFetched(false);
+}
+
 QSqlError LibraryModel::populateFromDirs() {
     QString dir;
     foreach(dir, importDirs) {
         addFromDir(dir, false);
     }
+    dropMissingFiles();
     return QSqlError();
 }
 
@@ -289,7 +771,6 @@ void LibraryModel::refreshLibrary() {
     //qDebug() << "Clearing library...";
     beginRemoveRows(QModelIndex(), 0, rootItem->ChildCount()-1);
     delete rootItem;
-    item_counts.clear();
     endRemoveRows();
 
     //qDebug() << "Repopulating library...";
@@ -341,8 +822,22 @@ bool LibraryModel::addMusicFromFile(QFileInfo & fileInfo) {
     // false if not, or if there's duplicate already.
     QString absFilePath = fileInfo.canonicalFilePath();
     QString fileName = fileInfo.fileName();
-    QString title, artist, album;
+    QString title, artist, album, genre;
     int length = 0;
+    int year = 0;
+
+    // already in the library, no need to parse the tags
+    {
+        SqlQuery q(statements, "SELECT 1 FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+        q.bindValue(":absFilePath", absFilePath);
+        if (q.exec() && q.next()) {
+            return false;
+        }
+    }
+    qint64 hash = (qint64)contentHash(absFilePath);
+    if (hash && relocateMissingFile(hash, absFilePath)) {
+        return true;
+    }
 
     QByteArray byteArray = absFilePath.toUtf8();
     const char* cString = byteArray.constData();
@@ -359,126 +854,244 @@ bool LibraryModel::addMusicFromFile(QFileInfo & fileInfo) {
         artist = artist.isEmpty() ? "Unknown" : artist;
         album = QString::fromStdString(tag->album().toCString(true));
         album = album.isEmpty() ? "Unknown" : album;
+        genre = QString::fromStdString(tag->genre().toCString(true));
+        year = tag->year();
     }
+    // edits that are still on their way to the file
+    QHash<QString, QString> tags;
+    tags["Title"] = title;
+    tags["Artist"] = artist;
+    tags["Album"] = album;
+    TagWriter::instance()->overlayPending(absFilePath, tags);
+    title = tags["Title"];
+    artist = tags["Artist"];
+    album = tags["Album"];
     assert(f.audioProperties());
     if (!f.isNull() && f.audioProperties()) {
         TagLib::AudioProperties *properties = f.audioProperties();
         length = properties->length();
     }
-    return addEntryToModel(absFilePath, fileName, title, artist, album, length);
+    return addEntryToModel(absFilePath, fileName, title, artist, album, length, genre, year, hash);
 }
 
 bool LibraryModel::addEntryToModel(QString &absFilePath, QString &fileName, QString &title,
-                                   QString &artist, QString &album, int length) {
+                                   QString &artist, QString &album, int length, const QString &genre, int year, qint64 hash) {
     // insert entry to database
-    QSqlQuery q(db);
-    if (q.exec(QString("INSERT INTO MUSICLIBRARY(absFilePath, fileName, Title, Artist, Album, Length) VALUES ('%1', '%2', '%3', '%4', '%5', %6)")
-                .arg(absFilePath).arg(fileName).arg(title).arg(artist).arg(album).arg(length))) {
-        // entry inserted successfully, check if there are items in the model already
-        insertArtistNode(artist);
-
-        // insert song node by:
-        // find the artistNode
-        int artistIndex = rootItem->findChildIndex(artist);
-        QModelIndex artistModelIndex = index(artistIndex,0);
-        TreeItem *artistNode = rootItem->child(artistIndex);
-        // find where to insert the songNode
-        int songIndex;
-        if (artistNode->ChildCount() == 0) {
-            songIndex = 0;
-        }
-        else {
-            QList<QString> existingSongs = artistNode->childrenData();
-            existingSongs.append(title);
-            qSort(existingSongs);
-            songIndex = existingSongs.indexOf(title);
-        }
-        // insert the songNode
-        beginInsertRows(artistModelIndex, songIndex, songIndex);
-        QHash<QString, QString> hash;
-        hash["Title"] = title;
-        hash["absFilePath"] = absFilePath;
-        artistNode->insertChild(songIndex, TreeItem::SONG, hash);
-        item_counts[artist]++;
-        endInsertRows();
+    SqlQuery q(statements, "INSERT INTO MUSICLIBRARY(absFilePath, fileName, Title, Artist, ArtistKey, Album, Length, ContentHash, Genre, Year, Format) VALUES (:absFilePath, :fileName, :Title, :Artist, :ArtistKey, :Album, :Length, :ContentHash, :Genre, :Year, :Format)");
+    q.bindValue(":absFilePath", absFilePath);
+    q.bindValue(":fileName", fileName);
+    q.bindValue(":Title", title);
+    q.bindValue(":Artist", artist);
+    q.bindValue(":ArtistKey", artistKey(artist));
+    q.bindValue(":Album", album);
+    q.bindValue(":Length", length);
+    q.bindValue(":ContentHash", hash ? QVariant(hash) : QVariant(QVariant::LongLong));
+    q.bindValue(":Genre", genre);
+    q.bindValue(":Year", year);
+    q.bindValue(":Format", formatOf(absFilePath));
+    if (q.exec()) {
+        insertSongNode(absFilePath, title, artist, album, genre, year);
         return true;
     }
     ////qDebug() << "Error@ addEntryToModel executing query: " << q.lastError();
     return false;
 }
 
-void LibraryModel::playlistMetaDataChange(QHash<QString, QString> newHash) {
-    // metadata has been changed in playlist
-    // delete the database entry associated with item.
-    QSqlQuery q(db);
-    if (!q.exec(QString("SELECT Artist, Length FROM MUSICLIBRARY WHERE absFilePath='%1'").arg(newHash["absFilePath"]))) {
-        //qDebug() << "Error SELECT Artist in SLOT:playlistMetaDataChange() - Executing query: " << q.lastError();
+void LibraryModel::insertSongNode(const QString &absFilePath, const QString &title, const QString &artist, const QString &album,
+                                  const QString &genre, int year) {
+    // indexed first, so a filtered view shows the new rows when they come
+    filterIndex->insert(absFilePath, title, artist, album, genre, yearString(year), formatOf(absFilePath));
+    placeSongNode(absFilePath, title, artist, album);
+}
+
+void LibraryModel::placeSongNode(const QString &absFilePath, const QString &title, const QString &artist, const QString &album) {
+    // add the artist node first if there are no items in the model for it yet
+    insertArtistNode(artist);
+    TreeItem *artistNode = artistNodes.value(artistKey(artist));
+    QModelIndex artistIdx = index(artistNode->childNumber(), 0);
+    artistNode->setSongCount(artistNode->songCount() + 1);
+    if (!artistNode->isFetched()) {
+        // it's in the database, the count is all that changes
+        emit(dataChanged(artistIdx, artistIdx));
         return;
     }
-    q.next();
-    QString oldArtist = q.value(0).toString();
-    int oldLength = q.value(1).toInt();
-    if (!q.exec(QString("DELETE FROM MUSICLIBRARY WHERE absFilePath='%1'").arg(newHash["absFilePath"]))) {
-        //qDebug() << "Error DELETING old entry in SLOT:playlistMetaDataChange() - Executing query: " << q.lastError();
+    TreeItem *albumNode = insertAlbumNode(artistNode, album);
+    QModelIndex albumIdx = index(albumNode->childNumber(), 0, artistIdx);
+    albumNode->setSongCount(albumNode->songCount() + 1);
+    if (!albumNode->isFetched()) {
+        emit(dataChanged(albumIdx, albumIdx));
         return;
     }
-    // delete the node associated with it from library
-    if (removeSongNode(oldArtist, newHash["absFilePath"])) {
-        // successfully removed song node
-        // add new node from database
-        if (addEntryToModel(newHash["absFilePath"], newHash["fileName"], newHash["Title"], newHash["Artist"],
-                            newHash["Album"], oldLength)) {
-            // new itme added successfully
-            return;
-        }
-        //qDebug() << "Error in SLOT:playlistMetaDataChange() - adding new entry failed!";
+    // find where to insert the songNode
+    int songIndex = sortedChildPosition(albumNode, title, 0);
+    SqlQuery q(statements, "SELECT id FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec() || !q.next()) {
+        //qDebug() << "Error at placeSongNode() - Executing query: " << q.lastError();
+        return;
+    }
+    qint64 id = q.value(0).toLongLong();
+    if (pendingSongs.contains(albumNode) && songIndex == albumNode->ChildCount()) {
+        // it goes among the pages not fetched yet: it's in the next one
+        // fetched, near where it belongs
+        pendingSongs[albumNode].prepend(id);
+        return;
+    }
+    beginInsertRows(albumIdx, songIndex, songIndex);
+    QHash<QString, QString> hash;
+    hash["id"] = QString::number(id);
+    hash["Title"] = title;
+    hash["absFilePath"] = absFilePath;
+    albumNode->insertChild(songIndex, TreeItem::SONG, hash);
+    endInsertRows();
+    nodeCache.add(albumNode, 1);
+}
+void LibraryModel::playlistMetaDataChange(QHash<QString, QString> newHash) {
+    // metadata has been changed in playlist
+    if (!updateSongEntry(newHash["absFilePath"], newHash)) {
+        //qDebug() << "Error in SLOT:playlistMetaDataChange() - updating the entry failed!";
     }
-    //qDebug() << "Error in SLOT:playlistMetaDataChange() - removing old song node failed!";
 }
 
-bool LibraryModel::removeEntryFromModel(QString &absFilePath, QString &artist) {
-    QSqlQuery q(db);
-    if (!q.exec(QString("DELETE FROM MUSICLIBRARY WHERE absFilePath='%1'").arg(absFilePath))) {
-        //qDebug() << "Error removeEntryFromModel() - Executing query: " << q.lastError();
+bool LibraryModel::updateSongEntry(const QString &absFilePath, const QHash<QString, QString> &fields) {
+    // the row and its node are changed, nothing is read from the file
+    SqlQuery q(statements, "SELECT Title, Artist, Album FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec() || !q.next()) {
+        //qDebug() << "Error at updateSongEntry() - Executing query: " << q.lastError();
         return false;
     }
-    // delete the node associated with it from library
-    return removeSongNode(artist, absFilePath);
+    QString oldTitle = q.value(0).toString();
+    QString oldArtist = q.value(1).toString();
+    QString oldAlbum = q.value(2).toString();
+    QString title = fields.value("Title", oldTitle);
+    QString artist = fields.value("Artist", oldArtist);
+    QString album = fields.value("Album", oldAlbum);
+    if (title == oldTitle && artist == oldArtist && album == oldAlbum) {
+        return true;
+    }
+    QString oldKey = artistKey(oldArtist);
+    QString key = artistKey(artist);
+    SqlQuery update(statements, "UPDATE MUSICLIBRARY SET Title=:title, Artist=:artist, ArtistKey=:artistKey, Album=:album WHERE absFilePath=:absFilePath");
+    update.bindValue(":title", title);
+    update.bindValue(":artist", artist);
+    update.bindValue(":artistKey", key);
+    update.bindValue(":album", album);
+    update.bindValue(":absFilePath", absFilePath);
+    if (!update.exec()) {
+        //qDebug() << "Error at updateSongEntry() - Executing query: " << q.lastError();
+        return false;
+    }
+    filterIndex->update(absFilePath, title, artist, album);
+    if (title == oldTitle && key == oldKey && album == oldAlbum) {
+        // the artist's spelling isn't in the tree
+        return true;
+    }
+    if (key == oldKey && album == oldAlbum) {
+        // retitled, it only moves within its album (if that's fetched)
+        TreeItem *artistNode = artistNodes.value(key);
+        TreeItem *albumNode = artistNode && artistNode->isFetched() ? artistNode->findChildNode(album) : 0;
+        TreeItem *songNode = albumNode && albumNode->isFetched() ? albumNode->findChildNode(absFilePath) : 0;
+        if (!songNode) {
+            return true;
+        }
+        songNode->getItemData()["Title"] = title;
+        QModelIndex albumIdx = index(albumNode->childNumber(), 0, index(artistNode->childNumber(), 0));
+        int row = songNode->childNumber();
+        int newRow = sortedChildPosition(albumNode, title, songNode);
+        if (newRow != row) {
+            beginMoveRows(albumIdx, row, row, albumIdx, newRow > row ? newRow + 1 : newRow);
+            albumNode->getChildItems().move(row, newRow);
+            endMoveRows();
+        }
+        QModelIndex songIdx = index(newRow, 0, albumIdx);
+        emit(dataChanged(songIdx, songIdx));
+        return true;
+    }
+    // taken out of its album and put where it belongs now
+    removeSongNode(oldKey, oldAlbum, absFilePath);
+    placeSongNode(absFilePath, title, artist, album);
+    return true;
 }
 
-bool LibraryModel::removeSongNode(const QString &artist, const QString &absFilePath) {
-    // find the artist node
-    int artistIndex = rootItem->findChildIndex(artist);
-    QModelIndex artistModelIndex = index(artistIndex, 0);
-    TreeItem *artistNode = rootItem->child(artistIndex);
-
-    // find the song node
-    int songNode = artistNode->findChildIndex(absFilePath);
+int LibraryModel::sortedChildPosition(TreeItem *parent, const QString &key, TreeItem *skip) const {
+    // where key goes among parent's (sorted) children, ahead of equal ones;
+    // a binary search, the children's keys are cached by Collation
+    Collation *collation = Collation::instance();
+    QCollatorSortKey sortKey = collation->key(key);
+    const QList<TreeItem*> &children = parent->getChildItems();
+    int skipped = skip ? children.indexOf(skip) : -1;
+    int low = 0, high = children.size() - (skipped >= 0 ? 1 : 0);
+    while (low < high) {
+        int middle = (low + high) / 2;
+        TreeItem *child = children[skipped >= 0 && middle >= skipped ? middle + 1 : middle];
+        if (collation->key(child->name()).compare(sortKey) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
 
-    // remove the song node
-    beginRemoveRows(artistModelIndex, songNode, songNode);
-    artistNode->removeChild(songNode);
-    item_counts[artist]--;
-    endRemoveRows();
+bool LibraryModel::removeSongNode(const QString &key, const QString &album, const QString &absFilePath) {
+    // the nodes are updated where they are fetched, the counts everywhere
+    TreeItem *artistNode = artistNodes.value(key);
+    if (!artistNode) {
+        return false;
+    }
+    QModelIndex artistIdx = index(artistNode->childNumber(), 0);
+    TreeItem *albumNode = artistNode->isFetched() ? artistNode->findChildNode(album) : 0;
+    if (albumNode) {
+        QModelIndex albumIdx = index(albumNode->childNumber(), 0, artistIdx);
+        int songRow = albumNode->isFetched() ? albumNode->findChildIndex(absFilePath) : -1;
+        if (songRow >= 0) {
+            beginRemoveRows(albumIdx, songRow, songRow);
+            albumNode->removeChild(songRow);
+            endRemoveRows();
+            nodeCache.add(albumNode, -1);
+        } else if (pendingSongs.contains(albumNode)) {
+            // not fetched yet, the id has the same row still
+            SqlQuery q(statements, "SELECT id FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+            q.bindValue(":absFilePath", absFilePath);
+            if (q.exec() && q.next()) {
+                pendingSongs[albumNode].removeOne(q.value(0).toLongLong());
+            }
+        }
+        albumNode->setSongCount(albumNode->songCount() - 1);
+        if (albumNode->songCount() <= 0) {
+            beginRemoveRows(artistIdx, albumIdx.row(), albumIdx.row());
+            forgetNodes(albumNode);
+            artistNode->removeChild(albumIdx.row());
+            nodeCache.add(artistNode, -1);
+            endRemoveRows();
+        } else {
+            emit(dataChanged(albumIdx, albumIdx));
+        }
+    }
 
     // remove artist node if it no longer contains any songs
-    if (item_counts[artist] == 0) {
-        beginRemoveRows(QModelIndex(), artistIndex, artistIndex);
-        rootItem->removeChild(artistIndex);
-        item_counts.remove(artist);
+    artistNode->setSongCount(artistNode->songCount() - 1);
+    if (artistNode->songCount() <= 0) {
+        beginRemoveRows(QModelIndex(), artistIdx.row(), artistIdx.row());
+        artistNodes.remove(key);
+        forgetNodes(artistNode);
+        rootItem->removeChild(artistIdx.row());
         endRemoveRows();
+    } else {
+        emit(dataChanged(artistIdx, artistIdx));
     }
     return true;
 }
-
 QHash<QString, QString> LibraryModel::getSongInfo(const QModelIndex idx) const {
     QHash<QString, QString> hash;
     TreeItem *item = getItem(idx);
-    QString absFilePath = item->getItemData()["absFilePath"];
+    QString absFilePath = item->path();
 
     // query database
-    QSqlQuery q(db);
-    if (!q.exec(QString("SELECT fileName, Title, Artist, Album, Length FROM MUSICLIBRARY WHERE absFilePath='%1'").arg(absFilePath))) {
+    SqlQuery q(statements, "SELECT fileName, Title, Artist, Album, Length, Loudness, TruePeak, AlbumLoudness, AlbumPeak, Bpm, MusicalKey FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec()) {
         //qDebug() << "Error at getSongInfo() - Executing query: " << q.lastError();
     }
     q.next();
@@ -489,18 +1102,157 @@ QHash<QString, QString> LibraryModel::getSongInfo(const QModelIndex idx) const {
     hash["Artist"] = q.value(2).toString();
     hash["Album"] = q.value(3).toString();
     hash["Length"] = u->convert_length_format(q.value(4).toInt());
+    hash["TrackGain"] = gainString(q.value(5), q.value(6));
+    hash["AlbumGain"] = gainString(q.value(7), q.value(8));
+    hash["BPM"] = bpmString(q.value(9));
+    hash["Key"] = keyString(q.value(10));
     return hash;
 }
 
 QList<QHash<QString, QString> > LibraryModel::getArtistSongInfo(const QModelIndex idx) const{
-    QList<QHash<QString, QString> > hashList;
     TreeItem *item = getItem(idx);
-    // Query database to get all songs by this artist
-    QSqlQuery q(db);
-    if (!q.exec(QString("SELECT absFilePath, fileName, Title, Artist, Album, Length from MUSICLIBRARY WHERE Artist='%1' ORDER BY Title ASC").arg(item->data().toString()))) {
-        //qDebug() << "Error at getArtistSongInfo(() - Executing query: " << q.lastError();
+    // Query database to get all songs by this artist, album by album
+    SqlQuery q(statements, "SELECT absFilePath, fileName, Title, Artist, Album, Length, Loudness, TruePeak, AlbumLoudness, AlbumPeak, Bpm, MusicalKey from MUSICLIBRARY WHERE ArtistKey=:ArtistKey ORDER BY Album, Title ASC");
+    q.bindValue(":ArtistKey", item->getItemData().value("ArtistKey"));
+    return songInfoList(q);
+}
+
+QList<QHash<QString, QString> > LibraryModel::getAlbumSongInfo(const QModelIndex idx) const{
+    TreeItem *item = getItem(idx);
+    SqlQuery q(statements, "SELECT absFilePath, fileName, Title, Artist, Album, Length, Loudness, TruePeak, AlbumLoudness, AlbumPeak, Bpm, MusicalKey from MUSICLIBRARY WHERE ArtistKey=:ArtistKey AND Album=:Album ORDER BY Title ASC");
+    q.bindValue(":ArtistKey", item->parent()->getItemData().value("ArtistKey"));
+    q.bindValue(":Album", item->getItemData().value("Album"));
+    return songInfoList(q);
+}
+
+QList<QHash<QString, QString> > LibraryModel::getPathSongInfo(const QStringList &absFilePaths) const {
+    QList<QHash<QString, QString> > hashList;
+    foreach (const QString &absFilePath, absFilePaths) {
+        SqlQuery q(statements, "SELECT absFilePath, fileName, Title, Artist, Album, Length, Loudness, TruePeak, AlbumLoudness, AlbumPeak, Bpm, MusicalKey from MUSICLIBRARY WHERE absFilePath=:absFilePath");
+        q.bindValue(":absFilePath", absFilePath);
+        hashList += songInfoList(q);
+    }
+    return hashList;
+}
+
+QList<QHash<QString, QString> > LibraryModel::getTrackSongInfo(QDataStream &stream) const {
+    // what mimeData() wrote: the item type, then a song's id, an artist's
+    // key or an artist's key and album
+    QList<qint32> types;
+    QVector<qint64> ids;
+    QStringList keys;
+    QStringList albums;
+    QStringList wantedKeys;
+    while (!stream.atEnd()) {
+        qint32 type;
+        stream >> type;
+        if (type == TreeItem::SONG) {
+            qint64 id;
+            stream >> id;
+            ids << id;
+            keys << QString();
+            albums << QString();
+        }
+        else {
+            QString key, album;
+            stream >> key;
+            if (type == TreeItem::ALBUM) {
+                stream >> album;
+            }
+            ids << 0;
+            keys << key;
+            albums << album;
+            if (!wantedKeys.contains(key)) {
+                wantedKeys << key;
+            }
+        }
+        types << type;
+    }
+    QVector<qint64> songIds;
+    foreach (qint64 id, ids) {
+        if (id != 0) {
+            songIds << id;
+        }
+    }
+
+    // the songs and the artists' songs together, SONG_PAGE of each a query;
+    // the padding (id 0, a NULL key) matches nothing
+    QStringList placeholders;
+    for (int j = 0; j < SONG_PAGE; j++) {
+        placeholders << "?";
+    }
+    SqlQuery q(statements, QString("SELECT id, absFilePath, fileName, Title, Artist, Album, Length, Loudness, TruePeak, AlbumLoudness, AlbumPeak, Bpm, MusicalKey, ArtistKey from MUSICLIBRARY "
+                                   "WHERE id IN (%1) OR ArtistKey IN (%1) ORDER BY ArtistKey, Album, Title ASC").arg(placeholders.join(",")));
+    QHash<qint64, QHash<QString, QString> > rows;
+    // by artist key, in album and title order
+    QHash<QString, QVector<qint64> > artistRows;
+    for (int first = 0; first < songIds.size() || first < wantedKeys.size(); first += SONG_PAGE) {
+        for (int j = 0; j < SONG_PAGE; j++) {
+            q.addBindValue(first + j < songIds.size() ? songIds[first + j] : (qint64)0);
+        }
+        QStringList chunkKeys = wantedKeys.mid(first, SONG_PAGE);
+        QSet<QString> chunkKeySet = chunkKeys.toSet();
+        for (int j = 0; j < SONG_PAGE; j++) {
+            q.addBindValue(j < chunkKeys.size() ? QVariant(chunkKeys[j]) : QVariant(QVariant::String));
+        }
+        if (!q.exec()) {
+            //qDebug() << "Error at getTrackSongInfo() - Executing query: " << q.lastError();
+            return QList<QHash<QString, QString> >();
+        }
+        while (q.next()) {
+            if (missingAlbums.contains(q.value(1).toString())) {
+                continue;
+            }
+            qint64 id = q.value(0).toLongLong();
+            QHash<QString, QString> hash;
+            hash["absFilePath"] = q.value(1).toString();
+            hash["fileName"] = q.value(2).toString();
+            hash["Title"] = q.value(3).toString();
+            hash["Artist"] = q.value(4).toString();
+            hash["Album"] = q.value(5).toString();
+            hash["Length"] = u->convert_length_format(q.value(6).toInt());
+            hash["TrackGain"] = gainString(q.value(7), q.value(8));
+            hash["AlbumGain"] = gainString(q.value(9), q.value(10));
+            hash["BPM"] = bpmString(q.value(11));
+            hash["Key"] = keyString(q.value(12));
+            rows.insert(id, hash);
+            // a song also matched by its id may be another chunk's artist's
+            QString key = q.value(13).toString();
+            if (chunkKeySet.contains(key)) {
+                artistRows[key].append(id);
+            }
+        }
+    }
+
+    // in the order they were dragged in, without the ones removed since
+    QList<QHash<QString, QString> > hashList;
+    for (int i = 0; i < types.size(); i++) {
+        if (types[i] == TreeItem::SONG) {
+            if (rows.contains(ids[i])) {
+                hashList.append(rows.value(ids[i]));
+            }
+            continue;
+        }
+        foreach (qint64 id, artistRows.value(keys[i])) {
+            const QHash<QString, QString> &hash = rows[id];
+            if (types[i] == TreeItem::ARTIST || hash.value("Album") == albums[i]) {
+                hashList.append(hash);
+            }
+        }
+    }
+    return hashList;
+}
+
+QList<QHash<QString, QString> > LibraryModel::songInfoList(SqlQuery &q) const {
+    QList<QHash<QString, QString> > hashList;
+    if (!q.exec()) {
+        //qDebug() << "Error at songInfoList() - Executing query: " << q.lastError();
     }
     while (q.next()) {
+        // missing entries are kept for the scan, not played
+        if (missingAlbums.contains(q.value(0).toString())) {
+            continue;
+        }
         QHash<QString, QString> hash;
         hash["absFilePath"] = q.value(0).toString();
         hash["fileName"] = q.value(1).toString();
@@ -508,17 +1260,24 @@ QList<QHash<QString, QString> > LibraryModel::getArtistSongInfo(const QModelInde
         hash["Artist"] = q.value(3).toString();
         hash["Album"] = q.value(4).toString();
         hash["Length"] = u->convert_length_format(q.value(5).toInt());
+        hash["TrackGain"] = gainString(q.value(6), q.value(7));
+        hash["AlbumGain"] = gainString(q.value(8), q.value(9));
+        hash["BPM"] = bpmString(q.value(10));
+        hash["Key"] = keyString(q.value(11));
         hashList.append(hash);
     }
     return hashList;
 }
-
 QMimeData *LibraryModel::mimeData(const QModelIndexList &indexes) const {
     //qDebug() << "Calling libraryModel mimeData";
+    // nothing is read from the database here: songs go in by id, artists
+    // and albums by their key, and the playlist looks them all up at once
+    // when they're dropped (see getTrackSongInfo()), so a big drag starts
+    // straight away
     QMimeData *mimeData = new QMimeData();
     QByteArray encodedData;
     QDataStream stream(&encodedData, QIODevice::WriteOnly);
-    QString header = "libraryItem";
+    QString header = "libraryTracks";
     stream << header; // mimeData header
 
     QModelIndex index;
@@ -527,17 +1286,15 @@ QMimeData *LibraryModel::mimeData(const QModelIndexList &indexes) const {
         if (index.isValid()) {
             item = getItem(index);
             if (item->getItemType() == TreeItem::ARTIST) {
-                // do stuff
-                QList<QHash<QString, QString> > songList = getArtistSongInfo(index);
-                QHash<QString, QString> hash;
-                foreach(hash, songList) {
-                    stream << hash;
-                }
-             }
+                // every song under it, fetched or not
+                stream << (qint32)TreeItem::ARTIST << item->getItemData().value("ArtistKey");
+            }
+            else if (item->getItemType() == TreeItem::ALBUM) {
+                stream << (qint32)TreeItem::ALBUM << item->parent()->getItemData().value("ArtistKey")
+                       << item->getItemData().value("Album");
+            }
             else if (item->getItemType() == TreeItem::SONG) {
-                // do stuff
-                QHash<QString, QString> song = getSongInfo(index);
-                stream << song;
+                stream << (qint32)TreeItem::SONG << item->trackId();
             }
         }
     }
@@ -562,48 +1319,79 @@ bool LibraryModel::setData(const QModelIndex &index, const QVariant &value, int
             QString newArtist = value.toString();
             QString oldArtist = data(index).toString();
 
-            // for each song node, get their information
+            // its songs may not be fetched, the database has them all
             TreeItem *artistItem = getItem(index);
-            QList<QString> absFilePathList;
-            TreeItem *item;
-            foreach(item, artistItem->getChildItems()) {
-                absFilePathList.append(item->getItemData()["absFilePath"]);
-            }
-
-            for (int i=0; i < absFilePathList.size(); i++) {
-                // change the metadata
-                changeMetaData(1, absFilePathList[i], newArtist);
-            }
-            // update the database entries
-            QSqlQuery q(db);
-            if (!q.exec(QString("UPDATE MUSICLIBRARY SET Artist='%1' WHERE Artist='%2'").arg(newArtist).arg(oldArtist))) {
+            QString oldKey = artistItem->getItemData().value("ArtistKey");
+            QString newKey = artistKey(newArtist);
+            QStringList absFilePathList = songPaths(oldKey, QString());
+
+            // the files are written behind, with one journal sync for all of them
+            TagWriter::instance()->queueEdits(absFilePathList, TagWriter::ARTIST, newArtist);
+            // update the database entries, every spelling the node groups
+            SqlQuery q(statements, "UPDATE MUSICLIBRARY SET Artist=:newArtist, ArtistKey=:newKey WHERE ArtistKey=:oldKey");
+            q.bindValue(":newArtist", newArtist);
+            q.bindValue(":newKey", newKey);
+            q.bindValue(":oldKey", oldKey);
+            if (!q.exec()) {
                 //qDebug() << "Error@setData(): Batch updating database entries artist columns failed: " << q.lastError();
                 return false;
             }
+            foreach(const QString &absFilePath, absFilePathList) {
+                filterIndex->update(absFilePath, QString(), newArtist, QString());
+            }
+            moveMissingAlbums(oldKey, QString(), newKey, QString());
 
-            // move all the nodes over and delete the oldArtist node
-            if (batchMoveSongNodes(newArtist, artistItem, index, absFilePathList.size())) {
+            if (newKey == oldKey) {
+                // respelled, the node stays but may sort elsewhere
+                renameArtistNode(artistItem, newArtist);
                 emit(libraryMetaDataChanged(1, oldArtist, newArtist));
                 return true;
             }
+            // its songs join the newArtist node, made if needed
+            mergeArtistNode(artistItem, newArtist);
+            emit(libraryMetaDataChanged(1, oldArtist, newArtist));
+            return true;
+        }
+        else if (getItem(index)->getItemType() == TreeItem::ALBUM) {
+            // clicked on an album node
+            QString newAlbum = value.toString();
+            QString oldAlbum = data(index).toString();
+            TreeItem *artistItem = getItem(index.parent());
+            QString key = artistItem->getItemData().value("ArtistKey");
+            QStringList absFilePathList = songPaths(key, oldAlbum);
+
+            TagWriter::instance()->queueEdits(absFilePathList, TagWriter::ALBUM, newAlbum);
+            SqlQuery q(statements, "UPDATE MUSICLIBRARY SET Album=:newAlbum WHERE ArtistKey=:ArtistKey AND Album=:oldAlbum");
+            q.bindValue(":newAlbum", newAlbum);
+            q.bindValue(":ArtistKey", key);
+            q.bindValue(":oldAlbum", oldAlbum);
+            if (!q.exec()) {
+                //qDebug() << "Error@setData(): Batch updating database entries album columns failed: " << q.lastError();
+                return false;
+            }
+            foreach(const QString &absFilePath, absFilePathList) {
+                filterIndex->update(absFilePath, QString(), QString(), newAlbum);
+                emit(libraryMetaDataChanged(2, absFilePath, newAlbum));
+            }
+            moveMissingAlbums(key, oldAlbum, key, newAlbum);
+            // it may have become part of another album, the albums are fetched again
+            unfetchChildren(artistItem, index.parent());
+            return true;
         }
         else {
             // clicked on a song node
             TreeItem *item = getItem(index);
-            QString absFilePath = item->getItemData()["absFilePath"];
+            QString absFilePath = item->path();
 
             // change MetaData of the actual file
             changeMetaData(0, absFilePath, value.toString());
 
-            // delete the node and database entry associated.
-            QString artist = item->parent()->data().toString();
-            if (removeEntryFromModel(absFilePath, artist)) {
-                // add the new node
-                QFileInfo fileInfo(absFilePath);
-                if (addMusicFromFile(fileInfo)) {
-                    emit(libraryMetaDataChanged(0, absFilePath, value.toString()));
-                    return true;
-                }
+            // update the database entry and the node where they are
+            QHash<QString, QString> fields;
+            fields["Title"] = value.toString();
+            if (updateSongEntry(absFilePath, fields)) {
+                emit(libraryMetaDataChanged(0, absFilePath, value.toString()));
+                return true;
             }
             return false;
         }
@@ -611,85 +1399,507 @@ bool LibraryModel::setData(const QModelIndex &index, const QVariant &value, int
     return false;
 }
 
-bool LibraryModel::batchMoveSongNodes(QString newArtist, TreeItem *oldArtistNode, const QModelIndex &oldArtistIndex, int numSongs) {
-    beginRemoveRows(oldArtistIndex, 0, numSongs-1);
-    // move the pointers to children song node to temporary storage.
-    QList<TreeItem *> orphans;
-    oldArtistNode->getChildItems().swap(orphans); // orphans now contains pointers to the songNodes
-    endRemoveRows();
-
-    beginRemoveRows(QModelIndex(), oldArtistIndex.row(), oldArtistIndex.row());
-    // remove library record for oldArtist
-    item_counts.remove(oldArtistNode->data().toString());
-    // remove old artist node
-    rootItem->removeChild(oldArtistIndex.row());
-    endRemoveRows();
+QStringList LibraryModel::songPaths(const QString &key, const QString &album) const {
+    // an artist's songs, or one album's with a non-empty album
+    SqlQuery q(statements, album.isEmpty() ? "SELECT absFilePath FROM MUSICLIBRARY WHERE ArtistKey=:ArtistKey"
+                                           : "SELECT absFilePath FROM MUSICLIBRARY WHERE ArtistKey=:ArtistKey AND Album=:Album");
+    q.bindValue(":ArtistKey", key);
+    if (!album.isEmpty()) {
+        q.bindValue(":Album", album);
+    }
+    QStringList paths;
+    if (!q.exec()) {
+        //qDebug() << "Error at songPaths() - Executing query: " << q.lastError();
+        return paths;
+    }
+    while (q.next()) {
+        if (!missingAlbums.contains(q.value(0).toString())) {
+            paths.append(q.value(0).toString());
+        }
+    }
+    return paths;
+}
 
-    // at this point the orphans' parentItem pointers are invalid,
-    // this will be fixed in the next for loop.
+void LibraryModel::moveMissingAlbums(const QString &oldKey, const QString &oldAlbum, const QString &newKey, const QString &newAlbum) {
+    // missing entries were updated with the rest, the counts follow them;
+    // empty albums stand for all of the artist's
+    QHash<QString, QString>::iterator it;
+    for (it = missingAlbums.begin(); it != missingAlbums.end(); ++it) {
+        int split = it.value().indexOf(QLatin1Char('\n'));
+        QString album = it.value().mid(split + 1);
+        if (it.value().left(split) == oldKey && (oldAlbum.isEmpty() || album == oldAlbum)) {
+            it.value() = newKey + "\n" + (newAlbum.isEmpty() ? album : newAlbum);
+        }
+    }
+}
 
-    // create the newArtistNode if doesn't exist
-    insertArtistNode(newArtist);
+void LibraryModel::mergeArtistNode(TreeItem *oldArtistNode, const QString &newArtist) {
+    int songs = oldArtistNode->songCount();
+    int row = oldArtistNode->childNumber();
+    beginRemoveRows(QModelIndex(), row, row);
+    artistNodes.remove(oldArtistNode->getItemData().value("ArtistKey"));
+    forgetNodes(oldArtistNode);
+    rootItem->removeChild(row);
+    endRemoveRows();
 
-    // vars needed in loop to finish connecting the orphans back
-    QModelIndex newArtistIdx = index(rootItem->findChildIndex(newArtist),0);
-    TreeItem *newArtistNode = rootItem->findChildNode(newArtist);
-    TreeItem *item;
-    QList<QString> existingSongs;
-    int newSongIdx;
-    foreach(item, orphans) {
-        existingSongs = newArtistNode->childrenData();
-        existingSongs.append(item->data().toString());
-        qSort(existingSongs);
-        newSongIdx = existingSongs.indexOf(item->data().toString());
-        beginInsertRows(newArtistIdx, newSongIdx, newSongIdx);
-        newArtistNode->insertChildItem(newSongIdx, TreeItem::SONG, item);
-        item->setParentItem(newArtistNode);
-        item_counts[newArtist]++;
-        endInsertRows();
+    QString key = artistKey(newArtist);
+    TreeItem *artistNode = artistNodes.value(key);
+    if (!artistNode) {
+        insertArtistNode(newArtist);
+        artistNode = artistNodes.value(key);
     }
-    return true;
+    // its albums are fetched again, with the songs that came over
+    QModelIndex artistIdx = index(artistNode->childNumber(), 0);
+    unfetchChildren(artistNode, artistIdx);
+    artistNode->setSongCount(artistNode->songCount() + songs);
+    emit(dataChanged(artistIdx, artistIdx));
 }
-
 bool LibraryModel::insertArtistNode(QString newArtist) {
-    // insert an Artist node if it doesn't exist already, set item_counts[newArtist] = 0 after
-    if (!item_counts.contains(newArtist)) {
-        QList<QString> keys = item_counts.keys();
-        keys.append(newArtist);
-        qSort(keys);
-        int newArtistIdx = keys.indexOf(newArtist);
+    // insert an Artist node if there's none for its key yet, with no songs;
+    // it's new, so its songs are added to it as they come instead of fetched
+    QString key = artistKey(newArtist);
+    if (!artistNodes.contains(key)) {
+        int newArtistIdx = sortedChildPosition(rootItem, newArtist, 0);
         beginInsertRows(QModelIndex(), newArtistIdx, newArtistIdx);
         QHash<QString, QString> hash;
         hash["Artist"] = newArtist;
+        hash["ArtistKey"] = key;
         rootItem->insertChild(newArtistIdx, TreeItem::ARTIST, hash);
-        item_counts[newArtist] = 0;
+        artistNodes.insert(key, rootItem->child(newArtistIdx));
         endInsertRows();
         return true;
     }
     return true;
 }
 
+TreeItem *LibraryModel::insertAlbumNode(TreeItem *artistNode, const QString &album) {
+    // the album node of a fetched artist, made (with no songs) if needed
+    TreeItem *albumNode = artistNode->findChildNode(album);
+    if (albumNode) {
+        return albumNode;
+    }
+    int row = sortedChildPosition(artistNode, album, 0);
+    beginInsertRows(index(artistNode->childNumber(), 0), row, row);
+    QHash<QString, QString> hash;
+    hash["Album"] = album;
+    artistNode->insertChild(row, TreeItem::ALBUM, hash);
+    endInsertRows();
+    nodeCache.add(artistNode, 1);
+    return artistNode->child(row);
+}
+
+void LibraryModel::renameArtistNode(TreeItem *artistNode, const QString &newArtist) {
+    int row = artistNode->childNumber();
+    int newRow = sortedChildPosition(rootItem, newArtist, artistNode);
+    artistNode->getItemData()["Artist"] = newArtist;
+    if (newRow != row) {
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), newRow > row ? newRow + 1 : newRow);
+        rootItem->getChildItems().move(row, newRow);
+        endMoveRows();
+    }
+    QModelIndex artistIdx = index(newRow, 0);
+    emit(dataChanged(artistIdx, artistIdx));
+}
+
 void LibraryModel::changeMetaData(int field, QString absFilePath, QString value) {
     // field=0 -> change Title
     // field=1 -> change Artist
-    QByteArray byteArray = absFilePath.toUtf8();
-    const char* cString = byteArray.constData();
-    TagLib::String tagValue = TagLib::String(value.toUtf8().constData());
-    TagLib::FileRef f(cString);
-    if (!f.isNull() && f.tag()) {
-        switch(field) {
-            case 0:
-                    //change title
-                    f.tag()->setTitle(tagValue);
-                    break;
-            case 1:
-                    // change artist
-                    f.tag()->setArtist(tagValue);
-                    break;
-            default:
-                    return;
-        }
-        f.file()->save();
+    // the file is saved in the background, until then reading its tags
+    // through addMusicFromFile() or Util gives the new value
+    if (field < TagWriter::TITLE || field > TagWriter::ARTIST) {
         return;
     }
+    TagWriter::instance()->queueEdit(absFilePath, (TagWriter::Field)field, value);
+}
+
+void LibraryModel::tagsWritten(QString absFilePath, bool ok, bool inPlace) {
+    if (ok) {
+        if (!inPlace) {
+            // a FLAC file's payload size counts the metadata in front of it
+            SqlQuery q(statements, "UPDATE MUSICLIBRARY SET ContentHash=:hash WHERE absFilePath=:absFilePath");
+            q.bindValue(":hash", (qint64)contentHash(absFilePath));
+            q.bindValue(":absFilePath", absFilePath);
+            if (!q.exec()) {
+                //qDebug() << "Error at tagsWritten() - Executing query: " << q.lastError();
+            }
+        }
+        return;
+    }
+    // the library shows the edit already, put back what the file says
+    QHash<QString, QString> tags;
+    u->get_metaData(absFilePath, tags);
+    if (tags.isEmpty()) {
+        //qDebug() << "tagsWritten(): can't read back" << absFilePath;
+        return;
+    }
+    playlistMetaDataChange(tags);
+}
+
+LibraryIndex *LibraryModel::searchIndex() const {
+    return filterIndex;
+}
+
+LoudnessAnalyzer *LibraryModel::loudnessAnalyzer() const {
+    return analyzer;
+}
+
+QString LibraryModel::gainString(const QVariant &loudness, const QVariant &truePeak) {
+    // empty until the track (or album) has been analysed
+    if (loudness.isNull()) {
+        return QString();
+    }
+    return QString::number(LoudnessAnalyzer::replayGain(loudness.toDouble(), truePeak.toDouble()), 'f', 2);
+}
+
+void LibraryModel::analyseLoudness() {
+    // album loudness gates all tracks of an album together, so an album with
+    // anything missing is measured again as a whole
+    if (analyzer->isRunning()) {
+        return;
+    }
+    SqlQuery q(statements, "SELECT absFilePath, ArtistKey, Album, AlbumLoudness FROM MUSICLIBRARY ORDER BY ArtistKey, Album");
+    if (!q.exec()) {
+        //qDebug() << "Error at analyseLoudness() - Executing query: " << q.lastError();
+        return;
+    }
+    QList<QPair<QString, QString> > tracks;
+    QSet<QString> staleAlbums;
+    while (q.next()) {
+        QString album = q.value(2).toString();
+        // "Unknown" is what untagged files get, those are not an album
+        QString albumKey = album == "Unknown" ? QString() : q.value(1).toString() + "\n" + album;
+        QString absFilePath = q.value(0).toString();
+        if (missingFiles.contains(absFilePath)) {
+            continue;
+        }
+        tracks.append(qMakePair(absFilePath, albumKey.isEmpty() ? absFilePath : albumKey));
+        if (q.value(3).isNull()) {
+            staleAlbums.insert(tracks.last().second);
+        }
+    }
+    QPair<QString, QString> track;
+    foreach(track, tracks) {
+        if (staleAlbums.contains(track.second)) {
+            analyzer->addTrack(track.first, track.second);
+        }
+    }
+    if (!analyzer->isRunning()) {
+        // nothing to do
+        emit(loudnessAnalysisFinished());
+    }
+}
+
+void LibraryModel::trackLoudnessAnalysed(QString absFilePath, double loudness, double truePeakDb) {
+    SqlQuery q(statements, "UPDATE MUSICLIBRARY SET Loudness=:Loudness, TruePeak=:TruePeak WHERE absFilePath=:absFilePath");
+    q.bindValue(":Loudness", loudness);
+    q.bindValue(":TruePeak", truePeakDb);
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec()) {
+        //qDebug() << "Error at trackLoudnessAnalysed() - Executing query: " << q.lastError();
+        return;
+    }
+    emit(replayGainChanged(absFilePath, gainString(loudness, truePeakDb), QString()));
+}
+
+void LibraryModel::albumLoudnessAnalysed(QStringList absFilePaths, double loudness, double truePeakDb) {
+    QString trackGain;
+    QString albumGain = gainString(loudness, truePeakDb);
+    SqlQuery q(statements, "UPDATE MUSICLIBRARY SET AlbumLoudness=:AlbumLoudness, AlbumPeak=:AlbumPeak WHERE absFilePath=:absFilePath");
+    SqlQuery track(statements, "SELECT Loudness, TruePeak FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+    db.transaction();
+    QString absFilePath;
+    foreach(absFilePath, absFilePaths) {
+        q.bindValue(":AlbumLoudness", loudness);
+        q.bindValue(":AlbumPeak", truePeakDb);
+        q.bindValue(":absFilePath", absFilePath);
+        if (!q.exec()) {
+            //qDebug() << "Error at albumLoudnessAnalysed() - Executing query: " << q.lastError();
+            continue;
+        }
+        track.bindValue(":absFilePath", absFilePath);
+        if (track.exec() && track.next()) {
+            trackGain = gainString(track.value(0), track.value(1));
+            emit(replayGainChanged(absFilePath, trackGain, albumGain));
+        }
+    }
+    db.commit();
+}
+
+TempoKeyAnalyzer *LibraryModel::tempoKeyAnalyzer() const {
+    return tempoAnalyzer;
+}
+
+QString LibraryModel::bpmString(const QVariant &bpm) {
+    // as stored in the playlist's "BPM", empty until analysed (or if there was no beat)
+    if (bpm.isNull() || bpm.toDouble() <= 0.0) {
+        return QString();
+    }
+    return QString::number(bpm.toDouble(), 'f', 1);
+}
+
+QString LibraryModel::keyString(const QVariant &key) {
+    // the playlist's "Key" is the TempoKeyMeter key number
+    if (key.isNull() || key.toInt() == TempoKeyMeter::NO_KEY) {
+        return QString();
+    }
+    return QString::number(key.toInt());
+}
+
+void LibraryModel::analyseTempoAndKey() {
+    if (tempoAnalyzer->isRunning()) {
+        return;
+    }
+    SqlQuery q(statements, "SELECT absFilePath FROM MUSICLIBRARY WHERE Bpm IS NULL OR MusicalKey IS NULL");
+    if (!q.exec()) {
+        //qDebug() << "Error at analyseTempoAndKey() - Executing query: " << q.lastError();
+        return;
+    }
+    while (q.next()) {
+        QString absFilePath = q.value(0).toString();
+        if (!missingFiles.contains(absFilePath)) {
+            tempoAnalyzer->addTrack(absFilePath);
+        }
+    }
+    if (!tempoAnalyzer->isRunning()) {
+        // nothing to do
+        emit(tempoKeyAnalysisFinished());
+    }
+}
+
+void LibraryModel::tempoKeyAnalysed(QString absFilePath, double bpm, int key) {
+    SqlQuery q(statements, "UPDATE MUSICLIBRARY SET Bpm=:Bpm, MusicalKey=:MusicalKey WHERE absFilePath=:absFilePath");
+    q.bindValue(":Bpm", bpm);
+    q.bindValue(":MusicalKey", key);
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec()) {
+        //qDebug() << "Error at tempoKeyAnalysed() - Executing query: " << q.lastError();
+        return;
+    }
+    emit(tempoKeyChanged(absFilePath, bpmString(bpm), keyString(key)));
+}
+
+FingerprintAnalyzer *LibraryModel::fingerprintAnalyzer() const {
+    return fingerprinter;
+}
+
+void LibraryModel::findDuplicates() {
+    pendingFingerprintJobs |= FIND_DUPLICATES;
+    fingerprintLibrary();
+}
+
+void LibraryModel::reattachMovedFiles() {
+    pendingFingerprintJobs |= REATTACH_MOVED;
+    fingerprintLibrary();
+}
+
+void LibraryModel::fingerprintLibrary() {
+    // a run in progress picks the pending jobs up when it's done
+    if (fingerprinter->isRunning()) {
+        return;
+    }
+    SqlQuery q(statements, "SELECT absFilePath FROM MUSICLIBRARY WHERE Fingerprint IS NULL");
+    if (!q.exec()) {
+        //qDebug() << "Error at fingerprintLibrary() - Executing query: " << q.lastError();
+        return;
+    }
+    while (q.next()) {
+        fingerprinter->addTrack(q.value(0).toString());
+    }
+    if (!fingerprinter->isRunning()) {
+        // everything has a fingerprint already
+        fingerprintingFinished();
+    }
+}
+
+void LibraryModel::trackFingerprinted(QString absFilePath, QByteArray fingerprint) {
+    SqlQuery q(statements, "UPDATE MUSICLIBRARY SET Fingerprint=:Fingerprint WHERE absFilePath=:absFilePath");
+    SqlQuery id(statements, "SELECT id FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+    SqlQuery clear(statements, "DELETE FROM FINGERPRINTINDEX WHERE Track=:Track");
+    SqlQuery insert(statements, "INSERT INTO FINGERPRINTINDEX(Key, Track) VALUES (:Key, :Track)");
+    db.transaction();
+    q.bindValue(":Fingerprint", fingerprint);
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec()) {
+        //qDebug() << "Error at trackFingerprinted() - Executing query: " << q.lastError();
+        db.rollback();
+        return;
+    }
+    id.bindValue(":absFilePath", absFilePath);
+    if (!id.exec() || !id.next()) {
+        db.rollback();
+        return;
+    }
+    int track = id.value(0).toInt();
+    // done reading, so the statement doesn't hold on to its cursor
+    id.finish();
+    clear.bindValue(":Track", track);
+    clear.exec();
+    foreach (quint32 key, AudioFingerprint::fromByteArray(fingerprint).indexKeys()) {
+        insert.bindValue(":Key", (qint64)key);
+        insert.bindValue(":Track", track);
+        insert.exec();
+    }
+    db.commit();
+}
+
+void LibraryModel::fingerprintingFinished() {
+    int jobs = pendingFingerprintJobs;
+    pendingFingerprintJobs = 0;
+    // moved files first, so they don't show up as duplicates of themselves
+    if (jobs & REATTACH_MOVED) {
+        int reattached = 0;
+        int removed = 0;
+        reattachMissingFiles(reattached, removed);
+        emit(movedFilesReattached(reattached, removed));
+    }
+    if (jobs & FIND_DUPLICATES) {
+        emit(duplicatesFound(duplicateGroups()));
+    }
+}
+
+QList<QPair<double, QString> > LibraryModel::fingerprintMatches(const AudioFingerprint &fingerprint, const QString &exclude) {
+    // only every INDEX_STRIDE-th sub-fingerprint is indexed, so all of the
+    // query's are looked up to hit them whatever the alignment. Tracks are
+    // then verified against the whole fingerprint, most hits first.
+    const int MAX_CANDIDATES = 16;
+    QList<QPair<double, QString> > matches;
+    QSet<quint32> keys;
+    foreach (quint32 value, fingerprint.values()) {
+        if (value != 0 && value != 0xffffffffu) {
+            keys.insert(value);
+        }
+    }
+    QList<quint32> keyList = keys.toList();
+    QHash<int, int> hits;
+    // keys are looked up BATCH at a time, the last batch is padded with a
+    // key that's never indexed so every lookup is the same statement
+    const int BATCH = 256;
+    QStringList placeholders;
+    for (int j = 0; j < BATCH; j++) {
+        placeholders << "?";
+    }
+    SqlQuery lookup(statements, QString("SELECT Track, COUNT(*) FROM FINGERPRINTINDEX WHERE Key IN (%1) GROUP BY Track").arg(placeholders.join(",")));
+    for (int i = 0; i < keyList.size(); i += BATCH) {
+        for (int j = i; j < i + BATCH; j++) {
+            lookup.addBindValue(j < keyList.size() ? (qint64)keyList[j] : (qint64)0);
+        }
+        if (!lookup.exec()) {
+            //qDebug() << "Error at fingerprintMatches() - Executing query: " << lookup.lastError();
+            return matches;
+        }
+        while (lookup.next()) {
+            hits[lookup.value(0).toInt()] += lookup.value(1).toInt();
+        }
+    }
+
+    QList<QPair<int, int> > candidates;
+    QHash<int, int>::const_iterator it;
+    for (it = hits.constBegin(); it != hits.constEnd(); ++it) {
+        candidates.append(qMakePair(-it.value(), it.key()));
+    }
+    qSort(candidates);
+    SqlQuery q(statements, "SELECT absFilePath, Fingerprint FROM MUSICLIBRARY WHERE id=:id");
+    for (int i = 0; i < candidates.size() && i < MAX_CANDIDATES; i++) {
+        q.bindValue(":id", candidates[i].second);
+        if (!q.exec() || !q.next() || q.value(0).toString() == exclude) {
+            continue;
+        }
+        double errorRate = fingerprint.bitErrorRate(AudioFingerprint::fromByteArray(q.value(1).toByteArray()));
+        if (errorRate < AudioFingerprint::MATCH_THRESHOLD) {
+            matches.append(qMakePair(errorRate, q.value(0).toString()));
+        }
+    }
+    qSort(matches);
+    return matches;
+}
+
+QList<QStringList> LibraryModel::duplicateGroups() {
+    QList<QStringList> groups;
+    QSet<QString> grouped;
+    SqlQuery q(statements, "SELECT absFilePath, Fingerprint FROM MUSICLIBRARY WHERE Fingerprint IS NOT NULL ORDER BY absFilePath");
+    if (!q.exec()) {
+        //qDebug() << "Error at duplicateGroups() - Executing query: " << q.lastError();
+        return groups;
+    }
+    while (q.next()) {
+        QString absFilePath = q.value(0).toString();
+        if (grouped.contains(absFilePath) || missingFiles.contains(absFilePath)) {
+            continue;
+        }
+        QStringList group(absFilePath);
+        QPair<double, QString> match;
+        foreach (match, fingerprintMatches(AudioFingerprint::fromByteArray(q.value(1).toByteArray()), absFilePath)) {
+            if (!grouped.contains(match.second) && !missingFiles.contains(match.second)) {
+                group.append(match.second);
+            }
+        }
+        if (group.size() > 1) {
+            grouped += group.toSet();
+            groups.append(group);
+        }
+    }
+    return groups;
+}
+
+void LibraryModel::reattachMissingFiles(int &reattached, int &removed) {
+    // the moved file was imported again as a new entry: that one is dropped
+    // and the old entry, with its edits and analysis, takes over its path
+    QSet<QString> claimed;
+    foreach (const QString &missing, missingFiles) {
+        AudioFingerprint fingerprint;
+        {
+            SqlQuery q(statements, "SELECT Fingerprint FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+            q.bindValue(":absFilePath", missing);
+            if (!q.exec() || !q.next()) {
+                continue;
+            }
+            fingerprint = AudioFingerprint::fromByteArray(q.value(0).toByteArray());
+        }
+        QString target;
+        QPair<double, QString> match;
+        foreach (match, fingerprintMatches(fingerprint, missing)) {
+            if (missingFiles.contains(match.second) || claimed.contains(match.second)) {
+                continue;
+            }
+            // another copy of the recording may be around too, a file that
+            // kept its name is most likely the one that moved
+            if (target.isEmpty()) {
+                target = match.second;
+            }
+            if (QFileInfo(match.second).fileName() == QFileInfo(missing).fileName()) {
+                target = match.second;
+                break;
+            }
+        }
+
+        QString gone = target.isEmpty() ? missing : target;
+        db.transaction();
+        SqlQuery unindex(statements, "DELETE FROM FINGERPRINTINDEX WHERE Track IN (SELECT id FROM MUSICLIBRARY WHERE absFilePath=:absFilePath)");
+        unindex.bindValue(":absFilePath", gone);
+        unindex.exec();
+        SqlQuery remove(statements, "DELETE FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+        remove.bindValue(":absFilePath", gone);
+        remove.exec();
+        if (!target.isEmpty()) {
+            SqlQuery move(statements, "UPDATE MUSICLIBRARY SET absFilePath=:target, fileName=:fileName WHERE absFilePath=:absFilePath");
+            move.bindValue(":target", target);
+            move.bindValue(":fileName", QFileInfo(target).fileName());
+            move.bindValue(":absFilePath", missing);
+            move.exec();
+            claimed.insert(target);
+            reattached++;
+        } else {
+            removed++;
+        }
+        db.commit();
+    }
+
+    // rebuild the tree from the database, the folders don't need a rescan
+    beginRemoveRows(QModelIndex(), 0, rootItem->ChildCount()-1);
+    delete rootItem;
+    endRemoveRows();
+    QSqlError err = populateModel();
+    if (err.type() != QSqlError::NoError) {
+        showError(err, "Populating model failed");
+    }
 }
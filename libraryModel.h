@@ -2,10 +2,20 @@
 #include "debug.h"
 #include "util.h"
 #include "treeItem.h"
+#include "nodeCache.h"
 #include <QtSql/QtSql>
 #include <QAbstractItemModel>
 #include <QModelIndex>
 
+class LoudnessAnalyzer;
+class FingerprintAnalyzer;
+class TempoKeyAnalyzer;
+class AudioFingerprint;
+class StatementCache;
+class SqlQuery;
+class LibraryIndex;
+class LibraryBackfill;
+
 /*
  * QSqlDatabase db;
  * db = QSqlDatabase::addDatabase("QSQLITE");
@@ -26,6 +36,32 @@ public:
     TreeItem *getItem(const QModelIndex &index) const;
     QHash<QString, QString> getSongInfo(const QModelIndex idx) const;
     QList<QHash<QString, QString> > getArtistSongInfo(const QModelIndex idx) const;
+    QList<QHash<QString, QString> > getAlbumSongInfo(const QModelIndex idx) const;
+    // the folder view's files, in the order given
+    QList<QHash<QString, QString> > getPathSongInfo(const QStringList &absFilePaths) const;
+    // the songs of a drag out of the library, read from what follows its
+    // "libraryTracks" header, in the order they were dragged
+    QList<QHash<QString, QString> > getTrackSongInfo(QDataStream &stream) const;
+    LoudnessAnalyzer *loudnessAnalyzer() const;
+    FingerprintAnalyzer *fingerprintAnalyzer() const;
+    TempoKeyAnalyzer *tempoKeyAnalyzer() const;
+    // title, artist and album words of every song in the tree, for filtering
+    LibraryIndex *searchIndex() const;
+    // at most this many album and song nodes are kept fetched, the ones
+    // used longest ago (and not expanded) are dropped; 0 keeps them all
+    void setNodeCap(int nodes);
+    // the view's expanded nodes stay fetched
+    void setExpanded(const QModelIndex &idx, bool expanded);
+
+public slots:
+    // measure every track (and album) that has no loudness in the database yet
+    void analyseLoudness();
+    // tempo and key of every track that has none in the database yet
+    void analyseTempoAndKey();
+    // both fingerprint whatever isn't yet first, then report with
+    // duplicatesFound() and movedFilesReattached() respectively
+    void findDuplicates();
+    void reattachMovedFiles();
 
 protected:
     // inherited from QAbstractItemModel
@@ -35,8 +71,10 @@ protected:
     virtual QModelIndex parent(const QModelIndex &index) const;
     virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
 
-    // for dynamic fetching...kinda obsolete
-    //virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    // albums and songs are fetched from the database when their parent is expanded
+    virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    virtual bool canFetchMore(const QModelIndex &parent) const;
+    virtual void fetchMore(const QModelIndex &parent);
 
     // drag and drop support with playlist, and editing library entries
     virtual QMimeData* mimeData(const QModelIndexList &indexes) const;
@@ -48,31 +86,101 @@ private slots:
     void addMusicFromPlaylist(const QString absFilePath);
     void playlistMetaDataChange(QHash<QString,QString> newHash);
     void refreshLibrary();
+    void trackLoudnessAnalysed(QString absFilePath, double loudness, double truePeakDb);
+    void albumLoudnessAnalysed(QStringList absFilePaths, double loudness, double truePeakDb);
+    void trackFingerprinted(QString absFilePath, QByteArray fingerprint);
+    void tempoKeyAnalysed(QString absFilePath, double bpm, int key);
+    void hashBackfilled(QString absFilePath, qint64 hash);
+    void facetsBackfilled(QString absFilePath, QString genre, int year);
+    void tagsWritten(QString absFilePath, bool ok, bool inPlace);
+    void fingerprintingFinished();
 
 signals:
     void libraryMetaDataChanged(int, QString, QString);
+    // gains in dB as stored in the playlist's "TrackGain"/"AlbumGain", empty if unknown
+    void replayGainChanged(QString absFilePath, QString trackGain, QString albumGain);
+    void loudnessAnalysisFinished();
+    // "BPM" and "Key" as stored in the playlist, empty if unknown
+    void tempoKeyChanged(QString absFilePath, QString bpm, QString key);
+    void tempoKeyAnalysisFinished();
+    // groups of library entries that are the same recording
+    void duplicatesFound(QList<QStringList> groups);
+    // missing entries moved to a file found by fingerprint, and the ones
+    // that had no match and were removed
+    void movedFilesReattached(int reattached, int removed);
+    // genres or years of songs already in the tree were read
+    void facetsChanged();
 
 private:
     QSqlError initDb();
+    // recomputes the stored ArtistKeys if artistKeyRules() changed since
+    QSqlError updateArtistKeys();
     QSqlError populateModel();
     QSqlError populateFromDirs();
-    void addArtistAndSongs(int artistCount, QString Artist, QList<QHash<QString, QString> > &validSongs);
     void showError(const QSqlError &err, const QString msg);
-    /*
-     * addEntry is adding an entry to database.
-     * addMusicFile is create a database entry from an actual file.
-     */
-    bool addEntry(QSqlQuery &q, const QString &absFilePath, const QString &fileName,
-                  const QString &title, const QString &artist, const QString &album, const int length);
+    // the facets of a song: the format is its lower case suffix, the year
+    // empty when it's not tagged
+    static QString formatOf(const QString &absFilePath);
+    static QString yearString(int year);
+    // addMusicFromFile creates a database entry from an actual file
     bool addMusicFromFile(QFileInfo &fileInfo);
-    bool addEntryToModel(QString &absFilePath, QString &fileName, QString &title, QString &artist, QString &album, int length);
-    bool removeEntryFromModel(QString &absFilePath, QString &artist);
-    bool removeSongNode(const QString &artist, const QString &absFilePath);
-    bool batchMoveSongNodes(QString newArtist, TreeItem *oldArtistNode, const QModelIndex &oldArtistIndex, int numSongs);
+    bool addEntryToModel(QString &absFilePath, QString &fileName, QString &title, QString &artist, QString &album, int length,
+                         const QString &genre, int year, qint64 hash = 0);
+    void insertSongNode(const QString &absFilePath, const QString &title, const QString &artist, const QString &album,
+                        const QString &genre, int year);
+    // insertSongNode() without the search index
+    void placeSongNode(const QString &absFilePath, const QString &title, const QString &artist, const QString &album);
+    // moved files: matched by content hash during a scan
+    bool relocateMissingFile(qint64 hash, const QString &absFilePath);
+    void dropMissingFiles();
+    // new Title/Artist/Album (any of them) of a song already in the library
+    bool updateSongEntry(const QString &absFilePath, const QHash<QString, QString> &fields);
+    int sortedChildPosition(TreeItem *parent, const QString &key, TreeItem *skip) const;
+    bool removeSongNode(const QString &key, const QString &album, const QString &absFilePath);
     bool insertArtistNode(QString newArtist);
+    TreeItem *insertAlbumNode(TreeItem *artistNode, const QString &album);
+    // the songs of oldArtistNode now belong to newArtist
+    void mergeArtistNode(TreeItem *oldArtistNode, const QString &newArtist);
+    void moveMissingAlbums(const QString &oldKey, const QString &oldAlbum, const QString &newKey, const QString &newAlbum);
+    void fetchAlbums(TreeItem *artistNode, const QModelIndex &artistIdx);
+    void fetchSongs(TreeItem *albumNode, const QModelIndex &albumIdx);
+    void fetchSongPage(TreeItem *albumNode, const QModelIndex &albumIdx);
+    void unfetchChildren(TreeItem *node, const QModelIndex &idx);
+    void evictNodes(TreeItem *keep);
+    void forgetNodes(TreeItem *node);
+    QModelIndex nodeIndex(TreeItem *node) const;
+    QStringList songPaths(const QString &key, const QString &album) const;
+    QList<QHash<QString, QString> > songInfoList(SqlQuery &q) const;
+    // a new spelling with the same key, the node shows it from now on
+    void renameArtistNode(TreeItem *artistNode, const QString &newArtist);
+    static QString gainString(const QVariant &loudness, const QVariant &truePeak);
+    static QString bpmString(const QVariant &bpm);
+    static QString keyString(const QVariant &key);
+    void fingerprintLibrary();
+    // library entries with the same recording, best match first, as (bit error rate, absFilePath)
+    QList<QPair<double, QString> > fingerprintMatches(const AudioFingerprint &fingerprint, const QString &exclude);
+    QList<QStringList> duplicateGroups();
+    void reattachMissingFiles(int &reattached, int &removed);
+    enum FingerprintJob { FIND_DUPLICATES = 1, REATTACH_MOVED = 2 };
+    // songs of an album fetched at a time
+    static const int SONG_PAGE = 256;
     Util *u;
+    LoudnessAnalyzer *analyzer;
+    FingerprintAnalyzer *fingerprinter;
+    TempoKeyAnalyzer *tempoAnalyzer;
+    LibraryBackfill *backfill;
+    int pendingFingerprintJobs;
+    // entries whose file was gone at populateModel(): the fingerprinted
+    // ones, and the ones with a content hash
+    QSet<QString> missingFiles;
+    QMultiHash<qint64, QString> missingByHash;     // copies of a file share a hash
+    QHash<QString, QString> missingAlbums;  // every missing entry -> artist key + "\n" + album
     TreeItem *rootItem;
     QSqlDatabase db;
-    QHash<QString, int> item_counts;
+    StatementCache *statements;     // every query goes through it
+    LibraryIndex *filterIndex;
+    QHash<QString, TreeItem*> artistNodes;  // by artist key
+    NodeCache nodeCache;
+    QHash<TreeItem*, QVector<qint64> > pendingSongs;   // album -> ids of its songs not fetched yet, in order
     QList<QString> importDirs;
 };
@@ -0,0 +1,213 @@
+#include "loudnessAnalyzer.h"
+#include "loudnessMeter.h"
+#include "pcmDecoder.h"
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QDebug>
+
+const double LoudnessAnalyzer::REFERENCE_LUFS = -18.0;
+
+namespace {
+
+// Feeds the decoded track into a LoudnessMeter, created once the first
+// buffer tells us the rate and channel count.
+class MeterSink : public PcmSink {
+public:
+    MeterSink(LoudnessAnalyzer *owner) : analyzer(owner), meter(0) {}
+    ~MeterSink() { delete meter; }
+
+    bool consume(const float *samples, int frames, int channels, int sampleRate) {
+        if (!meter) {
+            meter = new LoudnessMeter(sampleRate, channels);
+        }
+        meter->addFrames(samples, frames);
+        return !analyzer->isCancelled();
+    }
+
+    LoudnessAnalyzer *analyzer;
+    LoudnessMeter *meter;
+};
+
+class LoudnessTask : public QRunnable {
+public:
+    LoudnessTask(LoudnessAnalyzer *owner, const QString &absFilePath, const QString &albumKey)
+        : analyzer(owner), path(absFilePath), album(albumKey) {}
+
+    void run() {
+        LoudnessAnalyzer::Result result;
+        result.absFilePath = path;
+        result.albumKey = album;
+        result.ok = false;
+        result.loudness = 0.0;
+        result.truePeakDb = 0.0;
+        result.seconds = 0.0;
+        if (!analyzer->isCancelled()) {
+            PcmDecoder decoder;
+            MeterSink sink(analyzer);
+            if (decoder.decode(path, &sink) && sink.meter && !analyzer->isCancelled()) {
+                result.ok = true;
+                result.loudness = sink.meter->integratedLoudness();
+                result.truePeakDb = sink.meter->truePeakDb();
+                result.seconds = (double)decoder.decodedFrames() / decoder.sampleRate();
+                result.blocks = sink.meter->blockEnergies();
+            }
+        }
+        analyzer->post(result);
+    }
+
+private:
+    LoudnessAnalyzer *analyzer;
+    QString path;
+    QString album;
+};
+
+}
+
+LoudnessAnalyzer::LoudnessAnalyzer(QObject *parent) : QObject(parent) {
+    scheduler = JobScheduler::instance();
+    lastElapsed = 0;
+    total = 0;
+    done = 0;
+    failed = 0;
+    seconds = 0.0;
+}
+
+LoudnessAnalyzer::~LoudnessAnalyzer() {
+    cancel();
+    scheduler->waitForGroup(this);
+}
+
+void LoudnessAnalyzer::addTrack(const QString &absFilePath, const QString &albumKey) {
+    if (!isRunning()) {
+        // new run
+        cancelled.storeRelease(0);
+        albums.clear();
+        total = 0;
+        done = 0;
+        failed = 0;
+        seconds = 0.0;
+        timer.start();
+    }
+    if (!albumKey.isEmpty()) {
+        Album &a = albums[albumKey];
+        if (a.paths.isEmpty()) {
+            a.remaining = 0;
+            a.truePeakDb = -100.0;
+        }
+        a.remaining++;
+        a.paths.append(absFilePath);
+    }
+    total++;
+    scheduler->submit(new LoudnessTask(this, absFilePath, albumKey), JobScheduler::BACKGROUND, this);
+}
+
+void LoudnessAnalyzer::cancel() {
+    // running tasks stop at their next buffer, queued ones are dropped. Both
+    // report a failure, so the counts add up and finished() is emitted as usual
+    cancelled.storeRelease(1);
+    int dropped = scheduler->cancel(this);
+    for (int i = 0; i < dropped; i++) {
+        Result r;
+        r.ok = false;
+        post(r);
+    }
+}
+
+bool LoudnessAnalyzer::isCancelled() const {
+    return cancelled.loadAcquire() != 0;
+}
+
+bool LoudnessAnalyzer::isRunning() const {
+    return done < total;
+}
+
+int LoudnessAnalyzer::threadCount() const {
+    return scheduler->maxRunning(JobScheduler::BACKGROUND);
+}
+
+int LoudnessAnalyzer::tracksTotal() const {
+    return total;
+}
+
+int LoudnessAnalyzer::tracksDone() const {
+    return done;
+}
+
+int LoudnessAnalyzer::tracksFailed() const {
+    return failed;
+}
+
+qint64 LoudnessAnalyzer::elapsedMs() const {
+    return isRunning() ? timer.elapsed() : lastElapsed;
+}
+
+double LoudnessAnalyzer::audioSeconds() const {
+    return seconds;
+}
+
+double LoudnessAnalyzer::tracksPerMinutePerCore() const {
+    qint64 ms = elapsedMs();
+    if (ms <= 0) {
+        return 0.0;
+    }
+    return (done - failed) * 60000.0 / ms / threadCount();
+}
+
+double LoudnessAnalyzer::replayGain(double loudness, double truePeakDb) {
+    double gain = REFERENCE_LUFS - loudness;
+    gain = qMin(gain, -1.0 - truePeakDb);
+    return qBound(-20.0, gain, 20.0);
+}
+
+void LoudnessAnalyzer::post(const Result &result) {
+    QMutexLocker locker(&resultsLock);
+    results.append(result);
+    // one queued call is enough for any number of pending results
+    if (results.size() == 1) {
+        QMetaObject::invokeMethod(this, "collectResults", Qt::QueuedConnection);
+    }
+}
+
+void LoudnessAnalyzer::collectResults() {
+    QList<Result> batch;
+    {
+        QMutexLocker locker(&resultsLock);
+        batch.swap(results);
+    }
+    bool cancelledRun = isCancelled();
+    foreach (const Result &r, batch) {
+        done++;
+        if (!r.ok) {
+            failed++;
+        } else {
+            seconds += r.seconds;
+            if (!cancelledRun) {
+                emit(trackAnalysed(r.absFilePath, r.loudness, r.truePeakDb));
+            }
+        }
+        if (r.albumKey.isEmpty() || !albums.contains(r.albumKey)) {
+            continue;
+        }
+        Album &a = albums[r.albumKey];
+        if (r.ok) {
+            a.blocks += r.blocks;
+            a.truePeakDb = qMax(a.truePeakDb, r.truePeakDb);
+        }
+        if (--a.remaining == 0) {
+            if (!cancelledRun && !a.blocks.isEmpty()) {
+                emit(albumAnalysed(a.paths, LoudnessMeter::gatedLoudness(a.blocks), a.truePeakDb));
+            }
+            albums.remove(r.albumKey);
+        }
+    }
+    emit(progress(done, total));
+    if (!isRunning()) {
+        lastElapsed = timer.elapsed();
+#if DEBUG_ANALYSIS
+        qDebug() << "LoudnessAnalyzer:" << done << "tracks," << failed << "failed,"
+                 << lastElapsed << "ms," << tracksPerMinutePerCore() << "tracks/min/core,"
+                 << seconds * 1000.0 / qMax(lastElapsed, (qint64)1) << "x realtime";
+#endif
+        emit(finished());
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "debug.h"
+#include "jobScheduler.h"
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+/*
+ * LoudnessAnalyzer measures the integrated loudness and true peak of a batch
+ * of tracks in the background, one track per JobScheduler job. Tracks
+ * sharing an album key are also gated together once the last of them is
+ * done, which gives the album loudness. Results are reported on the thread
+ * that owns the analyzer.
+ */
+class LoudnessAnalyzer : public QObject {
+    Q_OBJECT
+
+public:
+    // ReplayGain 2.0 reference level
+    static const double REFERENCE_LUFS;
+
+    LoudnessAnalyzer(QObject *parent = 0);
+    ~LoudnessAnalyzer();
+
+    // queue a track; albumKey groups the tracks of one album, empty means none
+    void addTrack(const QString &absFilePath, const QString &albumKey);
+    void cancel();
+    bool isRunning() const;
+    int threadCount() const;
+
+    // statistics of the current (or last) run
+    int tracksTotal() const;
+    int tracksDone() const;
+    int tracksFailed() const;
+    qint64 elapsedMs() const;
+    double audioSeconds() const;
+    double tracksPerMinutePerCore() const;
+
+    // gain in dB that brings a track to REFERENCE_LUFS, limited so the true
+    // peak stays under -1 dBTP
+    static double replayGain(double loudness, double truePeakDb);
+
+    // filled in by the worker threads and picked up by collectResults()
+    struct Result {
+        QString absFilePath;
+        QString albumKey;
+        bool ok;
+        double loudness;
+        double truePeakDb;
+        double seconds;
+        QVector<double> blocks;
+    };
+    void post(const Result &result);
+    bool isCancelled() const;
+
+signals:
+    void trackAnalysed(QString absFilePath, double loudness, double truePeakDb);
+    void albumAnalysed(QStringList absFilePaths, double loudness, double truePeakDb);
+    void progress(int done, int total);
+    void finished();
+
+private slots:
+    void collectResults();
+
+private:
+    struct Album {
+        int remaining;
+        QStringList paths;
+        QVector<double> blocks;
+        double truePeakDb;
+    };
+
+    JobScheduler *scheduler;
+    QAtomicInt cancelled;
+    QMutex resultsLock;
+    QList<Result> results;
+    QHash<QString, Album> albums;
+
+    QElapsedTimer timer;
+    qint64 lastElapsed;
+    int total;
+    int done;
+    int failed;
+    double seconds;
+};
@@ -0,0 +1,212 @@
+#include "loudnessMeter.h"
+#include "sampleKernels.h"
+#include <qmath.h>
+#include <string.h>
+
+namespace {
+const double ABSOLUTE_GATE = -70.0;
+const double RELATIVE_GATE = -10.0;
+}
+
+LoudnessMeter::LoudnessMeter(int sampleRate, int numChannels)
+    : rate(sampleRate), channelCount(numChannels) {
+    // K-weighting: a high shelf modelling the head, then the RLB high pass,
+    // both re-derived for sampleRate (the standard only lists 48kHz values)
+    double f0 = 1681.974450955533;
+    double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = qTan(M_PI * f0 / rate);
+    double vh = qPow(10.0, gain / 20.0);
+    double vb = qPow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    stage[0].b0 = (vh + vb * k / q + k * k) / a0;
+    stage[0].b1 = 2.0 * (k * k - vh) / a0;
+    stage[0].b2 = (vh - vb * k / q + k * k) / a0;
+    stage[0].a1 = 2.0 * (k * k - 1.0) / a0;
+    stage[0].a2 = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = qTan(M_PI * f0 / rate);
+    a0 = 1.0 + k / q + k * k;
+    stage[1].b0 = 1.0;
+    stage[1].b1 = -2.0;
+    stage[1].b2 = 1.0;
+    stage[1].a1 = 2.0 * (k * k - 1.0) / a0;
+    stage[1].a2 = (1.0 - k / q + k * k) / a0;
+
+    // Hann windowed sinc interpolator, split into one FIR per output phase,
+    // each normalised to unity gain at DC
+    const int taps = OVERSAMPLE * PHASE_TAPS;
+    const double centre = (taps - 1) / 2.0;
+    for (int p = 0; p < OVERSAMPLE; p++) {
+        double sum = 0.0;
+        for (int t = 0; t < PHASE_TAPS; t++) {
+            int m = p + OVERSAMPLE * t;
+            double x = (m - centre) / OVERSAMPLE;
+            double sinc = x == 0.0 ? 1.0 : qSin(M_PI * x) / (M_PI * x);
+            double window = 0.5 - 0.5 * qCos(2.0 * M_PI * (m + 0.5) / taps);
+            phase[p][t] = (float)(sinc * window);
+            sum += phase[p][t];
+        }
+        for (int t = 0; t < PHASE_TAPS; t++) {
+            phase[p][t] = (float)(phase[p][t] / sum);
+        }
+    }
+
+    channels.resize(channelCount);
+    for (int c = 0; c < channelCount; c++) {
+        Channel &ch = channels[c];
+        // 5.0 / 5.1 layouts: surrounds are boosted by 1.5 dB and the LFE is ignored
+        ch.weight = 1.0;
+        if (channelCount == 5 && c >= 3) {
+            ch.weight = 1.41;
+        } else if (channelCount == 6 && c == 3) {
+            ch.weight = 0.0;
+        } else if (channelCount == 6 && c >= 4) {
+            ch.weight = 1.41;
+        }
+        ch.z1[0] = ch.z1[1] = ch.z2[0] = ch.z2[1] = 0.0;
+        ch.planar.fill(0.0f, PHASE_TAPS - 1 + CHUNK);
+    }
+    oversampled.resize(CHUNK);
+    scratch.resize(CHUNK);
+
+    subBlockFrames = qMax(1, rate / 10);
+    subBlockFill = 0;
+    subBlockEnergy = 0.0;
+    subBlocksSeen = 0;
+    peak = 0.0f;
+    frames = 0;
+}
+
+void LoudnessMeter::addFrames(const float *samples, int count) {
+    const SampleKernels &k = sampleKernels();
+    int stride = channelCount;
+    int done = 0;
+    while (done < count) {
+        int n = qMin(count - done, qMin((int)CHUNK, subBlockFrames - subBlockFill));
+        const float *in = samples + (qint64)done * stride;
+
+        // split the chunk into planar buffers, after each channel's history
+        if (channelCount == 2) {
+            k.deinterleave2(in, channels[0].planar.data() + PHASE_TAPS - 1,
+                            channels[1].planar.data() + PHASE_TAPS - 1, n);
+        } else {
+            for (int c = 0; c < channelCount; c++) {
+                float *out = channels[c].planar.data() + PHASE_TAPS - 1;
+                for (int i = 0; i < n; i++) {
+                    out[i] = in[i*stride + c];
+                }
+            }
+        }
+
+        for (int c = 0; c < channelCount; c++) {
+            Channel &ch = channels[c];
+            measurePeak(ch, n);
+            if (ch.weight == 0.0) {
+                continue;
+            }
+            memcpy(scratch.data(), ch.planar.constData() + PHASE_TAPS - 1, n * sizeof(float));
+            filter(ch, scratch.data(), n);
+            subBlockEnergy += ch.weight * k.sumSquares(scratch.constData(), n);
+        }
+
+        done += n;
+        frames += n;
+        subBlockFill += n;
+        if (subBlockFill == subBlockFrames) {
+            lastSubBlocks[subBlocksSeen % 4] = subBlockEnergy;
+            subBlocksSeen++;
+            // a 400ms block ends on every 100ms boundary once four have been seen
+            if (subBlocksSeen >= 4) {
+                double sum = lastSubBlocks[0] + lastSubBlocks[1] + lastSubBlocks[2] + lastSubBlocks[3];
+                blocks.append(sum / (4.0 * subBlockFrames));
+            }
+            subBlockFill = 0;
+            subBlockEnergy = 0.0;
+        }
+    }
+}
+
+void LoudnessMeter::filter(Channel &ch, float *buf, int n) {
+    for (int s = 0; s < 2; s++) {
+        const Biquad &b = stage[s];
+        double z1 = ch.z1[s], z2 = ch.z2[s];
+        for (int i = 0; i < n; i++) {
+            double x = buf[i];
+            double y = b.b0 * x + z1;
+            z1 = b.b1 * x - b.a1 * y + z2;
+            z2 = b.b2 * x - b.a2 * y;
+            buf[i] = (float)y;
+        }
+        // don't let a decaying tail into silence end up in denormals
+        ch.z1[s] = qAbs(z1) < 1e-30 ? 0.0 : z1;
+        ch.z2[s] = qAbs(z2) < 1e-30 ? 0.0 : z2;
+    }
+}
+
+void LoudnessMeter::measurePeak(Channel &ch, int n) {
+    const SampleKernels &k = sampleKernels();
+    // phase p of output i is sum(phase[p][t] * x[i - t]); x[i] sits at planar[PHASE_TAPS-1 + i]
+    const float *x = ch.planar.constData() + PHASE_TAPS - 1;
+    for (int p = 0; p < OVERSAMPLE; p++) {
+        float *out = oversampled.data();
+        memset(out, 0, n * sizeof(float));
+        for (int t = 0; t < PHASE_TAPS; t++) {
+            k.mixGain(out, x - t, n, phase[p][t]);
+        }
+        peak = qMax(peak, k.peakAbs(out, n));
+    }
+    peak = qMax(peak, k.peakAbs(x, n));
+    // keep the last samples as history for the next chunk
+    memmove(ch.planar.data(), x + n - (PHASE_TAPS - 1), (PHASE_TAPS - 1) * sizeof(float));
+}
+
+double LoudnessMeter::integratedLoudness() const {
+    return gatedLoudness(blocks);
+}
+
+double LoudnessMeter::truePeakDb() const {
+    return 20.0 * log10(qMax((double)peak, 1e-5));
+}
+
+const QVector<double> &LoudnessMeter::blockEnergies() const {
+    return blocks;
+}
+
+qint64 LoudnessMeter::framesMeasured() const {
+    return frames;
+}
+
+double LoudnessMeter::energyToLufs(double energy) {
+    if (energy <= 0.0) {
+        return -HUGE_VAL;
+    }
+    return -0.691 + 10.0 * log10(energy);
+}
+
+double LoudnessMeter::gatedLoudness(const QVector<double> &energies) {
+    double sum = 0.0;
+    int count = 0;
+    for (int i = 0; i < energies.size(); i++) {
+        if (energyToLufs(energies[i]) > ABSOLUTE_GATE) {
+            sum += energies[i];
+            count++;
+        }
+    }
+    if (count == 0) {
+        return ABSOLUTE_GATE;
+    }
+    double relative = energyToLufs(sum / count) + RELATIVE_GATE;
+    sum = 0.0;
+    count = 0;
+    for (int i = 0; i < energies.size(); i++) {
+        double lufs = energyToLufs(energies[i]);
+        if (lufs > ABSOLUTE_GATE && lufs > relative) {
+            sum += energies[i];
+            count++;
+        }
+    }
+    return count ? energyToLufs(sum / count) : ABSOLUTE_GATE;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "debug.h"
+#include <QtGlobal>
+#include <QVector>
+
+/*
+ * LoudnessMeter measures one track following EBU R128 / ITU-R BS.1770:
+ * K-weighted, channel-weighted mean square over 400ms blocks overlapping by
+ * 75%, gated at -70 LUFS and then 10 LU below the ungated mean. The true
+ * peak comes from a 4x oversampled copy of the signal.
+ *
+ * The K-weighting biquads are recursive and run per channel in scalar code;
+ * the block energies, the oversampling filter and the peak search run on
+ * the sample kernels.
+ */
+class LoudnessMeter {
+public:
+    LoudnessMeter(int sampleRate, int channels);
+
+    // interleaved frames, any count
+    void addFrames(const float *samples, int frames);
+
+    // LUFS; -70 (the absolute gate) if nothing passed the gates
+    double integratedLoudness() const;
+    // dBTP, floored at -100 for digital silence
+    double truePeakDb() const;
+    // mean square of every 400ms block, so several tracks can be gated together
+    const QVector<double> &blockEnergies() const;
+    qint64 framesMeasured() const;
+
+    static double gatedLoudness(const QVector<double> &energies);
+    static double energyToLufs(double energy);
+
+private:
+    // 12 taps per phase, 48 taps in total like the BS.1770 reference filter
+    enum { OVERSAMPLE = 4, PHASE_TAPS = 12, CHUNK = 1024 };
+
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+    struct Channel {
+        double weight;
+        double z1[2], z2[2];        // transposed direct form II state per stage
+        QVector<float> planar;      // PHASE_TAPS-1 samples of history, then the chunk
+    };
+
+    void filter(Channel &ch, float *buf, int n);
+    void measurePeak(Channel &ch, int n);
+
+    int rate;
+    int channelCount;
+    Biquad stage[2];
+    float phase[OVERSAMPLE][PHASE_TAPS];
+    QVector<Channel> channels;
+    QVector<float> oversampled;
+    QVector<float> scratch;
+
+    int subBlockFrames;         // 100ms
+    int subBlockFill;
+    double subBlockEnergy;
+    double lastSubBlocks[4];
+    int subBlocksSeen;
+    QVector<double> blocks;
+    float peak;
+    qint64 frames;
+};
@@ -1,15 +1,29 @@
 #include "debug.h"
 #include "util.h"
 #include "mainWindow.h"
+#include "sampleKernels.h"
+#include "jobScheduler.h"
+#include "tagWriter.h"
 #include <QApplication>
 #include <QtGlobal>
 #include <QTime>
+#include <QDebug>
 
 int main(int argc, char *argv[]) {
     // create seed for random
     QTime time = QTime::currentTime();
     qsrand((uint) time.msec());
     QApplication app(argc, argv);
+#if DEBUG_KERNELS
+    // check the SIMD kernels against the scalar ones, then time them
+    qDebug() << "SampleKernels: using" << sampleKernels().name
+             << "verified:" << verifySampleKernels();
+    benchmarkSampleKernels();
+#endif
+    // outlives the window, whose analyzers wait for their jobs on the way out
+    JobScheduler scheduler;
+    // replays the tag edits left over from the last run
+    TagWriter tagWriter;
     MainWindow window;
     window.show();
     return app.exec();
@@ -1,6 +1,13 @@
 #include "mainWindow.h"
 #include "playlistmodel.h"
+#include "playlistTable.h"
 #include "libraryModel.h"
+#include "loudnessAnalyzer.h"
+#include "fingerprintAnalyzer.h"
+#include "tempoKeyAnalyzer.h"
+#include "jobScheduler.h"
+#include "tagWriter.h"
+#include "statementCache.h"
 #include <QMenu>
 #include <QMenuBar>
 #include <QApplication>
@@ -56,12 +63,23 @@ void MainWindow::setupWidgets() {
     setCentralWidget(centralWidget);
     connect(player, SIGNAL(changeTitle(QString)), this, SLOT(setWindowTitle(const QString &)));
 
+    // songs dragged from the library are looked up by the playlist
+    player->view()->setLibrary(library->model());
+
     // signal connections.
     connect(library, SIGNAL(addSongToPlaylist(QHash<QString, QString>)), player, SLOT(addSongFromLibrary(QHash<QString, QString>)));
     connect(library, SIGNAL(addArtistToPlaylist(QList<QHash<QString, QString> >)), player, SLOT(addArtistFromLibrary(QList<QHash<QString, QString> >)));
     connect(player->model(), SIGNAL(mediaAddedToPlaylist(QString)), library->model(), SLOT(addMusicFromPlaylist(QString)));
     connect(player->model(), SIGNAL(playlistMetaDataChange(QHash<QString, QString>)), library->model(), SLOT(playlistMetaDataChange(QHash<QString,QString>)));
     connect(library->model(), SIGNAL(libraryMetaDataChanged(int, QString, QString)), player->model(), SLOT(libraryMetaDataChanged(int, QString, QString)));
+    connect(library->model(), SIGNAL(replayGainChanged(QString, QString, QString)), player->model(), SLOT(replayGainChanged(QString, QString, QString)));
+    connect(library->model(), SIGNAL(loudnessAnalysisFinished()), this, SLOT(loudnessAnalysisFinished()));
+    connect(library->model(), SIGNAL(tempoKeyChanged(QString, QString, QString)), player->model(), SLOT(tempoKeyChanged(QString, QString, QString)));
+    connect(library->model(), SIGNAL(tempoKeyAnalysisFinished()), this, SLOT(tempoKeyAnalysisFinished()));
+    connect(TagWriter::instance(), SIGNAL(tagsWritten(QString, bool, bool, qint64)), library->model(), SLOT(tagsWritten(QString, bool, bool)));
+    connect(TagWriter::instance(), SIGNAL(tagsWritten(QString, bool, bool, qint64)), player->model(), SLOT(tagsWritten(QString, bool)));
+    connect(library->model(), SIGNAL(duplicatesFound(QList<QStringList>)), this, SLOT(duplicatesFound(QList<QStringList>)));
+    connect(library->model(), SIGNAL(movedFilesReattached(int, int)), this, SLOT(movedFilesReattached(int, int)));
     connect(player->model(), SIGNAL(playlistFileOpened(QFileInfo)), library->model_pl(), SLOT(addToModelAndDB(QFileInfo)));
 
     connect(library->model_pl(), SIGNAL(loadPlaylist(QString)), player->model(), SLOT(loadPlaylistItem(QString)));
@@ -84,11 +102,89 @@ void MainWindow::setupMenus() {
     connect(refreshLibraryAction, SIGNAL(triggered()), library->model(), SLOT(refreshLibrary()));
     connect(refreshLibraryAction, SIGNAL(triggered()), library->model_pl(), SLOT(refresh()));
 
+    // windowedLibraryAction: cap the library nodes in memory, on by default
+    windowedLibraryAction = new QAction(tr("Windowed library"), this);
+    windowedLibraryAction->setCheckable(true);
+    windowedLibraryAction->setChecked(true);
+    fileMenu->addAction(windowedLibraryAction);
+    connect(windowedLibraryAction, SIGNAL(toggled(bool)), library, SLOT(setWindowed(bool)));
+
+    // analyseLoudnessAction
+    analyseLoudnessAction = new QAction(tr("Analyse loudness"), this);
+    fileMenu->addAction(analyseLoudnessAction);
+    connect(analyseLoudnessAction, SIGNAL(triggered()), library->model(), SLOT(analyseLoudness()));
+
+    // analyseTempoKeyAction
+    analyseTempoKeyAction = new QAction(tr("Analyse tempo and key"), this);
+    fileMenu->addAction(analyseTempoKeyAction);
+    connect(analyseTempoKeyAction, SIGNAL(triggered()), library->model(), SLOT(analyseTempoAndKey()));
+
+    // findDuplicatesAction and reattachMovedAction: by acoustic fingerprint
+    findDuplicatesAction = new QAction(tr("Find duplicates"), this);
+    fileMenu->addAction(findDuplicatesAction);
+    connect(findDuplicatesAction, SIGNAL(triggered()), library->model(), SLOT(findDuplicates()));
+    reattachMovedAction = new QAction(tr("Reattach moved files"), this);
+    fileMenu->addAction(reattachMovedAction);
+    connect(reattachMovedAction, SIGNAL(triggered()), library->model(), SLOT(reattachMovedFiles()));
+
     // exitAction
     exitAction = new QAction(tr("&Exit"), this);
     fileMenu->addAction(exitAction);
     connect(exitAction, SIGNAL(triggered()), this, SLOT(close()));
 
+    playbackMenu = menubar->addMenu(tr("&Playback"));
+
+    // pipelineAction: play through the decode->ring buffer->output engine
+    pipelineAction = new QAction(tr("Low-latency decode pipeline"), this);
+    pipelineAction->setCheckable(true);
+    playbackMenu->addAction(pipelineAction);
+    connect(pipelineAction, SIGNAL(toggled(bool)), player, SLOT(setPipelineEnabled(bool)));
+
+    // crossfadeMenu: durations are exclusive, the curve is a toggle
+    crossfadeMenu = playbackMenu->addMenu(tr("Crossfade"));
+    crossfadeGroup = new QActionGroup(this);
+    int fadeSeconds[] = {0, 2, 5, 8};
+    for (int i = 0; i < 4; i++) {
+        QAction *action = new QAction(fadeSeconds[i] ? tr("%1 seconds").arg(fadeSeconds[i]) : tr("Off"), this);
+        action->setCheckable(true);
+        action->setChecked(fadeSeconds[i] == 0);
+        action->setData(fadeSeconds[i]*1000);
+        crossfadeGroup->addAction(action);
+        crossfadeMenu->addAction(action);
+    }
+    crossfadeMenu->addSeparator();
+    equalPowerAction = new QAction(tr("Equal-power curve"), this);
+    equalPowerAction->setCheckable(true);
+    equalPowerAction->setChecked(true);
+    crossfadeMenu->addAction(equalPowerAction);
+    connect(crossfadeGroup, SIGNAL(triggered(QAction*)), this, SLOT(crossfadeChanged()));
+    connect(equalPowerAction, SIGNAL(toggled(bool)), this, SLOT(crossfadeChanged()));
+
+    // replayGainMenu: normalise with the library's loudness analysis
+    replayGainMenu = playbackMenu->addMenu(tr("ReplayGain"));
+    replayGainGroup = new QActionGroup(this);
+    QString gainNames[] = {tr("Off"), tr("Track gain"), tr("Album gain")};
+    int gainModes[] = {Player::GAIN_OFF, Player::GAIN_TRACK, Player::GAIN_ALBUM};
+    for (int i = 0; i < 3; i++) {
+        QAction *action = new QAction(gainNames[i], this);
+        action->setCheckable(true);
+        action->setChecked(gainModes[i] == Player::GAIN_OFF);
+        action->setData(gainModes[i]);
+        replayGainGroup->addAction(action);
+        replayGainMenu->addAction(action);
+    }
+    connect(replayGainGroup, SIGNAL(triggered(QAction*)), this, SLOT(replayGainChanged()));
+
+    // pipelineStatsAction
+    pipelineStatsAction = new QAction(tr("Pipeline statistics"), this);
+    playbackMenu->addAction(pipelineStatsAction);
+    connect(pipelineStatsAction, SIGNAL(triggered()), this, SLOT(pipelineStats()));
+
+    // queryStatsAction
+    queryStatsAction = new QAction(tr("Query statistics"), this);
+    playbackMenu->addAction(queryStatsAction);
+    connect(queryStatsAction, SIGNAL(triggered()), this, SLOT(queryStats()));
+
     aboutMenu = menubar->addMenu(tr("&About"));
 
     // aboutAction
@@ -103,6 +199,164 @@ void MainWindow::importFromFolder() {
     library->model()->addFromDir(dir);
 }
 
+void MainWindow::crossfadeChanged() {
+    int ms = crossfadeGroup->checkedAction()->data().toInt();
+    // QMediaPlayer can't crossfade, so turn the decode pipeline on for it
+    if (ms > 0) {
+        pipelineAction->setChecked(true);
+    }
+    player->setCrossfade(ms, equalPowerAction->isChecked());
+}
+
+void MainWindow::replayGainChanged() {
+    player->setReplayGainMode(replayGainGroup->checkedAction()->data().toInt());
+}
+
+void MainWindow::loudnessAnalysisFinished() {
+    LoudnessAnalyzer *analyzer = library->model()->loudnessAnalyzer();
+    QString msg = QString("Analysed: %1 tracks\nFailed: %2\nTime: %3 s on %4 threads\nThroughput: %5 tracks/min per core\nAudio: %6x realtime")
+                    .arg(analyzer->tracksDone() - analyzer->tracksFailed())
+                    .arg(analyzer->tracksFailed())
+                    .arg(analyzer->elapsedMs()/1000.0, 0, 'f', 1)
+                    .arg(analyzer->threadCount())
+                    .arg(analyzer->tracksPerMinutePerCore(), 0, 'f', 1)
+                    .arg(analyzer->audioSeconds()*1000.0/qMax(analyzer->elapsedMs(), (qint64)1), 0, 'f', 1);
+    QMessageBox::information(this, tr("Loudness analysis"), msg);
+}
+
+void MainWindow::tempoKeyAnalysisFinished() {
+    TempoKeyAnalyzer *analyzer = library->model()->tempoKeyAnalyzer();
+    QString msg = QString("Analysed: %1 tracks\nFailed: %2\nTime: %3 s on %4 threads\nThroughput: %5 tracks/min (%6 per core)\nAudio: %7x realtime")
+                    .arg(analyzer->tracksDone() - analyzer->tracksFailed())
+                    .arg(analyzer->tracksFailed())
+                    .arg(analyzer->elapsedMs()/1000.0, 0, 'f', 1)
+                    .arg(analyzer->threadCount())
+                    .arg(analyzer->tracksPerMinute(), 0, 'f', 1)
+                    .arg(analyzer->tracksPerMinutePerCore(), 0, 'f', 1)
+                    .arg(analyzer->audioSeconds()*1000.0/qMax(analyzer->elapsedMs(), (qint64)1), 0, 'f', 1);
+    QMessageBox::information(this, tr("Tempo and key analysis"), msg);
+}
+
+QString MainWindow::fingerprintStats() {
+    FingerprintAnalyzer *fingerprinter = library->model()->fingerprintAnalyzer();
+    return QString("Fingerprinted: %1 tracks\nFailed: %2\nTime: %3 s on %4 threads\nThroughput: %5 tracks/min per core")
+                    .arg(fingerprinter->tracksDone() - fingerprinter->tracksFailed())
+                    .arg(fingerprinter->tracksFailed())
+                    .arg(fingerprinter->elapsedMs()/1000.0, 0, 'f', 1)
+                    .arg(fingerprinter->threadCount())
+                    .arg(fingerprinter->tracksPerMinutePerCore(), 0, 'f', 1);
+}
+
+void MainWindow::duplicatesFound(QList<QStringList> groups) {
+    QMessageBox msgBox(this);
+    msgBox.setWindowTitle(tr("Find duplicates"));
+    msgBox.setText(QString("%1 recordings with more than one copy").arg(groups.size()));
+    msgBox.setInformativeText(fingerprintStats());
+    QStringList details;
+    QStringList group;
+    foreach(group, groups) {
+        details << group.join("\n");
+    }
+    msgBox.setDetailedText(details.join("\n\n"));
+    msgBox.exec();
+}
+
+void MainWindow::movedFilesReattached(int reattached, int removed) {
+    QString msg = QString("Reattached: %1 moved files\nRemoved: %2 missing files\n\n")
+                    .arg(reattached)
+                    .arg(removed);
+    QMessageBox::information(this, tr("Reattach moved files"), msg + fingerprintStats());
+}
+
+void MainWindow::pipelineStats() {
+    AudioEngine *engine = player->pipeline();
+    WaveformCache *waveforms = player->waveformCache();
+    QString msg = QString("Engine: %1\nBuffer: %2 ms\nFill level: %3%\nUnderruns: %4\nLatency: %5 ms")
+                    .arg(player->isPipelineEnabled() ? "decode pipeline" : "QMediaPlayer")
+                    .arg(engine->bufferMs())
+                    .arg(qRound(engine->fillLevel()*100))
+                    .arg(engine->underruns())
+                    .arg(engine->latencyMs());
+    TrackPrefetcher *prefetcher = player->prefetcher();
+    msg += QString("\nPrefetch: %1 hits, %2 misses (%3% hit rate), %4 of %5 KB resident, %6 KB requested")
+                    .arg(prefetcher->hits())
+                    .arg(prefetcher->misses())
+                    .arg(qRound(prefetcher->hitRate()*100))
+                    .arg(prefetcher->bytesResident()/1024)
+                    .arg(prefetcher->budget()/1024)
+                    .arg(prefetcher->bytesRequested()/1024);
+    TrackHeadCache *heads = player->headCache();
+    int headLookups = heads->hits() + heads->misses();
+    msg += QString("\nTrack heads: %1 hits, %2 misses (%3% hit rate), %4 of %5 KB used")
+                    .arg(heads->hits())
+                    .arg(heads->misses())
+                    .arg(headLookups > 0 ? qRound(heads->hits()*100.0/headLookups) : 0)
+                    .arg(heads->bytesUsed()/1024)
+                    .arg(heads->budget()/1024);
+    msg += QString("\nWaveforms: %1 hits, %2 misses, %3x realtime per core")
+                    .arg(waveforms->hits())
+                    .arg(waveforms->misses())
+                    .arg(waveforms->realtimeFactorPerCore(), 0, 'f', 1);
+    SpectrumAnalyzer *spectrum = player->spectrumAnalyzer();
+    msg += QString("\nSpectrum: %1 frames, %2 dropped before display, %3 input frames skipped")
+                    .arg(spectrum->framesPublished())
+                    .arg(spectrum->framesDropped())
+                    .arg(spectrum->inputFramesSkipped());
+    JobScheduler *jobs = JobScheduler::instance();
+    msg += QString("\nJobs: %1 workers, %2 steals, background throttled for %3 s%4")
+                    .arg(jobs->workerCount())
+                    .arg(jobs->steals())
+                    .arg(jobs->throttledMs()/1000.0, 0, 'f', 1)
+                    .arg(jobs->isThrottled() ? " (now)" : "");
+    const char *classNames[JobScheduler::PRIORITY_CLASSES] = {"interactive", "user", "background"};
+    for (int p = 0; p < JobScheduler::PRIORITY_CLASSES; p++) {
+        JobScheduler::Priority priority = (JobScheduler::Priority)p;
+        msg += QString("\n    %1: %2 queued, %3 running, %4 done, %5 cancelled")
+                        .arg(classNames[p])
+                        .arg(jobs->queued(priority))
+                        .arg(jobs->running(priority))
+                        .arg(jobs->completed(priority))
+                        .arg(jobs->cancelled(priority));
+    }
+    TagWriter *tags = TagWriter::instance();
+    msg += QString("\nTag writes: %1 edits, %2 merged, %3 files saved (%4 rewritten), %5 failed, %6 KB written")
+                    .arg(tags->editsQueued())
+                    .arg(tags->editsCoalesced())
+                    .arg(tags->filesWritten())
+                    .arg(tags->filesRewritten())
+                    .arg(tags->filesFailed())
+                    .arg(tags->bytesWritten()/1024);
+    QMessageBox::information(this, tr("Pipeline statistics"), msg);
+}
+
+void MainWindow::queryStats() {
+    // the statements that took longest overall, per connection
+    const int SHOWN = 10;
+    QString msg;
+    foreach (StatementCache *cache, StatementCache::caches()) {
+        QList<StatementCache::Stats> stats = cache->stats();
+        int calls = 0;
+        qint64 nsecs = 0;
+        foreach (const StatementCache::Stats &s, stats) {
+            calls += s.calls;
+            nsecs += s.nsecs;
+        }
+        msg += QString("%1%2: %3 statements, %4 runs, %5 ms\n")
+                    .arg(msg.isEmpty() ? "" : "\n")
+                    .arg(cache->connectionName())
+                    .arg(stats.size())
+                    .arg(calls)
+                    .arg(nsecs/1000000.0, 0, 'f', 1);
+        for (int i = 0; i < stats.size() && i < SHOWN; i++) {
+            msg += QString("    %1 ms, %2x: %3\n")
+                        .arg(stats[i].nsecs/1000000.0, 0, 'f', 1)
+                        .arg(stats[i].calls)
+                        .arg(stats[i].sql.left(80));
+        }
+    }
+    QMessageBox::information(this, tr("Query statistics"), msg);
+}
+
 void MainWindow::about() {
     QString msg = "AAMusicPlayer\nThe MIT License (MIT)\nCopyright (c) 2014 Allen Yin, April Dai";
     QMessageBox::about(0, "Title", msg);
@@ -22,6 +22,14 @@ public slots:
 private slots:
     void importFromFolder();
     void about();
+    void pipelineStats();
+    void queryStats();
+    void crossfadeChanged();
+    void replayGainChanged();
+    void loudnessAnalysisFinished();
+    void tempoKeyAnalysisFinished();
+    void duplicatesFound(QList<QStringList> groups);
+    void movedFilesReattached(int reattached, int removed);
 
 private:
     Player *player;
@@ -29,12 +37,27 @@ private:
     QWidget *centralWidget;
     QMenuBar *menubar;
     QMenu *fileMenu;
+    QMenu *playbackMenu;
     QMenu *aboutMenu;
     QAction *exitAction;
     QAction *importFromFolderAction;
     QAction *refreshLibraryAction;
+    QAction *windowedLibraryAction;
+    QAction *analyseLoudnessAction;
+    QAction *analyseTempoKeyAction;
+    QAction *findDuplicatesAction;
+    QAction *reattachMovedAction;
+    QAction *pipelineAction;
+    QAction *pipelineStatsAction;
+    QAction *queryStatsAction;
+    QMenu *crossfadeMenu;
+    QActionGroup *crossfadeGroup;
+    QAction *equalPowerAction;
+    QMenu *replayGainMenu;
+    QActionGroup *replayGainGroup;
     QAction *aboutAction;
     void setupWidgets();
     void setupMenus();
+    QString fingerprintStats();
 
 };
@@ -18,9 +18,80 @@ RESOURCES = music_player2.qrc
 HEADERS += player.h playercontrols.h playlistmodel.h playlistTable.h mainWindow.h util.h debug.h libraryModel.h library.h treeItem.h libraryView.h \
     plsortfilterproxymodel.h \
     playlistlibrarymodel.h \
-    playlistlibraryview.h
+    playlistlibraryview.h \
+    trackPrefetcher.h \
+    trackHeadCache.h \
+    ringBuffer.h \
+    audioEngine.h \
+    sampleKernels.h \
+    pcmDecoder.h \
+    loudnessMeter.h \
+    loudnessAnalyzer.h \
+    waveformCache.h \
+    waveformSlider.h \
+    fft.h \
+    spectrumAnalyzer.h \
+    spectrumWidget.h \
+    audioFingerprint.h \
+    fingerprintAnalyzer.h \
+    contentHash.h \
+    tempoKeyMeter.h \
+    tempoKeyAnalyzer.h \
+    jobScheduler.h \
+    tagWriter.h \
+    tagSpace.h \
+    statementCache.h \
+    libraryIndex.h \
+    libraryFilterProxyModel.h \
+    fuzzyMatcher.h \
+    quickFindDialog.h \
+    parallelSort.h \
+    collation.h \
+    artistKey.h \
+    nodeCache.h \
+    compressedBitmap.h \
+    facetIndex.h \
+    facetPanel.h \
+    libraryBackfill.h \
+    pathTrie.h \
+    folderModel.h
 SOURCES += main.cpp player.cpp playercontrols.cpp playlistmodel.cpp playlistTable.cpp mainWindow.cpp util.cpp libraryModel.cpp library.cpp treeItem.cpp libraryView.cpp \
     plsortfilterproxymodel.cpp \
     playlistlibrarymodel.cpp \
-    playlistlibraryview.cpp
+    playlistlibraryview.cpp \
+    trackPrefetcher.cpp \
+    trackHeadCache.cpp \
+    ringBuffer.cpp \
+    audioEngine.cpp \
+    sampleKernels.cpp \
+    pcmDecoder.cpp \
+    loudnessMeter.cpp \
+    loudnessAnalyzer.cpp \
+    waveformCache.cpp \
+    waveformSlider.cpp \
+    fft.cpp \
+    spectrumAnalyzer.cpp \
+    spectrumWidget.cpp \
+    audioFingerprint.cpp \
+    fingerprintAnalyzer.cpp \
+    contentHash.cpp \
+    tempoKeyMeter.cpp \
+    tempoKeyAnalyzer.cpp \
+    jobScheduler.cpp \
+    tagWriter.cpp \
+    tagSpace.cpp \
+    statementCache.cpp \
+    libraryIndex.cpp \
+    libraryFilterProxyModel.cpp \
+    fuzzyMatcher.cpp \
+    quickFindDialog.cpp \
+    collation.cpp \
+    artistKey.cpp \
+    nodeCache.cpp \
+    compressedBitmap.cpp \
+    facetIndex.cpp \
+    facetPanel.cpp \
+    libraryBackfill.cpp \
+    pathTrie.cpp \
+    folderModel.cpp
 
@@ -0,0 +1,105 @@
+#include "nodeCache.h"
+#include <QPair>
+#include <QVector>
+#include <algorithm>
+
+NodeCache::NodeCache() {
+    total = 0;
+    limit = 0;
+    clock = 0;
+}
+
+void NodeCache::setCap(int nodes) {
+    limit = nodes;
+}
+
+int NodeCache::cap() const {
+    return limit;
+}
+
+void NodeCache::clear() {
+    entries.clear();
+    total = 0;
+}
+
+void NodeCache::add(TreeItem *parent, int children) {
+    QHash<TreeItem*, Entry>::iterator it = entries.find(parent);
+    if (it == entries.end()) {
+        Entry e;
+        e.children = 0;
+        e.pinned = false;
+        it = entries.insert(parent, e);
+    }
+    it.value().children += children;
+    it.value().used = ++clock;
+    total += children;
+}
+
+void NodeCache::setPinned(TreeItem *parent, bool pinned) {
+    // the view may expand a node before its children are fetched
+    QHash<TreeItem*, Entry>::iterator it = entries.find(parent);
+    if (it == entries.end()) {
+        if (pinned) {
+            add(parent, 0);
+            entries[parent].pinned = true;
+        }
+    } else if (!pinned && it.value().children == 0) {
+        entries.erase(it);
+    } else {
+        it.value().pinned = pinned;
+        it.value().used = ++clock;
+    }
+}
+
+void NodeCache::release(TreeItem *parent) {
+    QHash<TreeItem*, Entry>::iterator it = entries.find(parent);
+    if (it == entries.end()) {
+        return;
+    }
+    total -= it.value().children;
+    if (it.value().pinned) {
+        it.value().children = 0;
+    } else {
+        entries.erase(it);
+    }
+}
+
+void NodeCache::remove(TreeItem *parent) {
+    QHash<TreeItem*, Entry>::iterator it = entries.find(parent);
+    if (it != entries.end()) {
+        total -= it.value().children;
+        entries.erase(it);
+    }
+}
+
+bool NodeCache::contains(TreeItem *parent) const {
+    return entries.contains(parent);
+}
+
+int NodeCache::size() const {
+    return total;
+}
+
+QList<TreeItem*> NodeCache::overCap(TreeItem *keep) const {
+    QList<TreeItem*> evict;
+    if (limit <= 0 || total <= limit) {
+        return evict;
+    }
+    // sorted only when over the cap, and there are only as many entries
+    // as parents that have been expanded
+    QVector<QPair<quint64, TreeItem*> > byUse;
+    byUse.reserve(entries.size());
+    QHash<TreeItem*, Entry>::const_iterator it;
+    for (it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        if (!it.value().pinned && it.value().children > 0 && it.key() != keep) {
+            byUse.append(qMakePair(it.value().used, it.key()));
+        }
+    }
+    std::sort(byUse.begin(), byUse.end());
+    int left = total;
+    for (int i = 0; i < byUse.size() && left > limit; i++) {
+        evict.append(byUse[i].second);
+        left -= entries.value(byUse[i].second).children;
+    }
+    return evict;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "debug.h"
+#include <QHash>
+#include <QList>
+
+class TreeItem;
+
+/*
+ * NodeCache keeps count of the library nodes fetched from the database, per
+ * parent, and in which order the parents were last used. Over the cap, the
+ * least recently used parents that aren't expanded in the view are handed
+ * back to LibraryModel, which drops their children (to be fetched again if
+ * they're expanded again). Only artist nodes are then always in memory,
+ * however large the library.
+ *
+ * A cap of 0 keeps everything that has been fetched.
+ */
+class NodeCache {
+public:
+    NodeCache();
+
+    void setCap(int nodes);
+    int cap() const;
+    void clear();
+
+    // count more (or fewer) of parent's children in memory, and it's been used
+    void add(TreeItem *parent, int children);
+    // expanded parents are never evicted
+    void setPinned(TreeItem *parent, bool pinned);
+    // its children are gone, it may still be expanded
+    void release(TreeItem *parent);
+    // it's gone itself
+    void remove(TreeItem *parent);
+    bool contains(TreeItem *parent) const;
+
+    // nodes in memory
+    int size() const;
+    // parents whose children have to go, least recently used first, to get
+    // back under the cap; keep isn't one of them
+    QList<TreeItem*> overCap(TreeItem *keep) const;
+
+private:
+    struct Entry {
+        int children;
+        bool pinned;
+        quint64 used;
+    };
+
+    QHash<TreeItem*, Entry> entries;
+    int total;
+    int limit;
+    quint64 clock;
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include "jobScheduler.h"
+#include <QVector>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <algorithm>
+
+/*
+ * parallelStableSort() sorts a QVector like qStableSort, using the
+ * JobScheduler's INTERACTIVE workers for long vectors: runs of it are sorted
+ * at the same time, then merged pairwise, each level of merges at the same
+ * time too. The calling thread works along, so a busy scheduler only makes
+ * it slower. Short vectors are sorted in place, jobs aren't worth it.
+ */
+template <typename T, typename Less>
+class SortPass {
+public:
+    SortPass(T *items, int count, Less lessThan) : data(items), size(count), less(lessThan), width(0), tasks(0), runLength(0) {}
+
+    // width 0 sorts runs of `run` items, otherwise merges pairs of sorted runs of `width`
+    void start(int runWidth, int taskCount, int run) {
+        width = runWidth;
+        tasks = taskCount;
+        runLength = run;
+        next.storeRelease(0);
+    }
+
+    void work() {
+        for (;;) {
+            int task = next.fetchAndAddRelaxed(1);
+            if (task >= tasks) {
+                return;
+            }
+            if (width == 0) {
+                int from = task * runLength;
+                std::stable_sort(data + from, data + qMin(size, from + runLength), less);
+            } else {
+                int from = task * 2 * width;
+                int middle = qMin(size, from + width);
+                int to = qMin(size, from + 2 * width);
+                std::inplace_merge(data + from, data + middle, data + to, less);
+            }
+        }
+    }
+
+private:
+    T *data;
+    int size;
+    Less less;
+    int width;
+    int tasks;
+    int runLength;
+    QAtomicInt next;
+};
+
+template <typename T, typename Less>
+class SortPassJob : public QRunnable {
+public:
+    SortPassJob(SortPass<T, Less> *owner) : pass(owner) {}
+    void run() { pass->work(); }
+
+private:
+    SortPass<T, Less> *pass;
+};
+
+template <typename T, typename Less>
+void runSortPass(SortPass<T, Less> &pass, int tasks) {
+    JobScheduler *scheduler = JobScheduler::instance();
+    int helpers = qMin(tasks - 1, scheduler->maxRunning(JobScheduler::INTERACTIVE));
+    for (int i = 0; i < helpers; i++) {
+        scheduler->submit(new SortPassJob<T, Less>(&pass), JobScheduler::INTERACTIVE, &pass);
+    }
+    pass.work();
+    scheduler->cancel(&pass);
+    scheduler->waitForGroup(&pass);
+}
+
+template <typename T, typename Less>
+void parallelStableSort(QVector<T> &v, Less less) {
+    const int MIN_RUN = 16384;
+    JobScheduler *scheduler = JobScheduler::instance();
+    int runs = scheduler ? qMin(scheduler->maxRunning(JobScheduler::INTERACTIVE) + 1, v.size() / MIN_RUN) : 1;
+    if (runs < 2) {
+        std::stable_sort(v.begin(), v.end(), less);
+        return;
+    }
+    int size = v.size();
+    int run = (size + runs - 1) / runs;
+    SortPass<T, Less> pass(v.data(), size, less);
+    pass.start(0, runs, run);
+    runSortPass(pass, runs);
+    for (int width = run; width < size; width *= 2) {
+        int merges = (size + 2 * width - 1) / (2 * width);
+        pass.start(width, merges, run);
+        runSortPass(pass, merges);
+    }
+}
@@ -0,0 +1,257 @@
+#include "pathTrie.h"
+#include <QStringList>
+#include <QPair>
+
+const quint32 PathTrie::ROOT;
+
+PathTrie::PathTrie() {
+    Node root;
+    root.parent = ROOT;
+    root.refs = 0;
+    nodes.append(root);
+}
+
+PathTrie *PathTrie::instance() {
+    static PathTrie trie;
+    return &trie;
+}
+
+QString PathTrie::firstComponent(const QString &label) {
+    int slash = label.indexOf(QLatin1Char('/'));
+    return slash < 0 ? label : label.left(slash);
+}
+
+int PathTrie::childPosition(quint32 id, const QString &first, bool *found) const {
+    const QVector<quint32> &children = nodes[id].children;
+    int low = 0, high = children.size();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        const QString &label = nodes[children[middle]].label;
+        int slash = label.indexOf(QLatin1Char('/'));
+        int c = QStringRef::compare(label.leftRef(slash), first);
+        if (c == 0) {
+            *found = true;
+            return middle;
+        }
+        if (c < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    *found = false;
+    return low;
+}
+
+quint32 PathTrie::newNode(const QString &label, quint32 parent) {
+    Node n;
+    n.label = label;
+    n.parent = parent;
+    n.refs = 0;
+    if (!freeIds.isEmpty()) {
+        quint32 id = freeIds.takeLast();
+        nodes[id] = n;
+        return id;
+    }
+    nodes.append(n);
+    return nodes.size() - 1;
+}
+
+void PathTrie::attach(quint32 parent, quint32 id) {
+    bool found;
+    int row = childPosition(parent, firstComponent(nodes[id].label), &found);
+    emit(rowAboutToBeInserted(parent, row));
+    nodes[parent].children.insert(row, id);
+    nodes[id].parent = parent;
+    emit(rowInserted());
+}
+
+void PathTrie::detach(quint32 id) {
+    quint32 parent = nodes[id].parent;
+    int at = row(id);
+    emit(rowAboutToBeRemoved(parent, at));
+    nodes[parent].children.remove(at);
+    emit(rowRemoved());
+}
+
+quint32 PathTrie::insert(const QString &absFilePath) {
+    QStringList parts = absFilePath.split(QLatin1Char('/'));
+    quint32 at = ROOT;
+    int i = 0;
+    for (;;) {
+        bool found;
+        int pos = childPosition(at, parts[i], &found);
+        if (!found) {
+            quint32 leaf = newNode(QStringList(parts.mid(i)).join(QLatin1Char('/')), at);
+            attach(at, leaf);
+            nodes[leaf].refs++;
+            return leaf;
+        }
+        quint32 c = nodes[at].children[pos];
+        QStringList labelParts = nodes[c].label.split(QLatin1Char('/'));
+        int k = 1;
+        while (k < labelParts.size() && i + k < parts.size() && labelParts[k] == parts[i + k]) {
+            k++;
+        }
+        if (k < labelParts.size()) {
+            // the path leaves c's label part way: the common part becomes
+            // a node of its own, with c under it
+            detach(c);
+            quint32 common = newNode(QStringList(labelParts.mid(0, k)).join(QLatin1Char('/')), at);
+            nodes[c].label = QStringList(labelParts.mid(k)).join(QLatin1Char('/'));
+            nodes[c].parent = common;
+            nodes[common].children.append(c);
+            attach(at, common);
+            c = common;
+        }
+        i += k;
+        at = c;
+        if (i == parts.size()) {
+            nodes[at].refs++;
+            return at;
+        }
+    }
+}
+
+void PathTrie::retain(quint32 id) {
+    if (id != ROOT) {
+        nodes[id].refs++;
+    }
+}
+
+void PathTrie::release(quint32 id) {
+    if (id == ROOT) {
+        return;
+    }
+    nodes[id].refs--;
+    compact(id);
+}
+
+void PathTrie::compact(quint32 id) {
+    while (id != ROOT && nodes[id].refs == 0 && nodes[id].children.size() <= 1) {
+        quint32 up = nodes[id].parent;
+        detach(id);
+        if (nodes[id].children.size() == 1) {
+            // its only child takes its place, with the same first component
+            quint32 only = nodes[id].children[0];
+            nodes[only].label = nodes[id].label + QLatin1Char('/') + nodes[only].label;
+            attach(up, only);
+            up = ROOT;
+        }
+        nodes[id].label.clear();
+        nodes[id].children = QVector<quint32>();
+        freeIds.append(id);
+        id = up;
+    }
+}
+
+quint32 PathTrie::find(const QString &absFilePath) const {
+    QStringList parts = absFilePath.split(QLatin1Char('/'));
+    quint32 at = ROOT;
+    int i = 0;
+    while (i < parts.size()) {
+        bool found;
+        int pos = childPosition(at, parts[i], &found);
+        if (!found) {
+            return ROOT;
+        }
+        quint32 c = nodes[at].children[pos];
+        QStringList labelParts = nodes[c].label.split(QLatin1Char('/'));
+        if (i + labelParts.size() > parts.size()) {
+            return ROOT;
+        }
+        for (int k = 1; k < labelParts.size(); k++) {
+            if (labelParts[k] != parts[i + k]) {
+                return ROOT;
+            }
+        }
+        i += labelParts.size();
+        at = c;
+    }
+    return at;
+}
+
+QString PathTrie::path(quint32 id) const {
+    QStringList labels;
+    while (id != ROOT) {
+        labels.prepend(nodes[id].label);
+        id = nodes[id].parent;
+    }
+    return labels.join(QLatin1Char('/'));
+}
+
+QString PathTrie::label(quint32 id) const {
+    return nodes[id].label;
+}
+
+quint32 PathTrie::parent(quint32 id) const {
+    return nodes[id].parent;
+}
+
+int PathTrie::childCount(quint32 id) const {
+    return nodes[id].children.size();
+}
+
+quint32 PathTrie::child(quint32 id, int row) const {
+    return nodes[id].children.value(row, ROOT);
+}
+
+int PathTrie::row(quint32 id) const {
+    bool found;
+    return childPosition(nodes[id].parent, firstComponent(nodes[id].label), &found);
+}
+
+bool PathTrie::isFile(quint32 id) const {
+    return nodes[id].refs > 0;
+}
+
+QStringList PathTrie::filesUnder(quint32 id) const {
+    QStringList files;
+    QVector<QPair<quint32, QString> > stack;
+    stack.append(qMakePair(id, path(id)));
+    while (!stack.isEmpty()) {
+        QPair<quint32, QString> top = stack.takeLast();
+        const Node &n = nodes[top.first];
+        if (n.refs > 0) {
+            files.append(top.second);
+        }
+        // in reverse, so they come out in order
+        for (int c = n.children.size() - 1; c >= 0; c--) {
+            const QString &label = nodes[n.children[c]].label;
+            stack.append(qMakePair(n.children[c], top.first == ROOT ? label : top.second + QLatin1Char('/') + label));
+        }
+    }
+    return files;
+}
+
+PathTrie::Stats PathTrie::stats() const {
+    // a QString is its pointer where it's kept, plus a header and the
+    // characters on the heap
+    const qint64 stringHeap = sizeof(QString::Data) + sizeof(QChar);
+    Stats stats;
+    stats.paths = 0;
+    stats.nodes = nodes.size() - freeIds.size();
+    stats.bytes = nodes.capacity() * sizeof(Node) + freeIds.capacity() * sizeof(quint32);
+    stats.flatBytes = 0;
+    // (node, length of its path)
+    QVector<QPair<quint32, int> > stack;
+    stack.append(qMakePair(ROOT, -1));
+    while (!stack.isEmpty()) {
+        QPair<quint32, int> top = stack.takeLast();
+        const Node &n = nodes[top.first];
+        if (top.first != ROOT) {
+            stats.bytes += stringHeap + n.label.capacity() * sizeof(QChar);
+        }
+        if (!n.children.isEmpty()) {
+            stats.bytes += sizeof(QArrayData) + n.children.capacity() * sizeof(quint32);
+        }
+        if (n.refs > 0) {
+            stats.paths++;
+            stats.flatBytes += sizeof(QString) + stringHeap + top.second * sizeof(QChar);
+        }
+        foreach (quint32 c, n.children) {
+            stack.append(qMakePair(c, top.second + 1 + nodes[c].label.size()));
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "debug.h"
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+/*
+ * PathTrie holds the library's file paths once, as a trie of their
+ * directories. A chain of directories that each have a single child is
+ * one node ("/home/me/Music"), so the songs of a deep layout share
+ * everything but their file names. Tracks are known by the id of their
+ * node, which stays the same until the last reference to it is released.
+ * The nodes are split and merged around it as paths come and go.
+ *
+ * The LibraryIndex and the library tree's song nodes keep ids rather than
+ * path strings. The folder view shows the trie itself, following the
+ * signals: every change is a child row taken out of or put into a node.
+ *
+ * Children are kept sorted by their first path component. There's one per
+ * application, for the GUI thread.
+ */
+class PathTrie : public QObject {
+    Q_OBJECT
+
+public:
+    // the root, which is no path
+    static const quint32 ROOT = 0;
+
+    struct Stats {
+        int paths;          // referenced ones
+        int nodes;
+        qint64 bytes;       // the trie's memory
+        qint64 flatBytes;   // the same paths as a QString each
+    };
+
+    static PathTrie *instance();
+
+    // adds a reference to absFilePath, making it if needed
+    quint32 insert(const QString &absFilePath);
+    void retain(quint32 id);
+    void release(quint32 id);
+    // ROOT if it isn't in the trie
+    quint32 find(const QString &absFilePath) const;
+    QString path(quint32 id) const;
+
+    // for the folder view: a node's part of the path, with its
+    // subdirectories' separators, and its children
+    QString label(quint32 id) const;
+    quint32 parent(quint32 id) const;
+    int childCount(quint32 id) const;
+    quint32 child(quint32 id, int row) const;
+    int row(quint32 id) const;
+    // referenced as a path itself, not only as a directory
+    bool isFile(quint32 id) const;
+    // the files at or under it
+    QStringList filesUnder(quint32 id) const;
+
+    Stats stats() const;
+
+signals:
+    // around each change to parent's children
+    void rowAboutToBeInserted(quint32 parent, int row);
+    void rowInserted();
+    void rowAboutToBeRemoved(quint32 parent, int row);
+    void rowRemoved();
+
+private:
+    PathTrie();
+
+    struct Node {
+        QString label;
+        quint32 parent;
+        int refs;
+        QVector<quint32> children;  // by first component
+    };
+
+    static QString firstComponent(const QString &label);
+    // where a child with that first component is, or goes, among id's children
+    int childPosition(quint32 id, const QString &first, bool *found) const;
+    quint32 newNode(const QString &label, quint32 parent);
+    void attach(quint32 parent, quint32 id);
+    void detach(quint32 id);
+    // drops id, or merges it with its only child, if nothing needs it
+    void compact(quint32 id);
+
+    QVector<Node> nodes;
+    QVector<quint32> freeIds;
+};
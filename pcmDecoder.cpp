@@ -0,0 +1,139 @@
+#include "pcmDecoder.h"
+#include "sampleKernels.h"
+#include <QAudioDecoder>
+#include <QAudioBuffer>
+#include <QEventLoop>
+#include <QDebug>
+#include <string.h>
+
+PcmDecoder::PcmDecoder(QObject *parent) : QObject(parent) {
+    // no output format requested, the backend's native one is converted here
+    decoder = new QAudioDecoder(this);
+    loop = new QEventLoop(this);
+    connect(decoder, SIGNAL(bufferReady()), this, SLOT(bufferReady()));
+    connect(decoder, SIGNAL(finished()), this, SLOT(decodeFinished()));
+    connect(decoder, SIGNAL(error(QAudioDecoder::Error)), this, SLOT(decodeError()));
+    sink = 0;
+    maxFrames = -1;
+    frames = 0;
+    rate = 0;
+    failed = false;
+    done = false;
+}
+
+PcmDecoder::~PcmDecoder() {
+    decoder->stop();
+}
+
+bool PcmDecoder::decode(const QString &absFilePath, PcmSink *pcmSink, qint64 maxMs) {
+    sink = pcmSink;
+    frames = 0;
+    rate = 0;
+    failed = false;
+    done = false;
+    errorMsg.clear();
+
+    // maxMs is turned into a frame limit once the first buffer tells us the rate
+    maxFrames = maxMs;
+    decoder->setSourceFilename(absFilePath);
+    decoder->start();
+    // the backend may already have failed (or finished) inside start()
+    if (!done) {
+        loop->exec();
+    }
+    decoder->stop();
+    sink = 0;
+#if DEBUG_ANALYSIS
+    qDebug() << "PcmDecoder:" << absFilePath << "frames=" << frames << "rate=" << rate
+             << (failed ? errorMsg : QString());
+#endif
+    return !failed && frames > 0;
+}
+
+QString PcmDecoder::errorString() const {
+    return errorMsg;
+}
+
+qint64 PcmDecoder::decodedFrames() const {
+    return frames;
+}
+
+int PcmDecoder::sampleRate() const {
+    return rate;
+}
+
+void PcmDecoder::bufferReady() {
+    QAudioBuffer buffer = decoder->read();
+    if (!buffer.isValid() || !sink || done) {
+        return;
+    }
+    QAudioFormat format = buffer.format();
+    if (rate == 0) {
+        rate = format.sampleRate();
+        if (maxFrames >= 0) {
+            maxFrames = maxFrames * rate / 1000;
+        }
+    }
+    if (format.byteOrder() != QAudioFormat::LittleEndian && format.sampleSize() > 8) {
+        errorMsg = "big endian samples are not supported";
+        failed = true;
+        finish();
+        return;
+    }
+    int channels = format.channelCount();
+    int count = buffer.frameCount();
+    if (maxFrames >= 0 && frames + count > maxFrames) {
+        count = (int)(maxFrames - frames);
+    }
+    if (!convert(buffer.constData(), count*channels, format.sampleSize(), format.sampleType())) {
+        failed = true;
+        finish();
+        return;
+    }
+    frames += count;
+    if (!sink->consume(scratch.constData(), count, channels, rate) ||
+        (maxFrames >= 0 && frames >= maxFrames)) {
+        finish();
+    }
+}
+
+bool PcmDecoder::convert(const void *data, int samples, int sampleSize, int sampleType) {
+    if (scratch.size() < samples) {
+        scratch.resize(samples);
+    }
+    const SampleKernels &k = sampleKernels();
+    float *out = scratch.data();
+    if (sampleType == QAudioFormat::SignedInt && sampleSize == 16) {
+        k.s16ToFloat((const qint16 *)data, out, samples);
+    } else if (sampleType == QAudioFormat::SignedInt && sampleSize == 24) {
+        k.s24ToFloat((const uchar *)data, out, samples);
+    } else if (sampleType == QAudioFormat::SignedInt && sampleSize == 32) {
+        k.s32ToFloat((const qint32 *)data, out, samples);
+    } else if (sampleType == QAudioFormat::Float && sampleSize == 32) {
+        memcpy(out, data, samples*sizeof(float));
+    } else if (sampleType == QAudioFormat::UnSignedInt && sampleSize == 8) {
+        const uchar *in = (const uchar *)data;
+        for (int i = 0; i < samples; i++) {
+            out[i] = ((int)in[i] - 128) * (1.0f/128.0f);
+        }
+    } else {
+        errorMsg = QString("unsupported sample format: %1 bit, type %2").arg(sampleSize).arg(sampleType);
+        return false;
+    }
+    return true;
+}
+
+void PcmDecoder::decodeFinished() {
+    finish();
+}
+
+void PcmDecoder::decodeError() {
+    errorMsg = decoder->errorString();
+    failed = true;
+    finish();
+}
+
+void PcmDecoder::finish() {
+    done = true;
+    loop->quit();
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "debug.h"
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+class QAudioDecoder;
+class QEventLoop;
+
+/*
+ * PcmSink receives the decoded audio of a PcmDecoder run as interleaved
+ * floats in [-1, 1). Returning false from consume() stops the decode early.
+ */
+class PcmSink {
+public:
+    virtual ~PcmSink() {}
+    virtual bool consume(const float *samples, int frames, int channels, int sampleRate) = 0;
+};
+
+/*
+ * PcmDecoder decodes a file synchronously on the calling thread, for the
+ * analysis jobs that run on QThreadPool workers. The QAudioDecoder is driven
+ * by a local event loop and every buffer is converted to float with the
+ * sample kernels before it is handed to the sink.
+ */
+class PcmDecoder : public QObject {
+    Q_OBJECT
+
+public:
+    PcmDecoder(QObject *parent = 0);
+    ~PcmDecoder();
+
+    // returns false if the file couldn't be decoded, see errorString()
+    bool decode(const QString &absFilePath, PcmSink *sink, qint64 maxMs = -1);
+
+    QString errorString() const;
+    qint64 decodedFrames() const;
+    int sampleRate() const;
+
+private slots:
+    void bufferReady();
+    void decodeFinished();
+    void decodeError();
+
+private:
+    bool convert(const void *data, int samples, int sampleSize, int sampleType);
+    void finish();
+
+    QAudioDecoder *decoder;
+    QEventLoop *loop;
+    PcmSink *sink;
+    QVector<float> scratch;
+    qint64 maxFrames;
+    qint64 frames;
+    int rate;
+    bool failed;
+    bool done;
+    QString errorMsg;
+};
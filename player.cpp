@@ -1,19 +1,35 @@
 #include "player.h"
+#include "jobScheduler.h"
 
 #include <QMediaService>
 #include <QMediaPlaylist>
 #include <QAudioProbe>
+#include <QAudioOutput>
+#include <QBuffer>
 #include <QMediaMetaData>
 #include <QtWidgets>
 #include <QHeaderView>
+#include <qmath.h>
 
-Player::Player(QWidget *parent) :QWidget(parent), coverLabel(0), slider(0) {
+Player::Player(QWidget *parent) :QWidget(parent), coverLabel(0), slider(0),
+    headOutput(0), headBuffer(0), playingHead(false), headPaused(false) {
     player = new QMediaPlayer(this);
+    engine = new AudioEngine(this);
+    usePipeline = false;
+    haveQueuedMedia = false;
+    replayGainMode = GAIN_OFF;
+    userVolume = player->volume();
     duration = 0;
 
     //-----------playlist model-view setup------------
     playlistModel = new PlaylistModel(this);
 
+    // read ahead the neighbouring tracks whenever the current one changes
+    trackPrefetcher = new TrackPrefetcher(playlistModel, this);
+
+    // keep decoded heads of the likely skip targets so skips start instantly
+    trackHeadCache = new TrackHeadCache(playlistModel, this);
+
     // need to configure the correct column playlist view
     playlistView = new PlaylistTable(this);
     playlistView->setModel(playlistModel);
@@ -22,6 +38,8 @@ Player::Player(QWidget *parent) :QWidget(parent), coverLabel(0), slider(0) {
     for (int c=1; c < playlistModel->getColumns(); c++) {
         playlistView->horizontalHeader()->setSectionResizeMode(c, QHeaderView::Stretch);
     }
+    playlistView->horizontalHeader()->setSectionResizeMode(PlaylistModel::BPM_COLUMN, QHeaderView::ResizeToContents);
+    playlistView->horizontalHeader()->setSectionResizeMode(PlaylistModel::KEY_COLUMN, QHeaderView::ResizeToContents);
 
     // connect playlist signals to the player slots.
     connect(playlistView, SIGNAL(activated(QModelIndex)), this, SLOT(jump(QModelIndex)));
@@ -30,6 +48,12 @@ Player::Player(QWidget *parent) :QWidget(parent), coverLabel(0), slider(0) {
     connect(playlistModel, SIGNAL(mediaAvailable()), SLOT(mediaAvailable()));
     connect(playlistModel, SIGNAL(changePlaylistLabel(QString)), this, SLOT(changePlaylistLabel(QString)));
 
+    // fuzzy find over the whole playlist
+    quickFind = new QuickFindDialog(playlistModel, this);
+    QShortcut *findShortcut = new QShortcut(QKeySequence::Find, this);
+    connect(findShortcut, SIGNAL(activated()), this, SLOT(openQuickFind()));
+    connect(quickFind, SIGNAL(rowChosen(int)), this, SLOT(quickFindChosen(int)));
+
     // buttons for playback mode, and playlist actions
     curPlaylistLabel = new QLabel(this);
     curPlaylistLabel->setText("Queue");
@@ -69,7 +93,18 @@ Player::Player(QWidget *parent) :QWidget(parent), coverLabel(0), slider(0) {
     connect(clearListButton, SIGNAL(clicked()), this, SLOT(clearPlaylist()));
 
     //------------Playback UI setup------------
-    slider = new QSlider(Qt::Horizontal, this);
+    // level meter and spectrum, fed by a probe on QMediaPlayer or the pipeline's tap
+    spectrum = new SpectrumAnalyzer(this);
+    probe = new QAudioProbe(this);
+    probe->setSource(player);
+    spectrum->listen(probe);
+    engine->setAnalysisTap(spectrum->tap());
+    spectrumView = new SpectrumWidget(spectrum, this);
+
+    // seek bar with the track's waveform overview behind it
+    waveforms = new WaveformCache(this);
+    connect(waveforms, SIGNAL(ready(QString)), this, SLOT(waveformReady(QString)));
+    slider = new WaveformSlider(this);
     slider->setRange(0, player->duration()/1000);
 
     labelDuration = new QLabel(this);
@@ -84,18 +119,36 @@ Player::Player(QWidget *parent) :QWidget(parent), coverLabel(0), slider(0) {
     controls->setMuted(controls->isMuted());
 
     connect(controls, SIGNAL(play()), this, SLOT(play()));
-    connect(controls, SIGNAL(pause()), player, SLOT(pause()));
+    connect(controls, SIGNAL(pause()), this, SLOT(pause()));
     connect(controls, SIGNAL(stop()), this, SLOT(stop()));
     connect(controls, SIGNAL(next()), this, SLOT(next()));
     connect(controls, SIGNAL(previous()), this, SLOT(previousClicked()));
-    connect(controls, SIGNAL(changeVolume(int)), player, SLOT(setVolume(int)));
-    connect(player, SIGNAL(volumeChanged(int)), controls, SLOT(setVolume(int)));
+    // the player's own volume includes ReplayGain, so it isn't fed back to the slider
+    connect(controls, SIGNAL(changeVolume(int)), this, SLOT(setVolume(int)));
     connect(controls, SIGNAL(changeMuting(bool)), player, SLOT(setMuted(bool)));
     connect(player, SIGNAL(mutedChanged(bool)), controls, SLOT(setMuted(bool)));
     connect(controls, SIGNAL(changeRate(qreal)), player, SLOT(setPlaybackRate(qreal)));
     connect(player, SIGNAL(stateChanged(QMediaPlayer::State)),
             controls, SLOT(setState(QMediaPlayer::State)));
 
+    // the decode pipeline follows the same controls
+    connect(controls, SIGNAL(changeVolume(int)), engine, SLOT(setVolume(int)));
+    connect(controls, SIGNAL(changeMuting(bool)), engine, SLOT(setMuted(bool)));
+    connect(engine, SIGNAL(stateChanged(QMediaPlayer::State)),
+            controls, SLOT(setState(QMediaPlayer::State)));
+
+    // background jobs back off while either of them is playing
+    connect(player, SIGNAL(stateChanged(QMediaPlayer::State)),
+            JobScheduler::instance(), SLOT(playbackStateChanged(QMediaPlayer::State)));
+    connect(engine, SIGNAL(stateChanged(QMediaPlayer::State)),
+            JobScheduler::instance(), SLOT(playbackStateChanged(QMediaPlayer::State)));
+    connect(engine, SIGNAL(durationChanged(qint64)), SLOT(durationChanged(qint64)));
+    connect(engine, SIGNAL(positionChanged(qint64)), SLOT(positionChanged(qint64)));
+    connect(engine, SIGNAL(endOfMedia()), this, SLOT(pipelineEndOfMedia()));
+    connect(engine, SIGNAL(error(QString)), this, SLOT(pipelineError(QString)));
+    connect(engine, SIGNAL(aboutToFinish()), this, SLOT(crossfadeToNext()));
+    connect(engine, SIGNAL(currentMediaChanged(QString)), this, SLOT(crossfadeFinished(QString)));
+
     //--------------player media signals connection--------
     connect(player, SIGNAL(durationChanged(qint64)), SLOT(durationChanged(qint64)));
     connect(player, SIGNAL(positionChanged(qint64)), SLOT(positionChanged(qint64)));
@@ -133,6 +186,7 @@ Player::Player(QWidget *parent) :QWidget(parent), coverLabel(0), slider(0) {
     QBoxLayout *layout = new QVBoxLayout;
     layout->addLayout(playlistControlLayout);
     layout->addLayout(displayLayout);
+    layout->addWidget(spectrumView);
 
     QHBoxLayout *hLayout = new QHBoxLayout;
     hLayout->addWidget(slider);
@@ -155,6 +209,11 @@ Player::Player(QWidget *parent) :QWidget(parent), coverLabel(0), slider(0) {
 }
 
 Player::~Player() {
+    stopHead();
+    delete engine;
+    delete trackHeadCache;
+    delete trackPrefetcher;
+    delete quickFind;
     delete playlistView;
     delete playlistModel;
     delete labelDuration;
@@ -167,6 +226,54 @@ PlaylistModel *Player::model() {
     return playlistModel;
 }
 
+PlaylistTable *Player::view() {
+    return playlistView;
+}
+
+TrackPrefetcher *Player::prefetcher() {
+    return trackPrefetcher;
+}
+
+TrackHeadCache *Player::headCache() {
+    return trackHeadCache;
+}
+
+WaveformCache *Player::waveformCache() {
+    return waveforms;
+}
+
+SpectrumAnalyzer *Player::spectrumAnalyzer() {
+    return spectrum;
+}
+
+AudioEngine *Player::pipeline() {
+    return engine;
+}
+
+bool Player::isPipelineEnabled() const {
+    return usePipeline;
+}
+
+void Player::setPipelineEnabled(bool enabled) {
+    if (enabled == usePipeline) {
+        return;
+    }
+    if (enabled && !engine->isAvailable()) {
+        setStatusInfo(tr("Audio device doesn't support the decode pipeline format"));
+        return;
+    }
+    // hand the current track over to the other engine, stopped
+    stop();
+    player->setMedia(QMediaContent());
+    engine->setMedia(QString());
+    usePipeline = enabled;
+    setMedia(playlistModel->currentMedia());
+}
+
+void Player::setCrossfade(int ms, bool equalPower) {
+    engine->setCrossfade(ms, equalPower ? RingBufferDevice::EQUAL_POWER : RingBufferDevice::LINEAR);
+}
+
 
 //--------------------Slots---------------------
 void Player::open() {
@@ -188,7 +295,7 @@ void Player::durationChanged(qint64 duration) {
 }
 
 void Player::positionChanged(qint64 progress) {
-    if (!player->currentMedia().isNull()) {
+    if (hasMedia()) {
         if (!slider->isSliderDown()) {
             slider->setValue(progress/1000);
         }
@@ -201,25 +308,34 @@ void Player::previousClicked() {
     // Go to previous track if we are within the first 5 seconds of playback
     // otherwise, seek to the beginning
 
-    if (player->position() <= 5000) {
-        player->setMedia(playlistModel->previousMedia());
-        player->play();
+    if (playbackPosition() <= 5000) {
+        playMedia(playlistModel->previousMedia());
     }
     else {
-        player->setPosition(0);
+        setPlaybackPosition(0);
     }
 }
 
 void Player::jump(const QModelIndex &index) {
     if (index.isValid()) {
-        player->setMedia(playlistModel->setCurMedia(index.row()));
-        player->play();
+        playMedia(playlistModel->setCurMedia(index.row()));
     }
 }
 
+void Player::openQuickFind() {
+    quickFind->show();
+    quickFind->raise();
+    quickFind->activateWindow();
+}
+
+void Player::quickFindChosen(int row) {
+    QModelIndex index = playlistModel->index(row, 0);
+    playlistView->scrollTo(index, QAbstractItemView::PositionAtCenter);
+    jump(index);
+}
+
 void Player::next() {
-    player->setMedia(playlistModel->pressNextMedia());
-    player->play();
+    playMedia(playlistModel->pressNextMedia());
 }
 
 void Player::playlistPositionChanged(int currentItem) {
@@ -231,33 +347,36 @@ void Player::curMediaRemoved(int newCurMediaIdx) {
     stop();
     if (newCurMediaIdx >= 0) {
         playlistView->setCurrentIndex(playlistModel->index(newCurMediaIdx,0));
-        player->setMedia(playlistModel->currentMedia());
+        setMedia(playlistModel->currentMedia());
     }
     else {
         //qDebug() << "Player: curMediaRemoved, set media to none!";
         playlistView->setCurrentIndex(QModelIndex());
-        player->setMedia(QMediaContent());
+        setMedia(QMediaContent());
         emit(changeTitle("AAMusicPlayer"));
     }
 }
 
 void Player::mediaAvailable() {
     //qDebug() << "Player: mediaAvailable";
-    player->setMedia(playlistModel->currentMedia());
+    setMedia(playlistModel->currentMedia());
 }
 
 void Player::clearPlaylist() {
     //qDebug() << "Player: clearPlaylist";
     stop();
     playlistView->setCurrentIndex(QModelIndex());
-    player->setMedia(QMediaContent());
+    setMedia(QMediaContent());
     playlistModel->clear();
     changePlaylistLabel(QString());
     setTrackInfo(QString());
 }
 
 void Player::stop() {
+    stopHead();
+    haveQueuedMedia = false;
     player->stop();
+    engine->stop();
     slider->setValue(0);
     //qDebug() << "Clearing labelDuration in stop()";
     labelDuration->clear();
@@ -265,15 +384,35 @@ void Player::stop() {
 }
 
 void Player::play() {
+    if (playingHead && headPaused) {
+        // paused before the hand-over, QMediaPlayer takes over when it's loaded
+        headPaused = false;
+        headOutput->resume();
+        return;
+    }
     // highlight the correct media, then play
-    if (player->isAudioAvailable()) {
+    if (usePipeline ? hasMedia() : player->isAudioAvailable()) {
         playlistView->setCurrentIndex(playlistModel->getCurMediaModelIndex());
-        player->play();
+        startPlayback();
+    }
+}
+
+void Player::pause() {
+    if (playingHead) {
+        // the hand-over keeps it paused
+        headPaused = true;
+        headOutput->suspend();
+    }
+    if (usePipeline) {
+        engine->pause();
+    }
+    else {
+        player->pause();
     }
 }
 
 void Player::seek(int seconds) {
-    player->setPosition(seconds * 1000);
+    setPlaybackPosition(seconds * 1000);
 }
 
 void Player::setRepeatOne(bool checked) {
@@ -291,6 +430,15 @@ void Player::setShuffle(bool checked) {
 void Player::statusChanged(QMediaPlayer::MediaStatus status) {
     handleCursor(status);
 
+    if (playingHead) {
+        if (status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::BufferedMedia) {
+            handOffFromHead();
+        }
+        else if (status == QMediaPlayer::InvalidMedia) {
+            stopHead();
+        }
+    }
+
     switch(status) {
         case QMediaPlayer::UnknownMediaStatus:
         case QMediaPlayer::NoMedia:
@@ -307,13 +455,7 @@ void Player::statusChanged(QMediaPlayer::MediaStatus status) {
             setStatusInfo(tr("Media Stalled"));
             break;
         case QMediaPlayer::EndOfMedia:
-            player->setMedia(playlistModel->nextMedia());
-            if (!playlistModel->keepPlaying()) {
-                stop();
-            }
-            else {
-                player->play();
-            }
+            advanceAfterEndOfMedia();
             break;
         case QMediaPlayer::InvalidMedia:
             displayErrorMessage();
@@ -344,7 +486,7 @@ void Player::audioAvailableChanged(bool available)
 }
 
 void Player::metaDataChanged() {
-    if (player->isMetaDataAvailable()) {
+    if (usePipeline || player->isMetaDataAvailable()) {
         QString title = playlistModel->getCurTitle();
         QString albumArtist = playlistModel->getCurAlbumArtist();
         //qDebug() << "metaDataChanged loop: title=" << title << ", albumArtist=" << albumArtist;
@@ -383,6 +525,52 @@ void Player::displayErrorMessage()
     setStatusInfo(player->errorString());
 }
 
+void Player::pipelineEndOfMedia() {
+    advanceAfterEndOfMedia();
+}
+
+void Player::pipelineError(QString msg) {
+    setStatusInfo(msg);
+}
+
+void Player::crossfadeToNext() {
+    // only look at the entry the playlist will move to; it moves when the
+    // engine has switched over (crossfadeFinished()), so a stop or a seek
+    // back before then leaves it on the track still playing
+    int next = playlistModel->peekEndOfMediaIdx();
+    // at the end of the playlist in normal mode, let the track just end
+    if (next < 0) {
+        haveQueuedMedia = false;
+        return;
+    }
+    haveQueuedMedia = true;
+    // followed through sorts and edits until the switch
+    queuedEntry = QPersistentModelIndex(playlistModel->index(next, 0));
+    qreal gainDb = (replayGainMode == GAIN_OFF) ? 0 : playlistModel->getGain(next, replayGainMode == GAIN_ALBUM);
+    engine->crossfadeTo(playlistModel->getAbsFilePath(next), gainDb);
+}
+
+void Player::crossfadeFinished(QString absFilePath) {
+    if (haveQueuedMedia) {
+        // the entry picked in crossfadeToNext(), wherever the playlist's
+        // changes since have put it; by its file if it was taken out
+        int row = -1;
+        if (queuedEntry.isValid() && playlistModel->getAbsFilePath(queuedEntry.row()) == absFilePath) {
+            row = queuedEntry.row();
+        }
+        for (int r = 0; row < 0 && r < playlistModel->rowCount(); r++) {
+            if (playlistModel->getAbsFilePath(r) == absFilePath) {
+                row = r;
+            }
+        }
+        playlistModel->advanceTo(row);
+    }
+    haveQueuedMedia = false;
+    queuedEntry = QPersistentModelIndex();
+    metaDataChanged();
+    showWaveform(engine->media());
+}
+
 void Player::savePlaylist() {
     if (playlistModel->rowCount(QModelIndex()) == 0) {
        // nothing to save
@@ -408,6 +596,178 @@ void Player::changePlaylistLabel(QString absFilePath) {
     stop();
 }
 
+void Player::playMedia(const QMediaContent &media) {
+    haveQueuedMedia = false;
+    // start the cached head first, in case setMedia() loads synchronously
+    // the pipeline starts quickly on its own, the head cache is for QMediaPlayer
+    bool fromHead = !usePipeline && startFromHead(media);
+    setMedia(media);
+    if (!fromHead) {
+        startPlayback();
+    }
+}
+
+void Player::setMedia(const QMediaContent &media) {
+    if (usePipeline) {
+        engine->setMedia(media.canonicalUrl().toLocalFile());
+        // no QMediaPlayer metadata signal in this mode
+        metaDataChanged();
+    }
+    else {
+        player->setMedia(media);
+    }
+    applyReplayGain();
+    showWaveform(media.canonicalUrl().toLocalFile());
+}
+
+void Player::showWaveform(const QString &absFilePath) {
+    waveformPath = absFilePath;
+    Waveform waveform;
+    if (!absFilePath.isEmpty() && waveforms->request(absFilePath, waveform)) {
+        slider->setWaveform(waveform);
+    }
+    else {
+        // waveformReady() fills it in once it has been generated
+        slider->clearWaveform();
+    }
+}
+
+void Player::waveformReady(QString absFilePath) {
+    if (absFilePath == waveformPath) {
+        showWaveform(absFilePath);
+    }
+}
+
+void Player::setReplayGainMode(int mode) {
+    replayGainMode = mode;
+    applyReplayGain();
+}
+
+void Player::setVolume(int volume) {
+    userVolume = volume;
+    applyReplayGain();
+}
+
+qreal Player::currentGainDb() const {
+    // the playlist's current entry is the track being played (or faded in)
+    if (replayGainMode == GAIN_OFF) {
+        return 0;
+    }
+    return playlistModel->getGain(playlistModel->getCurMediaIdx(), replayGainMode == GAIN_ALBUM);
+}
+
+void Player::applyReplayGain() {
+    qreal gainDb = currentGainDb();
+    // QMediaPlayer's volume tops out at 100, so it can only attenuate
+    qreal factor = qMin((qreal)1.0, qPow(10.0, gainDb/20.0));
+    player->setVolume(qRound(userVolume*factor));
+    // during a crossfade the incoming track's gain went with crossfadeTo()
+    if (!haveQueuedMedia) {
+        engine->setReplayGain(gainDb);
+    }
+}
+
+bool Player::hasMedia() const {
+    return usePipeline ? !engine->media().isEmpty() : !player->currentMedia().isNull();
+}
+
+void Player::startPlayback() {
+    if (usePipeline) {
+        engine->play();
+    }
+    else {
+        player->play();
+    }
+}
+
+qint64 Player::playbackPosition() const {
+    return usePipeline ? engine->position() : player->position();
+}
+
+void Player::setPlaybackPosition(qint64 ms) {
+    if (usePipeline) {
+        // the engine drops the incoming track, and asks again if it gets
+        // near the end
+        haveQueuedMedia = false;
+        engine->setPosition(ms);
+    }
+    else {
+        player->setPosition(ms);
+    }
+}
+
+void Player::advanceAfterEndOfMedia() {
+    // a crossfade armed but not switched to hasn't moved the playlist
+    QMediaContent next = playlistModel->nextMedia();
+    haveQueuedMedia = false;
+    setMedia(next);
+    if (!playlistModel->keepPlaying()) {
+        stop();
+    }
+    else {
+        startPlayback();
+    }
+}
+
+bool Player::startFromHead(const QMediaContent &media) {
+    stopHead();
+    if (media.isNull()) {
+        return false;
+    }
+    QAudioFormat format;
+    QByteArray pcm;
+    if (!trackHeadCache->lookup(media.canonicalUrl().toLocalFile(), format, pcm)) {
+        return false;
+    }
+
+    if (headOutput && headOutput->format() != format) {
+        delete headOutput;
+        headOutput = 0;
+    }
+    if (!headOutput) {
+        headOutput = new QAudioOutput(format, this);
+    }
+    headOutput->setVolume(player->isMuted() ? 0 : player->volume()/100.0);
+
+    headBuffer = new QBuffer(this);
+    headBuffer->setData(pcm);
+    headBuffer->open(QIODevice::ReadOnly);
+    headOutput->start(headBuffer);
+    playingHead = (headOutput->error() == QAudio::NoError);
+    if (!playingHead) {
+        stopHead();
+    }
+    return playingHead;
+}
+
+void Player::handOffFromHead() {
+    // continue in QMediaPlayer from where the head got to, playing only
+    // if it wasn't paused meanwhile (stop() ends the head, no hand-over)
+    qint64 elapsedMs = headOutput->processedUSecs()/1000;
+    bool resume = !headPaused;
+    stopHead();
+    player->setPosition(elapsedMs);
+    if (resume) {
+        player->play();
+    }
+    else {
+        player->pause();
+    }
+}
+
+void Player::stopHead() {
+    playingHead = false;
+    headPaused = false;
+    if (headOutput) {
+        headOutput->stop();
+    }
+    if (headBuffer) {
+        headBuffer->close();
+        headBuffer->deleteLater();
+        headBuffer = 0;
+    }
+}
+
 void Player::updateDurationInfo(qint64 currentInfo)
 {
     QString tStr;
@@ -4,6 +4,14 @@
 #include "playlistmodel.h"
 #include "playercontrols.h"
 #include "playlistTable.h"
+#include "trackPrefetcher.h"
+#include "trackHeadCache.h"
+#include "audioEngine.h"
+#include "waveformCache.h"
+#include "waveformSlider.h"
+#include "spectrumAnalyzer.h"
+#include "spectrumWidget.h"
+#include "quickFindDialog.h"
 
 #include <QWidget>
 #include <QMediaPlayer>
@@ -20,16 +28,46 @@ class QAudioProbe;
 class PlaylistModel;
 class PlaylistTable;
 class PlaylistProxyModel;
+class TrackPrefetcher;
+class TrackHeadCache;
+class QAudioOutput;
+class QBuffer;
+class AudioEngine;
+class WaveformCache;
+class WaveformSlider;
+class SpectrumAnalyzer;
+class SpectrumWidget;
+class QuickFindDialog;
 
 class Player : public QWidget {
     Q_OBJECT
 
 public:
+    // ReplayGain modes
+    const static int GAIN_OFF = 0;
+    const static int GAIN_TRACK = 1;
+    const static int GAIN_ALBUM = 2;
+
     Player(QWidget *parent=0);
     ~Player();
 
     // getters
     PlaylistModel *model();
+    PlaylistTable *view();
+    TrackPrefetcher *prefetcher();
+    TrackHeadCache *headCache();
+    WaveformCache *waveformCache();
+    SpectrumAnalyzer *spectrumAnalyzer();
+    AudioEngine *pipeline();
+    bool isPipelineEnabled() const;
+
+public slots:
+    // switch between QMediaPlayer and the decode->ring buffer->output engine
+    void setPipelineEnabled(bool enabled);
+    // crossfade between tracks, needs the decode pipeline; 0 ms turns it off
+    void setCrossfade(int ms, bool equalPower);
+    // normalise playback with the library's loudness analysis
+    void setReplayGainMode(int mode);
 
 signals:
     // no signals so far
@@ -54,6 +92,7 @@ private slots:
 
     // Player control for playlists
     void play();
+    void pause();
     void seek(int seconds);
     void jump(const QModelIndex &index);
     void playlistPositionChanged(int currentItem);
@@ -72,10 +111,19 @@ private slots:
     void audioAvailableChanged(bool available);
 
     void displayErrorMessage();
+    void pipelineEndOfMedia();
+    void pipelineError(QString msg);
+    void crossfadeToNext();
+    void crossfadeFinished(QString absFilePath);
+    void setVolume(int volume);
+    void waveformReady(QString absFilePath);
 
     // playlist management
     void savePlaylist();
     void changePlaylistLabel(QString absFilePath);
+    // quick find, Ctrl+F
+    void openQuickFind();
+    void quickFindChosen(int row);
 
 private:
     void setTrackInfo(const QString &info);
@@ -83,13 +131,53 @@ private:
     void handleCursor(QMediaPlayer::MediaStatus status);
     void updateDurationInfo(qint64 currentInfo);
 
+    // route to whichever playback engine is active
+    void setMedia(const QMediaContent &media);
+    bool hasMedia() const;
+    void startPlayback();
+    qint64 playbackPosition() const;
+    void setPlaybackPosition(qint64 ms);
+    void advanceAfterEndOfMedia();
+    qreal currentGainDb() const;
+    void applyReplayGain();
+    void showWaveform(const QString &absFilePath);
+
+    /* Skips go through playMedia(), which starts the cached decoded head of the
+     * track (if any) on headOutput while QMediaPlayer opens the file, then hands
+     * over to QMediaPlayer at the same position once it has loaded.
+     */
+    void playMedia(const QMediaContent &media);
+    bool startFromHead(const QMediaContent &media);
+    void handOffFromHead();
+    void stopHead();
+
     QMediaPlayer *player;
+    AudioEngine *engine;
+    bool usePipeline;
+    // the pipeline is crossfading (or about to) into the entry nextMedia()
+    // will move to; the playlist moves when the engine switches to it
+    bool haveQueuedMedia;
+    QPersistentModelIndex queuedEntry;
+    int replayGainMode;
+    int userVolume;         // slider volume, before ReplayGain is applied
     QLabel *coverLabel;
-    QSlider *slider;
+    WaveformSlider *slider;
     QLabel *labelDuration;
     QLabel *curPlaylistLabel;
     PlaylistModel *playlistModel;
     PlaylistTable *playlistView;
+    QuickFindDialog *quickFind;
+    TrackPrefetcher *trackPrefetcher;
+    TrackHeadCache *trackHeadCache;
+    WaveformCache *waveforms;
+    QAudioProbe *probe;
+    SpectrumAnalyzer *spectrum;
+    SpectrumWidget *spectrumView;
+    QString waveformPath;   // track the slider shows (or waits for) the overview of
+    QAudioOutput *headOutput;
+    QBuffer *headBuffer;
+    bool playingHead;
+    bool headPaused;        // pause() came while the head was playing
     QString trackInfo;
     QString statusInfo;
     qint64 duration;
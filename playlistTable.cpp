@@ -1,5 +1,6 @@
 #include "playlistTable.h"
 #include "playlistmodel.h"
+#include "libraryModel.h"
 #include <stdio.h>
 #include <iostream>
 #include <QApplication>
@@ -10,6 +11,7 @@
 class PlaylistModel;
 
 PlaylistTable::PlaylistTable(QWidget* parent) : QTableView(parent) {
+    library = 0;
     // edit only when F2 is pressed
     setEditTriggers(QAbstractItemView::EditKeyPressed);
     setAlternatingRowColors(true);
@@ -25,11 +27,20 @@ PlaylistTable::PlaylistTable(QWidget* parent) : QTableView(parent) {
     setDefaultDropAction(Qt::MoveAction);
     setDragDropOverwriteMode(false);
     setDragDropMode(QTableView::DragDrop);
+
+    // clicking a header sorts the playlist once, no indicator means it's
+    // left in play order to start with
+    horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+    setSortingEnabled(true);
 }
 
 PlaylistTable::~PlaylistTable() {
 }
 
+void PlaylistTable::setLibrary(LibraryModel *model) {
+    library = model;
+}
+
 void PlaylistTable::mouseDoubleClickEvent(QMouseEvent* e) {
     QPoint clickPos = e->pos();
     QModelIndex clickIdx = QTableView::indexAt(clickPos);
@@ -136,15 +147,10 @@ void PlaylistTable::dropEvent(QDropEvent *event) {
             event->accept();
         }
 
-        if (header == "libraryItem") {
-            QList<QHash<QString, QString> > itemList;
-            QHash<QString, QString> hash;
-            while (!dataStream.atEnd()) {
-                dataStream >> hash;
-                itemList << hash;
-            }
+        if (header == "libraryTracks" && library) {
+            // the library only sends ids and keys, they're looked up all at once here
             PlaylistModel *model = static_cast<PlaylistModel*>(QTableView::model());
-            model->addMediaList(itemList);
+            model->addMediaList(library->getTrackSongInfo(dataStream));
             event->setDropAction(Qt::CopyAction);
             event->accept();
         }
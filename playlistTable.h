@@ -5,12 +5,16 @@
 #include <QMouseEvent>
 #include <QTimer>
 
+class LibraryModel;
+
 class PlaylistTable : public QTableView {
     Q_OBJECT
 
 public:
     PlaylistTable(QWidget* parent = 0);
     ~PlaylistTable();
+    // where the track ids dragged from the library are looked up
+    void setLibrary(LibraryModel *model);
 
 protected:
     virtual void mouseDoubleClickEvent(QMouseEvent* e);
@@ -28,6 +32,8 @@ protected:
 private:
     //QList<int> getRowOfIndexes(QModelIndexList &idxList);
 
+    LibraryModel *library;
+
 signals:
     // None right now.
 
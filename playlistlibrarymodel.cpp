@@ -1,4 +1,5 @@
 #include "playlistLibraryModel.h"
+#include "statementCache.h"
 #include <QStandardItemModel>
 #include <assert.h>
 #include <QtWidgets>
@@ -7,6 +8,7 @@
 #include <QMessageBox>
 
 PlaylistLibraryModel::PlaylistLibraryModel(QWidget *parent) : QStandardItemModel(0,2,parent) {
+    statements = 0;
     if (!QSqlDatabase::drivers().contains("QSQLITE")) {
         QMessageBox msgBox;
         msgBox.setText("Unable to load database, Library needs the SQLITE driver");
@@ -35,6 +37,7 @@ PlaylistLibraryModel::PlaylistLibraryModel(QWidget *parent) : QStandardItemModel
 }
 
 PlaylistLibraryModel::~PlaylistLibraryModel() {
+    delete statements;
     db.close();
 }
 
@@ -61,14 +64,15 @@ QSqlError PlaylistLibraryModel::initDb() {
         qDebug() << "PlaylistLibraryModel::initDb(): Can't open database!";
         return db.lastError();
     }
+    statements = new StatementCache(db);
 
     QStringList tables = db.tables();
     if (tables.contains("PLAYLISTLIBRARY", Qt::CaseInsensitive)) {
         return QSqlError();
     }
 
-    QSqlQuery q(db);
-    if (!q.exec(QString("CREATE TABLE IF NOT EXISTS PLAYLISTLIBRARY(id integer primary key, absFilePath varchar(500) UNIQUE)"))) {
+    SqlQuery q(statements, "CREATE TABLE IF NOT EXISTS PLAYLISTLIBRARY(id integer primary key, absFilePath varchar(500) UNIQUE)");
+    if (!q.exec()) {
         qDebug() << "PlaylistLibraryModel::initDb(): Can't create table!";
         return q.lastError();
     }
@@ -77,9 +81,9 @@ QSqlError PlaylistLibraryModel::initDb() {
 
 QSqlError PlaylistLibraryModel::populateModel() {
     qDebug() << "Populate playlist-library model from database";
-    QSqlQuery q(db);    // fetching playlist entries
-    QSqlQuery q2(db);   // deleting invalid playlist entries
-    if (!q.exec(QString("SELECT absFilePath FROM PLAYLISTLIBRARY"))) {
+    SqlQuery q(statements, "SELECT absFilePath FROM PLAYLISTLIBRARY");                     // fetching playlist entries
+    SqlQuery q2(statements, "DELETE FROM PLAYLISTLIBRARY WHERE absFilePath=:absFilePath");  // deleting invalid playlist entries
+    if (!q.exec()) {
         qDebug() << "PlaylistLibraryModel::populateModel() failed at fetching playlists from database";
         return q.lastError();
     }
@@ -87,7 +91,8 @@ QSqlError PlaylistLibraryModel::populateModel() {
         QFileInfo fileInfo = QFileInfo(q.value(0).toString());
         if (!fileInfo.exists()) {
             // remove nonexistent playlist file
-            if (!q2.exec(QString("DELETE FROM PLAYLISTLIBRARY WHERE absFilePath='%1'").arg(q.value(0).toString()))) {
+            q2.bindValue(":absFilePath", q.value(0).toString());
+            if (!q2.exec()) {
                 qDebug() << "PlaylistLibraryModel::populateModel() failed@Remvoing invalid DB entry with absFilePath=" << q.value(0).toString();
                 return q.lastError();
             }
@@ -137,8 +142,9 @@ void PlaylistLibraryModel::addFromDir(const QString &dir) {
 void PlaylistLibraryModel::addNewlyCreatedPlaylist(QString absFilePath, QString fileName) {
     // only add the database item, need to refresh for the new playlist to show up.
     Q_UNUSED(absFilePath)
-    QSqlQuery q(db);
-    if (q.exec(QString("INSERT INTO PLAYLISTLIBRARY(absFilePath) VALUES ('%1')").arg(absFilePath))) {
+    SqlQuery q(statements, "INSERT INTO PLAYLISTLIBRARY(absFilePath) VALUES (:absFilePath)");
+    q.bindValue(":absFilePath", absFilePath);
+    if (q.exec()) {
         return;
     }
 }
@@ -146,8 +152,9 @@ void PlaylistLibraryModel::addNewlyCreatedPlaylist(QString absFilePath, QString
 void PlaylistLibraryModel::addToModelAndDB(QFileInfo fileInfo) {
     QString absFilePath = fileInfo.canonicalFilePath();
     //qDebug() << "Adding playlist to model and DB, absFilePath is: " << absFilePath;
-    QSqlQuery q(db);
-    if (q.exec(QString("INSERT INTO PLAYLISTLIBRARY(absFilePath) VALUES ('%1')").arg(absFilePath))) {
+    SqlQuery q(statements, "INSERT INTO PLAYLISTLIBRARY(absFilePath) VALUES (:absFilePath)");
+    q.bindValue(":absFilePath", absFilePath);
+    if (q.exec()) {
         addToModelOnly(fileInfo);
         return;
     }
@@ -201,8 +208,9 @@ void PlaylistLibraryModel::deletePlaylist(const QModelIndex &idx) {
     // remove node
     removeRows(idx.row(), 1);
     // remove database item
-    QSqlQuery q(db);
-    if (!q.exec(QString("DELETE FROM PLAYLISTLIBRARY WHERE absFilePath='%1'").arg(absFilePath))) {
+    SqlQuery q(statements, "DELETE FROM PLAYLISTLIBRARY WHERE absFilePath=:absFilePath");
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec()) {
         qDebug() << "PlaylistLibraryModel: deleting playlist failed: " << q.lastError();
         return;
     }
@@ -229,8 +237,9 @@ void PlaylistLibraryModel::changePlaylistName(const QModelIndex &idx, QString ne
     removeRows(idx.row(), 1);
 
     // delete database entry
-    QSqlQuery q(db);
-    if (!q.exec(QString("DELETE FROM PLAYLISTLIBRARY WHERE absFilePath='%1'").arg(absFilePath))) {
+    SqlQuery q(statements, "DELETE FROM PLAYLISTLIBRARY WHERE absFilePath=:absFilePath");
+    q.bindValue(":absFilePath", absFilePath);
+    if (!q.exec()) {
         qDebug() << "PlaylistLibraryModel: deleting playlist failed: " << q.lastError();
         return;
     }
@@ -3,6 +3,8 @@
 #include <QStandardItemModel>
 #include <QModelIndex>
 
+class StatementCache;
+
 class PlaylistLibraryModel : public QStandardItemModel {
     Q_OBJECT
 
@@ -34,6 +36,7 @@ private:
     void showError(const QSqlError &err, const QString msg);
 
     QSqlDatabase db;
+    StatementCache *statements;
     QList<QString> importDirs;
 
 };
@@ -1,19 +1,27 @@
 #include "playlistmodel.h"
+#include "tempoKeyMeter.h"
+#include "tagWriter.h"
+#include "collation.h"
+#include "artistKey.h"
+#include "parallelSort.h"
 #include <assert.h>
 #include <QColor>
 #include <QBrush>
+#include <QFont>
 #include <QMimeData>
 #include <QApplication>
 #include <QMessageBox>
 #include <QWidget>
+#include <QtAlgorithms>
 
 class QMessageBox;
 
 PlaylistModel::PlaylistModel(QObject *parent)
     : QAbstractTableModel(parent){
-    columns = 4;
+    columns = 6;
     m_data = QList<QHash<QString, QString> >();
     curMediaIdx = -1;
+    shuffleIdx = -1;
     finishedPlaylist = false;
     u = new Util();
     mode = NORMAL;
@@ -68,11 +76,31 @@ QVariant PlaylistModel::data(const QModelIndex &index, int role) const {
             case 3:
                 // length
                 return h["Length"];
+            case BPM_COLUMN:
+                return h["BPM"];
+            case KEY_COLUMN: {
+                // Camelot code first, harmonically compatible keys are one step apart
+                if (h["Key"].isEmpty()) {
+                    return QString();
+                }
+                int key = h["Key"].toInt();
+                return QString("%1  %2").arg(TempoKeyMeter::camelotCode(key)).arg(TempoKeyMeter::keyName(key));
+            }
             default:
                return QVariant();
         }
     }
 
+    if (role == Qt::FontRole) {
+        // tag edits not yet saved to the file
+        if (index.column() <= 2 && TagWriter::instance()->isPending(m_data.at(index.row())["absFilePath"])) {
+            QFont font;
+            font.setItalic(true);
+            return font;
+        }
+        return QVariant();
+    }
+
     if (role == Qt::EditRole) {
         const QHash<QString, QString> h = m_data.at(index.row());
         switch(index.column()) {
@@ -111,6 +139,10 @@ QVariant PlaylistModel::headerData(int section, Qt::Orientation orientation, int
                 return tr("Album");
             case 3:
                 return tr("Length");
+            case BPM_COLUMN:
+                return tr("BPM");
+            case KEY_COLUMN:
+                return tr("Key");
             default:
                 return QVariant();
         }
@@ -123,8 +155,8 @@ Qt::ItemFlags PlaylistModel::flags(const QModelIndex &index) const {
         return Qt::ItemIsEnabled | Qt::ItemIsDropEnabled;
     }
 
-    if (index.column() == 3) {
-        // clicking on length doesn't do anything
+    if (index.column() >= 3) {
+        // clicking on length (or the analysis results) doesn't do anything
         return QAbstractTableModel::flags(index) | Qt::ItemIsDropEnabled | Qt::ItemIsDragEnabled;
     }
 
@@ -285,6 +317,7 @@ void PlaylistModel::addMedia(const QStringList& fileNames) {
             endInsertRows();
         }
     }
+    rollShuffle();
     if (curMediaIdx < 0 && start > 0) {
         curMediaIdx = 0;
         emit(mediaAvailable());
@@ -296,6 +329,7 @@ void PlaylistModel::addMedia(const QHash<QString, QString> libraryItem) {
     beginInsertRows(QModelIndex(), m_data.size(), m_data.size());
     m_data.append(libraryItem);
     endInsertRows();
+    rollShuffle();
     if (curMediaIdx < 0) {
         curMediaIdx = 0;
         emit(mediaAvailable());
@@ -319,6 +353,7 @@ void PlaylistModel::removeMedia(int start, int end) {
         }
     }
     endRemoveRows();
+    rollShuffle();
     if (m_data.size() == 0) {
         curMediaIdx = -1;
         emit(curMediaRemoved(curMediaIdx));
@@ -351,7 +386,8 @@ const QMediaContent PlaylistModel::nextMedia(){
             curMediaIdx = curMediaIdx;
          }
         else if (mode & SHUFFLE) {
-            curMediaIdx = qrand() % m_data.size();
+            curMediaIdx = (shuffleIdx >= 0 && shuffleIdx < m_data.size()) ? shuffleIdx : qrand() % m_data.size();
+            rollShuffle();
         }
         else {
             if (finishedPlaylist) {
@@ -372,7 +408,8 @@ const QMediaContent PlaylistModel::pressNextMedia() {
     finishedPlaylist = false;
     if (m_data.size() > 0) {
         if (mode & SHUFFLE) {
-            curMediaIdx = qrand() % m_data.size();
+            curMediaIdx = (shuffleIdx >= 0 && shuffleIdx < m_data.size()) ? shuffleIdx : qrand() % m_data.size();
+            rollShuffle();
         }
         else {
             curMediaIdx = (curMediaIdx+1) % m_data.size();
@@ -444,6 +481,8 @@ void PlaylistModel::clear() {
     m_data.clear();
     endRemoveRows();
     curMediaIdx = -1;
+    shuffleIdx = -1;
+    sortColumns.clear();
 }
 
 void PlaylistModel::loadPlaylistItem(QString absFilePath) {
@@ -478,6 +517,198 @@ const QString PlaylistModel::getCurTitle() const {
     return QString();
 }
 
+int PlaylistModel::peekNextIdx() const {
+    // the entry pressNextMedia() would move to
+    if (m_data.size() == 0) {
+        return -1;
+    }
+    if (mode & SHUFFLE) {
+        return shuffleIdx;
+    }
+    return (curMediaIdx+1) % m_data.size();
+}
+
+int PlaylistModel::peekPreviousIdx() const {
+    // the entry previousMedia() would move to
+    if (m_data.size() == 0) {
+        return -1;
+    }
+    return (curMediaIdx <= 0) ? m_data.size()-1 : curMediaIdx-1;
+}
+
+int PlaylistModel::peekEndOfMediaIdx() const {
+    if (m_data.size() == 0 || curMediaIdx < 0) {
+        return -1;
+    }
+    if (mode & REPEAT1) {
+        return curMediaIdx;
+    }
+    if (mode & SHUFFLE) {
+        return (shuffleIdx >= 0 && shuffleIdx < m_data.size()) ? shuffleIdx : -1;
+    }
+    if (curMediaIdx == m_data.size()-1) {
+        return (mode == NORMAL) ? -1 : 0;
+    }
+    return curMediaIdx+1;
+}
+
+void PlaylistModel::advanceTo(int row) {
+    if (row < 0 || row >= m_data.size()) {
+        return;
+    }
+    finishedPlaylist = (curMediaIdx == m_data.size()-1);
+    if ((mode & SHUFFLE) && !(mode & REPEAT1)) {
+        rollShuffle();
+    }
+    curMediaIdx = row;
+    emit(currentIndexChanged(curMediaIdx));
+}
+
+QString PlaylistModel::getAbsFilePath(int row) const {
+    if (row >= 0 && row < m_data.size()) {
+        return m_data[row]["absFilePath"];
+    }
+    return QString();
+}
+
+double PlaylistModel::getGain(int row, bool album) const {
+    if (row < 0 || row >= m_data.size()) {
+        return 0.0;
+    }
+    const QHash<QString, QString> &h = m_data[row];
+    if (album && !h.value("AlbumGain").isEmpty()) {
+        return h.value("AlbumGain").toDouble();
+    }
+    return h.value("TrackGain").toDouble();
+}
+
+namespace {
+// rows in the order of their keys, one key per sort column, each one
+// ascending or descending; stable, so equal rows keep their order
+struct SortKeyLess {
+    SortKeyLess(const QVector<double> &sortKeys, const QVector<bool> &sortDescending)
+        : keys(sortKeys.constData()), descending(sortDescending), count(sortDescending.size()) {}
+    bool operator()(int a, int b) const {
+        const double *ka = keys + a * count;
+        const double *kb = keys + b * count;
+        for (int i = 0; i < count; i++) {
+            if (ka[i] != kb[i]) {
+                return descending[i] ? kb[i] < ka[i] : ka[i] < kb[i];
+            }
+        }
+        return false;
+    }
+    const double *keys;
+    QVector<bool> descending;
+    int count;
+};
+}
+
+void PlaylistModel::sort(int column, Qt::SortOrder order) {
+    // a one-off reorder, the playlist doesn't stay sorted as items are added
+    if (column < 0 || column >= columns || m_data.size() < 2) {
+        return;
+    }
+    // the columns sorted by before break ties, the latest first
+    for (int i = 0; i < sortColumns.size(); i++) {
+        if (sortColumns[i].first == column) {
+            sortColumns.removeAt(i);
+            break;
+        }
+    }
+    sortColumns.prepend(qMakePair(column, order));
+    while (sortColumns.size() > MAX_SORT_COLUMNS) {
+        sortColumns.removeLast();
+    }
+
+    const int rows = m_data.size();
+    const int count = sortColumns.size();
+    const double unknown = 1e30;  // unanalysed tracks go last (ascending)
+    QVector<double> keys(rows * count);
+    QVector<bool> descending(count);
+    static const char *textFields[] = { "Title", "Artist", "Album" };
+    for (int c = 0; c < count; c++) {
+        descending[c] = sortColumns[c].second == Qt::DescendingOrder;
+        int col = sortColumns[c].first;
+        if (col < 3) {
+            // collation ranks, worked out once per distinct string
+            QStringList texts;
+            texts.reserve(rows);
+            for (int row = 0; row < rows; row++) {
+                texts.append(m_data[row].value(textFields[col]));
+            }
+            QVector<int> ranks = Collation::instance()->ranks(texts);
+            for (int row = 0; row < rows; row++) {
+                keys[row * count + c] = ranks[row];
+            }
+            continue;
+        }
+        for (int row = 0; row < rows; row++) {
+            const QHash<QString, QString> &h = m_data[row];
+            double &k = keys[row * count + c];
+            k = 0.0;
+            switch (col) {
+                case 3: {
+                    // m:ss, or h:mm:ss for the long ones
+                    QStringList parts = h["Length"].split(':');
+                    qint64 secs = 0;
+                    bool ok = parts.size() >= 2;
+                    foreach (const QString &part, parts) {
+                        bool partOk;
+                        secs = secs*60 + part.toInt(&partOk);
+                        ok = ok && partOk;
+                    }
+                    k = ok ? secs : unknown;
+                    break;
+                }
+                case BPM_COLUMN:
+                    k = h["BPM"].isEmpty() ? unknown : h["BPM"].toDouble();
+                    break;
+                case KEY_COLUMN:
+                    // around the Camelot wheel, so mixable keys end up together
+                    k = h["Key"].isEmpty() ? unknown : TempoKeyMeter::camelotOrder(h["Key"].toInt());
+                    break;
+            }
+        }
+    }
+    QVector<int> order(rows);
+    for (int row = 0; row < rows; row++) {
+        order[row] = row;
+    }
+    parallelStableSort(order, SortKeyLess(keys, descending));
+
+    emit(layoutAboutToBeChanged());
+    QList<QHash<QString, QString> > sorted;
+    sorted.reserve(rows);
+    QVector<int> newRow(rows);
+    for (int i = 0; i < rows; i++) {
+        sorted.append(m_data[order[i]]);
+        newRow[order[i]] = i;
+    }
+    m_data = sorted;
+    if (curMediaIdx >= 0 && curMediaIdx < newRow.size()) {
+        curMediaIdx = newRow[curMediaIdx];
+    }
+    if (shuffleIdx >= 0 && shuffleIdx < newRow.size()) {
+        shuffleIdx = newRow[shuffleIdx];
+    }
+    QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    foreach(QModelIndex idx, from) {
+        to.append(index(newRow[idx.row()], idx.column()));
+    }
+    changePersistentIndexList(from, to);
+    emit(layoutChanged());
+#if DEBUG_PLAYLISTVIEW
+    qDebug() << "PlaylistModel::sort: by" << count << "columns," << rows << "rows";
+#endif
+}
+
+void PlaylistModel::rollShuffle() {
+    // pick the next shuffle entry ahead of time so it can be prefetched
+    shuffleIdx = (m_data.size() > 0) ? qrand() % m_data.size() : -1;
+}
+
 void PlaylistModel::beginRemoveItems(int start, int end) {
     beginRemoveRows(QModelIndex(), start, end);
     for (int row=0; row < end+1; row++) {
@@ -514,48 +745,60 @@ void PlaylistModel::savePlaylist(QString fileName) {
     return;
 }
 
-void PlaylistModel::changeMetaData(QModelIndex index) {
-    int row = index.row();
-    int col = index.column();
+void PlaylistModel::changeMetaData(QModelIndex changed) {
+    int row = changed.row();
+    int col = changed.column();
     // get path of the associated file
     //QUrl location = m_playlist->media(row).canonicalUrl();
     //QString path = location.path();
-    QByteArray byteArray = m_data[row]["absFilePath"].toUtf8();
-    const char* cString = byteArray.constData();
-
-    TagLib::FileRef f(cString);
-    if (!f.isNull() && f.tag()) {
-        switch (col) {
-            case 0: {
-                // change title
-                TagLib::String title = TagLib::String(m_data[row]["Title"].toUtf8().constData());
-                f.tag()->setTitle(title);
-                f.file()->save();
-                break;
-                    }
-            case 1: {
-                // change artist
-                TagLib::String artist = TagLib::String(m_data[row]["Artist"].toUtf8().constData());
-                f.tag()->setArtist(artist);
-                f.file()->save();
-                break;
-                    }
-            case 2: {
-                // change album
-                TagLib::String album = TagLib::String(m_data[row]["Album"].toUtf8().constData());
-                f.tag()->setAlbum(album);
-                f.file()->save();
-                break;
-                    }
-            default:
-                break;
+    // written behind, the row already shows the new value
+    QString absFilePath = m_data[row]["absFilePath"];
+    switch (col) {
+        case 0:
+            // change title
+            TagWriter::instance()->queueEdit(absFilePath, TagWriter::TITLE, m_data[row]["Title"]);
+            break;
+        case 1:
+            // change artist
+            TagWriter::instance()->queueEdit(absFilePath, TagWriter::ARTIST, m_data[row]["Artist"]);
+            break;
+        case 2:
+            // change album
+            TagWriter::instance()->queueEdit(absFilePath, TagWriter::ALBUM, m_data[row]["Album"]);
+            break;
+        default:
+            return;
+    }
+    for (int r = 0; r < m_data.size(); r++) {
+        if (m_data[r]["absFilePath"] == absFilePath) {
+            emit(dataChanged(index(r, 0), index(r, columns-1)));
         }
     }
     return;
 }
 
+void PlaylistModel::tagsWritten(QString absFilePath, bool ok) {
+    for (int row = 0; row < m_data.size(); row++) {
+        if (m_data[row]["absFilePath"] != absFilePath) {
+            continue;
+        }
+        if (!ok) {
+            // back to what the file really says
+            QHash<QString, QString> tags;
+            u->get_metaData(absFilePath, tags);
+            if (!tags.isEmpty()) {
+                m_data[row]["Title"] = tags["Title"];
+                m_data[row]["Artist"] = tags["Artist"];
+                m_data[row]["Album"] = tags["Album"];
+            }
+        }
+        // no longer in italics
+        emit(dataChanged(index(row, 0), index(row, columns-1)));
+    }
+}
+
 void PlaylistModel::libraryMetaDataChanged(int dataType, QString arg1, QString arg2) {
-    // either title or artist in library have been changed,
+    // title, artist or album in library have been changed,
     // alter the affected playlist items accordingly.
     if (dataType == 0) {
         // title change
@@ -569,14 +812,45 @@ void PlaylistModel::libraryMetaDataChanged(int dataType, QString arg1, QString a
         }
     }
     if (dataType == 1) {
-        // artist change
-        QString oldArtist = arg1;
+        // artist change, to every spelling the library grouped with it
+        QString oldKey = artistKey(arg1);
         QString newArtist = arg2;
         for(int row = 0; row < m_data.size(); row++) {
-            if (m_data[row]["Artist"] == oldArtist) {
+            if (artistKey(m_data[row]["Artist"]) == oldKey) {
                 m_data[row]["Artist"] = newArtist;
                 emit(dataChanged(index(row,0), index(row,0)));
             }
         }
     }
+    if (dataType == 2) {
+        // album change
+        QString absFilePath = arg1;
+        QString newAlbum = arg2;
+        for(int row = 0; row < m_data.size(); row++) {
+            if (m_data[row]["absFilePath"] == absFilePath) {
+                m_data[row]["Album"] = newAlbum;
+                emit(dataChanged(index(row,2), index(row,2)));
+            }
+        }
+    }
+}
+
+void PlaylistModel::tempoKeyChanged(QString absFilePath, QString bpm, QString key) {
+    for(int row = 0; row < m_data.size(); row++) {
+        if (m_data[row]["absFilePath"] == absFilePath) {
+            m_data[row]["BPM"] = bpm;
+            m_data[row]["Key"] = key;
+            emit(dataChanged(index(row, BPM_COLUMN), index(row, KEY_COLUMN)));
+        }
+    }
+}
+
+void PlaylistModel::replayGainChanged(QString absFilePath, QString trackGain, QString albumGain) {
+    // loudness analysis finished for a track, nothing visible changes
+    for(int row = 0; row < m_data.size(); row++) {
+        if (m_data[row]["absFilePath"] == absFilePath) {
+            m_data[row]["TrackGain"] = trackGain;
+            m_data[row]["AlbumGain"] = albumGain;
+        }
+    }
 }
@@ -5,6 +5,7 @@
 #include <QAbstractTableModel>
 #include <QModelIndex>
 #include <QMediaContent>
+#include <QPair>
 
 class PlaylistModel : public QAbstractTableModel {
     Q_OBJECT
@@ -16,6 +17,12 @@ public:
     const static int REPEATALL = 4; // 0100
     const static int SHUFFLE = 8;   // 1000
 
+    // analysis columns, after title, artist, album and length
+    const static int BPM_COLUMN = 4;
+    const static int KEY_COLUMN = 5;
+    // columns a sort keeps as tie-breakers, the clicked one included
+    const static int MAX_SORT_COLUMNS = 3;
+
     // constructor
     PlaylistModel(QObject *parent = 0);
     ~PlaylistModel();
@@ -35,6 +42,7 @@ public:
     virtual QVariant headerData(int section, Qt::Orientation Orientation, int role) const;
     virtual Qt::ItemFlags flags(const QModelIndex &index) const;
     virtual bool setData(const QModelIndex &index, const QVariant &value, int role=Qt::EditRole);
+    virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
     // needed for drag and drop
     virtual Qt::DropActions supportedDropActions() const;
     virtual QStringList mimetypes() const;
@@ -56,6 +64,20 @@ public:
     const QString getCurAlbumArtist(void) const;
     const QString getCurTitle(void) const;
 
+    // look-ahead used by the prefetcher, does not move curMediaIdx
+    int peekNextIdx() const;
+    int peekPreviousIdx() const;
+    // the entry nextMedia() would move to at the end of the current one,
+    // -1 if playback stops there (or the shuffle pick isn't known)
+    int peekEndOfMediaIdx() const;
+    // the move nextMedia() makes, to the row peekEndOfMediaIdx() gave (it
+    // may have moved since); nothing if it's gone
+    void advanceTo(int row);
+    QString getAbsFilePath(int row) const;
+    // ReplayGain in dB from the library's loudness analysis, 0 if not analysed.
+    // An album gain falls back to the track gain.
+    double getGain(int row, bool album) const;
+
     // saving playlist
     void savePlaylist(QString fileName);
 
@@ -63,8 +85,11 @@ private slots:
     void beginRemoveItems(int start, int end);
     void endRemoveItems();
     void changeItems(int start, int end);
-    void changeMetaData(QModelIndex index);
+    void changeMetaData(QModelIndex changed);
     void libraryMetaDataChanged(int dataType, QString arg1, QString arg2);
+    void replayGainChanged(QString absFilePath, QString trackGain, QString albumGain);
+    void tempoKeyChanged(QString absFilePath, QString bpm, QString key);
+    void tagsWritten(QString absFilePath, bool ok);
     void loadPlaylistItem(QString absFilePath);
 
 signals:
@@ -86,14 +111,18 @@ private:
      *          (Artist: bla)
      *          (Album: bla)
      *          (Length: bla)
+     *          (BPM: bla)
+     *          (Key: bla)
      * QMap keeps the order of the dictionary keys.
      */
     QList<QHash<QString, QString> > m_data;
     int curMediaIdx;
+    int shuffleIdx;     // pre-rolled shuffle pick, so it can be predicted
     Util *u;
     int mode;
     int columns;
     bool finishedPlaylist;
-
+    QList<QPair<int, Qt::SortOrder> > sortColumns;  // latest first
+    void rollShuffle();
 
 };
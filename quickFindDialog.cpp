@@ -0,0 +1,129 @@
+#include "quickFindDialog.h"
+#include "playlistmodel.h"
+#include "libraryIndex.h"
+#include <QtWidgets>
+
+namespace {
+
+// results shown, the rest only counts
+const int SHOWN = 50;
+
+}
+
+QuickFindDialog::QuickFindDialog(PlaylistModel *model, QWidget *parent) : QDialog(parent), playlist(model) {
+    setWindowTitle(tr("Find in playlist"));
+    queryBox = new QLineEdit(this);
+    queryBox->setPlaceholderText(tr("Type part of a title, artist or album"));
+    queryBox->installEventFilter(this);
+    results = new QListWidget(this);
+    statusLabel = new QLabel(this);
+
+    QBoxLayout *layout = new QVBoxLayout;
+    layout->addWidget(queryBox);
+    layout->addWidget(results);
+    layout->addWidget(statusLabel);
+    setLayout(layout);
+    resize(480, 360);
+
+    connect(queryBox, SIGNAL(textChanged(QString)), this, SLOT(search(QString)));
+    connect(results, SIGNAL(itemActivated(QListWidgetItem*)), this, SLOT(choose(QListWidgetItem*)));
+    connect(playlist, SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(playlistChanged()));
+    connect(playlist, SIGNAL(rowsRemoved(QModelIndex, int, int)), this, SLOT(playlistChanged()));
+    connect(playlist, SIGNAL(layoutChanged()), this, SLOT(playlistChanged()));
+    connect(playlist, SIGNAL(modelReset()), this, SLOT(playlistChanged()));
+}
+
+void QuickFindDialog::showEvent(QShowEvent *event) {
+    // the playlist may have changed since last time
+    reload();
+    queryBox->selectAll();
+    queryBox->setFocus();
+    QDialog::showEvent(event);
+}
+
+// slot
+void QuickFindDialog::playlistChanged() {
+    // rows come and go while it's open, the results follow
+    if (isVisible()) {
+        reload();
+    }
+}
+
+void QuickFindDialog::reload() {
+    QStringList rows;
+    for (int row = 0; row < playlist->rowCount(); row++) {
+        rows << LibraryIndex::fold(playlist->data(playlist->index(row, 0)).toString())
+                + LibraryIndex::fold(playlist->data(playlist->index(row, 1)).toString())
+                + LibraryIndex::fold(playlist->data(playlist->index(row, 2)).toString());
+    }
+    matcher.setRows(rows);
+    search(queryBox->text());
+}
+
+bool QuickFindDialog::eventFilter(QObject *watched, QEvent *event) {
+    // the query box keeps the focus, the list still follows the arrow keys
+    if (watched == queryBox && event->type() == QEvent::KeyPress) {
+        QKeyEvent *key = static_cast<QKeyEvent *>(event);
+        switch (key->key()) {
+        case Qt::Key_Up:
+        case Qt::Key_Down:
+        case Qt::Key_PageUp:
+        case Qt::Key_PageDown:
+            QApplication::sendEvent(results, event);
+            return true;
+        case Qt::Key_Return:
+        case Qt::Key_Enter:
+            choose(results->currentItem());
+            return true;
+        default:
+            break;
+        }
+    }
+    return QDialog::eventFilter(watched, event);
+}
+
+void QuickFindDialog::search(const QString &query) {
+    QVector<FuzzyMatcher::Match> matches = matcher.search(query, SHOWN);
+    results->clear();
+    foreach (const FuzzyMatcher::Match &match, matches) {
+        QString title = playlist->data(playlist->index(match.row, 0)).toString();
+        QString artist = playlist->data(playlist->index(match.row, 1)).toString();
+        QListWidgetItem *item = new QListWidgetItem(QString("%1 - %2").arg(title).arg(artist), results);
+        item->setData(Qt::UserRole, match.row);
+        item->setData(Qt::UserRole + 1, playlist->getAbsFilePath(match.row));
+    }
+    if (results->count() > 0) {
+        results->setCurrentRow(0);
+    }
+    statusLabel->setText(QString("%1 of %2 rows, %3 ms")
+                            .arg(matcher.matchCount())
+                            .arg(matcher.rowCount())
+                            .arg(matcher.lastSearchNsecs()/1000000.0, 0, 'f', 2));
+}
+
+void QuickFindDialog::choose(QListWidgetItem *item) {
+    if (!item) {
+        return;
+    }
+    // the row it was found at may hold another track by now
+    int row = currentRow(item->data(Qt::UserRole).toInt(), item->data(Qt::UserRole + 1).toString());
+    if (row < 0) {
+        delete item;
+        statusLabel->setText(tr("That track is no longer in the playlist"));
+        return;
+    }
+    emit(rowChosen(row));
+    hide();
+}
+
+int QuickFindDialog::currentRow(int row, const QString &absFilePath) const {
+    if (playlist->getAbsFilePath(row) == absFilePath) {
+        return row;
+    }
+    for (int r = 0; r < playlist->rowCount(); r++) {
+        if (playlist->getAbsFilePath(r) == absFilePath) {
+            return r;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "debug.h"
+#include "fuzzyMatcher.h"
+#include <QDialog>
+
+class PlaylistModel;
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
+class QLabel;
+
+/*
+ * Quick find over the playlist: fuzzy matches what's typed against the
+ * title, artist and album of every row (see FuzzyMatcher) and lists the
+ * best ones, best first. Enter plays the selected row, looked up again by
+ * its file in case the playlist changed since.
+ */
+class QuickFindDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    QuickFindDialog(PlaylistModel *model, QWidget *parent = 0);
+
+signals:
+    void rowChosen(int row);
+
+protected:
+    virtual void showEvent(QShowEvent *event);
+    virtual bool eventFilter(QObject *watched, QEvent *event);
+
+private slots:
+    void search(const QString &query);
+    void choose(QListWidgetItem *item);
+    void playlistChanged();
+
+private:
+    // the rows and the results from the playlist as it is now
+    void reload();
+    // where the track found at row is now, -1 if it's gone
+    int currentRow(int row, const QString &absFilePath) const;
+
+    PlaylistModel *playlist;
+    FuzzyMatcher matcher;
+    QLineEdit *queryBox;
+    QListWidget *results;
+    QLabel *statusLabel;
+};
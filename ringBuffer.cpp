@@ -0,0 +1,75 @@
+#include "ringBuffer.h"
+#include <string.h>
+
+RingBuffer::RingBuffer(int capacity) {
+    size = 1;
+    while (size < (quint32)capacity) {
+        size <<= 1;
+    }
+    mask = size - 1;
+    buf = new char[size];
+    readPos.store(0);
+    writePos.store(0);
+}
+
+RingBuffer::~RingBuffer() {
+    delete [] buf;
+}
+
+int RingBuffer::capacity() const {
+    return size;
+}
+
+int RingBuffer::available() const {
+    quint32 w = (quint32)writePos.loadAcquire();
+    quint32 r = (quint32)readPos.loadAcquire();
+    return w - r;
+}
+
+int RingBuffer::freeSpace() const {
+    return size - available();
+}
+
+int RingBuffer::write(const char *data, int len) {
+    // only the producer moves writePos, so a relaxed load of it is enough
+    quint32 w = (quint32)writePos.load();
+    quint32 r = (quint32)readPos.loadAcquire();
+    quint32 n = qMin((quint32)len, size - (w - r));
+    if (n == 0) {
+        return 0;
+    }
+    quint32 start = w & mask;
+    quint32 first = qMin(n, size - start);
+    memcpy(buf + start, data, first);
+    memcpy(buf, data + first, n - first);
+    writePos.storeRelease((int)(w + n));
+    return n;
+}
+
+int RingBuffer::read(char *data, int len) {
+    quint32 r = (quint32)readPos.load();
+    quint32 w = (quint32)writePos.loadAcquire();
+    quint32 n = qMin((quint32)len, w - r);
+    if (n == 0) {
+        return 0;
+    }
+    quint32 start = r & mask;
+    quint32 first = qMin(n, size - start);
+    memcpy(data, buf + start, first);
+    memcpy(data + first, buf, n - first);
+    readPos.storeRelease((int)(r + n));
+    return n;
+}
+
+int RingBuffer::skip(int len) {
+    quint32 r = (quint32)readPos.load();
+    quint32 w = (quint32)writePos.loadAcquire();
+    quint32 n = qMin((quint32)len, w - r);
+    readPos.storeRelease((int)(r + n));
+    return n;
+}
+
+void RingBuffer::reset() {
+    readPos.store(0);
+    writePos.store(0);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <QAtomicInt>
+#include <QtGlobal>
+
+/*
+ * Lock-free single-producer/single-consumer byte ring buffer.
+ * One thread may call write() while another calls read(); neither blocks.
+ * The read and write positions only ever grow (modulo 2^32) and are published
+ * with release/acquire ordering, so the data a reader sees is always complete.
+ * The capacity is rounded up to a power of two.
+ */
+class RingBuffer {
+public:
+    RingBuffer(int capacity);
+    ~RingBuffer();
+
+    // producer side
+    int write(const char *data, int len);
+    int freeSpace() const;
+
+    // consumer side
+    int read(char *data, int len);
+    int skip(int len);
+    int available() const;
+
+    int capacity() const;
+    // only safe while neither side is running
+    void reset();
+
+private:
+    Q_DISABLE_COPY(RingBuffer)
+
+    char *buf;
+    quint32 size;
+    quint32 mask;
+    QAtomicInt readPos;
+    QAtomicInt writePos;
+};
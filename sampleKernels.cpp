@@ -0,0 +1,1003 @@
+#include "sampleKernels.h"
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QVector>
+#include <math.h>
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SAMPLEKERNELS_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+const float S16_SCALE = 32768.0f;
+const float S24_SCALE = 8388608.0f;
+const float S32_SCALE = 2147483648.0f;
+// largest float below 2^31, anything above doesn't fit in a qint32
+const float S32_MAX = 2147483520.0f;
+
+inline float clampf(float x, float lo, float hi) {
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+
+//--------------------scalar reference---------------------
+void s16ToFloatScalar(const qint16 *in, float *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = in[i] * (1.0f/S16_SCALE);
+    }
+}
+
+void floatToS16Scalar(const float *in, qint16 *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = (qint16)lrintf(clampf(in[i] * S16_SCALE, -S16_SCALE, S16_SCALE-1));
+    }
+}
+
+void s24ToFloatScalar(const uchar *in, float *out, int n) {
+    for (int i = 0; i < n; i++, in += 3) {
+        qint32 v = in[0] | (in[1] << 8) | ((qint32)(signed char)in[2] << 16);
+        out[i] = (float)v * (1.0f/S24_SCALE);
+    }
+}
+
+void floatToS24Scalar(const float *in, uchar *out, int n) {
+    for (int i = 0; i < n; i++, out += 3) {
+        qint32 v = (qint32)lrintf(clampf(in[i] * S24_SCALE, -S24_SCALE, S24_SCALE-1));
+        out[0] = (uchar)v;
+        out[1] = (uchar)(v >> 8);
+        out[2] = (uchar)(v >> 16);
+    }
+}
+
+void s32ToFloatScalar(const qint32 *in, float *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = (float)in[i] * (1.0f/S32_SCALE);
+    }
+}
+
+void floatToS32Scalar(const float *in, qint32 *out, int n) {
+    for (int i = 0; i < n; i++) {
+        out[i] = (qint32)lrintf(clampf(in[i] * S32_SCALE, -S32_SCALE, S32_MAX));
+    }
+}
+
+void interleave2Scalar(const float *left, const float *right, float *out, int frames) {
+    for (int i = 0; i < frames; i++) {
+        out[2*i] = left[i];
+        out[2*i+1] = right[i];
+    }
+}
+
+void deinterleave2Scalar(const float *in, float *left, float *right, int frames) {
+    for (int i = 0; i < frames; i++) {
+        left[i] = in[2*i];
+        right[i] = in[2*i+1];
+    }
+}
+
+void applyGainScalar(float *buf, int n, float gain) {
+    for (int i = 0; i < n; i++) {
+        buf[i] *= gain;
+    }
+}
+
+// the ramp gain at sample i is from + step*i, computed the same way by every table
+void applyGainRampScalar(float *buf, int n, float from, float to) {
+    if (n <= 0) {
+        return;
+    }
+    float step = (to - from) / n;
+    for (int i = 0; i < n; i++) {
+        buf[i] *= from + step * (float)i;
+    }
+}
+
+void mixGainScalar(float *dst, const float *src, int n, float gain) {
+    for (int i = 0; i < n; i++) {
+        dst[i] += src[i] * gain;
+    }
+}
+
+void mixGainRampScalar(float *dst, const float *src, int n, float from, float to) {
+    if (n <= 0) {
+        return;
+    }
+    float step = (to - from) / n;
+    for (int i = 0; i < n; i++) {
+        dst[i] += src[i] * (from + step * (float)i);
+    }
+}
+
+float peakAbsScalar(const float *buf, int n) {
+    float peak = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float v = fabsf(buf[i]);
+        if (v > peak) {
+            peak = v;
+        }
+    }
+    return peak;
+}
+
+// lanes[j] holds the squares of buf[j], buf[j+8], ... up to the last full
+// group of 8; the tail is added after the lanes
+double finishSumSquares(const double *lanes, const float *tail, int n) {
+    double sum = 0.0;
+    for (int j = 0; j < 8; j++) {
+        sum += lanes[j];
+    }
+    for (int i = 0; i < n; i++) {
+        sum += (double)tail[i] * (double)tail[i];
+    }
+    return sum;
+}
+
+double sumSquaresScalar(const float *buf, int n) {
+    double lanes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (int j = 0; j < 8; j++) {
+            lanes[j] += (double)buf[i+j] * (double)buf[i+j];
+        }
+    }
+    return finishSumSquares(lanes, buf + i, n - i);
+}
+
+void minMaxScalar(const float *buf, int n, float *lo, float *hi) {
+    float mn = *lo, mx = *hi;
+    for (int i = 0; i < n; i++) {
+        mn = buf[i] < mn ? buf[i] : mn;
+        mx = buf[i] > mx ? buf[i] : mx;
+    }
+    *lo = mn;
+    *hi = mx;
+}
+
+void applyWindowScalar(float *buf, const float *window, int n) {
+    for (int i = 0; i < n; i++) {
+        buf[i] *= window[i];
+    }
+}
+
+void fftButterflyScalar(float *ar, float *ai, float *br, float *bi,
+                        const float *wr, const float *wi, int n) {
+    for (int i = 0; i < n; i++) {
+        float tr = br[i] * wr[i] - bi[i] * wi[i];
+        float ti = br[i] * wi[i] + bi[i] * wr[i];
+        br[i] = ar[i] - tr;
+        bi[i] = ai[i] - ti;
+        ar[i] = ar[i] + tr;
+        ai[i] = ai[i] + ti;
+    }
+}
+
+void powerSpectrumScalar(const float *re, const float *im, float *out, int n) {
+    for (int i = 0; i < n; i++) {
+        float r2 = re[i] * re[i];
+        float i2 = im[i] * im[i];
+        out[i] = r2 + i2;
+    }
+}
+
+// lanes[j] holds the rises of element j, j+8, ... up to the last full group
+// of 8; the tail is added after the lanes
+float finishFluxSum(const float *lanes, const float *cur, const float *prev, int n) {
+    float sum = 0.0f;
+    for (int j = 0; j < 8; j++) {
+        sum += lanes[j];
+    }
+    for (int i = 0; i < n; i++) {
+        float d = cur[i] - prev[i];
+        sum += d > 0.0f ? d : 0.0f;
+    }
+    return sum;
+}
+
+float fluxSumScalar(const float *cur, const float *prev, int n) {
+    float lanes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (int j = 0; j < 8; j++) {
+            float d = cur[i+j] - prev[i+j];
+            lanes[j] += d > 0.0f ? d : 0.0f;
+        }
+    }
+    return finishFluxSum(lanes, cur + i, prev + i, n - i);
+}
+
+const SampleKernels scalarTable = {
+    "scalar",
+    s16ToFloatScalar, floatToS16Scalar,
+    s24ToFloatScalar, floatToS24Scalar,
+    s32ToFloatScalar, floatToS32Scalar,
+    interleave2Scalar, deinterleave2Scalar,
+    applyGainScalar, applyGainRampScalar,
+    mixGainScalar, mixGainRampScalar,
+    peakAbsScalar, sumSquaresScalar,
+    minMaxScalar,
+    applyWindowScalar, fftButterflyScalar,
+    powerSpectrumScalar, fluxSumScalar
+};
+
+#ifdef SAMPLEKERNELS_X86
+//--------------------SSE2---------------------
+// Each kernel handles 4 samples per step and leaves the tail to the scalar one.
+
+TARGET_SSE2 void s16ToFloatSse2(const qint16 *in, float *out, int n) {
+    const __m128 scale = _mm_set1_ps(1.0f/S16_SCALE);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        // sign-extend by unpacking into the high half and shifting back down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    s16ToFloatScalar(in + i, out + i, n - i);
+}
+
+TARGET_SSE2 void floatToS16Sse2(const float *in, qint16 *out, int n) {
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+    const __m128 lo = _mm_set1_ps(-S16_SCALE);
+    const __m128 hi = _mm_set1_ps(S16_SCALE-1);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), lo), hi);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), lo), hi);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i *)(out + i), packed);
+    }
+    floatToS16Scalar(in + i, out + i, n - i);
+}
+
+TARGET_SSE2 void s24ToFloatSse2(const uchar *in, float *out, int n) {
+    // 3-byte samples don't line up with SSE2 lanes, unpack them in scalar code
+    const __m128 scale = _mm_set1_ps(1.0f/S24_SCALE);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const uchar *p = in + 3*i;
+        __m128i v = _mm_setr_epi32(p[0] | (p[1] << 8) | ((qint32)(signed char)p[2] << 16),
+                                   p[3] | (p[4] << 8) | ((qint32)(signed char)p[5] << 16),
+                                   p[6] | (p[7] << 8) | ((qint32)(signed char)p[8] << 16),
+                                   p[9] | (p[10] << 8) | ((qint32)(signed char)p[11] << 16));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    s24ToFloatScalar(in + 3*i, out + i, n - i);
+}
+
+TARGET_SSE2 void floatToS24Sse2(const float *in, uchar *out, int n) {
+    const __m128 scale = _mm_set1_ps(S24_SCALE);
+    const __m128 lo = _mm_set1_ps(-S24_SCALE);
+    const __m128 hi = _mm_set1_ps(S24_SCALE-1);
+    int i = 0;
+    qint32 v[4];
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), lo), hi);
+        _mm_storeu_si128((__m128i *)v, _mm_cvtps_epi32(a));
+        uchar *p = out + 3*i;
+        for (int k = 0; k < 4; k++, p += 3) {
+            p[0] = (uchar)v[k];
+            p[1] = (uchar)(v[k] >> 8);
+            p[2] = (uchar)(v[k] >> 16);
+        }
+    }
+    floatToS24Scalar(in + i, out + 3*i, n - i);
+}
+
+TARGET_SSE2 void s32ToFloatSse2(const qint32 *in, float *out, int n) {
+    const __m128 scale = _mm_set1_ps(1.0f/S32_SCALE);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    s32ToFloatScalar(in + i, out + i, n - i);
+}
+
+TARGET_SSE2 void floatToS32Sse2(const float *in, qint32 *out, int n) {
+    const __m128 scale = _mm_set1_ps(S32_SCALE);
+    const __m128 lo = _mm_set1_ps(-S32_SCALE);
+    const __m128 hi = _mm_set1_ps(S32_MAX);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), lo), hi);
+        _mm_storeu_si128((__m128i *)(out + i), _mm_cvtps_epi32(a));
+    }
+    floatToS32Scalar(in + i, out + i, n - i);
+}
+
+TARGET_SSE2 void interleave2Sse2(const float *left, const float *right, float *out, int frames) {
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(out + 2*i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(out + 2*i + 4, _mm_unpackhi_ps(l, r));
+    }
+    interleave2Scalar(left + i, right + i, out + 2*i, frames - i);
+}
+
+TARGET_SSE2 void deinterleave2Sse2(const float *in, float *left, float *right, int frames) {
+    int i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        __m128 a = _mm_loadu_ps(in + 2*i);
+        __m128 b = _mm_loadu_ps(in + 2*i + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    deinterleave2Scalar(in + 2*i, left + i, right + i, frames - i);
+}
+
+TARGET_SSE2 void applyGainSse2(float *buf, int n, float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+    }
+    applyGainScalar(buf + i, n - i, gain);
+}
+
+TARGET_SSE2 void applyGainRampSse2(float *buf, int n, float from, float to) {
+    if (n <= 0) {
+        return;
+    }
+    float step = (to - from) / n;
+    const __m128 vfrom = _mm_set1_ps(from);
+    const __m128 vstep = _mm_set1_ps(step);
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 idx = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(i), lane));
+        __m128 g = _mm_add_ps(vfrom, _mm_mul_ps(vstep, idx));
+        _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+    }
+    for (; i < n; i++) {
+        buf[i] *= from + step * (float)i;
+    }
+}
+
+TARGET_SSE2 void mixGainSse2(float *dst, const float *src, int n, float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 d = _mm_loadu_ps(dst + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    }
+    mixGainScalar(dst + i, src + i, n - i, gain);
+}
+
+TARGET_SSE2 void mixGainRampSse2(float *dst, const float *src, int n, float from, float to) {
+    if (n <= 0) {
+        return;
+    }
+    float step = (to - from) / n;
+    const __m128 vfrom = _mm_set1_ps(from);
+    const __m128 vstep = _mm_set1_ps(step);
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 idx = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(i), lane));
+        __m128 g = _mm_add_ps(vfrom, _mm_mul_ps(vstep, idx));
+        __m128 d = _mm_loadu_ps(dst + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    }
+    for (; i < n; i++) {
+        dst[i] += src[i] * (from + step * (float)i);
+    }
+}
+
+TARGET_SSE2 float peakAbsSse2(const float *buf, int n) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 peak = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(buf + i), absMask));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, peak);
+    float result = peakAbsScalar(buf + i, n - i);
+    for (int j = 0; j < 4; j++) {
+        if (lanes[j] > result) {
+            result = lanes[j];
+        }
+    }
+    return result;
+}
+
+TARGET_SSE2 double sumSquaresSse2(const float *buf, int n) {
+    __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    __m128d acc2 = _mm_setzero_pd(), acc3 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_loadu_ps(buf + i);
+        __m128 b = _mm_loadu_ps(buf + i + 4);
+        __m128d a0 = _mm_cvtps_pd(a), a1 = _mm_cvtps_pd(_mm_movehl_ps(a, a));
+        __m128d b0 = _mm_cvtps_pd(b), b1 = _mm_cvtps_pd(_mm_movehl_ps(b, b));
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(a0, a0));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(a1, a1));
+        acc2 = _mm_add_pd(acc2, _mm_mul_pd(b0, b0));
+        acc3 = _mm_add_pd(acc3, _mm_mul_pd(b1, b1));
+    }
+    double lanes[8];
+    _mm_storeu_pd(lanes, acc0);
+    _mm_storeu_pd(lanes + 2, acc1);
+    _mm_storeu_pd(lanes + 4, acc2);
+    _mm_storeu_pd(lanes + 6, acc3);
+    return finishSumSquares(lanes, buf + i, n - i);
+}
+
+TARGET_SSE2 void minMaxSse2(const float *buf, int n, float *lo, float *hi) {
+    if (n < 4) {
+        minMaxScalar(buf, n, lo, hi);
+        return;
+    }
+    __m128 mn = _mm_set1_ps(*lo), mx = _mm_set1_ps(*hi);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(buf + i);
+        mn = _mm_min_ps(mn, v);
+        mx = _mm_max_ps(mx, v);
+    }
+    float lanesLo[4], lanesHi[4];
+    _mm_storeu_ps(lanesLo, mn);
+    _mm_storeu_ps(lanesHi, mx);
+    for (int j = 0; j < 4; j++) {
+        minMaxScalar(lanesLo + j, 1, lo, hi);
+        minMaxScalar(lanesHi + j, 1, lo, hi);
+    }
+    minMaxScalar(buf + i, n - i, lo, hi);
+}
+
+TARGET_SSE2 void applyWindowSse2(float *buf, const float *window, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), _mm_loadu_ps(window + i)));
+    }
+    applyWindowScalar(buf + i, window + i, n - i);
+}
+
+TARGET_SSE2 void fftButterflySse2(float *ar, float *ai, float *br, float *bi,
+                                  const float *wr, const float *wi, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 xr = _mm_loadu_ps(ar + i), xi = _mm_loadu_ps(ai + i);
+        __m128 yr = _mm_loadu_ps(br + i), yi = _mm_loadu_ps(bi + i);
+        __m128 cr = _mm_loadu_ps(wr + i), ci = _mm_loadu_ps(wi + i);
+        __m128 tr = _mm_sub_ps(_mm_mul_ps(yr, cr), _mm_mul_ps(yi, ci));
+        __m128 ti = _mm_add_ps(_mm_mul_ps(yr, ci), _mm_mul_ps(yi, cr));
+        _mm_storeu_ps(br + i, _mm_sub_ps(xr, tr));
+        _mm_storeu_ps(bi + i, _mm_sub_ps(xi, ti));
+        _mm_storeu_ps(ar + i, _mm_add_ps(xr, tr));
+        _mm_storeu_ps(ai + i, _mm_add_ps(xi, ti));
+    }
+    fftButterflyScalar(ar + i, ai + i, br + i, bi + i, wr + i, wi + i, n - i);
+}
+
+TARGET_SSE2 void powerSpectrumSse2(const float *re, const float *im, float *out, int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 r = _mm_loadu_ps(re + i), m = _mm_loadu_ps(im + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(m, m)));
+    }
+    powerSpectrumScalar(re + i, im + i, out + i, n - i);
+}
+
+TARGET_SSE2 float fluxSumSse2(const float *cur, const float *prev, int n) {
+    const __m128 zero = _mm_setzero_ps();
+    __m128 acc0 = zero, acc1 = zero;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(cur + i), _mm_loadu_ps(prev + i));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(cur + i + 4), _mm_loadu_ps(prev + i + 4));
+        acc0 = _mm_add_ps(acc0, _mm_max_ps(d0, zero));
+        acc1 = _mm_add_ps(acc1, _mm_max_ps(d1, zero));
+    }
+    float lanes[8];
+    _mm_storeu_ps(lanes, acc0);
+    _mm_storeu_ps(lanes + 4, acc1);
+    return finishFluxSum(lanes, cur + i, prev + i, n - i);
+}
+
+const SampleKernels sse2Table = {
+    "sse2",
+    s16ToFloatSse2, floatToS16Sse2,
+    s24ToFloatSse2, floatToS24Sse2,
+    s32ToFloatSse2, floatToS32Sse2,
+    interleave2Sse2, deinterleave2Sse2,
+    applyGainSse2, applyGainRampSse2,
+    mixGainSse2, mixGainRampSse2,
+    peakAbsSse2, sumSquaresSse2,
+    minMaxSse2,
+    applyWindowSse2, fftButterflySse2,
+    powerSpectrumSse2, fluxSumSse2
+};
+
+//--------------------AVX2---------------------
+// 8 samples per step; packed 24-bit stays on the SSE2 kernels.
+
+TARGET_AVX2 void s16ToFloatAvx2(const qint16 *in, float *out, int n) {
+    const __m256 scale = _mm256_set1_ps(1.0f/S16_SCALE);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    s16ToFloatScalar(in + i, out + i, n - i);
+}
+
+TARGET_AVX2 void floatToS16Avx2(const float *in, qint16 *out, int n) {
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+    const __m256 lo = _mm256_set1_ps(-S16_SCALE);
+    const __m256 hi = _mm256_set1_ps(S16_SCALE-1);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), lo), hi);
+        __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale), lo), hi);
+        // packs works per 128-bit lane, so restore the order afterwards
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        packed = _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(out + i), packed);
+    }
+    floatToS16Sse2(in + i, out + i, n - i);
+}
+
+TARGET_AVX2 void s32ToFloatAvx2(const qint32 *in, float *out, int n) {
+    const __m256 scale = _mm256_set1_ps(1.0f/S32_SCALE);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    s32ToFloatScalar(in + i, out + i, n - i);
+}
+
+TARGET_AVX2 void floatToS32Avx2(const float *in, qint32 *out, int n) {
+    const __m256 scale = _mm256_set1_ps(S32_SCALE);
+    const __m256 lo = _mm256_set1_ps(-S32_SCALE);
+    const __m256 hi = _mm256_set1_ps(S32_MAX);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), lo), hi);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_cvtps_epi32(a));
+    }
+    floatToS32Scalar(in + i, out + i, n - i);
+}
+
+TARGET_AVX2 void interleave2Avx2(const float *left, const float *right, float *out, int frames) {
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 l = _mm256_loadu_ps(left + i);
+        __m256 r = _mm256_loadu_ps(right + i);
+        __m256 lo = _mm256_unpacklo_ps(l, r);   // l0 r0 l1 r1 | l4 r4 l5 r5
+        __m256 hi = _mm256_unpackhi_ps(l, r);   // l2 r2 l3 r3 | l6 r6 l7 r7
+        _mm256_storeu_ps(out + 2*i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + 2*i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    interleave2Scalar(left + i, right + i, out + 2*i, frames - i);
+}
+
+TARGET_AVX2 void deinterleave2Avx2(const float *in, float *left, float *right, int frames) {
+    int i = 0;
+    for (; i + 8 <= frames; i += 8) {
+        __m256 a = _mm256_loadu_ps(in + 2*i);
+        __m256 b = _mm256_loadu_ps(in + 2*i + 8);
+        __m256 lo = _mm256_permute2f128_ps(a, b, 0x20);  // l0 r0 l1 r1 | l4 r4 l5 r5
+        __m256 hi = _mm256_permute2f128_ps(a, b, 0x31);  // l2 r2 l3 r3 | l6 r6 l7 r7
+        _mm256_storeu_ps(left + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm256_storeu_ps(right + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    deinterleave2Scalar(in + 2*i, left + i, right + i, frames - i);
+}
+
+TARGET_AVX2 void applyGainAvx2(float *buf, int n, float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), g));
+    }
+    applyGainScalar(buf + i, n - i, gain);
+}
+
+TARGET_AVX2 void applyGainRampAvx2(float *buf, int n, float from, float to) {
+    if (n <= 0) {
+        return;
+    }
+    float step = (to - from) / n;
+    const __m256 vfrom = _mm256_set1_ps(from);
+    const __m256 vstep = _mm256_set1_ps(step);
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 idx = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(i), lane));
+        __m256 g = _mm256_add_ps(vfrom, _mm256_mul_ps(vstep, idx));
+        _mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), g));
+    }
+    for (; i < n; i++) {
+        buf[i] *= from + step * (float)i;
+    }
+}
+
+TARGET_AVX2 void mixGainAvx2(float *dst, const float *src, int n, float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_loadu_ps(dst + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+    }
+    mixGainScalar(dst + i, src + i, n - i, gain);
+}
+
+TARGET_AVX2 void mixGainRampAvx2(float *dst, const float *src, int n, float from, float to) {
+    if (n <= 0) {
+        return;
+    }
+    float step = (to - from) / n;
+    const __m256 vfrom = _mm256_set1_ps(from);
+    const __m256 vstep = _mm256_set1_ps(step);
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 idx = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(i), lane));
+        __m256 g = _mm256_add_ps(vfrom, _mm256_mul_ps(vstep, idx));
+        __m256 d = _mm256_loadu_ps(dst + i);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(d, _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+    }
+    for (; i < n; i++) {
+        dst[i] += src[i] * (from + step * (float)i);
+    }
+}
+
+TARGET_AVX2 float peakAbsAvx2(const float *buf, int n) {
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 peak = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        peak = _mm256_max_ps(peak, _mm256_and_ps(_mm256_loadu_ps(buf + i), absMask));
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, peak);
+    float result = peakAbsScalar(buf + i, n - i);
+    for (int j = 0; j < 8; j++) {
+        if (lanes[j] > result) {
+            result = lanes[j];
+        }
+    }
+    return result;
+}
+
+TARGET_AVX2 double sumSquaresAvx2(const float *buf, int n) {
+    __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d a = _mm256_cvtps_pd(_mm_loadu_ps(buf + i));
+        __m256d b = _mm256_cvtps_pd(_mm_loadu_ps(buf + i + 4));
+        // separate mul and add, a fused multiply-add would round differently
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(a, a));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(b, b));
+    }
+    double lanes[8];
+    _mm256_storeu_pd(lanes, acc0);
+    _mm256_storeu_pd(lanes + 4, acc1);
+    return finishSumSquares(lanes, buf + i, n - i);
+}
+
+TARGET_AVX2 void minMaxAvx2(const float *buf, int n, float *lo, float *hi) {
+    if (n < 8) {
+        minMaxSse2(buf, n, lo, hi);
+        return;
+    }
+    __m256 mn = _mm256_set1_ps(*lo), mx = _mm256_set1_ps(*hi);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(buf + i);
+        mn = _mm256_min_ps(mn, v);
+        mx = _mm256_max_ps(mx, v);
+    }
+    float lanesLo[8], lanesHi[8];
+    _mm256_storeu_ps(lanesLo, mn);
+    _mm256_storeu_ps(lanesHi, mx);
+    for (int j = 0; j < 8; j++) {
+        minMaxScalar(lanesLo + j, 1, lo, hi);
+        minMaxScalar(lanesHi + j, 1, lo, hi);
+    }
+    minMaxScalar(buf + i, n - i, lo, hi);
+}
+
+TARGET_AVX2 void applyWindowAvx2(float *buf, const float *window, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), _mm256_loadu_ps(window + i)));
+    }
+    applyWindowScalar(buf + i, window + i, n - i);
+}
+
+TARGET_AVX2 void fftButterflyAvx2(float *ar, float *ai, float *br, float *bi,
+                                  const float *wr, const float *wi, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 xr = _mm256_loadu_ps(ar + i), xi = _mm256_loadu_ps(ai + i);
+        __m256 yr = _mm256_loadu_ps(br + i), yi = _mm256_loadu_ps(bi + i);
+        __m256 cr = _mm256_loadu_ps(wr + i), ci = _mm256_loadu_ps(wi + i);
+        __m256 tr = _mm256_sub_ps(_mm256_mul_ps(yr, cr), _mm256_mul_ps(yi, ci));
+        __m256 ti = _mm256_add_ps(_mm256_mul_ps(yr, ci), _mm256_mul_ps(yi, cr));
+        _mm256_storeu_ps(br + i, _mm256_sub_ps(xr, tr));
+        _mm256_storeu_ps(bi + i, _mm256_sub_ps(xi, ti));
+        _mm256_storeu_ps(ar + i, _mm256_add_ps(xr, tr));
+        _mm256_storeu_ps(ai + i, _mm256_add_ps(xi, ti));
+    }
+    fftButterflySse2(ar + i, ai + i, br + i, bi + i, wr + i, wi + i, n - i);
+}
+
+TARGET_AVX2 void powerSpectrumAvx2(const float *re, const float *im, float *out, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 r = _mm256_loadu_ps(re + i), m = _mm256_loadu_ps(im + i);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_mul_ps(r, r), _mm256_mul_ps(m, m)));
+    }
+    powerSpectrumSse2(re + i, im + i, out + i, n - i);
+}
+
+TARGET_AVX2 float fluxSumAvx2(const float *cur, const float *prev, int n) {
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 acc = zero;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(cur + i), _mm256_loadu_ps(prev + i));
+        acc = _mm256_add_ps(acc, _mm256_max_ps(d, zero));
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, acc);
+    return finishFluxSum(lanes, cur + i, prev + i, n - i);
+}
+
+const SampleKernels avx2Table = {
+    "avx2",
+    s16ToFloatAvx2, floatToS16Avx2,
+    s24ToFloatSse2, floatToS24Sse2,
+    s32ToFloatAvx2, floatToS32Avx2,
+    interleave2Avx2, deinterleave2Avx2,
+    applyGainAvx2, applyGainRampAvx2,
+    mixGainAvx2, mixGainRampAvx2,
+    peakAbsAvx2, sumSquaresAvx2,
+    minMaxAvx2,
+    applyWindowAvx2, fftButterflyAvx2,
+    powerSpectrumAvx2, fluxSumAvx2
+};
+
+bool cpuHasSse2() {
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) {
+        return false;
+    }
+    return d & (1 << 26);
+}
+
+bool cpuHasAvx2() {
+    unsigned int a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) {
+        return false;
+    }
+    // the OS must save the YMM registers too (OSXSAVE + XCR0 bits 1 and 2)
+    if (!(c & (1 << 27)) || !(c & (1 << 28))) {
+        return false;
+    }
+    unsigned int xcr0Lo, xcr0Hi;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+    if ((xcr0Lo & 6) != 6) {
+        return false;
+    }
+    if (__get_cpuid_max(0, 0) < 7) {
+        return false;
+    }
+    __cpuid_count(7, 0, a, b, c, d);
+    return b & (1 << 5);
+}
+#endif
+
+const SampleKernels *pickKernels() {
+#ifdef SAMPLEKERNELS_X86
+    if (cpuHasAvx2()) {
+        return &avx2Table;
+    }
+    if (cpuHasSse2()) {
+        return &sse2Table;
+    }
+#endif
+    return &scalarTable;
+}
+
+// small deterministic generator, so verification runs are reproducible
+quint32 nextRandom(quint32 &state) {
+    state = state * 1664525u + 1013904223u;
+    return state;
+}
+
+}
+
+const SampleKernels &sampleKernels() {
+    static const SampleKernels *kernels = pickKernels();
+    return *kernels;
+}
+
+const SampleKernels &scalarSampleKernels() {
+    return scalarTable;
+}
+
+int availableSampleKernels(const SampleKernels **tables, int max) {
+    int count = 0;
+    if (count < max) {
+        tables[count++] = &scalarTable;
+    }
+#ifdef SAMPLEKERNELS_X86
+    if (count < max && cpuHasSse2()) {
+        tables[count++] = &sse2Table;
+    }
+    if (count < max && cpuHasAvx2()) {
+        tables[count++] = &avx2Table;
+    }
+#endif
+    return count;
+}
+
+bool verifySampleKernels() {
+    // odd length so every kernel's scalar tail is exercised as well
+    const int n = 4099;
+    quint32 seed = 12345;
+    QVector<float> f(2*n), f2(2*n);
+    QVector<qint16> i16(n);
+    QVector<qint32> i32(n);
+    QVector<uchar> i24(3*n);
+    for (int i = 0; i < 2*n; i++) {
+        // slightly beyond [-1, 1] so clamping is covered
+        f[i] = ((qint32)nextRandom(seed) / 2147483648.0f) * 1.1f;
+    }
+    for (int i = 0; i < n; i++) {
+        i16[i] = (qint16)(nextRandom(seed) >> 16);
+        i32[i] = (qint32)nextRandom(seed);
+    }
+    for (int i = 0; i < 3*n; i++) {
+        i24[i] = (uchar)(nextRandom(seed) >> 24);
+    }
+
+    const SampleKernels &ref = scalarTable;
+    const SampleKernels *tables[4];
+    int count = availableSampleKernels(tables, 4);
+    for (int t = 1; t < count; t++) {
+        const SampleKernels &k = *tables[t];
+        QVector<float> a(2*n), b(2*n), c(2*n), d(2*n);
+        QVector<qint16> o16a(n), o16b(n);
+        QVector<qint32> o32a(n), o32b(n);
+        QVector<uchar> o24a(3*n), o24b(3*n);
+
+#define CHECK(what, x, y, bytes) \
+        if (memcmp((x), (y), (bytes)) != 0) { \
+            qWarning() << "SampleKernels:" << k.name << what << "differs from scalar"; \
+            return false; \
+        }
+        ref.s16ToFloat(i16.constData(), a.data(), n);
+        k.s16ToFloat(i16.constData(), b.data(), n);
+        CHECK("s16ToFloat", a.constData(), b.constData(), n*sizeof(float));
+        ref.floatToS16(f.constData(), o16a.data(), n);
+        k.floatToS16(f.constData(), o16b.data(), n);
+        CHECK("floatToS16", o16a.constData(), o16b.constData(), n*sizeof(qint16));
+        ref.s24ToFloat(i24.constData(), a.data(), n);
+        k.s24ToFloat(i24.constData(), b.data(), n);
+        CHECK("s24ToFloat", a.constData(), b.constData(), n*sizeof(float));
+        ref.floatToS24(f.constData(), o24a.data(), n);
+        k.floatToS24(f.constData(), o24b.data(), n);
+        CHECK("floatToS24", o24a.constData(), o24b.constData(), 3*n);
+        ref.s32ToFloat(i32.constData(), a.data(), n);
+        k.s32ToFloat(i32.constData(), b.data(), n);
+        CHECK("s32ToFloat", a.constData(), b.constData(), n*sizeof(float));
+        ref.floatToS32(f.constData(), o32a.data(), n);
+        k.floatToS32(f.constData(), o32b.data(), n);
+        CHECK("floatToS32", o32a.constData(), o32b.constData(), n*sizeof(qint32));
+
+        ref.interleave2(f.constData(), f.constData() + n, a.data(), n);
+        k.interleave2(f.constData(), f.constData() + n, b.data(), n);
+        CHECK("interleave2", a.constData(), b.constData(), 2*n*sizeof(float));
+        ref.deinterleave2(f.constData(), a.data(), a.data() + n, n);
+        k.deinterleave2(f.constData(), b.data(), b.data() + n, n);
+        CHECK("deinterleave2", a.constData(), b.constData(), 2*n*sizeof(float));
+
+        a = f; b = f;
+        ref.applyGain(a.data(), 2*n, 0.7f);
+        k.applyGain(b.data(), 2*n, 0.7f);
+        CHECK("applyGain", a.constData(), b.constData(), 2*n*sizeof(float));
+        a = f; b = f;
+        ref.applyGainRamp(a.data(), 2*n, 1.0f, 0.0f);
+        k.applyGainRamp(b.data(), 2*n, 1.0f, 0.0f);
+        CHECK("applyGainRamp", a.constData(), b.constData(), 2*n*sizeof(float));
+
+        for (int i = 0; i < 2*n; i++) {
+            f2[i] = f[(i*7) % (2*n)];
+        }
+        c = f; d = f;
+        ref.mixGain(c.data(), f2.constData(), 2*n, 0.5f);
+        k.mixGain(d.data(), f2.constData(), 2*n, 0.5f);
+        CHECK("mixGain", c.constData(), d.constData(), 2*n*sizeof(float));
+        c = f; d = f;
+        ref.mixGainRamp(c.data(), f2.constData(), 2*n, 0.0f, 1.0f);
+        k.mixGainRamp(d.data(), f2.constData(), 2*n, 0.0f, 1.0f);
+        CHECK("mixGainRamp", c.constData(), d.constData(), 2*n*sizeof(float));
+
+        float peakA = ref.peakAbs(f.constData(), 2*n - 1);
+        float peakB = k.peakAbs(f.constData(), 2*n - 1);
+        CHECK("peakAbs", &peakA, &peakB, sizeof(float));
+        double sumA = ref.sumSquares(f.constData(), 2*n - 1);
+        double sumB = k.sumSquares(f.constData(), 2*n - 1);
+        CHECK("sumSquares", &sumA, &sumB, sizeof(double));
+        float range[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        ref.minMax(f.constData(), 2*n - 1, &range[0], &range[1]);
+        k.minMax(f.constData(), 2*n - 1, &range[2], &range[3]);
+        CHECK("minMax", &range[0], &range[2], 2*sizeof(float));
+
+        a = f; b = f;
+        ref.applyWindow(a.data(), f2.constData(), 2*n - 1);
+        k.applyWindow(b.data(), f2.constData(), 2*n - 1);
+        CHECK("applyWindow", a.constData(), b.constData(), 2*n*sizeof(float));
+        // a/b hold the a and b operands in their halves, f/f2 double as twiddles
+        a = f; b = f;
+        c = f2; d = f2;
+        ref.fftButterfly(a.data(), c.data(), a.data() + n, c.data() + n, f.constData(), f2.constData(), n);
+        k.fftButterfly(b.data(), d.data(), b.data() + n, d.data() + n, f.constData(), f2.constData(), n);
+        CHECK("fftButterfly", a.constData(), b.constData(), 2*n*sizeof(float));
+        CHECK("fftButterfly", c.constData(), d.constData(), 2*n*sizeof(float));
+
+        ref.powerSpectrum(f.constData(), f2.constData(), a.data(), 2*n - 1);
+        k.powerSpectrum(f.constData(), f2.constData(), b.data(), 2*n - 1);
+        CHECK("powerSpectrum", a.constData(), b.constData(), (2*n - 1)*sizeof(float));
+        float fluxA = ref.fluxSum(f.constData(), f2.constData(), 2*n - 1);
+        float fluxB = k.fluxSum(f.constData(), f2.constData(), 2*n - 1);
+        CHECK("fluxSum", &fluxA, &fluxB, sizeof(float));
+#undef CHECK
+    }
+    return true;
+}
+
+void benchmarkSampleKernels(int samples, int rounds) {
+    QVector<float> f(2*samples, 0.25f), g(2*samples, 0.5f);
+    QVector<qint16> i16(samples, 1000);
+    QVector<qint32> i32(samples, 100000);
+    QVector<uchar> i24(3*samples, 7);
+    const SampleKernels *tables[4];
+    int count = availableSampleKernels(tables, 4);
+    QElapsedTimer timer;
+
+    for (int t = 0; t < count; t++) {
+        const SampleKernels &k = *tables[t];
+#define BENCH(what, call) \
+        timer.start(); \
+        for (int r = 0; r < rounds; r++) { call; } \
+        qDebug() << "SampleKernels:" << k.name << what \
+                 << (double)timer.nsecsElapsed() / ((double)samples*rounds) << "ns/sample";
+        BENCH("s16ToFloat", k.s16ToFloat(i16.constData(), f.data(), samples));
+        BENCH("floatToS16", k.floatToS16(f.constData(), i16.data(), samples));
+        BENCH("s24ToFloat", k.s24ToFloat(i24.constData(), f.data(), samples));
+        BENCH("floatToS24", k.floatToS24(f.constData(), i24.data(), samples));
+        BENCH("s32ToFloat", k.s32ToFloat(i32.constData(), f.data(), samples));
+        BENCH("floatToS32", k.floatToS32(f.constData(), i32.data(), samples));
+        BENCH("interleave2", k.interleave2(g.constData(), g.constData() + samples/2, f.data(), samples/2));
+        BENCH("deinterleave2", k.deinterleave2(g.constData(), f.data(), f.data() + samples/2, samples/2));
+        BENCH("applyGain", k.applyGain(f.data(), samples, 0.999f));
+        BENCH("applyGainRamp", k.applyGainRamp(f.data(), samples, 1.0f, 0.999f));
+        BENCH("mixGain", k.mixGain(f.data(), g.constData(), samples, 0.001f));
+        BENCH("mixGainRamp", k.mixGainRamp(f.data(), g.constData(), samples, 0.0f, 0.001f));
+        BENCH("peakAbs", k.peakAbs(g.constData(), samples));
+        BENCH("sumSquares", k.sumSquares(g.constData(), samples));
+        float lo = 0.0f, hi = 0.0f;
+        BENCH("minMax", k.minMax(g.constData(), samples, &lo, &hi));
+        BENCH("applyWindow", k.applyWindow(f.data(), g.constData(), samples));
+        BENCH("fftButterfly", k.fftButterfly(f.data(), f.data() + samples/2, g.data(), g.data() + samples/2,
+                                             g.constData(), g.constData(), samples/2));
+        BENCH("powerSpectrum", k.powerSpectrum(g.constData(), g.constData() + samples, f.data(), samples));
+        BENCH("fluxSum", k.fluxSum(g.constData(), f.constData(), samples));
+#undef BENCH
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "debug.h"
+#include <QtGlobal>
+
+/*
+ * Sample format conversion and mixing kernels used by the audio pipeline and
+ * the analysis jobs. Each table holds one implementation of every kernel;
+ * sampleKernels() returns the fastest table the CPU supports (AVX2, SSE2 or
+ * the scalar reference), picked once at first use.
+ *
+ * Floats are in [-1, 1). Float to integer conversions clamp, then round to
+ * nearest even, so every table produces bit-identical output to the scalar
+ * one. Packed 24-bit samples are 3 bytes, little endian.
+ */
+struct SampleKernels {
+    const char *name;
+
+    void (*s16ToFloat)(const qint16 *in, float *out, int n);
+    void (*floatToS16)(const float *in, qint16 *out, int n);
+    void (*s24ToFloat)(const uchar *in, float *out, int n);
+    void (*floatToS24)(const float *in, uchar *out, int n);
+    void (*s32ToFloat)(const qint32 *in, float *out, int n);
+    void (*floatToS32)(const float *in, qint32 *out, int n);
+
+    // stereo <-> planar
+    void (*interleave2)(const float *left, const float *right, float *out, int frames);
+    void (*deinterleave2)(const float *in, float *left, float *right, int frames);
+
+    // buf *= gain, or a linear ramp from `from` (at sample 0) towards `to` (at sample n)
+    void (*applyGain)(float *buf, int n, float gain);
+    void (*applyGainRamp)(float *buf, int n, float from, float to);
+
+    // dst += src * gain, with a constant or ramped gain
+    void (*mixGain)(float *dst, const float *src, int n, float gain);
+    void (*mixGainRamp)(float *dst, const float *src, int n, float from, float to);
+
+    // largest |buf[i]|, and the sum of buf[i]^2 accumulated in double. The sum
+    // is kept in 8 interleaved partial sums that are added up in a fixed
+    // order, so it is bit-identical across tables too.
+    float (*peakAbs)(const float *buf, int n);
+    double (*sumSquares)(const float *buf, int n);
+
+    // lowest and highest sample, folded into *lo and *hi (which the caller
+    // initialises, so runs of buffers can be accumulated)
+    void (*minMax)(const float *buf, int n, float *lo, float *hi);
+
+    // buf[i] *= window[i]
+    void (*applyWindow)(float *buf, const float *window, int n);
+    // n radix-2 butterflies on split complex data: t = b * w, b = a - t, a = a + t
+    void (*fftButterfly)(float *ar, float *ai, float *br, float *bi,
+                         const float *wr, const float *wi, int n);
+
+    // out[i] = re[i]^2 + im[i]^2
+    void (*powerSpectrum)(const float *re, const float *im, float *out, int n);
+    // sum of max(cur[i] - prev[i], 0), in 8 interleaved partial sums like sumSquares
+    float (*fluxSum)(const float *cur, const float *prev, int n);
+};
+
+const SampleKernels &sampleKernels();
+const SampleKernels &scalarSampleKernels();
+
+// every table the running CPU can execute, scalar first; returns the count
+int availableSampleKernels(const SampleKernels **tables, int max);
+
+// compare each available table against the scalar one on random input,
+// returns false (and qWarning()s the kernel) on the first mismatching bit
+bool verifySampleKernels();
+
+// time every kernel of every available table, printed with qDebug()
+void benchmarkSampleKernels(int samples = 1 << 20, int rounds = 50);
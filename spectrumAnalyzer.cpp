@@ -0,0 +1,233 @@
+#include "spectrumAnalyzer.h"
+#include "sampleKernels.h"
+#include <QAudioProbe>
+#include <QTimer>
+#include <QDebug>
+#include <qmath.h>
+#include <string.h>
+
+namespace {
+// analysis input the worker will hold before it skips ahead to catch up
+const int MAX_BACKLOG_FRAMES = 8 * SpectrumWorker::FFT_SIZE;
+// the pipeline always outputs 16-bit stereo at this rate
+const int TAP_RATE = 44100;
+const int TAP_CHANNELS = 2;
+const float FLOOR_DB = -90.0f;
+}
+
+//--------------------SpectrumWorker---------------------
+SpectrumWorker::SpectrumWorker(SpectrumAnalyzer *owner, RingBuffer *tapRing)
+    : QObject(0), analyzer(owner), tap(tapRing), pollTimer(0), fft(FFT_SIZE) {
+    rate = TAP_RATE;
+    sequence = 0;
+    fill = 0;
+    fifo.resize(2 * (MAX_BACKLOG_FRAMES + FFT_SIZE));
+    tapPcm.resize(TAP_CHANNELS * FFT_SIZE);
+    left.resize(FFT_SIZE);
+    right.resize(FFT_SIZE);
+    re.resize(FFT_SIZE);
+    im.resize(FFT_SIZE);
+    window.resize(FFT_SIZE);
+    for (int i = 0; i < FFT_SIZE; i++) {
+        window[i] = (float)(0.5 - 0.5 * qCos(2.0 * M_PI * i / FFT_SIZE));
+    }
+}
+
+void SpectrumWorker::start() {
+    // created here so the timer lives on the worker's thread
+    pollTimer = new QTimer(this);
+    pollTimer->setInterval(10);
+    connect(pollTimer, SIGNAL(timeout()), this, SLOT(pollTap()));
+    pollTimer->start();
+}
+
+void SpectrumWorker::stop() {
+    if (pollTimer) {
+        pollTimer->stop();
+    }
+}
+
+void SpectrumWorker::pollTap() {
+    const SampleKernels &k = sampleKernels();
+    const int bytesPerFrame = TAP_CHANNELS * sizeof(qint16);
+    while (tap->available() >= bytesPerFrame) {
+        int frames = qMin(tap->available() / bytesPerFrame, (int)FFT_SIZE);
+        tap->read((char *)tapPcm.data(), frames * bytesPerFrame);
+        if (converted.size() < frames * TAP_CHANNELS) {
+            converted.resize(frames * TAP_CHANNELS);
+        }
+        k.s16ToFloat(tapPcm.constData(), converted.data(), frames * TAP_CHANNELS);
+        append(converted.constData(), frames, TAP_CHANNELS, TAP_RATE);
+    }
+}
+
+void SpectrumWorker::probeBuffer(QAudioBuffer buffer) {
+    // QMediaPlayer's buffers come in whatever format the backend decodes to
+    if (!buffer.isValid()) {
+        return;
+    }
+    const SampleKernels &k = sampleKernels();
+    QAudioFormat format = buffer.format();
+    int samples = buffer.sampleCount();
+    if (converted.size() < samples) {
+        converted.resize(samples);
+    }
+    if (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 16) {
+        k.s16ToFloat(buffer.constData<qint16>(), converted.data(), samples);
+    } else if (format.sampleType() == QAudioFormat::SignedInt && format.sampleSize() == 32) {
+        k.s32ToFloat(buffer.constData<qint32>(), converted.data(), samples);
+    } else if (format.sampleType() == QAudioFormat::Float && format.sampleSize() == 32) {
+        memcpy(converted.data(), buffer.constData(), samples * sizeof(float));
+    } else {
+        return;
+    }
+    append(converted.constData(), buffer.frameCount(), format.channelCount(), format.sampleRate());
+}
+
+void SpectrumWorker::append(const float *samples, int frames, int channels, int sampleRate) {
+    if (channels < 1 || sampleRate <= 0) {
+        return;
+    }
+    if (sampleRate != rate) {
+        // a new stream, don't mix it into an old window
+        rate = sampleRate;
+        fill = 0;
+    }
+    // fell behind: keep only the most recent window's worth
+    if (fill + frames > MAX_BACKLOG_FRAMES) {
+        int drop = qMin(fill, fill + frames - MAX_BACKLOG_FRAMES);
+        memmove(fifo.data(), fifo.constData() + 2 * drop, 2 * (fill - drop) * sizeof(float));
+        fill -= drop;
+        analyzer->skippedInput(drop);
+        if (frames > MAX_BACKLOG_FRAMES) {
+            analyzer->skippedInput(frames - MAX_BACKLOG_FRAMES);
+            samples += (frames - MAX_BACKLOG_FRAMES) * channels;
+            frames = MAX_BACKLOG_FRAMES;
+        }
+    }
+    float *out = fifo.data() + 2 * fill;
+    if (channels == 2) {
+        memcpy(out, samples, 2 * frames * sizeof(float));
+    } else {
+        // mono is duplicated, anything beyond stereo is reduced to the front pair
+        for (int i = 0; i < frames; i++) {
+            out[2*i] = samples[i * channels];
+            out[2*i+1] = samples[i * channels + (channels > 1 ? 1 : 0)];
+        }
+    }
+    fill += frames;
+    analyse();
+}
+
+void SpectrumWorker::analyse() {
+    const SampleKernels &k = sampleKernels();
+    const int n = FFT_SIZE;
+    // full-scale sine through a Hann window peaks at n/4 in its bin
+    const float norm = 1.0f / ((n / 4.0f) * (n / 4.0f));
+    const double lowHz = 40.0;
+    const double highHz = qMin(16000.0, rate / 2.0);
+
+    while (fill >= n) {
+        SpectrumFrame frame;
+        k.deinterleave2(fifo.constData(), left.data(), right.data(), n);
+        frame.peak[0] = k.peakAbs(left.constData(), n);
+        frame.peak[1] = k.peakAbs(right.constData(), n);
+        frame.rms[0] = (float)qSqrt(k.sumSquares(left.constData(), n) / n);
+        frame.rms[1] = (float)qSqrt(k.sumSquares(right.constData(), n) / n);
+
+        memcpy(re.data(), left.constData(), n * sizeof(float));
+        k.applyGain(re.data(), n, 0.5f);
+        k.mixGain(re.data(), right.constData(), n, 0.5f);
+        k.applyWindow(re.data(), window.constData(), n);
+        memset(im.data(), 0, n * sizeof(float));
+        fft.forward(re.data(), im.data());
+
+        // log-spaced bands, each the loudest bin it covers
+        for (int b = 0; b < SpectrumFrame::BANDS; b++) {
+            double from = lowHz * qPow(highHz / lowHz, (double)b / SpectrumFrame::BANDS);
+            double to = lowHz * qPow(highHz / lowHz, (double)(b + 1) / SpectrumFrame::BANDS);
+            int firstBin = qBound(1, (int)(from * n / rate), n/2 - 1);
+            int lastBin = qBound(firstBin + 1, (int)(to * n / rate), n/2);
+            float power = 0.0f;
+            for (int i = firstBin; i < lastBin; i++) {
+                power = qMax(power, re[i] * re[i] + im[i] * im[i]);
+            }
+            float db = power > 0.0f ? 10.0f * log10f(power * norm) : FLOOR_DB;
+            frame.bands[b] = qMax(db, FLOOR_DB);
+        }
+        frame.sequence = ++sequence;
+        analyzer->publish(frame);
+
+        memmove(fifo.data(), fifo.constData() + 2 * HOP, 2 * (fill - HOP) * sizeof(float));
+        fill -= HOP;
+    }
+}
+
+//--------------------SpectrumAnalyzer---------------------
+SpectrumAnalyzer::SpectrumAnalyzer(QObject *parent) : QObject(parent) {
+    qRegisterMetaType<QAudioBuffer>();
+    // ~370ms of pipeline output
+    tapRing = new RingBuffer(64*1024);
+    middle.store(1);
+    back = 0;
+    front = 2;
+    memset(frames, 0, sizeof(frames));
+
+    worker = new SpectrumWorker(this, tapRing);
+    worker->moveToThread(&thread);
+    connect(&thread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+    thread.start();
+    QMetaObject::invokeMethod(worker, "start", Qt::QueuedConnection);
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer() {
+    QMetaObject::invokeMethod(worker, "stop", Qt::BlockingQueuedConnection);
+    thread.quit();
+    thread.wait();
+    delete tapRing;
+}
+
+RingBuffer *SpectrumAnalyzer::tap() {
+    return tapRing;
+}
+
+void SpectrumAnalyzer::listen(QAudioProbe *probe) {
+    // queued to the worker's thread, the GUI thread only passes the buffer on
+    connect(probe, SIGNAL(audioBufferProbed(QAudioBuffer)), worker, SLOT(probeBuffer(QAudioBuffer)));
+}
+
+bool SpectrumAnalyzer::takeFrame(SpectrumFrame &frame) {
+    if (!(middle.loadAcquire() & DIRTY)) {
+        return false;
+    }
+    front = middle.fetchAndStoreAcqRel(front) & ~DIRTY;
+    frame = frames[front];
+    return true;
+}
+
+void SpectrumAnalyzer::publish(const SpectrumFrame &frame) {
+    frames[back] = frame;
+    int previous = middle.fetchAndStoreAcqRel(back | DIRTY);
+    if (previous & DIRTY) {
+        // the GUI never saw the frame that was waiting there
+        dropped.ref();
+    }
+    back = previous & ~DIRTY;
+    published.ref();
+}
+
+void SpectrumAnalyzer::skippedInput(int count) {
+    skipped.fetchAndAddRelaxed(count);
+}
+
+int SpectrumAnalyzer::framesPublished() const {
+    return published.load();
+}
+
+int SpectrumAnalyzer::framesDropped() const {
+    return dropped.load();
+}
+
+int SpectrumAnalyzer::inputFramesSkipped() const {
+    return skipped.load();
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "debug.h"
+#include "ringBuffer.h"
+#include "fft.h"
+#include <QObject>
+#include <QThread>
+#include <QVector>
+#include <QAtomicInt>
+#include <QAudioBuffer>
+
+class QAudioProbe;
+class QTimer;
+class SpectrumAnalyzer;
+
+/*
+ * One analysis frame: levels per channel (linear, 1 is full scale) and the
+ * spectrum of the mono mix in log-spaced bands, in dBFS.
+ */
+struct SpectrumFrame {
+    enum { BANDS = 32 };
+    float peak[2];
+    float rms[2];
+    float bands[BANDS];
+    qint64 sequence;
+};
+
+/*
+ * SpectrumWorker does all the DSP on the analyzer's thread. Audio comes in
+ * either from the decode pipeline's tap ring, which it polls, or as
+ * QAudioBuffers from a QAudioProbe on QMediaPlayer, delivered as queued
+ * signals. Every HOP frames it windows the last FFT_SIZE frames, measures the
+ * levels and the spectrum, and publishes the result.
+ */
+class SpectrumWorker : public QObject {
+    Q_OBJECT
+
+public:
+    enum { FFT_SIZE = 2048, HOP = 1024 };
+
+    SpectrumWorker(SpectrumAnalyzer *owner, RingBuffer *tap);
+
+public slots:
+    void start();
+    void stop();
+    void probeBuffer(QAudioBuffer buffer);
+
+private slots:
+    void pollTap();
+
+private:
+    void append(const float *samples, int frames, int channels, int sampleRate);
+    void analyse();
+
+    SpectrumAnalyzer *analyzer;
+    RingBuffer *tap;
+    QTimer *pollTimer;
+    Fft fft;
+    int rate;
+    qint64 sequence;
+
+    QVector<float> fifo;        // stereo interleaved, `fill` frames
+    int fill;
+    QVector<qint16> tapPcm;
+    QVector<float> converted;
+    QVector<float> left, right, re, im, window;
+};
+
+/*
+ * SpectrumAnalyzer owns the analysis thread and hands finished frames to the
+ * GUI through a lock-free triple buffer: the worker always has a slot to
+ * write, the GUI always has a slot to read, and the third is swapped between
+ * them atomically. A frame the worker replaces before the GUI took it counts
+ * as dropped.
+ */
+class SpectrumAnalyzer : public QObject {
+    Q_OBJECT
+
+public:
+    SpectrumAnalyzer(QObject *parent = 0);
+    ~SpectrumAnalyzer();
+
+    // the ring the decode pipeline copies its output into
+    RingBuffer *tap();
+    // analyse what a probe on QMediaPlayer sees
+    void listen(QAudioProbe *probe);
+
+    // GUI side: true and a new frame if one was published since the last call
+    bool takeFrame(SpectrumFrame &frame);
+
+    // statistics
+    int framesPublished() const;
+    int framesDropped() const;
+    int inputFramesSkipped() const;
+
+    // worker side
+    void publish(const SpectrumFrame &frame);
+    void skippedInput(int count);
+
+private:
+    enum { DIRTY = 4 };
+
+    QThread thread;
+    SpectrumWorker *worker;
+    RingBuffer *tapRing;
+
+    SpectrumFrame frames[3];
+    QAtomicInt middle;      // index of the shared slot, | DIRTY if not taken yet
+    int back;               // worker's slot
+    int front;              // GUI's slot
+    QAtomicInt published;
+    QAtomicInt dropped;
+    QAtomicInt skipped;
+};
@@ -0,0 +1,104 @@
+#include "spectrumWidget.h"
+#include <QPainter>
+#include <QTimer>
+#include <QGuiApplication>
+#include <QScreen>
+#include <qmath.h>
+#include <string.h>
+
+namespace {
+const float FLOOR_DB = -90.0f;
+
+float levelDb(float linear) {
+    return linear > 0.0f ? qMax(20.0f * log10f(linear), FLOOR_DB) : FLOOR_DB;
+}
+}
+
+SpectrumWidget::SpectrumWidget(SpectrumAnalyzer *spectrumAnalyzer, QWidget *parent)
+    : QWidget(parent), analyzer(spectrumAnalyzer) {
+    memset(&shown, 0, sizeof(shown));
+    for (int b = 0; b < SpectrumFrame::BANDS; b++) {
+        shown.bands[b] = FLOOR_DB;
+    }
+
+    // one repaint per display refresh, there's nothing newer to show in between
+    qreal hz = 60.0;
+    if (QGuiApplication::primaryScreen()) {
+        hz = qMax((qreal)24.0, QGuiApplication::primaryScreen()->refreshRate());
+    }
+    timer = new QTimer(this);
+    timer->setInterval(qRound(1000.0 / hz));
+    connect(timer, SIGNAL(timeout()), this, SLOT(refresh()));
+    // fall the full range in about 1.5 seconds
+    fallPerTick = -FLOOR_DB / (1.5f * hz);
+}
+
+QSize SpectrumWidget::sizeHint() const {
+    return QSize(320, 48);
+}
+
+void SpectrumWidget::showEvent(QShowEvent *event) {
+    timer->start();
+    QWidget::showEvent(event);
+}
+
+void SpectrumWidget::hideEvent(QHideEvent *event) {
+    timer->stop();
+    QWidget::hideEvent(event);
+}
+
+void SpectrumWidget::refresh() {
+    SpectrumFrame frame;
+    bool fresh = analyzer->takeFrame(frame);
+    bool changed = false;
+    // bars jump up to a new frame, and fall back slowly without one
+    for (int b = 0; b < SpectrumFrame::BANDS; b++) {
+        float target = fresh ? frame.bands[b] : FLOOR_DB;
+        float next = qMax(target, shown.bands[b] - fallPerTick);
+        changed |= (next != shown.bands[b]);
+        shown.bands[b] = next;
+    }
+    for (int c = 0; c < 2; c++) {
+        float peak = fresh ? frame.peak[c] : 0.0f;
+        float rms = fresh ? frame.rms[c] : 0.0f;
+        float fall = qPow(10.0f, -fallPerTick / 20.0f);
+        float nextPeak = qMax(peak, shown.peak[c] * fall);
+        float nextRms = qMax(rms, shown.rms[c] * fall);
+        changed |= (nextPeak != shown.peak[c] || nextRms != shown.rms[c]);
+        shown.peak[c] = nextPeak < 1e-5f ? 0.0f : nextPeak;
+        shown.rms[c] = nextRms < 1e-5f ? 0.0f : nextRms;
+    }
+    if (changed) {
+        update();
+    }
+}
+
+void SpectrumWidget::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event);
+    QPainter painter(this);
+    QRect area = rect().adjusted(1, 1, -1, -1);
+    painter.fillRect(rect(), palette().color(QPalette::Base));
+    QColor barColor = palette().color(QPalette::Highlight);
+    QColor peakColor = palette().color(QPalette::Text);
+
+    // level meters on the left: RMS as a bar, peak as a line, -90..0 dBFS
+    const int meterWidth = 6;
+    for (int c = 0; c < 2; c++) {
+        int x = area.left() + c * (meterWidth + 2);
+        int rmsHeight = (int)(area.height() * (1.0f - levelDb(shown.rms[c]) / FLOOR_DB));
+        int peakY = area.bottom() - (int)(area.height() * (1.0f - levelDb(shown.peak[c]) / FLOOR_DB));
+        painter.fillRect(x, area.bottom() - rmsHeight, meterWidth, rmsHeight, barColor);
+        painter.setPen(peakColor);
+        painter.drawLine(x, peakY, x + meterWidth - 1, peakY);
+    }
+
+    // spectrum bands in the rest
+    int left = area.left() + 2 * (meterWidth + 2) + 4;
+    qreal bandWidth = (qreal)(area.right() - left) / SpectrumFrame::BANDS;
+    for (int b = 0; b < SpectrumFrame::BANDS; b++) {
+        int height = (int)(area.height() * (1.0f - shown.bands[b] / FLOOR_DB));
+        int x = left + (int)(b * bandWidth);
+        int w = qMax(1, (int)((b + 1) * bandWidth) - (int)(b * bandWidth) - 1);
+        painter.fillRect(x, area.bottom() - height, w, height, barColor);
+    }
+}
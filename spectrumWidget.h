@@ -0,0 +1,35 @@
+#pragma once
+#include "debug.h"
+#include "spectrumAnalyzer.h"
+#include <QWidget>
+
+class QTimer;
+
+/*
+ * Level meter and spectrum display. It only ever copies the latest frame out
+ * of the SpectrumAnalyzer, once per display refresh, and lets the bars fall
+ * back smoothly between frames; all the analysis happens on the analyzer's
+ * thread.
+ */
+class SpectrumWidget : public QWidget {
+    Q_OBJECT
+
+public:
+    SpectrumWidget(SpectrumAnalyzer *analyzer, QWidget *parent = 0);
+
+    virtual QSize sizeHint() const;
+
+protected:
+    virtual void paintEvent(QPaintEvent *event);
+    virtual void showEvent(QShowEvent *event);
+    virtual void hideEvent(QHideEvent *event);
+
+private slots:
+    void refresh();
+
+private:
+    SpectrumAnalyzer *analyzer;
+    QTimer *timer;
+    SpectrumFrame shown;    // what is drawn, falls towards the latest frame
+    float fallPerTick;      // dB the bars may drop per refresh
+};
@@ -0,0 +1,136 @@
+#include "statementCache.h"
+#include <QElapsedTimer>
+#include <QtAlgorithms>
+
+namespace {
+
+bool slowerThan(const StatementCache::Stats &a, const StatementCache::Stats &b) {
+    return a.nsecs > b.nsecs;
+}
+
+}
+
+QList<StatementCache *> StatementCache::all;
+
+StatementCache::StatementCache(const QSqlDatabase &database) : db(database) {
+    all.append(this);
+}
+
+StatementCache::~StatementCache() {
+    qDeleteAll(statements);
+    all.removeOne(this);
+}
+
+QString StatementCache::connectionName() const {
+    return db.connectionName();
+}
+
+QList<StatementCache::Stats> StatementCache::stats() const {
+    QList<Stats> list;
+    QHash<QString, Statement *>::const_iterator it;
+    for (it = statements.constBegin(); it != statements.constEnd(); ++it) {
+        Stats s;
+        s.sql = it.key();
+        s.calls = it.value()->calls;
+        s.nsecs = it.value()->nsecs;
+        list.append(s);
+    }
+    qSort(list.begin(), list.end(), slowerThan);
+    return list;
+}
+
+void StatementCache::resetStats() {
+    foreach (Statement *s, statements) {
+        s->calls = 0;
+        s->nsecs = 0;
+    }
+}
+
+QList<StatementCache *> StatementCache::caches() {
+    return all;
+}
+
+StatementCache::Statement *StatementCache::statement(const QString &sql) {
+    Statement *s = statements.value(sql);
+    if (s) {
+        return s;
+    }
+    s = new Statement(db);
+    s->query.setForwardOnly(true);
+    if (!s->query.prepare(sql)) {
+        // not kept, the caller gets its error
+        return s;
+    }
+    statements.insert(sql, s);
+    return s;
+}
+
+SqlQuery::SqlQuery(StatementCache *cache, const QString &sql) {
+    statement = cache->statement(sql);
+    owned = !cache->statements.contains(sql);
+    prepared = !owned;
+    if (statement->inUse) {
+        // the cached one is still reading rows
+        statement = new StatementCache::Statement(cache->db);
+        statement->query.setForwardOnly(true);
+        prepared = statement->query.prepare(sql);
+        owned = true;
+    }
+    counted = owned && prepared ? cache->statements.value(sql) : statement;
+    if (!owned) {
+        statement->inUse = true;
+    }
+}
+
+SqlQuery::~SqlQuery() {
+    if (owned) {
+        delete statement;
+        return;
+    }
+    statement->query.finish();
+    statement->inUse = false;
+}
+
+void SqlQuery::bindValue(const QString &placeholder, const QVariant &value) {
+    statement->query.bindValue(placeholder, value);
+}
+
+void SqlQuery::addBindValue(const QVariant &value) {
+    statement->query.addBindValue(value);
+}
+
+bool SqlQuery::exec() {
+    if (!prepared) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = statement->query.exec();
+    counted->calls++;
+    counted->nsecs += timer.nsecsElapsed();
+    return ok;
+}
+
+bool SqlQuery::next() {
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = statement->query.next();
+    counted->nsecs += timer.nsecsElapsed();
+    return ok;
+}
+
+QVariant SqlQuery::value(int i) const {
+    return statement->query.value(i);
+}
+
+void SqlQuery::finish() {
+    statement->query.finish();
+}
+
+int SqlQuery::numRowsAffected() const {
+    return statement->query.numRowsAffected();
+}
+
+QSqlError SqlQuery::lastError() const {
+    return statement->query.lastError();
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "debug.h"
+#include <QtSql/QtSql>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+/*
+ * StatementCache keeps the compiled statements of one database connection,
+ * so a query that runs once per track is parsed by SQLite once rather than
+ * once per track. Values are always bound to placeholders, never pasted
+ * into the SQL, so a quote in a title or a path can't break the statement.
+ *
+ * Statements are looked up by their SQL text and run through SqlQuery.
+ * Every run is counted and timed, exec() and the next() calls reading its
+ * rows together, for stats().
+ */
+class StatementCache {
+public:
+    struct Stats {
+        QString sql;
+        int calls;
+        qint64 nsecs;
+    };
+
+    StatementCache(const QSqlDatabase &db);
+    // must go before the connection is closed
+    ~StatementCache();
+
+    QString connectionName() const;
+    // slowest first, by cumulative time
+    QList<Stats> stats() const;
+    void resetStats();
+    // the caches of all open connections
+    static QList<StatementCache *> caches();
+
+private:
+    friend class SqlQuery;
+
+    struct Statement {
+        Statement(const QSqlDatabase &db) : query(db), inUse(false), calls(0), nsecs(0) {}
+        QSqlQuery query;
+        bool inUse;
+        int calls;
+        qint64 nsecs;
+    };
+
+    Statement *statement(const QString &sql);
+
+    QSqlDatabase db;
+    QHash<QString, Statement *> statements;
+
+    static QList<StatementCache *> all;
+};
+
+/*
+ * SqlQuery runs one statement of a StatementCache:
+ *
+ *     SqlQuery q(statements, "SELECT Title FROM MUSICLIBRARY WHERE absFilePath=:absFilePath");
+ *     q.bindValue(":absFilePath", absFilePath);
+ *     if (q.exec() && q.next()) ...
+ *
+ * The statement is reset (and its read lock released) when q goes out of
+ * scope. While one is still reading rows further up the stack, the same SQL
+ * gets a statement of its own that isn't kept.
+ */
+class SqlQuery {
+public:
+    SqlQuery(StatementCache *cache, const QString &sql);
+    ~SqlQuery();
+
+    void bindValue(const QString &placeholder, const QVariant &value);
+    // for the positional "?" placeholders
+    void addBindValue(const QVariant &value);
+    bool exec();
+    bool next();
+    QVariant value(int i) const;
+    // done reading rows before the end
+    void finish();
+    int numRowsAffected() const;
+    QSqlError lastError() const;
+
+private:
+    Q_DISABLE_COPY(SqlQuery)
+
+    StatementCache::Statement *statement;
+    StatementCache::Statement *counted;     // the cached one, also for a copy
+    bool owned;
+    bool prepared;
+};
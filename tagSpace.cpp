@@ -0,0 +1,197 @@
+#include "tagSpace.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QByteArray>
+#include <QList>
+#include <QDebug>
+
+namespace {
+
+const int ID3_HEADER = 10;
+const int FLAC_BLOCK_HEADER = 4;
+const int FLAC_PADDING = 1;
+const int FLAC_VORBIS_COMMENT = 4;
+const qint64 COPY_CHUNK = 1024 * 1024;
+
+qint64 syncsafe(const uchar *p) {
+    return ((p[0] & 0x7f) << 21) | ((p[1] & 0x7f) << 14) | ((p[2] & 0x7f) << 7) | (p[3] & 0x7f);
+}
+
+QByteArray toSyncsafe(qint64 size) {
+    QByteArray s(4, 0);
+    s[0] = (char)((size >> 21) & 0x7f);
+    s[1] = (char)((size >> 14) & 0x7f);
+    s[2] = (char)((size >> 7) & 0x7f);
+    s[3] = (char)(size & 0x7f);
+    return s;
+}
+
+bool isMp3(const QString &absFilePath) {
+    return QFileInfo(absFilePath).suffix().compare("mp3", Qt::CaseInsensitive) == 0;
+}
+
+struct FlacBlock {
+    int type;
+    qint64 offset;      // of the block header
+    qint64 length;      // not counting the header
+};
+
+// the metadata blocks after "fLaC", false if they don't add up
+bool flacBlocks(QFile &file, QList<FlacBlock> &blocks, qint64 &audioStart) {
+    qint64 pos = 4;
+    for (;;) {
+        if (!file.seek(pos)) {
+            return false;
+        }
+        QByteArray header = file.read(FLAC_BLOCK_HEADER);
+        if (header.size() != FLAC_BLOCK_HEADER) {
+            return false;
+        }
+        const uchar *h = (const uchar *)header.constData();
+        FlacBlock b;
+        b.type = h[0] & 0x7f;
+        b.offset = pos;
+        b.length = (h[1] << 16) | (h[2] << 8) | h[3];
+        blocks.append(b);
+        pos += FLAC_BLOCK_HEADER + b.length;
+        if (pos > file.size()) {
+            return false;
+        }
+        if (h[0] & 0x80) {
+            // last metadata block
+            audioStart = pos;
+            return true;
+        }
+    }
+}
+
+bool writeZeros(QSaveFile &out, qint64 count) {
+    QByteArray zeros(qMin(count, COPY_CHUNK), 0);
+    while (count > 0) {
+        qint64 n = qMin(count, (qint64)zeros.size());
+        if (out.write(zeros.constData(), n) != n) {
+            return false;
+        }
+        count -= n;
+    }
+    return true;
+}
+
+bool copyRest(QFile &in, qint64 from, QSaveFile &out) {
+    if (!in.seek(from)) {
+        return false;
+    }
+    while (!in.atEnd()) {
+        QByteArray chunk = in.read(COPY_CHUNK);
+        if (chunk.isEmpty() || out.write(chunk) != chunk.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+qint64 tagSpace(const QString &absFilePath) {
+    QFile file(absFilePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    QByteArray head = file.read(ID3_HEADER);
+    if (head.size() == ID3_HEADER && head.startsWith("ID3")) {
+        if (!isMp3(absFilePath)) {
+            // an ID3v2 tag in front of a FLAC file, TagLib moves things around
+            return -1;
+        }
+        const uchar *h = (const uchar *)head.constData();
+        return ID3_HEADER + syncsafe(h + 6) + ((h[5] & 0x10) ? ID3_HEADER : 0);
+    }
+    if (head.startsWith("fLaC")) {
+        QList<FlacBlock> blocks;
+        qint64 audioStart;
+        if (!flacBlocks(file, blocks, audioStart)) {
+            return -1;
+        }
+        qint64 space = 0;
+        foreach (const FlacBlock &b, blocks) {
+            if (b.type == FLAC_VORBIS_COMMENT || b.type == FLAC_PADDING) {
+                space += FLAC_BLOCK_HEADER + b.length;
+            }
+        }
+        return space;
+    }
+    return isMp3(absFilePath) ? 0 : -1;
+}
+
+bool growTagSpace(const QString &absFilePath, qint64 extraBytes) {
+    QFile in(absFilePath);
+    if (extraBytes <= 0 || !in.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QSaveFile out(absFilePath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    bool ok = false;
+    QByteArray head = in.read(ID3_HEADER);
+    if (head.size() == ID3_HEADER && head.startsWith("ID3") && isMp3(absFilePath)) {
+        const uchar *h = (const uchar *)head.constData();
+        qint64 size = syncsafe(h + 6);
+        // a footer and padding can't go together
+        if (!(h[5] & 0x10) && size + extraBytes < (1 << 28)) {
+            // the old frames and padding, then the new padding, then the audio
+            out.write(head.left(6));
+            out.write(toSyncsafe(size + extraBytes));
+            QByteArray frames = in.read(size);
+            ok = frames.size() == size && out.write(frames) == size
+                    && writeZeros(out, extraBytes) && copyRest(in, ID3_HEADER + size, out);
+        }
+    } else if (head.startsWith("fLaC")) {
+        QList<FlacBlock> blocks;
+        qint64 audioStart;
+        if (flacBlocks(in, blocks, audioStart)) {
+            // every block but the padding, then one padding block holding the
+            // old padding and the extra bytes
+            qint64 padding = extraBytes - FLAC_BLOCK_HEADER;
+            ok = out.write("fLaC", 4) == 4;
+            foreach (const FlacBlock &b, blocks) {
+                if (b.type == FLAC_PADDING) {
+                    padding += FLAC_BLOCK_HEADER + b.length;
+                    continue;
+                }
+                in.seek(b.offset);
+                QByteArray block = in.read(FLAC_BLOCK_HEADER + b.length);
+                block[0] = (char)(block[0] & 0x7f);
+                ok = ok && block.size() == FLAC_BLOCK_HEADER + b.length && out.write(block) == block.size();
+            }
+            padding = qMin(padding, (qint64)0xffffff);
+            QByteArray header(FLAC_BLOCK_HEADER, 0);
+            header[0] = (char)(0x80 | FLAC_PADDING);
+            header[1] = (char)((padding >> 16) & 0xff);
+            header[2] = (char)((padding >> 8) & 0xff);
+            header[3] = (char)(padding & 0xff);
+            ok = ok && padding > 0 && out.write(header) == FLAC_BLOCK_HEADER
+                    && writeZeros(out, padding) && copyRest(in, audioStart, out);
+        }
+    } else if (isMp3(absFilePath)) {
+        // no tag yet, put an empty one with just padding in front
+        out.write("ID3\x04\x00\x00", 6);
+        out.write(toSyncsafe(extraBytes));
+        ok = extraBytes < (1 << 28) && writeZeros(out, extraBytes) && copyRest(in, 0, out);
+    }
+    in.close();
+    if (!ok) {
+        out.cancelWriting();
+        return false;
+    }
+    return out.commit();
+}
+
+qint64 tagPaddingFor(qint64 fileSize) {
+    // TagLib drops padding over 1% of the file (at least 1 KB, at most 1 MB)
+    // at the next save, which would move the audio again. Half of that limit
+    // leaves room for the tags to grow as well as shrink.
+    qint64 limit = qBound((qint64)1024, fileSize / 100, (qint64)1024 * 1024);
+    return limit / 2;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "debug.h"
+#include <QtGlobal>
+#include <QString>
+
+/*
+ * Room for the tags at the head of a music file, so a tag edit can be saved
+ * in place instead of moving all the audio behind it.
+ *
+ * tagSpace() is the size of the region a tag save may rewrite without
+ * moving anything: the whole ID3v2 tag of an MP3 (0 if it has none), or
+ * the Vorbis comment and padding blocks of a FLAC file. It is -1 for the
+ * other formats, whose tags are left to TagLib.
+ *
+ * growTagSpace() rewrites the file once with extraBytes more padding in
+ * that region, through a QSaveFile so a failed copy leaves the file as it
+ * was.
+ */
+qint64 tagSpace(const QString &absFilePath);
+bool growTagSpace(const QString &absFilePath, qint64 extraBytes);
+
+// how much padding to reserve when a file has to be rewritten anyway
+qint64 tagPaddingFor(qint64 fileSize);
@@ -0,0 +1,392 @@
+#include "tagWriter.h"
+#include "tagSpace.h"
+#include <QRunnable>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QMap>
+#include <QPair>
+#include <QDebug>
+#include <taglib/fileref.h>
+#include <taglib/tag.h>
+#include <taglib/mpegfile.h>
+#include <taglib/id3v2tag.h>
+#include <taglib/flacfile.h>
+#include <taglib/xiphcomment.h>
+
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+TagWriter *TagWriter::self = 0;
+
+namespace {
+
+const char *JOURNAL_FILE = "AAMusicPlayer_tagjournal.txt";
+
+// journal lines are space separated, paths and values percent encoded
+QByteArray encode(const QString &s) {
+    return s.toUtf8().toPercentEncoding();
+}
+
+QString decode(const QByteArray &s) {
+    return QString::fromUtf8(QByteArray::fromPercentEncoding(s));
+}
+
+QByteArray editLine(qint64 seq, int field, const QString &absFilePath, const QString &value) {
+    return "E " + QByteArray::number(seq) + " " + QByteArray::number(field) + " "
+            + encode(absFilePath) + " " + encode(value) + "\n";
+}
+
+void applyEdits(TagLib::FileRef &f, const QHash<int, QString> &edits) {
+    QHash<int, QString>::const_iterator i;
+    for (i = edits.constBegin(); i != edits.constEnd(); ++i) {
+        TagLib::String value(i.value().toUtf8().constData(), TagLib::String::UTF8);
+        switch (i.key()) {
+            case TagWriter::TITLE:
+                f.tag()->setTitle(value);
+                break;
+            case TagWriter::ARTIST:
+                f.tag()->setArtist(value);
+                break;
+            case TagWriter::ALBUM:
+                f.tag()->setAlbum(value);
+                break;
+        }
+    }
+}
+
+// what the edited tags will take of tagSpace(), -1 if it's not a format
+// tagSpace() knows
+qint64 neededTagSpace(TagLib::File *file) {
+    TagLib::MPEG::File *mpeg = dynamic_cast<TagLib::MPEG::File *>(file);
+    if (mpeg && mpeg->ID3v2Tag()) {
+        // padded to the old size if it fits
+        return mpeg->ID3v2Tag()->render().size();
+    }
+    TagLib::FLAC::File *flac = dynamic_cast<TagLib::FLAC::File *>(file);
+    if (flac && flac->xiphComment()) {
+        // the comment block, and a padding block TagLib won't do without
+        return 4 + flac->xiphComment()->render(false).size() + 4 + 1;
+    }
+    return -1;
+}
+
+// TagLib moves all the audio when the tags outgrow their room. When that
+// would happen the file is rewritten once with generous padding instead,
+// after which this and later edits are saved in place.
+bool saveEdits(const QString &path, const QHash<int, QString> &edits, qint64 &bytesWritten, bool &inPlace) {
+    bytesWritten = 0;
+    inPlace = true;
+    QByteArray byteArray = path.toUtf8();
+    for (int attempt = 0; attempt < 2; attempt++) {
+        TagLib::FileRef f(byteArray.constData());
+        if (f.isNull() || !f.tag()) {
+            return false;
+        }
+        applyEdits(f, edits);
+        qint64 space = tagSpace(path);
+        qint64 needed = neededTagSpace(f.file());
+        qint64 sizeBefore = QFileInfo(path).size();
+        if (attempt == 0 && space >= 0 && needed > space) {
+            // let go of the file before it's replaced
+            f = TagLib::FileRef();
+            qint64 extra = needed - space + tagPaddingFor(sizeBefore);
+            if (growTagSpace(path, extra)) {
+                bytesWritten += sizeBefore + extra;
+                inPlace = false;
+            }
+            continue;
+        }
+        if (!f.file()->save()) {
+            return false;
+        }
+        qint64 sizeAfter = QFileInfo(path).size();
+        if (sizeAfter != sizeBefore) {
+            // TagLib had to move the audio after all
+            bytesWritten += sizeAfter;
+            inPlace = false;
+        } else if (space > 0) {
+            bytesWritten += space;
+        }
+        return true;
+    }
+    return false;
+}
+
+class TagWriteTask : public QRunnable {
+public:
+    TagWriteTask(TagWriter *owner, const QString &absFilePath)
+        : writer(owner), path(absFilePath) {}
+
+    void run() {
+        QHash<int, QString> edits;
+        qint64 lastSeq;
+        if (!writer->takeEdits(path, edits, lastSeq)) {
+            return;
+        }
+        qint64 bytes;
+        bool inPlace;
+        bool ok = saveEdits(path, edits, bytes, inPlace);
+        writer->writeFinished(path, lastSeq, ok, inPlace, bytes);
+    }
+
+private:
+    TagWriter *writer;
+    QString path;
+};
+
+}
+
+TagWriter::TagWriter(QObject *parent) : QObject(parent) {
+    self = this;
+    nextSeq = 1;
+    queuedCount = 0;
+    writtenCount = 0;
+    failedCount = 0;
+    coalescedCount = 0;
+    rewriteCount = 0;
+    writtenBytes = 0;
+    replayJournal();
+}
+
+TagWriter::~TagWriter() {
+    JobScheduler::instance()->waitForGroup(this);
+    journal.close();
+    if (self == this) {
+        self = 0;
+    }
+}
+
+TagWriter *TagWriter::instance() {
+    return self;
+}
+
+void TagWriter::replayJournal() {
+    // edits whose "done" line never made it, per file and field: seq -> value
+    QHash<QString, QMap<int, QPair<qint64, QString> > > left;
+    QFile old(JOURNAL_FILE);
+    if (old.open(QIODevice::ReadOnly)) {
+        while (!old.atEnd()) {
+            QList<QByteArray> parts = old.readLine().trimmed().split(' ');
+            if (parts.size() == 5 && parts[0] == "E") {
+                // a line cut short by a crash doesn't parse and is skipped
+                QString path = decode(parts[3]);
+                left[path][parts[2].toInt()] = qMakePair(parts[1].toLongLong(), decode(parts[4]));
+            } else if (parts.size() == 3 && parts[0] == "D") {
+                QString path = decode(parts[1]);
+                qint64 doneSeq = parts[2].toLongLong();
+                if (!left.contains(path)) {
+                    continue;
+                }
+                QMap<int, QPair<qint64, QString> > &fields = left[path];
+                foreach (int field, fields.keys()) {
+                    if (fields[field].first <= doneSeq) {
+                        fields.remove(field);
+                    }
+                }
+                if (fields.isEmpty()) {
+                    left.remove(path);
+                }
+            }
+        }
+        old.close();
+    }
+
+    // start a fresh journal with just what's left
+    QMutexLocker locker(&lock);
+    QSaveFile compacted(JOURNAL_FILE);
+    if (compacted.open(QIODevice::WriteOnly)) {
+        QHash<QString, QMap<int, QPair<qint64, QString> > >::const_iterator i;
+        for (i = left.constBegin(); i != left.constEnd(); ++i) {
+            Edit &e = pending[i.key()];
+            foreach (int field, i.value().keys()) {
+                e.values[field] = i.value()[field].second;
+                e.lastSeq = nextSeq;
+                compacted.write(editLine(nextSeq++, field, i.key(), e.values[field]));
+            }
+        }
+        compacted.commit();
+    }
+    journal.setFileName(JOURNAL_FILE);
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "TagWriter: can't open" << JOURNAL_FILE << "- tag edits are not journalled";
+    }
+#if DEBUG_JOBS
+    qDebug() << "TagWriter:" << pending.size() << "files with unwritten edits in the journal";
+#endif
+    foreach (const QString &path, pending.keys()) {
+        scheduleLocked(path);
+    }
+}
+
+void TagWriter::appendJournal(const QByteArray &line, bool sync) {
+    if (!journal.isOpen()) {
+        return;
+    }
+    journal.write(line);
+    if (sync) {
+        syncJournal();
+    }
+}
+
+void TagWriter::syncJournal() {
+    if (!journal.isOpen()) {
+        return;
+    }
+    journal.flush();
+#if defined(Q_OS_UNIX)
+    // on disk before the edit is acted on, not just in the OS buffers
+    fsync(journal.handle());
+#endif
+}
+
+void TagWriter::queueEdit(const QString &absFilePath, Field field, const QString &value) {
+    queueEdits(QStringList() << absFilePath, field, value);
+}
+
+void TagWriter::queueEdits(const QStringList &absFilePaths, Field field, const QString &value) {
+    QMutexLocker locker(&lock);
+    qint64 firstSeq = nextSeq;
+    foreach (const QString &path, absFilePaths) {
+        appendJournal(editLine(nextSeq++, field, path, value), false);
+    }
+    syncJournal();
+    for (int i = 0; i < absFilePaths.size(); i++) {
+        Edit &e = pending[absFilePaths[i]];
+        if (!e.values.isEmpty()) {
+            coalescedCount++;
+        }
+        e.values[field] = value;
+        e.lastSeq = firstSeq + i;
+        queuedCount++;
+        scheduleLocked(absFilePaths[i]);
+    }
+}
+
+void TagWriter::scheduleLocked(const QString &absFilePath) {
+    // one job per file at a time, edits arriving meanwhile wait for the next
+    if (scheduled.contains(absFilePath)) {
+        return;
+    }
+    scheduled.insert(absFilePath);
+    JobScheduler::instance()->submit(new TagWriteTask(this, absFilePath), JobScheduler::USER_INITIATED,
+                                     this, JobScheduler::IO_BOUND);
+}
+
+bool TagWriter::isPending(const QString &absFilePath) const {
+    QMutexLocker locker(&lock);
+    return scheduled.contains(absFilePath);
+}
+
+void TagWriter::overlayPending(const QString &absFilePath, QHash<QString, QString> &hash) const {
+    static const char *keys[FIELDS] = {"Title", "Artist", "Album"};
+    QMutexLocker locker(&lock);
+    // the ones being saved first, the newer queued ones override them
+    const QHash<QString, Edit> *sources[2] = {&writing, &pending};
+    for (int s = 0; s < 2; s++) {
+        if (!sources[s]->contains(absFilePath)) {
+            continue;
+        }
+        const QHash<int, QString> &values = (*sources[s])[absFilePath].values;
+        QHash<int, QString>::const_iterator i;
+        for (i = values.constBegin(); i != values.constEnd(); ++i) {
+            hash[keys[i.key()]] = i.value();
+        }
+    }
+}
+
+bool TagWriter::takeEdits(const QString &absFilePath, QHash<int, QString> &edits, qint64 &lastSeq) {
+    QMutexLocker locker(&lock);
+    if (!pending.contains(absFilePath)) {
+        scheduled.remove(absFilePath);
+        return false;
+    }
+    Edit e = pending.take(absFilePath);
+    writing[absFilePath] = e;
+    edits = e.values;
+    lastSeq = e.lastSeq;
+    return true;
+}
+
+void TagWriter::writeFinished(const QString &absFilePath, qint64 lastSeq, bool ok, bool inPlace, qint64 bytesWritten) {
+    {
+        QMutexLocker locker(&lock);
+        writing.remove(absFilePath);
+        // a failed write isn't retried at the next start either, the file
+        // is most likely read-only
+        appendJournal("D " + encode(absFilePath) + " " + QByteArray::number(lastSeq) + "\n");
+        if (ok) {
+            writtenCount++;
+            if (!inPlace) {
+                rewriteCount++;
+            }
+        } else {
+            failedCount++;
+        }
+        writtenBytes += bytesWritten;
+        scheduled.remove(absFilePath);
+        if (pending.contains(absFilePath)) {
+            scheduleLocked(absFilePath);
+        }
+        if (pending.isEmpty() && writing.isEmpty() && journal.isOpen()) {
+            // all caught up, the journal has nothing worth keeping
+            journal.resize(0);
+        }
+    }
+    QMutexLocker locker(&resultsLock);
+    Written w;
+    w.absFilePath = absFilePath;
+    w.ok = ok;
+    w.inPlace = inPlace;
+    w.bytesWritten = bytesWritten;
+    results.append(w);
+    if (results.size() == 1) {
+        QMetaObject::invokeMethod(this, "collectResults", Qt::QueuedConnection);
+    }
+}
+
+void TagWriter::collectResults() {
+    QList<Written> batch;
+    {
+        QMutexLocker locker(&resultsLock);
+        batch.swap(results);
+    }
+    foreach (const Written &w, batch) {
+#if DEBUG_JOBS
+        qDebug() << "TagWriter:" << w.absFilePath << (w.ok ? "written" : "FAILED")
+                 << (w.inPlace ? "in place," : "rewritten,") << w.bytesWritten << "bytes";
+#endif
+        emit(tagsWritten(w.absFilePath, w.ok, w.inPlace, w.bytesWritten));
+    }
+}
+
+int TagWriter::editsQueued() const {
+    QMutexLocker locker(&lock);
+    return queuedCount;
+}
+
+int TagWriter::filesWritten() const {
+    QMutexLocker locker(&lock);
+    return writtenCount;
+}
+
+int TagWriter::filesFailed() const {
+    QMutexLocker locker(&lock);
+    return failedCount;
+}
+
+int TagWriter::editsCoalesced() const {
+    QMutexLocker locker(&lock);
+    return coalescedCount;
+}
+
+int TagWriter::filesRewritten() const {
+    QMutexLocker locker(&lock);
+    return rewriteCount;
+}
+
+qint64 TagWriter::bytesWritten() const {
+    QMutexLocker locker(&lock);
+    return writtenBytes;
+}
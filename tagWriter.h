@@ -0,0 +1,113 @@
+#pragma once
+#include "debug.h"
+#include "jobScheduler.h"
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QFile>
+
+/*
+ * TagWriter saves tag edits to the files behind the GUI's back. The models
+ * update themselves straight away and queue the edit here; a JobScheduler
+ * job then opens the file with TagLib and saves it. Edits to a file that
+ * haven't been written yet are merged, so renaming an artist and then
+ * fixing a typo in the new name saves each file once.
+ *
+ * Every edit is appended to a journal before it is queued, and marked done
+ * once its file is saved. Edits still in the journal at start up (the
+ * player quit or crashed before writing them) are queued again.
+ *
+ * Edits are saved in place when the tags still fit their room in the file;
+ * when they don't, the file is rewritten once with generous padding (see
+ * tagSpace.h) so the following edits fit again.
+ *
+ * Reading a file's tags back with overlayPending() gives the edited values
+ * until the write is done. There's one per application, created in main().
+ */
+class TagWriter : public QObject {
+    Q_OBJECT
+
+public:
+    // same numbering as LibraryModel::changeMetaData()
+    enum Field {
+        TITLE = 0,
+        ARTIST,
+        ALBUM,
+        FIELDS
+    };
+
+    TagWriter(QObject *parent = 0);
+    // waits for the queued writes, so nothing is left to the journal
+    ~TagWriter();
+    static TagWriter *instance();
+
+    void queueEdit(const QString &absFilePath, Field field, const QString &value);
+    // the same edit to many files, with a single journal sync
+    void queueEdits(const QStringList &absFilePaths, Field field, const QString &value);
+    bool isPending(const QString &absFilePath) const;
+    // replaces the "Title", "Artist" and "Album" entries of hash with the
+    // edits of absFilePath that are not on disk yet
+    void overlayPending(const QString &absFilePath, QHash<QString, QString> &hash) const;
+
+    // statistics
+    int editsQueued() const;
+    int filesWritten() const;
+    int filesFailed() const;
+    int editsCoalesced() const;
+    // saves that had to move the audio, and bytes written by all saves
+    int filesRewritten() const;
+    qint64 bytesWritten() const;
+
+    // called by the write jobs
+    bool takeEdits(const QString &absFilePath, QHash<int, QString> &edits, qint64 &lastSeq);
+    void writeFinished(const QString &absFilePath, qint64 lastSeq, bool ok, bool inPlace, qint64 bytesWritten);
+
+signals:
+    // one per save; on failure the file still has its old tags. inPlace is
+    // false when the audio had to be moved.
+    void tagsWritten(QString absFilePath, bool ok, bool inPlace, qint64 bytesWritten);
+
+private slots:
+    void collectResults();
+
+private:
+    struct Edit {
+        QHash<int, QString> values;     // Field -> value
+        qint64 lastSeq;
+    };
+    struct Written {
+        QString absFilePath;
+        bool ok;
+        bool inPlace;
+        qint64 bytesWritten;
+    };
+
+    void replayJournal();
+    void appendJournal(const QByteArray &line, bool sync = true);
+    void syncJournal();
+    void scheduleLocked(const QString &absFilePath);
+
+    mutable QMutex lock;
+    QHash<QString, Edit> pending;       // queued, not yet picked up by a job
+    QHash<QString, Edit> writing;       // picked up, being saved
+    QSet<QString> scheduled;            // files with a job queued or running
+    qint64 nextSeq;
+
+    QFile journal;                      // written under lock
+
+    QMutex resultsLock;
+    QList<Written> results;
+
+    int queuedCount;
+    int writtenCount;
+    int failedCount;
+    int coalescedCount;
+    int rewriteCount;
+    qint64 writtenBytes;
+
+    static TagWriter *self;
+};
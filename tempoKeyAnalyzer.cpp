@@ -0,0 +1,180 @@
+#include "tempoKeyAnalyzer.h"
+#include "tempoKeyMeter.h"
+#include "pcmDecoder.h"
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QDebug>
+
+namespace {
+
+// Feeds the decoded track into a TempoKeyMeter, created once the first
+// buffer tells us the rate and channel count.
+class TempoKeySink : public PcmSink {
+public:
+    TempoKeySink(TempoKeyAnalyzer *owner) : analyzer(owner), meter(0) {}
+    ~TempoKeySink() { delete meter; }
+
+    bool consume(const float *samples, int frames, int channels, int sampleRate) {
+        if (!meter) {
+            meter = new TempoKeyMeter(sampleRate, channels);
+        }
+        meter->addFrames(samples, frames);
+        return !analyzer->isCancelled();
+    }
+
+    TempoKeyAnalyzer *analyzer;
+    TempoKeyMeter *meter;
+};
+
+class TempoKeyTask : public QRunnable {
+public:
+    TempoKeyTask(TempoKeyAnalyzer *owner, const QString &absFilePath)
+        : analyzer(owner), path(absFilePath) {}
+
+    void run() {
+        TempoKeyAnalyzer::Result result;
+        result.absFilePath = path;
+        result.ok = false;
+        result.bpm = 0.0;
+        result.key = TempoKeyMeter::NO_KEY;
+        result.seconds = 0.0;
+        if (!analyzer->isCancelled()) {
+            PcmDecoder decoder;
+            TempoKeySink sink(analyzer);
+            if (decoder.decode(path, &sink) && sink.meter && !analyzer->isCancelled()) {
+                result.ok = true;
+                result.bpm = sink.meter->bpm();
+                result.key = sink.meter->key();
+                result.seconds = (double)decoder.decodedFrames() / decoder.sampleRate();
+            }
+        }
+        analyzer->post(result);
+    }
+
+private:
+    TempoKeyAnalyzer *analyzer;
+    QString path;
+};
+
+}
+
+TempoKeyAnalyzer::TempoKeyAnalyzer(QObject *parent) : QObject(parent) {
+    scheduler = JobScheduler::instance();
+    lastElapsed = 0;
+    total = 0;
+    done = 0;
+    failed = 0;
+    seconds = 0.0;
+}
+
+TempoKeyAnalyzer::~TempoKeyAnalyzer() {
+    cancel();
+    scheduler->waitForGroup(this);
+}
+
+void TempoKeyAnalyzer::addTrack(const QString &absFilePath) {
+    if (!isRunning()) {
+        // new run
+        cancelled.storeRelease(0);
+        total = 0;
+        done = 0;
+        failed = 0;
+        seconds = 0.0;
+        timer.start();
+    }
+    total++;
+    scheduler->submit(new TempoKeyTask(this, absFilePath), JobScheduler::BACKGROUND, this);
+}
+
+void TempoKeyAnalyzer::cancel() {
+    // like LoudnessAnalyzer, dropped tasks are reported as failures
+    cancelled.storeRelease(1);
+    int dropped = scheduler->cancel(this);
+    for (int i = 0; i < dropped; i++) {
+        Result r;
+        r.ok = false;
+        post(r);
+    }
+}
+
+bool TempoKeyAnalyzer::isCancelled() const {
+    return cancelled.loadAcquire() != 0;
+}
+
+bool TempoKeyAnalyzer::isRunning() const {
+    return done < total;
+}
+
+int TempoKeyAnalyzer::threadCount() const {
+    return scheduler->maxRunning(JobScheduler::BACKGROUND);
+}
+
+int TempoKeyAnalyzer::tracksTotal() const {
+    return total;
+}
+
+int TempoKeyAnalyzer::tracksDone() const {
+    return done;
+}
+
+int TempoKeyAnalyzer::tracksFailed() const {
+    return failed;
+}
+
+qint64 TempoKeyAnalyzer::elapsedMs() const {
+    return isRunning() ? timer.elapsed() : lastElapsed;
+}
+
+double TempoKeyAnalyzer::audioSeconds() const {
+    return seconds;
+}
+
+double TempoKeyAnalyzer::tracksPerMinute() const {
+    qint64 ms = elapsedMs();
+    if (ms <= 0) {
+        return 0.0;
+    }
+    return (done - failed) * 60000.0 / ms;
+}
+
+double TempoKeyAnalyzer::tracksPerMinutePerCore() const {
+    return tracksPerMinute() / threadCount();
+}
+
+void TempoKeyAnalyzer::post(const Result &result) {
+    QMutexLocker locker(&resultsLock);
+    results.append(result);
+    if (results.size() == 1) {
+        QMetaObject::invokeMethod(this, "collectResults", Qt::QueuedConnection);
+    }
+}
+
+void TempoKeyAnalyzer::collectResults() {
+    QList<Result> batch;
+    {
+        QMutexLocker locker(&resultsLock);
+        batch.swap(results);
+    }
+    bool cancelledRun = isCancelled();
+    foreach (const Result &r, batch) {
+        done++;
+        if (!r.ok) {
+            failed++;
+        } else {
+            seconds += r.seconds;
+            if (!cancelledRun) {
+                emit(trackAnalysed(r.absFilePath, r.bpm, r.key));
+            }
+        }
+    }
+    emit(progress(done, total));
+    if (!isRunning()) {
+        lastElapsed = timer.elapsed();
+#if DEBUG_ANALYSIS
+        qDebug() << "TempoKeyAnalyzer:" << done << "tracks," << failed << "failed,"
+                 << lastElapsed << "ms," << tracksPerMinute() << "tracks/min,"
+                 << seconds * 1000.0 / qMax(lastElapsed, (qint64)1) << "x realtime";
+#endif
+        emit(finished());
+    }
+}
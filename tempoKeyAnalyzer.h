@@ -0,0 +1,69 @@
+#pragma once
+#include "debug.h"
+#include "jobScheduler.h"
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+/*
+ * TempoKeyAnalyzer runs a TempoKeyMeter over a batch of tracks in the
+ * background, one whole track per JobScheduler job. Results are reported
+ * on the thread that owns the analyzer.
+ */
+class TempoKeyAnalyzer : public QObject {
+    Q_OBJECT
+
+public:
+    TempoKeyAnalyzer(QObject *parent = 0);
+    ~TempoKeyAnalyzer();
+
+    void addTrack(const QString &absFilePath);
+    void cancel();
+    bool isRunning() const;
+    int threadCount() const;
+
+    // statistics of the current (or last) run
+    int tracksTotal() const;
+    int tracksDone() const;
+    int tracksFailed() const;
+    qint64 elapsedMs() const;
+    double audioSeconds() const;
+    double tracksPerMinute() const;
+    double tracksPerMinutePerCore() const;
+
+    // filled in by the worker threads and picked up by collectResults()
+    struct Result {
+        QString absFilePath;
+        bool ok;
+        double bpm;
+        int key;
+        double seconds;
+    };
+    void post(const Result &result);
+    bool isCancelled() const;
+
+signals:
+    // bpm is 0 and key TempoKeyMeter::NO_KEY when they couldn't be told
+    void trackAnalysed(QString absFilePath, double bpm, int key);
+    void progress(int done, int total);
+    void finished();
+
+private slots:
+    void collectResults();
+
+private:
+    JobScheduler *scheduler;
+    QAtomicInt cancelled;
+    QMutex resultsLock;
+    QList<Result> results;
+
+    QElapsedTimer timer;
+    qint64 lastElapsed;
+    int total;
+    int done;
+    int failed;
+    double seconds;
+};
@@ -0,0 +1,233 @@
+#include "tempoKeyMeter.h"
+#include "sampleKernels.h"
+#include <qmath.h>
+#include <string.h>
+
+namespace {
+
+int fftSizeFor(int sampleRate) {
+    // ~90ms frames: fine enough in frequency for the chroma
+    return sampleRate > 24000 ? 4096 : 2048;
+}
+
+// Krumhansl-Kessler key profiles, tonic first
+const double MAJOR_PROFILE[12] = {6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88};
+const double MINOR_PROFILE[12] = {6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17};
+
+double correlation(const double *chroma, const double *profile, int tonic) {
+    double meanC = 0.0, meanP = 0.0;
+    for (int i = 0; i < 12; i++) {
+        meanC += chroma[i] / 12.0;
+        meanP += profile[i] / 12.0;
+    }
+    double cov = 0.0, varC = 0.0, varP = 0.0;
+    for (int i = 0; i < 12; i++) {
+        double c = chroma[(i + tonic) % 12] - meanC;
+        double p = profile[i] - meanP;
+        cov += c * p;
+        varC += c * c;
+        varP += p * p;
+    }
+    return (varC > 0.0) ? cov / qSqrt(varC * varP) : 0.0;
+}
+
+}
+
+TempoKeyMeter::TempoKeyMeter(int sampleRate, int numChannels)
+    : rate(sampleRate), channels(qMax(numChannels, 1)), fft(fftSizeFor(sampleRate)) {
+    const int n = fft.size();
+    // ~11ms between onset frames
+    hop = n / 8;
+    window.resize(n);
+    for (int i = 0; i < n; i++) {
+        window[i] = (float)(0.5 - 0.5 * qCos(2.0 * M_PI * i / n));
+    }
+    re.resize(n);
+    im.resize(n);
+    power.resize(n / 2);
+    logMag.fill(0.0f, n / 2);
+    prevLogMag.fill(0.0f, n / 2);
+    // percussive onsets live below ~8kHz, the rest is mostly noise
+    fluxBins = qMin(n / 2, (int)(8000.0 * n / rate));
+    // bins from ~G2 to ~E7 fold into the chroma, lower ones are too coarse
+    pitchClass.fill(-1, n / 2);
+    for (int k = 1; k < n / 2; k++) {
+        double hz = (double)k * rate / n;
+        if (hz >= 100.0 && hz <= 2500.0) {
+            int semitone = qRound(12.0 * qLn(hz / 440.0) / qLn(2.0)) + 9;
+            pitchClass[k] = ((semitone % 12) + 12) % 12;
+        }
+    }
+    for (int i = 0; i < 12; i++) {
+        chroma[i] = 0.0;
+    }
+    frames = 0;
+    fftFrames = 0;
+}
+
+void TempoKeyMeter::addFrames(const float *samples, int count) {
+    int old = mono.size();
+    mono.resize(old + count);
+    float *out = mono.data() + old;
+    if (channels == 1) {
+        memcpy(out, samples, count * sizeof(float));
+    } else {
+        float scale = 1.0f / channels;
+        for (int i = 0; i < count; i++) {
+            float sum = 0.0f;
+            for (int c = 0; c < channels; c++) {
+                sum += samples[i * channels + c];
+            }
+            out[i] = sum * scale;
+        }
+    }
+    frames += count;
+    analyse();
+}
+
+void TempoKeyMeter::analyse() {
+    const SampleKernels &k = sampleKernels();
+    const int n = fft.size();
+    // a full scale sine through the Hann window peaks at n/4
+    const float magScale = 1000.0f / (n / 4.0f);
+    int offset = 0;
+    while (mono.size() - offset >= n) {
+        memcpy(re.data(), mono.constData() + offset, n * sizeof(float));
+        k.applyWindow(re.data(), window.constData(), n);
+        memset(im.data(), 0, n * sizeof(float));
+        fft.forward(re.data(), im.data());
+        k.powerSpectrum(re.constData(), im.constData(), power.data(), n / 2);
+
+        for (int i = 0; i < n / 2; i++) {
+            power[i] = qSqrt(power[i]);
+            logMag[i] = log1pf(power[i] * magScale);
+        }
+        onsets.append(fftFrames > 0 ? k.fluxSum(logMag.constData(), prevLogMag.constData(), fluxBins) : 0.0f);
+        // the key doesn't need every frame. Linear magnitudes, the log ones
+        // would lift the overtones (mostly the fifth) up to the fundamentals.
+        if (fftFrames % 2 == 0) {
+            for (int i = 0; i < n / 2; i++) {
+                if (pitchClass[i] >= 0) {
+                    chroma[pitchClass[i]] += power[i];
+                }
+            }
+        }
+        logMag.swap(prevLogMag);
+        fftFrames++;
+        offset += hop;
+    }
+    if (offset > 0) {
+        mono.remove(0, offset);
+    }
+}
+
+double TempoKeyMeter::bpm() const {
+    const double fps = (double)rate / hop;
+    const int count = onsets.size();
+    if (count < fps * 5) {
+        return 0.0;
+    }
+    // onsets above their local mean (~0.25 s), so sustained loudness doesn't count
+    QVector<double> prefix(count + 1);
+    prefix[0] = 0.0;
+    for (int i = 0; i < count; i++) {
+        prefix[i+1] = prefix[i] + onsets[i];
+    }
+    int half = qMax(1, (int)(fps / 8));
+    QVector<float> env(count);
+    for (int i = 0; i < count; i++) {
+        int from = qMax(0, i - half), to = qMin(count, i + half + 1);
+        double mean = (prefix[to] - prefix[from]) / (to - from);
+        env[i] = (float)qMax(0.0, onsets[i] - mean);
+    }
+
+    // autocorrelation over 50-220 BPM, with a log-normal prior around 120 BPM
+    int minLag = qMax(1, (int)(fps * 60.0 / 220.0));
+    int maxLag = qMin(count / 2, (int)(fps * 60.0 / 50.0) + 1);
+    if (maxLag <= minLag + 2) {
+        return 0.0;
+    }
+    QVector<double> score(maxLag + 2, 0.0);
+    int best = -1;
+    for (int lag = minLag; lag <= maxLag; lag++) {
+        double acf = 0.0;
+        for (int i = 0; i + lag < count; i++) {
+            acf += (double)env[i] * env[i + lag];
+        }
+        acf /= (count - lag);
+        double octaves = qLn(60.0 * fps / lag / 120.0) / qLn(2.0);
+        score[lag] = acf * qExp(-0.5 * octaves * octaves);
+        if (score[lag] > 0.0 && (best < 0 || score[lag] > score[best])) {
+            best = lag;
+        }
+    }
+    if (best < 0) {
+        return 0.0;
+    }
+    // parabolic interpolation between the lags around the peak
+    double lag = best;
+    if (best > minLag && best < maxLag) {
+        double a = score[best-1], b = score[best], c = score[best+1];
+        double denom = a - 2.0 * b + c;
+        if (denom < 0.0) {
+            lag += 0.5 * (a - c) / denom;
+        }
+    }
+    return 60.0 * fps / lag;
+}
+
+int TempoKeyMeter::key() const {
+    double total = 0.0;
+    for (int i = 0; i < 12; i++) {
+        total += chroma[i];
+    }
+    if (total <= 0.0) {
+        return NO_KEY;
+    }
+    int best = NO_KEY;
+    double bestCorrelation = -2.0;
+    for (int tonic = 0; tonic < 12; tonic++) {
+        double major = correlation(chroma, MAJOR_PROFILE, tonic);
+        double minor = correlation(chroma, MINOR_PROFILE, tonic);
+        if (major > bestCorrelation) {
+            bestCorrelation = major;
+            best = tonic;
+        }
+        if (minor > bestCorrelation) {
+            bestCorrelation = minor;
+            best = 12 + tonic;
+        }
+    }
+    return best;
+}
+
+qint64 TempoKeyMeter::framesMeasured() const {
+    return frames;
+}
+
+QString TempoKeyMeter::keyName(int key) {
+    static const char *names[12] = {"C", "Db", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B"};
+    if (key < 0 || key >= 24) {
+        return QString();
+    }
+    return QString("%1 %2").arg(names[key % 12]).arg(key < 12 ? "major" : "minor");
+}
+
+QString TempoKeyMeter::camelotCode(int key) {
+    if (key < 0 || key >= 24) {
+        return QString();
+    }
+    // a minor key sits next to its relative major, three semitones up
+    int major = key < 12 ? key : (key + 3) % 12;
+    int number = ((major * 7) % 12 + 7) % 12 + 1;
+    return QString("%1%2").arg(number).arg(key < 12 ? "B" : "A");
+}
+
+int TempoKeyMeter::camelotOrder(int key) {
+    if (key < 0 || key >= 24) {
+        return 24;
+    }
+    int major = key < 12 ? key : (key + 3) % 12;
+    int number = ((major * 7) % 12 + 7) % 12 + 1;
+    return (number - 1) * 2 + (key < 12 ? 1 : 0);
+}
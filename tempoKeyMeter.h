@@ -0,0 +1,57 @@
+#pragma once
+#include "debug.h"
+#include "fft.h"
+#include <QString>
+#include <QVector>
+
+/*
+ * TempoKeyMeter estimates the tempo and the musical key of a track from its
+ * decoded audio. Both come from one short-time FFT of the mono mix:
+ *
+ *  - tempo: spectral flux of the log-compressed magnitudes gives an onset
+ *    envelope, whose autocorrelation (weighted towards 120 BPM to settle
+ *    octave errors) peaks at the beat period
+ *  - key: the magnitudes of the whole track folded into a 12-bin chroma,
+ *    correlated with the Krumhansl-Kessler major and minor profiles
+ *
+ * Keys are numbered 0-11 for C major to B major and 12-23 for C minor to
+ * B minor.
+ */
+class TempoKeyMeter {
+public:
+    static const int NO_KEY = -1;
+
+    TempoKeyMeter(int sampleRate, int numChannels);
+
+    void addFrames(const float *samples, int frames);
+
+    // 0 / NO_KEY if the track was too short or silent
+    double bpm() const;
+    int key() const;
+    qint64 framesMeasured() const;
+
+    static QString keyName(int key);
+    // Camelot wheel code ("8A" for A minor), harmonically compatible keys
+    // are one step apart; empty for NO_KEY
+    static QString camelotCode(int key);
+    // orders keys around the Camelot wheel, 1A first
+    static int camelotOrder(int key);
+
+private:
+    void analyse();
+
+    int rate;
+    int channels;
+    int hop;
+    Fft fft;
+    QVector<float> mono;        // not yet analysed input
+    QVector<float> window;
+    QVector<float> re, im, power;
+    QVector<float> logMag, prevLogMag;
+    int fluxBins;
+    QVector<int> pitchClass;    // per bin, -1 outside the chroma range
+    double chroma[12];
+    QVector<float> onsets;
+    qint64 frames;
+    int fftFrames;
+};
@@ -0,0 +1,162 @@
+#include "trackHeadCache.h"
+#include <QAudioDecoder>
+#include <QAudioBuffer>
+#include <QDebug>
+
+TrackHeadCache::TrackHeadCache(PlaylistModel *model, QObject *parent)
+    : QObject(parent), playlistModel(model) {
+    headMs = 400;
+    budgetBytes = 4*1024*1024;  // 400ms of 16-bit stereo 44.1kHz is ~70 KB
+    usedBytes = 0;
+    hitCount = 0;
+    missCount = 0;
+
+    // ask for plain 16-bit PCM so the heads can be fed straight to QAudioOutput
+    QAudioFormat format;
+    format.setSampleRate(44100);
+    format.setChannelCount(2);
+    format.setSampleSize(16);
+    format.setSampleType(QAudioFormat::SignedInt);
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setCodec("audio/pcm");
+
+    decoder = new QAudioDecoder(this);
+    decoder->setAudioFormat(format);
+    connect(decoder, SIGNAL(bufferReady()), this, SLOT(bufferReady()));
+    connect(decoder, SIGNAL(finished()), this, SLOT(decodeFinished()));
+    connect(decoder, SIGNAL(error(QAudioDecoder::Error)), this, SLOT(decodeError()));
+
+    connect(playlistModel, SIGNAL(currentIndexChanged(int)), this, SLOT(fillNeighbours()));
+    connect(playlistModel, SIGNAL(mediaAvailable()), this, SLOT(fillNeighbours()));
+}
+
+TrackHeadCache::~TrackHeadCache() {
+    decoder->stop();
+}
+
+void TrackHeadCache::setHeadMs(int ms) {
+    headMs = ms;
+}
+
+void TrackHeadCache::setBudgetBytes(qint64 bytes) {
+    budgetBytes = bytes;
+    trimToBudget();
+}
+
+int TrackHeadCache::hits() const {
+    return hitCount;
+}
+
+int TrackHeadCache::misses() const {
+    return missCount;
+}
+
+qint64 TrackHeadCache::bytesUsed() const {
+    return usedBytes;
+}
+
+qint64 TrackHeadCache::budget() const {
+    return budgetBytes;
+}
+
+bool TrackHeadCache::lookup(const QString &absFilePath, QAudioFormat &format, QByteArray &pcm) {
+    if (!heads.contains(absFilePath)) {
+        missCount++;
+        return false;
+    }
+    hitCount++;
+    const Head &h = heads[absFilePath];
+    format = h.format;
+    pcm = h.pcm;    // implicitly shared, no copy
+    lruOrder.removeOne(absFilePath);
+    lruOrder.append(absFilePath);
+    return true;
+}
+
+void TrackHeadCache::fillNeighbours() {
+    // queue the likely skip targets; anything already cached or decoding is skipped
+    QList<int> rows;
+    rows << playlistModel->peekNextIdx() << playlistModel->peekPreviousIdx();
+    pending.clear();
+    int row;
+    foreach(row, rows) {
+        QString absFilePath = playlistModel->getAbsFilePath(row);
+        if (absFilePath.isEmpty() || heads.contains(absFilePath) ||
+            absFilePath == decodingPath || pending.contains(absFilePath)) {
+            continue;
+        }
+        pending.append(absFilePath);
+    }
+    if (decodingPath.isEmpty()) {
+        decodeNext();
+    }
+}
+
+void TrackHeadCache::decodeNext() {
+    decodingPath.clear();
+    decodingHead = Head();
+    while (!pending.isEmpty()) {
+        QString absFilePath = pending.takeFirst();
+        if (heads.contains(absFilePath)) {
+            continue;
+        }
+        decodingPath = absFilePath;
+        decoder->setSourceFilename(absFilePath);
+        decoder->start();
+        return;
+    }
+}
+
+void TrackHeadCache::bufferReady() {
+    QAudioBuffer buffer = decoder->read();
+    if (!buffer.isValid() || decodingPath.isEmpty()) {
+        return;
+    }
+    if (decodingHead.pcm.isEmpty()) {
+        decodingHead.format = buffer.format();
+    }
+    decodingHead.pcm.append(buffer.constData<char>(), buffer.byteCount());
+
+    // stop once we have enough of the head
+    if (decodingHead.format.durationForBytes(decodingHead.pcm.size()) >= (qint64)headMs*1000) {
+        decoder->stop();
+        storeCurrent();
+        decodeNext();
+    }
+}
+
+void TrackHeadCache::decodeFinished() {
+    // track shorter than headMs, keep what we have
+    if (!decodingPath.isEmpty()) {
+        storeCurrent();
+        decodeNext();
+    }
+}
+
+void TrackHeadCache::decodeError() {
+#if DEBUG_PREFETCH
+    qDebug() << "TrackHeadCache: can't decode" << decodingPath << decoder->errorString();
+#endif
+    decoder->stop();
+    decodeNext();
+}
+
+void TrackHeadCache::storeCurrent() {
+    if (decodingHead.pcm.isEmpty()) {
+        return;
+    }
+    heads[decodingPath] = decodingHead;
+    lruOrder.append(decodingPath);
+    usedBytes += decodingHead.pcm.size();
+    trimToBudget();
+#if DEBUG_PREFETCH
+    qDebug() << "TrackHeadCache: cached" << decodingPath << "used=" << usedBytes
+             << " hits=" << hitCount << " misses=" << missCount;
+#endif
+}
+
+void TrackHeadCache::trimToBudget() {
+    while (usedBytes > budgetBytes && !lruOrder.isEmpty()) {
+        usedBytes -= heads.take(lruOrder.takeFirst()).pcm.size();
+    }
+}
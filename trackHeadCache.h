@@ -0,0 +1,76 @@
+#pragma once
+#include "debug.h"
+#include "playlistmodel.h"
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QByteArray>
+#include <QAudioFormat>
+
+class PlaylistModel;
+class QAudioDecoder;
+
+/*
+ * TrackHeadCache keeps the first few hundred milliseconds of decoded PCM for
+ * the tracks the user is most likely to skip to (next, previous and the
+ * pre-rolled shuffle pick), so the Player can start a skip audibly while
+ * QMediaPlayer is still opening the file. Heads are decoded one at a time in
+ * the background and evicted least-recently-used first once the memory budget
+ * is exceeded.
+ */
+class TrackHeadCache : public QObject {
+    Q_OBJECT
+
+public:
+    TrackHeadCache(PlaylistModel *model, QObject *parent = 0);
+    ~TrackHeadCache();
+
+    void setHeadMs(int ms);
+    void setBudgetBytes(qint64 bytes);
+
+    // returns true and fills format/pcm if the head of absFilePath is cached
+    bool lookup(const QString &absFilePath, QAudioFormat &format, QByteArray &pcm);
+
+    // statistics
+    int hits() const;
+    int misses() const;
+    qint64 bytesUsed() const;
+    qint64 budget() const;
+
+public slots:
+    void fillNeighbours();
+
+private slots:
+    void bufferReady();
+    void decodeFinished();
+    void decodeError();
+
+private:
+    struct Head {
+        QAudioFormat format;
+        QByteArray pcm;
+    };
+
+    void decodeNext();
+    void storeCurrent();
+    void trimToBudget();
+
+    PlaylistModel *playlistModel;
+    QAudioDecoder *decoder;
+    int headMs;
+    qint64 budgetBytes;
+
+    // absFilePath -> decoded head, least recently used first in lruOrder
+    QHash<QString, Head> heads;
+    QList<QString> lruOrder;
+    qint64 usedBytes;
+
+    // the head currently being decoded, and the ones waiting for it
+    QString decodingPath;
+    Head decodingHead;
+    QList<QString> pending;
+
+    int hitCount;
+    int missCount;
+};
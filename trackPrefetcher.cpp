@@ -0,0 +1,166 @@
+#include "trackPrefetcher.h"
+#include <QRunnable>
+#include <QFile>
+#include <QDebug>
+
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(Q_OS_MAC)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Issues the readahead for one file off the GUI thread; opening a file on a
+// network mount can itself block, so even the advise call is not done inline.
+class PrefetchTask : public QRunnable {
+public:
+    PrefetchTask(const QString &absFilePath, qint64 length)
+        : path(absFilePath), len(length) {}
+
+    void run() {
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly)) {
+            return;
+        }
+#if defined(Q_OS_LINUX)
+        // asynchronous: the kernel schedules the reads and returns immediately
+        posix_fadvise(f.handle(), 0, len, POSIX_FADV_WILLNEED);
+#elif defined(Q_OS_MAC)
+        struct radvisory ra;
+        ra.ra_offset = 0;
+        ra.ra_count = (int)len;
+        fcntl(f.handle(), F_RDADVISE, &ra);
+#else
+        // no advisory interface, touch the pages ourselves
+        qint64 left = len;
+        while (left > 0) {
+            QByteArray chunk = f.read(qMin(left, (qint64)65536));
+            if (chunk.isEmpty()) {
+                break;
+            }
+            left -= chunk.size();
+        }
+#endif
+        f.close();
+    }
+
+private:
+    QString path;
+    qint64 len;
+};
+
+}
+
+TrackPrefetcher::TrackPrefetcher(PlaylistModel *model, QObject *parent)
+    : QObject(parent), playlistModel(model) {
+    scheduler = JobScheduler::instance();
+    headBytes = 1024*1024;      // ~1 MB covers several seconds of most codecs
+    budgetBytes = 8*1024*1024;
+    residentBytes = 0;
+    hitCount = 0;
+    missCount = 0;
+    requestedBytes = 0;
+
+    connect(playlistModel, SIGNAL(currentIndexChanged(int)), this, SLOT(curMediaChanged(int)));
+    connect(playlistModel, SIGNAL(mediaAvailable()), this, SLOT(prefetchNeighbours()));
+}
+
+TrackPrefetcher::~TrackPrefetcher() {
+    scheduler->cancel(this);
+    scheduler->waitForGroup(this);
+}
+
+void TrackPrefetcher::setHeadBytes(qint64 bytes) {
+    headBytes = bytes;
+}
+
+void TrackPrefetcher::setBudgetBytes(qint64 bytes) {
+    budgetBytes = bytes;
+    trimToBudget();
+}
+
+int TrackPrefetcher::hits() const {
+    return hitCount;
+}
+
+int TrackPrefetcher::misses() const {
+    return missCount;
+}
+
+qreal TrackPrefetcher::hitRate() const {
+    int total = hitCount + missCount;
+    return (total > 0) ? (qreal)hitCount / total : 0;
+}
+
+qint64 TrackPrefetcher::bytesRequested() const {
+    return requestedBytes;
+}
+
+qint64 TrackPrefetcher::bytesResident() const {
+    return residentBytes;
+}
+
+qint64 TrackPrefetcher::budget() const {
+    return budgetBytes;
+}
+
+void TrackPrefetcher::curMediaChanged(int curMediaIdx) {
+    // account for whether the track we moved to had been prefetched
+    QString absFilePath = playlistModel->getAbsFilePath(curMediaIdx);
+    if (absFilePath.isEmpty()) {
+        return;
+    }
+    if (prefetched.contains(absFilePath)) {
+        hitCount++;
+        // it is being read by the player now, no need to keep accounting for it
+        residentBytes -= prefetched.take(absFilePath);
+        prefetchOrder.removeOne(absFilePath);
+    }
+    else {
+        missCount++;
+    }
+#if DEBUG_PREFETCH
+    qDebug() << "TrackPrefetcher: hits=" << hitCount << " misses=" << missCount
+             << " hitRate=" << hitRate() << " requested=" << requestedBytes;
+#endif
+    prefetchNeighbours();
+}
+
+void TrackPrefetcher::prefetchNeighbours() {
+    int next = playlistModel->peekNextIdx();
+    int previous = playlistModel->peekPreviousIdx();
+    int cur = playlistModel->getCurMediaIdx();
+
+    // in shuffle mode peekNextIdx() is already the pre-rolled pick, otherwise
+    // it is the following row
+    if (next >= 0 && next != cur) {
+        prefetch(playlistModel->getAbsFilePath(next));
+    }
+    if (previous >= 0 && previous != cur && previous != next) {
+        prefetch(playlistModel->getAbsFilePath(previous));
+    }
+}
+
+void TrackPrefetcher::prefetch(const QString &absFilePath) {
+    if (absFilePath.isEmpty() || prefetched.contains(absFilePath) || headBytes <= 0) {
+        return;
+    }
+    qint64 len = qMin(headBytes, budgetBytes);
+    prefetched[absFilePath] = len;
+    prefetchOrder.append(absFilePath);
+    residentBytes += len;
+    requestedBytes += len;
+    trimToBudget();
+    // the next track starts on it, and it's all disk reads
+    scheduler->submit(new PrefetchTask(absFilePath, len), JobScheduler::INTERACTIVE, this, JobScheduler::IO_BOUND);
+}
+
+void TrackPrefetcher::trimToBudget() {
+    // forget the oldest prefetches first, the page cache will reclaim them
+    while (residentBytes > budgetBytes && !prefetchOrder.isEmpty()) {
+        residentBytes -= prefetched.take(prefetchOrder.takeFirst());
+    }
+}
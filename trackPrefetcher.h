@@ -0,0 +1,60 @@
+#pragma once
+#include "debug.h"
+#include "playlistmodel.h"
+#include "jobScheduler.h"
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+class PlaylistModel;
+
+/*
+ * TrackPrefetcher warms the OS page cache for the tracks that are most likely
+ * to be played next (next, previous and the pre-rolled shuffle pick) every time
+ * the playlist's current entry changes. Only the head of each file is advised,
+ * and the total amount of outstanding readahead is bounded by a byte budget.
+ */
+class TrackPrefetcher : public QObject {
+    Q_OBJECT
+
+public:
+    TrackPrefetcher(PlaylistModel *model, QObject *parent = 0);
+    ~TrackPrefetcher();
+
+    // how much of each file's head to read ahead, and the budget for all of them
+    void setHeadBytes(qint64 bytes);
+    void setBudgetBytes(qint64 bytes);
+
+    // statistics
+    int hits() const;
+    int misses() const;
+    qreal hitRate() const;
+    qint64 bytesRequested() const;
+    qint64 bytesResident() const;
+    qint64 budget() const;
+
+public slots:
+    void prefetchNeighbours();
+
+private slots:
+    void curMediaChanged(int curMediaIdx);
+
+private:
+    void prefetch(const QString &absFilePath);
+    void trimToBudget();
+
+    PlaylistModel *playlistModel;
+    JobScheduler *scheduler;
+    qint64 headBytes;
+    qint64 budgetBytes;
+
+    // absFilePath -> advised bytes, oldest first in prefetchOrder
+    QHash<QString, qint64> prefetched;
+    QList<QString> prefetchOrder;
+    qint64 residentBytes;
+
+    int hitCount;
+    int missCount;
+    qint64 requestedBytes;
+};
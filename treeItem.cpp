@@ -1,4 +1,6 @@
 #include "treeItem.h"
+#include "collation.h"
+#include "pathTrie.h"
 #include <QStringList>
 #include <assert.h>
 #include <QDebug>
@@ -8,8 +10,11 @@ TreeItem::TreeItem(const QHash<QString, QString> &data, ITEM_TYPE type, TreeItem
         case ARTIST:
             assert(data.contains("Artist") && parent->getItemType() == ROOT);
             break;
+        case ALBUM:
+            assert(data.contains("Album") && parent->getItemType() == ARTIST);
+            break;
         case SONG:
-            assert(data.contains("Title") && data.contains("absFilePath") && parent->getItemType() == ARTIST);
+            assert(data.contains("Title") && data.contains("absFilePath") && parent->getItemType() == ALBUM);
             break;
         case ROOT:
             // no data for root
@@ -22,11 +27,21 @@ TreeItem::TreeItem(const QHash<QString, QString> &data, ITEM_TYPE type, TreeItem
     parentItem = parent;
     itemData = data;
     itemType = type;
+    songs = 0;
+    fetched = true;
+    pathId = PathTrie::ROOT;
+    songId = 0;
+    if (type == SONG) {
+        // the path is kept once, in the trie
+        pathId = PathTrie::instance()->insert(itemData.take("absFilePath"));
+        songId = itemData.take("id").toLongLong();
+    }
 }
 
 TreeItem::~TreeItem() {
     qDeleteAll(childItems);
     childItems.clear();
+    PathTrie::instance()->release(pathId);
 }
 
 void TreeItem::setParentItem(TreeItem *item) {
@@ -46,9 +61,18 @@ QHash<QString, QString>& TreeItem::getItemData() {
 }
 
 void TreeItem::sortChildren() {
-    // sort the childItems pointers alphabetically.
-    if (itemType == ROOT || itemType == ARTIST) {
-        qSort(childItems.begin(), childItems.end(), PtrLess<TreeItem>());
+    // sort the childItems pointers in the locale's collation order.
+    if (itemType != SONG) {
+        QStringList names;
+        foreach (TreeItem *child, childItems) {
+            names.append(child->name());
+        }
+        QVector<int> order = Collation::instance()->order(names);
+        QList<TreeItem*> sorted;
+        for (int i = 0; i < order.size(); i++) {
+            sorted.append(childItems[order[i]]);
+        }
+        childItems.swap(sorted);
     }
 }
 
@@ -56,7 +80,7 @@ TreeItem *TreeItem::findChildNode(const QString clue) const {
     if (itemType == ROOT) {
         TreeItem* child;
         foreach(child, childItems) {
-            if (child->itemData["Artist"] == clue) {
+            if (child->itemData["ArtistKey"] == clue) {
                 return child;
             }
         }
@@ -64,11 +88,15 @@ TreeItem *TreeItem::findChildNode(const QString clue) const {
     if (itemType == ARTIST) {
         TreeItem* child;
         foreach(child, childItems) {
-            if (child->itemData["absFilePath"] == clue) {
+            if (child->itemData["Album"] == clue) {
                 return child;
             }
         }
     }
+    if (itemType == ALBUM) {
+        int i = findChildIndex(clue);
+        return i >= 0 ? childItems[i] : NULL;
+    }
     return NULL;
 }
 
@@ -77,11 +105,21 @@ int TreeItem::findChildIndex(const QString clue) const {
     QString clueType;
     switch(itemType) {
         case ROOT:
-            clueType = "Artist";
+            clueType = "ArtistKey";
             break;
         case ARTIST:
-            clueType = "absFilePath";
+            clueType = "Album";
             break;
+        case ALBUM: {
+            // songs by their path's node, there's no path string to compare
+            quint32 id = PathTrie::instance()->find(clue);
+            for (int i = 0; id != PathTrie::ROOT && i < childItems.size(); i++) {
+                if (childItems[i]->pathId == id) {
+                    return i;
+                }
+            }
+            return -1;
+        }
         default:
             return -1;
     }
@@ -121,6 +159,8 @@ QVariant TreeItem::data() const {
     switch(itemType) {
         case ARTIST:
             return itemData["Artist"];
+        case ALBUM:
+            return itemData["Album"];
         case SONG:
             return itemData["Title"];
         default:
@@ -128,6 +168,19 @@ QVariant TreeItem::data() const {
     }
 }
 
+QString TreeItem::name() const {
+    switch(itemType) {
+        case ARTIST:
+            return itemData.value("Artist");
+        case ALBUM:
+            return itemData.value("Album");
+        case SONG:
+            return itemData.value("Title");
+        default:
+            return QString();
+    }
+}
+
 bool TreeItem::addChild(ITEM_TYPE type, QHash<QString, QString> data) {
     //qDebug() << "Want to add item of type " << type;
     //qDebug() << "Adding to item of type " << itemType;
@@ -166,8 +219,7 @@ bool TreeItem::insertChild(int position, ITEM_TYPE type, QHash<QString, QString>
 }
 
 bool TreeItem::insertChildItem(int position, ITEM_TYPE type, TreeItem *item) {
-    assert(type != ROOT);
-    itemTypeAssert(type, item->getItemData());
+    assert(type != ROOT && type == item->getItemType());
     childItems.insert(position, item);
     return true;
 }
@@ -193,13 +245,44 @@ QList<TreeItem*> & TreeItem::getChildItems() {
     return childItems;
 }
 
+int TreeItem::songCount() const {
+    return songs;
+}
+
+void TreeItem::setSongCount(int count) {
+    songs = count;
+}
+
+QString TreeItem::path() const {
+    return pathId == PathTrie::ROOT ? QString() : PathTrie::instance()->path(pathId);
+}
+
+quint32 TreeItem::pathNode() const {
+    return pathId;
+}
+
+qint64 TreeItem::trackId() const {
+    return songId;
+}
+
+bool TreeItem::isFetched() const {
+    return fetched;
+}
+
+void TreeItem::setFetched(bool done) {
+    fetched = done;
+}
+
 void TreeItem::itemTypeAssert(ITEM_TYPE type, QHash<QString, QString> &data) const {
     switch (type) {
         case ARTIST:
             assert(data.contains("Artist") && (itemType == ROOT));
             return;
+        case ALBUM:
+            assert(data.contains("Album") && (itemType == ARTIST));
+            return;
         case SONG:
-            assert(data.contains("absFilePath") && data.contains("Title") && (itemType == ARTIST));
+            assert(data.contains("absFilePath") && data.contains("Title") && (itemType == ALBUM));
             return;
         default:
             return;
@@ -5,7 +5,7 @@
 
 class TreeItem {
     public:
-        enum ITEM_TYPE {ROOT, ARTIST, SONG};
+        enum ITEM_TYPE {ROOT, ARTIST, ALBUM, SONG};
         TreeItem(const QHash<QString, QString> &data, ITEM_TYPE type, TreeItem *parent = 0);
         ~TreeItem();
         void setParentItem(TreeItem *item);
@@ -14,6 +14,8 @@ class TreeItem {
         int ChildCount() const;
         int columnCount() const;
         QVariant data() const;
+        // what data() shows, without the QVariant
+        QString name() const;
         bool addChild(ITEM_TYPE type, QHash<QString, QString> data);
         bool removeChild(int position);
         bool insertChild(int position, ITEM_TYPE type, QHash<QString, QString> data);
@@ -29,6 +31,18 @@ class TreeItem {
         QList<QString> childrenData() const;
         const QList<TreeItem*> &getChildItems() const;
         QList<TreeItem*> &getChildItems();
+        // artists and albums: the songs under them, whether or not their
+        // children have been fetched from the database yet
+        int songCount() const;
+        void setSongCount(int count);
+        bool isFetched() const;
+        void setFetched(bool done);
+        // songs: the file, which is given as "absFilePath" but isn't kept
+        // in the item data, see PathTrie
+        QString path() const;
+        quint32 pathNode() const;
+        // songs: the MUSICLIBRARY row, given as "id", 0 if it wasn't
+        qint64 trackId() const;
 
     private:
         void itemTypeAssert(ITEM_TYPE type, QHash<QString, QString> &data) const;
@@ -37,11 +51,8 @@ class TreeItem {
         QList<TreeItem*> childItems;
         QHash<QString, QString> itemData;
         TreeItem *parentItem;
-};
-
-template <typename T>
-struct PtrLess {
-    bool operator()(const T* a, const T* b) const {
-        return a->data().toString() < b->data().toString();
-    }
+        int songs;
+        bool fetched;
+        quint32 pathId;
+        qint64 songId;
 };
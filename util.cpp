@@ -1,4 +1,5 @@
 #include "util.h"
+#include "tagWriter.h"
 #include <QHash>
 void Util::get_metaData(QString path, QHash<QString, QString>& hash) {
     // get fileInfo first
@@ -23,6 +24,8 @@ void Util::get_metaData(QString path, QHash<QString, QString>& hash) {
             hash["Artist"] = artist.isEmpty() ? QString("Unknown") : artist;
             hash["Album"] = album.isEmpty() ? QString("Unknown") : album;
         }
+        // edits that are still on their way to the file
+        TagWriter::instance()->overlayPending(path, hash);
         if (!f.isNull() && f.audioProperties()) {
             TagLib::AudioProperties *properties = f.audioProperties();
             int seconds = properties->length() % 60;
@@ -0,0 +1,260 @@
+#include "waveformCache.h"
+#include "pcmDecoder.h"
+#include "sampleKernels.h"
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+namespace {
+
+const quint32 WAVEFORM_MAGIC = 0x41415746;  // "AAWF"
+const quint32 WAVEFORM_VERSION = 1;
+// ~11.6ms per bucket at 44.1kHz; levels stop halving below MIN_BUCKETS
+const int BUCKET_FRAMES = 512;
+const int MIN_BUCKETS = 64;
+
+// peaks are signed bytes; plain char is unsigned on ARM and PowerPC
+inline qint8 toByte(float v) {
+    return (qint8)qBound(-127, qRound(v * 127.0f), 127);
+}
+
+// Folds the decoded samples of all channels into (min, max) buckets.
+class PeakSink : public PcmSink {
+public:
+    PeakSink() : fill(0), lo(0.0f), hi(0.0f), rate(0) {}
+
+    bool consume(const float *samples, int frames, int channels, int sampleRate) {
+        const SampleKernels &k = sampleKernels();
+        rate = sampleRate;
+        // interleaved frames are contiguous, so a bucket is one flat run of samples
+        while (frames > 0) {
+            int n = qMin(frames, BUCKET_FRAMES - fill);
+            k.minMax(samples, n * channels, &lo, &hi);
+            samples += n * channels;
+            frames -= n;
+            fill += n;
+            if (fill == BUCKET_FRAMES) {
+                flush();
+            }
+        }
+        return true;
+    }
+
+    void flush() {
+        if (fill == 0) {
+            return;
+        }
+        peaks.append((char)toByte(lo));
+        peaks.append((char)toByte(hi));
+        fill = 0;
+        lo = 0.0f;
+        hi = 0.0f;
+    }
+
+    QByteArray peaks;
+    int fill;
+    float lo, hi;
+    int rate;
+};
+
+class WaveformTask : public QRunnable {
+public:
+    WaveformTask(WaveformCache *owner, const QString &absFilePath)
+        : cache(owner), path(absFilePath) {}
+
+    void run() {
+        QElapsedTimer timer;
+        timer.start();
+        PcmDecoder decoder;
+        PeakSink sink;
+        Waveform waveform;
+        if (decoder.decode(path, &sink)) {
+            sink.flush();
+            waveform.sampleRate = sink.rate;
+            waveform.bucketFrames = BUCKET_FRAMES;
+            waveform.durationMs = decoder.decodedFrames() * 1000 / sink.rate;
+            waveform.levels.append(sink.peaks);
+            // every coarser level takes the min of the mins and max of the maxes
+            while (waveform.levels.last().size() / 2 > MIN_BUCKETS) {
+                const QByteArray &fineBytes = waveform.levels.last();
+                const qint8 *fine = reinterpret_cast<const qint8 *>(fineBytes.constData());
+                int size = fineBytes.size();
+                int buckets = (size / 2 + 1) / 2;
+                QByteArray coarseBytes(buckets * 2, 0);
+                qint8 *coarse = reinterpret_cast<qint8 *>(coarseBytes.data());
+                for (int i = 0; i < buckets; i++) {
+                    int a = 4*i, b = qMin(4*i + 2, size - 2);
+                    coarse[2*i] = qMin(fine[a], fine[b]);
+                    coarse[2*i+1] = qMax(fine[a+1], fine[b+1]);
+                }
+                waveform.levels.append(coarseBytes);
+            }
+        }
+        cache->post(path, waveform, timer.elapsed());
+    }
+
+private:
+    WaveformCache *cache;
+    QString path;
+};
+
+}
+
+int Waveform::levelFor(int buckets) const {
+    int level = 0;
+    while (level + 1 < levels.size() && this->buckets(level + 1) >= buckets) {
+        level++;
+    }
+    return level;
+}
+
+WaveformCache::WaveformCache(QObject *parent) : QObject(parent) {
+    // the seek bar of the current track is waiting for it
+    scheduler = JobScheduler::instance();
+    cacheDir = "AAMusicPlayer_waveforms";
+    QDir().mkpath(cacheDir);
+    memoryEntries = 16;
+    hitCount = 0;
+    missCount = 0;
+    audioSeconds = 0.0;
+    cpuMs = 0;
+}
+
+WaveformCache::~WaveformCache() {
+    scheduler->cancel(this);
+    scheduler->waitForGroup(this);
+}
+
+int WaveformCache::hits() const {
+    return hitCount;
+}
+
+int WaveformCache::misses() const {
+    return missCount;
+}
+
+double WaveformCache::realtimeFactorPerCore() const {
+    // each overview is generated by a single worker, so busy time is per core
+    return cpuMs > 0 ? audioSeconds * 1000.0 / cpuMs : 0.0;
+}
+
+bool WaveformCache::request(const QString &absFilePath, Waveform &waveform) {
+    if (memory.contains(absFilePath)) {
+        hitCount++;
+        waveform = memory[absFilePath];
+        lruOrder.removeOne(absFilePath);
+        lruOrder.append(absFilePath);
+        return true;
+    }
+    QFileInfo info(absFilePath);
+    if (!info.exists()) {
+        return false;
+    }
+    if (load(cacheFile(info), waveform)) {
+        hitCount++;
+        remember(absFilePath, waveform);
+        return true;
+    }
+    missCount++;
+    if (!generating.contains(absFilePath)) {
+        generating.append(absFilePath);
+        scheduler->submit(new WaveformTask(this, absFilePath), JobScheduler::INTERACTIVE, this);
+    }
+    return false;
+}
+
+void WaveformCache::post(const QString &absFilePath, const Waveform &waveform, qint64 ms) {
+    QMutexLocker locker(&resultsLock);
+    Pending p;
+    p.absFilePath = absFilePath;
+    p.waveform = waveform;
+    p.cpuMs = ms;
+    results.append(p);
+    if (results.size() == 1) {
+        QMetaObject::invokeMethod(this, "collectResults", Qt::QueuedConnection);
+    }
+}
+
+void WaveformCache::collectResults() {
+    QList<Pending> batch;
+    {
+        QMutexLocker locker(&resultsLock);
+        batch.swap(results);
+    }
+    foreach (const Pending &p, batch) {
+        generating.removeOne(p.absFilePath);
+        if (p.waveform.isEmpty()) {
+            continue;
+        }
+        audioSeconds += p.waveform.durationMs / 1000.0;
+        cpuMs += p.cpuMs;
+#if DEBUG_ANALYSIS
+        qDebug() << "WaveformCache:" << p.absFilePath << p.cpuMs << "ms,"
+                 << realtimeFactorPerCore() << "x realtime per core";
+#endif
+        save(cacheFile(QFileInfo(p.absFilePath)), p.waveform);
+        remember(p.absFilePath, p.waveform);
+        emit(ready(p.absFilePath));
+    }
+}
+
+QString WaveformCache::cacheFile(const QFileInfo &info) const {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(info.canonicalFilePath().toUtf8());
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    return cacheDir + "/" + hash.result().toHex() + ".wf";
+}
+
+bool WaveformCache::load(const QString &fileName, Waveform &waveform) const {
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&f);
+    quint32 magic, version;
+    in >> magic >> version;
+    if (magic != WAVEFORM_MAGIC || version != WAVEFORM_VERSION) {
+        return false;
+    }
+    Waveform w;
+    qint32 rate, bucketFrames;
+    in >> w.durationMs >> rate >> bucketFrames >> w.levels;
+    w.sampleRate = rate;
+    w.bucketFrames = bucketFrames;
+    if (in.status() != QDataStream::Ok || w.isEmpty()) {
+        return false;
+    }
+    waveform = w;
+    return true;
+}
+
+bool WaveformCache::save(const QString &fileName, const Waveform &waveform) const {
+    // QSaveFile only replaces the old file once everything is written
+    QSaveFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream out(&f);
+    out << WAVEFORM_MAGIC << WAVEFORM_VERSION << waveform.durationMs
+        << (qint32)waveform.sampleRate << (qint32)waveform.bucketFrames << waveform.levels;
+    return f.commit();
+}
+
+void WaveformCache::remember(const QString &absFilePath, const Waveform &waveform) {
+    if (!memory.contains(absFilePath)) {
+        lruOrder.append(absFilePath);
+    }
+    memory[absFilePath] = waveform;
+    while (lruOrder.size() > memoryEntries) {
+        memory.remove(lruOrder.takeFirst());
+    }
+}
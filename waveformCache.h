@@ -0,0 +1,89 @@
+#pragma once
+#include "debug.h"
+#include "jobScheduler.h"
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+
+class QFileInfo;
+
+/*
+ * Min/max overview of a whole track, at several resolutions. levels[0] has one
+ * bucket per bucketFrames frames, every following level halves the bucket
+ * count. Each bucket is a (min, max) pair of signed bytes, -127..127.
+ */
+struct Waveform {
+    qint64 durationMs;
+    int sampleRate;
+    int bucketFrames;
+    QList<QByteArray> levels;
+
+    Waveform() : durationMs(0), sampleRate(0), bucketFrames(0) {}
+    bool isEmpty() const { return levels.isEmpty(); }
+    int buckets(int level) const { return levels[level].size() / 2; }
+    // the coarsest level that still has at least `buckets` buckets
+    int levelFor(int buckets) const;
+};
+
+/*
+ * WaveformCache produces Waveforms for the seek bar. Overviews are computed
+ * as INTERACTIVE JobScheduler jobs and stored on disk under a fingerprint of the
+ * file (path, size and modification time), so a track that was shown before
+ * is displayed straight from the cache, and a file that changed is measured
+ * again. A few recent ones are also kept in memory.
+ */
+class WaveformCache : public QObject {
+    Q_OBJECT
+
+public:
+    WaveformCache(QObject *parent = 0);
+    ~WaveformCache();
+
+    // returns true and fills waveform if it is cached (memory or disk);
+    // otherwise starts generating it and emits ready() when done
+    bool request(const QString &absFilePath, Waveform &waveform);
+
+    // statistics
+    int hits() const;
+    int misses() const;
+    double realtimeFactorPerCore() const;
+
+    // filled in by the worker threads and picked up by collectResults()
+    void post(const QString &absFilePath, const Waveform &waveform, qint64 cpuMs);
+
+signals:
+    void ready(QString absFilePath);
+
+private slots:
+    void collectResults();
+
+private:
+    struct Pending {
+        QString absFilePath;
+        Waveform waveform;
+        qint64 cpuMs;
+    };
+
+    QString cacheFile(const QFileInfo &info) const;
+    bool load(const QString &fileName, Waveform &waveform) const;
+    bool save(const QString &fileName, const Waveform &waveform) const;
+    void remember(const QString &absFilePath, const Waveform &waveform);
+
+    JobScheduler *scheduler;
+    QString cacheDir;
+    QHash<QString, Waveform> memory;
+    QList<QString> lruOrder;
+    int memoryEntries;
+    QList<QString> generating;
+
+    QMutex resultsLock;
+    QList<Pending> results;
+
+    int hitCount;
+    int missCount;
+    double audioSeconds;
+    qint64 cpuMs;
+};
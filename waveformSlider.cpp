@@ -0,0 +1,62 @@
+#include "waveformSlider.h"
+#include <QPainter>
+#include <QStyleOptionSlider>
+
+WaveformSlider::WaveformSlider(QWidget *parent) : QSlider(Qt::Horizontal, parent) {
+    setMinimumHeight(32);
+}
+
+void WaveformSlider::setWaveform(const Waveform &w) {
+    waveform = w;
+    update();
+}
+
+void WaveformSlider::clearWaveform() {
+    waveform = Waveform();
+    update();
+}
+
+void WaveformSlider::paintEvent(QPaintEvent *event) {
+    if (waveform.isEmpty()) {
+        QSlider::paintEvent(event);
+        return;
+    }
+
+    QStyleOptionSlider opt;
+    initStyleOption(&opt);
+    QRect groove = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderGroove, this);
+    int width = groove.width();
+    int mid = rect().center().y();
+    int halfHeight = rect().height() / 2 - 1;
+    int playedX = maximum() > minimum()
+            ? groove.left() + (int)((qint64)width * (value() - minimum()) / (maximum() - minimum()))
+            : groove.left();
+
+    // one vertical line per pixel, from the coarsest level that still has a
+    // bucket per pixel
+    QPainter painter(this);
+    int level = waveform.levelFor(width);
+    // signed, whatever the platform's char is
+    const qint8 *peaks = reinterpret_cast<const qint8 *>(waveform.levels[level].constData());
+    int buckets = waveform.buckets(level);
+    QColor played = palette().color(QPalette::Highlight);
+    QColor unplayed = palette().color(QPalette::Mid);
+    for (int x = 0; x < width; x++) {
+        int first = (int)((qint64)x * buckets / width);
+        int last = qMax(first + 1, (int)((qint64)(x + 1) * buckets / width));
+        int lo = 0, hi = 0;
+        for (int b = first; b < last && b < buckets; b++) {
+            lo = qMin(lo, (int)peaks[2*b]);
+            hi = qMax(hi, (int)peaks[2*b+1]);
+        }
+        painter.setPen(groove.left() + x < playedX ? played : unplayed);
+        painter.drawLine(groove.left() + x, mid - hi * halfHeight / 127,
+                         groove.left() + x, mid - lo * halfHeight / 127);
+    }
+    painter.end();
+
+    // only the handle on top, the waveform takes the groove's place
+    QPainter handlePainter(this);
+    opt.subControls = QStyle::SC_SliderHandle;
+    style()->drawComplexControl(QStyle::CC_Slider, &opt, &handlePainter, this);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "debug.h"
+#include "waveformCache.h"
+#include <QSlider>
+
+/*
+ * Seek slider that draws the track's min/max overview behind the handle,
+ * the part already played in the highlight colour. Without a waveform it
+ * looks like a plain QSlider.
+ */
+class WaveformSlider : public QSlider {
+    Q_OBJECT
+
+public:
+    WaveformSlider(QWidget *parent = 0);
+
+    void setWaveform(const Waveform &waveform);
+    void clearWaveform();
+
+protected:
+    virtual void paintEvent(QPaintEvent *event);
+
+private:
+    Waveform waveform;
+};